@@ -0,0 +1,572 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+// For pread and fstat (POSIX extensions).
+#define _POSIX_C_SOURCE 200809L
+
+#include "cactusGlobalsPrivate.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+/*
+ * The file is laid out as:
+ *
+ * magic (8 bytes), the blocks (each a record written by a codec, holding a run of entries sorted by key),
+ * the index (an entry for each block, in order),
+ * the footer (the number of blocks, the number of entries, the offset of the index, then the magic again).
+ *
+ * A decompressed block is a sequence of entries, each its key, type and size (int64s) followed by its bytes.
+ */
+static const char archiveMagic[8] = { 'C', 'A', 'C', 'T', 'A', 'R', 'C', '1' };
+
+#define ARCHIVE_BLOCK_SIZE 1048576 //A block is closed once it holds this many bytes of entries, before compression.
+#define ARCHIVE_ENTRY_HEADER_SIZE (3 * sizeof(int64_t))
+
+typedef enum {
+    ARCHIVE_RECORD = 0, ARCHIVE_INT64 = 1
+} ArchiveEntryType;
+
+typedef struct _archiveBlockEntry {
+    int64_t firstKey;
+    int64_t lastKey;
+    int64_t offset;
+    int64_t size;
+    int64_t entryNumber;
+} ArchiveBlockEntry;
+
+typedef struct _archiveFooter {
+    int64_t blockNumber;
+    int64_t entryNumber;
+    int64_t indexOffset;
+    char magic[8];
+} ArchiveFooter;
+
+struct _cactusArchive {
+    char *archiveFile;
+    int fd;
+    ArchiveBlockEntry *blocks;
+    int64_t blockNumber;
+    int64_t entryNumber;
+    CactusCodec *codec; //Decompresses the blocks, whatever codec wrote them.
+};
+
+struct _cactusArchiveWriter {
+    char *archiveFile;
+    char *spillFile;
+    CactusSnapshotWriter *spill; //The records, in the order they are added, sorted when the spill is finished.
+    stList *counters; //The counters, as stIntTuples of key and value.
+    int64_t threadNumber;
+};
+
+/*
+ * Reading.
+ */
+
+static void readBytes(CactusArchive *archive, void *bytes, int64_t size, int64_t offset) {
+    int64_t i = 0;
+    while (i < size) {
+        ssize_t j = pread(archive->fd, (char *) bytes + i, size - i, offset + i);
+        if (j <= 0) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to read the archive %s", archive->archiveFile);
+        }
+        i += j;
+    }
+}
+
+CactusArchive *cactusArchive_construct(const char *archiveFile) {
+    int fd = open(archiveFile, O_RDONLY);
+    if (fd == -1) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to open the archive %s: %s", archiveFile, strerror(errno));
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to stat the archive %s", archiveFile);
+    }
+    CactusArchive *archive = st_calloc(1, sizeof(CactusArchive));
+    archive->archiveFile = stString_copy(archiveFile);
+    archive->fd = fd;
+    int64_t fileSize = fileStat.st_size;
+    char magic[8];
+    ArchiveFooter footer;
+    bool isArchive = fileSize >= (int64_t) (sizeof(archiveMagic) + sizeof(ArchiveFooter));
+    if (isArchive) {
+        readBytes(archive, magic, sizeof(magic), 0);
+        readBytes(archive, &footer, sizeof(ArchiveFooter), fileSize - sizeof(ArchiveFooter));
+        isArchive = memcmp(magic, archiveMagic, sizeof(archiveMagic)) == 0
+                && memcmp(footer.magic, archiveMagic, sizeof(archiveMagic)) == 0 && footer.blockNumber >= 0
+                && footer.indexOffset + footer.blockNumber * (int64_t) sizeof(ArchiveBlockEntry)
+                        + (int64_t) sizeof(ArchiveFooter) == fileSize;
+    }
+    if (!isArchive) {
+        cactusArchive_destruct(archive);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The file %s is not an archive, or is corrupt", archiveFile);
+    }
+    archive->blockNumber = footer.blockNumber;
+    archive->entryNumber = footer.entryNumber;
+    archive->blocks = st_malloc(archive->blockNumber * sizeof(ArchiveBlockEntry) + 1);
+    readBytes(archive, archive->blocks, archive->blockNumber * sizeof(ArchiveBlockEntry), footer.indexOffset);
+    archive->codec = cactusCodec_construct(CACTUS_CODEC_NONE, 0, CACTUS_CODEC_NONE);
+    st_logDebug("Opened the archive %s, containing %" PRIi64 " records in %" PRIi64 " blocks\n", archiveFile,
+            archive->entryNumber, archive->blockNumber);
+    return archive;
+}
+
+void cactusArchive_destruct(CactusArchive *archive) {
+    close(archive->fd);
+    if (archive->codec != NULL) {
+        cactusCodec_destruct(archive->codec);
+    }
+    free(archive->blocks);
+    free(archive->archiveFile);
+    free(archive);
+}
+
+int64_t cactusArchive_getRecordNumber(CactusArchive *archive) {
+    return archive->entryNumber;
+}
+
+int64_t cactusArchive_getBlockNumber(CactusArchive *archive) {
+    return archive->blockNumber;
+}
+
+static char *readBlock(CactusArchive *archive, int64_t blockIndex, int64_t *blockSize) {
+    /*
+     * Reads and decompresses the block. May be called by several threads at once.
+     */
+    ArchiveBlockEntry *blockEntry = archive->blocks + blockIndex;
+    char *compressedBlock = st_malloc(blockEntry->size + 1);
+    readBytes(archive, compressedBlock, blockEntry->size, blockEntry->offset);
+    char *block = cactusCodec_decompress(archive->codec, compressedBlock, blockEntry->size, blockSize);
+    free(compressedBlock);
+    return block;
+}
+
+static int64_t parseEntry(CactusArchive *archive, const char *block, int64_t blockSize, int64_t offset, int64_t *key,
+        int64_t *type, int64_t *size) {
+    /*
+     * Parses the header of the entry at the given offset of the block, returning the offset of its bytes.
+     */
+    int64_t header[3];
+    if (offset + (int64_t) ARCHIVE_ENTRY_HEADER_SIZE > blockSize) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "A block of the archive %s is corrupt", archive->archiveFile);
+    }
+    memcpy(header, block + offset, ARCHIVE_ENTRY_HEADER_SIZE);
+    *key = header[0];
+    *type = header[1];
+    *size = header[2];
+    offset += ARCHIVE_ENTRY_HEADER_SIZE;
+    if (*size < 0 || offset + *size > blockSize || (*type != ARCHIVE_RECORD && *type != ARCHIVE_INT64)
+            || (*type == ARCHIVE_INT64 && *size != sizeof(int64_t))) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "A block of the archive %s is corrupt", archive->archiveFile);
+    }
+    return offset;
+}
+
+void *cactusArchive_getRecord(CactusArchive *archive, int64_t key, int64_t *recordSize) {
+    /*
+     * Binary search for the block that would hold the key, then scan it.
+     */
+    int64_t i = 0, j = archive->blockNumber;
+    while (i < j) {
+        int64_t k = (i + j) / 2;
+        if (archive->blocks[k].lastKey < key) {
+            i = k + 1;
+        } else {
+            j = k;
+        }
+    }
+    if (i == archive->blockNumber || archive->blocks[i].firstKey > key) {
+        return NULL;
+    }
+    int64_t blockSize;
+    char *block = readBlock(archive, i, &blockSize);
+    void *record = NULL;
+    for (int64_t offset = 0; offset < blockSize && record == NULL;) {
+        int64_t entryKey, type, size;
+        offset = parseEntry(archive, block, blockSize, offset, &entryKey, &type, &size);
+        if (entryKey == key) {
+            record = st_malloc(size + 1);
+            memcpy(record, block + offset, size);
+            *recordSize = size;
+        }
+        offset += size;
+    }
+    free(block);
+    return record;
+}
+
+/*
+ * Importing. Each thread takes the next block to import until there are none left, and decompresses and parses it,
+ * then inserts its records in one bulk request. The threads share one connection, to a local database or a
+ * stKVDatabase, so the inserts are serialised under the mutex, while the other threads keep decompressing.
+ */
+
+typedef struct _archiveImport {
+    CactusArchive *archive;
+    CactusLocalDatabase *localDatabase; //If non-null, the database is a local database.
+    stKVDatabase *database;
+    pthread_mutex_t mutex;
+    int64_t nextBlock;
+    int64_t entryNumber; //The number of records and counters imported.
+    char *errorMessage; //If non-null, a thread failed with this error.
+} ArchiveImport;
+
+typedef struct _archiveImportThread {
+    ArchiveImport *import;
+    char *block;
+    stList *requests;
+    stList *counters; //The key and value of each counter of the block.
+} ArchiveImportThread;
+
+static void insertBlock(ArchiveImport *import, ArchiveImportThread *importThread) {
+    for (int64_t i = 0; i < stList_length(importThread->counters); i++) {
+        stIntTuple *counter = stList_get(importThread->counters, i);
+        if (import->localDatabase != NULL) {
+            cactusLocalDatabase_insertInt64(import->localDatabase, stIntTuple_get(counter, 0),
+                    stIntTuple_get(counter, 1));
+        } else {
+            stKVDatabase_insertInt64(import->database, stIntTuple_get(counter, 0), stIntTuple_get(counter, 1));
+        }
+    }
+    if (stList_length(importThread->requests) > 0) {
+        if (import->localDatabase != NULL) {
+            cactusLocalDatabase_bulkSetRecords(import->localDatabase, importThread->requests);
+        } else {
+            stKVDatabase_bulkSetRecords(import->database, importThread->requests);
+        }
+    }
+}
+
+static void importBlock(ArchiveImportThread *importThread, int64_t blockIndex) {
+    ArchiveImport *import = importThread->import;
+    int64_t blockSize;
+    importThread->block = readBlock(import->archive, blockIndex, &blockSize);
+    importThread->requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    importThread->counters = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+    int64_t entryNumber = 0;
+    for (int64_t offset = 0; offset < blockSize; entryNumber++) {
+        int64_t key, type, size;
+        offset = parseEntry(import->archive, importThread->block, blockSize, offset, &key, &type, &size);
+        if (type == ARCHIVE_RECORD) {
+            stList_append(importThread->requests,
+                    stKVDatabaseBulkRequest_constructInsertRequest(key, importThread->block + offset, size));
+        } else {
+            int64_t value;
+            memcpy(&value, importThread->block + offset, sizeof(int64_t));
+            stList_append(importThread->counters, stIntTuple_construct2(key, value));
+        }
+        offset += size;
+    }
+    if (entryNumber != import->archive->blocks[blockIndex].entryNumber) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "A block of the archive %s is corrupt", import->archive->archiveFile);
+    }
+    pthread_mutex_lock(&import->mutex);
+    stTry {
+        insertBlock(import, importThread);
+        import->entryNumber += entryNumber;
+    } stCatch(except) {
+        pthread_mutex_unlock(&import->mutex);
+        stThrow(except);
+    } stTryEnd;
+    pthread_mutex_unlock(&import->mutex);
+    stList_destruct(importThread->requests);
+    importThread->requests = NULL;
+    stList_destruct(importThread->counters);
+    importThread->counters = NULL;
+    free(importThread->block);
+    importThread->block = NULL;
+}
+
+static void *importBlocks(ArchiveImport *import) {
+    ArchiveImportThread *importThread = st_calloc(1, sizeof(ArchiveImportThread));
+    importThread->import = import;
+    stTry {
+        while (1) {
+            pthread_mutex_lock(&import->mutex);
+            int64_t blockIndex = import->nextBlock++;
+            pthread_mutex_unlock(&import->mutex);
+            if (blockIndex >= import->archive->blockNumber) {
+                break;
+            }
+            importBlock(importThread, blockIndex);
+        }
+    } stCatch(except) {
+        pthread_mutex_lock(&import->mutex);
+        if (import->errorMessage == NULL) {
+            import->errorMessage = stString_copy(stExcept_getMsg(except));
+        }
+        import->nextBlock = import->archive->blockNumber; //Stop the other threads.
+        pthread_mutex_unlock(&import->mutex);
+        stExcept_free(except);
+    } stTryEnd;
+    if (importThread->requests != NULL) {
+        stList_destruct(importThread->requests);
+    }
+    if (importThread->counters != NULL) {
+        stList_destruct(importThread->counters);
+    }
+    free(importThread->block);
+    free(importThread);
+    return NULL;
+}
+
+int64_t cactusArchive_import(CactusArchive *archive, const char *databaseString, bool create, int64_t threadNumber) {
+    ArchiveImport import;
+    memset(&import, 0, sizeof(ArchiveImport));
+    import.archive = archive;
+    char *localDatabaseDir = cactusLocalDatabase_getDatabaseDirFromConfString(databaseString);
+    stKVDatabaseConf *conf = NULL;
+    if (localDatabaseDir != NULL) {
+        import.localDatabase = cactusLocalDatabase_construct(localDatabaseDir, create);
+        free(localDatabaseDir);
+    } else {
+        conf = stKVDatabaseConf_constructFromString(databaseString);
+        import.database = stKVDatabase_construct(conf, create);
+    }
+    pthread_mutex_init(&import.mutex, NULL);
+    threadNumber = threadNumber < archive->blockNumber ? threadNumber : archive->blockNumber;
+    threadNumber = threadNumber > 1 ? threadNumber : 1;
+    pthread_t *threads = st_malloc(threadNumber * sizeof(pthread_t));
+    int64_t startedThreadNumber = 0;
+    while (startedThreadNumber < threadNumber
+            && pthread_create(&threads[startedThreadNumber], NULL, (void *(*)(void *)) importBlocks, &import) == 0) {
+        startedThreadNumber++;
+    }
+    if (startedThreadNumber < threadNumber) {
+        pthread_mutex_lock(&import.mutex);
+        if (import.errorMessage == NULL) {
+            import.errorMessage = stString_copy("Failed to start a thread");
+        }
+        import.nextBlock = archive->blockNumber; //Stop the started threads.
+        pthread_mutex_unlock(&import.mutex);
+    }
+    for (int64_t i = 0; i < startedThreadNumber; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    pthread_mutex_destroy(&import.mutex);
+    if (import.localDatabase != NULL) {
+        cactusLocalDatabase_destruct(import.localDatabase);
+    } else {
+        stKVDatabase_destruct(import.database);
+        stKVDatabaseConf_destruct(conf);
+    }
+    if (import.errorMessage != NULL) {
+        char *errorMessage = import.errorMessage;
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to import the archive %s: %s", archive->archiveFile,
+                errorMessage);
+    }
+    st_logDebug("Imported %" PRIi64 " records from the archive %s\n", import.entryNumber, archive->archiveFile);
+    return import.entryNumber;
+}
+
+/*
+ * Writing.
+ */
+
+CactusArchiveWriter *cactusArchiveWriter_construct(const char *archiveFile, int64_t threadNumber) {
+    CactusArchiveWriter *writer = st_calloc(1, sizeof(CactusArchiveWriter));
+    writer->archiveFile = stString_copy(archiveFile);
+    writer->spillFile = stString_print("%s.spill%i", archiveFile, (int) getpid());
+    writer->spill = cactusSnapshotWriter_construct(writer->spillFile, 0);
+    writer->counters = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+    writer->threadNumber = threadNumber > 1 ? threadNumber : 1;
+    return writer;
+}
+
+void cactusArchiveWriter_add(CactusArchiveWriter *writer, int64_t key, const void *record, int64_t recordSize) {
+    cactusSnapshotWriter_add(writer->spill, key, record, recordSize);
+}
+
+void cactusArchiveWriter_addInt64(CactusArchiveWriter *writer, int64_t key, int64_t value) {
+    stList_append(writer->counters, stIntTuple_construct2(key, value));
+}
+
+typedef struct _archiveBlock {
+    CactusCodec *codec;
+    char *block;
+    int64_t blockSize;
+    int64_t maxBlockSize;
+    ArchiveBlockEntry entry;
+    void *compressedBlock;
+} ArchiveBlock;
+
+static ArchiveBlock *archiveBlock_construct(CactusCodec *codec) {
+    ArchiveBlock *archiveBlock = st_calloc(1, sizeof(ArchiveBlock));
+    archiveBlock->codec = codec;
+    archiveBlock->maxBlockSize = ARCHIVE_BLOCK_SIZE;
+    archiveBlock->block = st_malloc(archiveBlock->maxBlockSize);
+    return archiveBlock;
+}
+
+static void archiveBlock_destruct(ArchiveBlock *archiveBlock) {
+    free(archiveBlock->block);
+    free(archiveBlock->compressedBlock);
+    free(archiveBlock);
+}
+
+static void archiveBlock_append(ArchiveBlock *archiveBlock, const void *bytes, int64_t size) {
+    if (archiveBlock->blockSize + size > archiveBlock->maxBlockSize) {
+        archiveBlock->maxBlockSize = 2 * (archiveBlock->blockSize + size);
+        archiveBlock->block = st_realloc(archiveBlock->block, archiveBlock->maxBlockSize);
+    }
+    memcpy(archiveBlock->block + archiveBlock->blockSize, bytes, size);
+    archiveBlock->blockSize += size;
+}
+
+static void archiveBlock_add(ArchiveBlock *archiveBlock, int64_t key, ArchiveEntryType type, const void *bytes,
+        int64_t size) {
+    if (archiveBlock->entry.entryNumber++ == 0) {
+        archiveBlock->entry.firstKey = key;
+    }
+    archiveBlock->entry.lastKey = key;
+    int64_t header[3] = { key, type, size };
+    archiveBlock_append(archiveBlock, header, ARCHIVE_ENTRY_HEADER_SIZE);
+    archiveBlock_append(archiveBlock, bytes, size);
+}
+
+static ArchiveBlock *archiveBlock_compress(ArchiveBlock *archiveBlock) {
+    archiveBlock->compressedBlock = cactusCodec_compress(archiveBlock->codec, archiveBlock->block,
+            archiveBlock->blockSize, &archiveBlock->entry.size);
+    free(archiveBlock->block); //Free the uncompressed block as soon as we are done with it.
+    archiveBlock->block = NULL;
+    return archiveBlock;
+}
+
+static void writeArchiveBytes(FILE *fileHandle, const char *file, const void *bytes, int64_t size, int64_t *offset) {
+    if (fwrite(bytes, 1, size, fileHandle) != (size_t) size) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to write to the archive %s", file);
+    }
+    *offset += size;
+}
+
+static void writeBlocks(CactusArchiveWriter *writer, stList *archiveBlocks, FILE *fileHandle, const char *tempFile,
+        int64_t *offset, stList *blockEntries) {
+    /*
+     * Compresses the blocks, in parallel if we have threads, then writes them in order and empties the list.
+     */
+    int64_t threadNumber = writer->threadNumber < stList_length(archiveBlocks) ? writer->threadNumber
+            : stList_length(archiveBlocks);
+    if (threadNumber <= 1) {
+        for (int64_t i = 0; i < stList_length(archiveBlocks); i++) {
+            archiveBlock_compress(stList_get(archiveBlocks, i));
+        }
+    } else {
+        stThreadPool *threadPool = stThreadPool_construct(threadNumber, (void *(*)(void *)) archiveBlock_compress,
+                cactusMisc_threadPoolNoFinish);
+        for (int64_t i = 0; i < stList_length(archiveBlocks); i++) {
+            stThreadPool_push(threadPool, stList_get(archiveBlocks, i));
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+    }
+    while (stList_length(archiveBlocks) > 0) {
+        ArchiveBlock *archiveBlock = stList_remove(archiveBlocks, 0);
+        archiveBlock->entry.offset = *offset;
+        writeArchiveBytes(fileHandle, tempFile, archiveBlock->compressedBlock, archiveBlock->entry.size, offset);
+        ArchiveBlockEntry *blockEntry = st_malloc(sizeof(ArchiveBlockEntry));
+        *blockEntry = archiveBlock->entry;
+        stList_append(blockEntries, blockEntry);
+        archiveBlock_destruct(archiveBlock);
+    }
+}
+
+void cactusArchiveWriter_finish(CactusArchiveWriter *writer) {
+    /*
+     * Sort the records, by finishing the spill, and the counters.
+     */
+    cactusSnapshotWriter_finish(writer->spill);
+    CactusSnapshot *spill = cactusSnapshot_construct(writer->spillFile);
+    stList_sort(writer->counters, (int (*)(const void *, const void *)) stIntTuple_cmpFn);
+    for (int64_t i = 0; i < stList_length(writer->counters); i++) {
+        int64_t key = stIntTuple_get(stList_get(writer->counters, i), 0);
+        if ((i > 0 && stIntTuple_get(stList_get(writer->counters, i - 1), 0) == key)
+                || cactusSnapshot_containsRecord(spill, key)) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The record %" PRIi64 " was written twice to the archive %s", key,
+                    writer->archiveFile);
+        }
+    }
+
+    /*
+     * Merge the records and counters, in order of their keys, into blocks, which are compressed in batches of a block per thread.
+     */
+    char *tempFile = stString_print("%s.tmp%i", writer->archiveFile, (int) getpid());
+    FILE *fileHandle = fopen(tempFile, "wb");
+    if (fileHandle == NULL) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to create the archive %s: %s", tempFile, strerror(errno));
+    }
+    CactusCodec *codec = cactusCodec_isAvailable(CACTUS_CODEC_ZSTD) ? cactusCodec_construct(CACTUS_CODEC_ZSTD, 3,
+            CACTUS_CODEC_NONE) : cactusCodec_construct(CACTUS_CODEC_ZLIB, -1, CACTUS_CODEC_NONE);
+    int64_t offset = 0;
+    writeArchiveBytes(fileHandle, tempFile, archiveMagic, sizeof(archiveMagic), &offset);
+    stList *archiveBlocks = stList_construct();
+    stList *blockEntries = stList_construct3(0, free);
+    ArchiveBlock *archiveBlock = archiveBlock_construct(codec);
+    int64_t recordNumber = cactusSnapshot_getRecordNumber(spill), counterNumber = stList_length(writer->counters);
+    for (int64_t i = 0, j = 0; i < recordNumber || j < counterNumber;) {
+        int64_t key, recordSize;
+        const void *record = i < recordNumber ? cactusSnapshot_getRecordByIndex(spill, i, &key, &recordSize) : NULL;
+        stIntTuple *counter = j < counterNumber ? stList_get(writer->counters, j) : NULL;
+        if (record != NULL && (counter == NULL || key < stIntTuple_get(counter, 0))) {
+            archiveBlock_add(archiveBlock, key, ARCHIVE_RECORD, record, recordSize);
+            i++;
+        } else {
+            int64_t value = stIntTuple_get(counter, 1);
+            archiveBlock_add(archiveBlock, stIntTuple_get(counter, 0), ARCHIVE_INT64, &value, sizeof(int64_t));
+            j++;
+        }
+        if (archiveBlock->blockSize >= ARCHIVE_BLOCK_SIZE) {
+            stList_append(archiveBlocks, archiveBlock);
+            archiveBlock = archiveBlock_construct(codec);
+            if (stList_length(archiveBlocks) >= writer->threadNumber) {
+                writeBlocks(writer, archiveBlocks, fileHandle, tempFile, &offset, blockEntries);
+            }
+        }
+    }
+    if (archiveBlock->entry.entryNumber > 0) {
+        stList_append(archiveBlocks, archiveBlock);
+    } else {
+        archiveBlock_destruct(archiveBlock);
+    }
+    writeBlocks(writer, archiveBlocks, fileHandle, tempFile, &offset, blockEntries);
+
+    /*
+     * Write the index and footer, then move the archive into place.
+     */
+    ArchiveFooter footer;
+    footer.blockNumber = stList_length(blockEntries);
+    footer.entryNumber = recordNumber + counterNumber;
+    footer.indexOffset = offset;
+    memcpy(footer.magic, archiveMagic, sizeof(archiveMagic));
+    for (int64_t i = 0; i < stList_length(blockEntries); i++) {
+        writeArchiveBytes(fileHandle, tempFile, stList_get(blockEntries, i), sizeof(ArchiveBlockEntry), &offset);
+    }
+    writeArchiveBytes(fileHandle, tempFile, &footer, sizeof(ArchiveFooter), &offset);
+    if (fclose(fileHandle) != 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to close the archive %s", tempFile);
+    }
+    if (rename(tempFile, writer->archiveFile) != 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to move the archive %s to %s: %s", tempFile, writer->archiveFile,
+                strerror(errno));
+    }
+    st_logDebug("Wrote the archive %s, containing %" PRIi64 " records in %" PRIi64 " blocks\n", writer->archiveFile,
+            footer.entryNumber, footer.blockNumber);
+
+    cactusSnapshot_destruct(spill);
+    remove(writer->spillFile);
+    cactusCodec_destruct(codec);
+    stList_destruct(archiveBlocks);
+    stList_destruct(blockEntries);
+    free(tempFile);
+    free(writer->archiveFile);
+    free(writer->spillFile);
+    stList_destruct(writer->counters);
+    free(writer);
+}
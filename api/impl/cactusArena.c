@@ -0,0 +1,138 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <pthread.h>
+#include "cactusGlobalsPrivate.h"
+
+/*
+ * Sizes are rounded up to a multiple of eight bytes, giving a free list for each multiple up to the
+ * maximum size. The slabs double in size, from small ones, so the many flowers with few objects waste little
+ * memory, to big ones, so flowers with millions of caps need few slabs.
+ */
+#define ARENA_ALIGNMENT 8
+#define ARENA_SIZE_CLASSES (CACTUS_ARENA_MAX_SIZE / ARENA_ALIGNMENT)
+#define ARENA_MIN_SLAB_SIZE 1024
+#define ARENA_MAX_SLAB_SIZE 65536
+
+typedef struct _arenaSlab ArenaSlab;
+
+struct _arenaSlab {
+    ArenaSlab *next;
+    int64_t size; //Of the slab, including this header.
+};
+
+typedef struct _freeChunk FreeChunk;
+
+struct _freeChunk {
+    FreeChunk *next;
+};
+
+struct _cactusArena {
+    ArenaSlab *slabs;
+    char *top; //The next free byte of the current slab.
+    char *limit; //The end of the current slab.
+    int64_t size;
+    FreeChunk *freeLists[ARENA_SIZE_CLASSES];
+    stList *retainedArenas;
+    int64_t references;
+};
+
+//Arenas are retained by the flowers objects are moved to, which may be released by other threads.
+static pthread_mutex_t referencesMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline int64_t getSizeClass(size_t size) {
+    assert(size > 0 && size <= CACTUS_ARENA_MAX_SIZE);
+    return (size - 1) / ARENA_ALIGNMENT;
+}
+
+static void addSlab(CactusArena *arena, size_t size) {
+    int64_t slabSize = arena->slabs == NULL ? ARENA_MIN_SLAB_SIZE : arena->slabs->size * 2;
+    if (slabSize > ARENA_MAX_SLAB_SIZE) {
+        slabSize = ARENA_MAX_SLAB_SIZE;
+    }
+    ArenaSlab *slab = st_malloc(slabSize);
+    slab->next = arena->slabs;
+    slab->size = slabSize;
+    arena->slabs = slab;
+    arena->size += slabSize;
+    arena->top = (char *) slab + ((sizeof(ArenaSlab) + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT) * ARENA_ALIGNMENT;
+    arena->limit = (char *) slab + slabSize;
+    assert(arena->top + size <= arena->limit);
+}
+
+CactusArena *cactusArena_construct(void) {
+    CactusArena *arena = st_calloc(1, sizeof(CactusArena));
+    arena->references = 1;
+    return arena;
+}
+
+void *cactusArena_malloc(CactusArena *arena, size_t size) {
+    int64_t sizeClass = getSizeClass(size);
+    FreeChunk *chunk = arena->freeLists[sizeClass];
+    if (chunk != NULL) {
+        arena->freeLists[sizeClass] = chunk->next;
+        return chunk;
+    }
+    size = (sizeClass + 1) * ARENA_ALIGNMENT;
+    if ((size_t) (arena->limit - arena->top) < size) { //The rest of the slab is left unused.
+        addSlab(arena, size);
+    }
+    void *ptr = arena->top;
+    arena->top += size;
+    return ptr;
+}
+
+void cactusArena_free(CactusArena *arena, void *ptr, size_t size) {
+    int64_t sizeClass = getSizeClass(size);
+    FreeChunk *chunk = ptr;
+    chunk->next = arena->freeLists[sizeClass];
+    arena->freeLists[sizeClass] = chunk;
+}
+
+void cactusArena_retain(CactusArena *arena, CactusArena *otherArena) {
+    if (arena == otherArena) {
+        return;
+    }
+    if (arena->retainedArenas == NULL) {
+        arena->retainedArenas = stList_construct();
+    }
+    //Objects are moved in runs from the same flower, so the last arena retained is checked first.
+    for (int64_t i = stList_length(arena->retainedArenas) - 1; i >= 0; i--) {
+        if (stList_get(arena->retainedArenas, i) == otherArena) {
+            return;
+        }
+    }
+    pthread_mutex_lock(&referencesMutex);
+    otherArena->references++;
+    pthread_mutex_unlock(&referencesMutex);
+    stList_append(arena->retainedArenas, otherArena);
+}
+
+void cactusArena_release(CactusArena *arena) {
+    pthread_mutex_lock(&referencesMutex);
+    int64_t references = --arena->references;
+    pthread_mutex_unlock(&referencesMutex);
+    assert(references >= 0);
+    if (references > 0) {
+        return;
+    }
+    while (arena->slabs != NULL) {
+        ArenaSlab *slab = arena->slabs;
+        arena->slabs = slab->next;
+        free(slab);
+    }
+    if (arena->retainedArenas != NULL) {
+        for (int64_t i = 0; i < stList_length(arena->retainedArenas); i++) {
+            cactusArena_release(stList_get(arena->retainedArenas, i));
+        }
+        stList_destruct(arena->retainedArenas);
+    }
+    free(arena);
+}
+
+int64_t cactusArena_getSize(CactusArena *arena) {
+    return arena->size;
+}
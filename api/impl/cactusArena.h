@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_ARENA_H_
+#define CACTUS_ARENA_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Arenas.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * An arena is the memory the caps, ends, segments and blocks of a flower are allocated from. Objects are carved
+ * from slabs of growing size, and freed objects are kept on a list for each size and reused, so the slabs are only
+ * returned to the system, all at once, when the arena is released.
+ *
+ * An arena is not thread safe, except for retaining and releasing it, as it belongs to a flower, which is only
+ * changed by one thread at a time.
+ */
+typedef struct _cactusArena CactusArena;
+
+/*
+ * The biggest allocation an arena makes.
+ */
+#define CACTUS_ARENA_MAX_SIZE 256
+
+/*
+ * Constructs an empty arena, held by the caller.
+ */
+CactusArena *cactusArena_construct(void);
+
+/*
+ * Allocates memory of the given size (at most CACTUS_ARENA_MAX_SIZE bytes) from the arena.
+ */
+void *cactusArena_malloc(CactusArena *arena, size_t size);
+
+/*
+ * Returns memory of the given size to the arena, for reuse by its next allocation of that size. The memory may
+ * have been allocated from another arena, if that arena is retained by this one.
+ */
+void cactusArena_free(CactusArena *arena, void *ptr, size_t size);
+
+/*
+ * Makes the arena hold the other arena, so the other arena's memory is not released until this arena
+ * is, for when objects allocated from the other arena are moved to the owner of this arena. Holding an arena
+ * more than once has no further effect.
+ */
+void cactusArena_retain(CactusArena *arena, CactusArena *otherArena);
+
+/*
+ * Lets go of the arena. When an arena is no longer held by its owner or any other arena its memory is released,
+ * and it lets go of the arenas it holds.
+ */
+void cactusArena_release(CactusArena *arena);
+
+/*
+ * Gets the total bytes of the slabs of the arena.
+ */
+int64_t cactusArena_getSize(CactusArena *arena);
+
+#endif
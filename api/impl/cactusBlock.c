@@ -14,6 +14,11 @@
 ////////////////////////////////////////////////
 ////////////////////////////////////////////////
 
+/*
+ * A block, its reverse and their contents are a single allocation from the arena of the block's flower.
+ */
+#define BLOCK_ALLOCATION_SIZE (2 * sizeof(Block) + sizeof(BlockContents))
+
 int blockConstruct_constructP(const void *o1, const void *o2) {
 	return cactusMisc_nameCompare(segment_getName((Segment *)o1), segment_getName((Segment *)o2));
 }
@@ -28,10 +33,10 @@ Block *block_construct2(Name name, int64_t length,
 		End *leftEnd, End *rightEnd,
 		Flower *flower) {
 	Block *block;
-	block = st_malloc(sizeof(Block));
-	block->rBlock = st_malloc(sizeof(Block));
+	block = cactusArena_malloc(flower_getArena(flower), BLOCK_ALLOCATION_SIZE);
+	block->rBlock = block + 1;
 	block->rBlock->rBlock = block;
-	block->blockContents = st_malloc(sizeof(BlockContents));
+	block->blockContents = (BlockContents *) (block + 2);
 	block->rBlock->blockContents = block->blockContents;
 
 	block->orientation = 1;
@@ -64,9 +69,12 @@ void block_destruct(Block *block) {
 	//now the actual instances.
 	stSortedSet_destruct(block->blockContents->segments);
 
-	free(block->rBlock);
-	free(block->blockContents);
-	free(block);
+	cactusArena_free(flower_getArena(block_getFlower(block)), block < block->rBlock ? block : block->rBlock,
+			BLOCK_ALLOCATION_SIZE);
+}
+
+void block_destructWithFlower(Block *block) {
+	stSortedSet_destruct(block->blockContents->segments);
 }
 
 bool block_getOrientation(Block *block) {
@@ -102,6 +110,7 @@ End *block_get3End(Block *block) {
 }
 
 int64_t block_getInstanceNumber(Block *block) {
+	flower_materialise(block_getFlower(block));
 	return stSortedSet_size(block->blockContents->segments);
 }
 
@@ -110,12 +119,12 @@ Segment *block_getInstanceP(Block *block, Segment *connectedSegment) {
 }
 
 Segment *block_getInstance(Block *block, Name name) {
-	Segment segment;
-	segment.name = name;
-	return block_getInstanceP(block, stSortedSet_search(block->blockContents->segments, &segment));
+	Segment *segment = flower_getSegment(block_getFlower(block), name);
+	return segment != NULL && segment_getBlock(segment) == block_getPositiveOrientation(block) ? block_getInstanceP(block, segment) : NULL;
 }
 
 Segment *block_getFirst(Block *block) {
+	flower_materialise(block_getFlower(block));
 	return block_getInstanceP(block, stSortedSet_getFirst(block->blockContents->segments));
 }
 
@@ -133,6 +142,7 @@ void block_setRootInstance(Block *block, Segment *segment) {
 }
 
 Block_InstanceIterator *block_getInstanceIterator(Block *block) {
+	flower_materialise(block_getFlower(block));
 	Block_InstanceIterator *iterator;
 	iterator = st_malloc(sizeof(struct _block_instanceIterator));
 	iterator->block = block;
@@ -355,14 +365,17 @@ bool block_isTrivialChain(Block *block) {
  */
 
 void block_addInstance(Block *block, Segment *segment) {
+	flower_materialise(block_getFlower(block));
 	stSortedSet_insert(block->blockContents->segments, segment_getPositiveOrientation(segment));
 }
 
 void block_removeInstance(Block *block, Segment *segment) {
+	flower_materialise(block_getFlower(block));
 	stSortedSet_remove(block->blockContents->segments, segment_getPositiveOrientation(segment));
 }
 
 void block_setFlower(Block *block, Flower *flower) {
+	cactusArena_retain(flower_getArena(flower), flower_getArena(block_getFlower(block)));
 	flower_removeBlock(block_getFlower(block), block);
 	block->blockContents->flower = flower;
 	flower_addBlock(flower, block);
@@ -390,7 +403,11 @@ void block_writeBinaryRepresentation(Block *block, void (*writeFn)(const void *
 	binaryRepresentation_writeElementType(CODE_BLOCK, writeFn);
 }
 
-Block *block_loadFromBinaryRepresentation(void **binaryString, Flower *flower) {
+static Block *block_loadFromBinaryRepresentationP(void **binaryString, Flower *flower, bool loadBlock, bool loadSegments) {
+	/*
+	 * Reads a block, if one is next. If loadBlock is non-zero the block is constructed, else it is found in the flower.
+	 * If loadSegments is non-zero its segments are constructed, else they are read past.
+	 */
 	Block *block;
 	Name name, leftEndName, rightEndName;
 	int64_t length;
@@ -402,10 +419,33 @@ Block *block_loadFromBinaryRepresentation(void **binaryString, Flower *flower) {
 		length = binaryRepresentation_getInteger(binaryString);
 		leftEndName = binaryRepresentation_getName(binaryString);
 		rightEndName = binaryRepresentation_getName(binaryString);
-		block = block_construct2(name, length, flower_getEnd(flower, leftEndName), flower_getEnd(flower, rightEndName), flower);
-		while(segment_loadFromBinaryRepresentation(binaryString, block) != NULL);
+		if(loadBlock) {
+			block = block_construct2(name, length, flower_getEnd(flower, leftEndName), flower_getEnd(flower, rightEndName), flower);
+		}
+		else {
+			block = flower_getBlock(flower, name);
+			assert(block != NULL);
+		}
+		if(loadSegments) {
+			while(segment_loadFromBinaryRepresentation(binaryString, block) != NULL);
+		}
+		else {
+			while(segment_skipBinaryRepresentation(binaryString));
+		}
 		assert(binaryRepresentation_peekNextElementType(*binaryString) == CODE_BLOCK);
 		binaryRepresentation_popNextElementType(binaryString);
 	}
 	return block;
 }
+
+Block *block_loadFromBinaryRepresentation(void **binaryString, Flower *flower) {
+	return block_loadFromBinaryRepresentationP(binaryString, flower, 1, 1);
+}
+
+Block *block_loadSkeletonFromBinaryRepresentation(void **binaryString, Flower *flower) {
+	return block_loadFromBinaryRepresentationP(binaryString, flower, 1, 0);
+}
+
+Block *block_loadSegmentsFromBinaryRepresentation(void **binaryString, Flower *flower) {
+	return block_loadFromBinaryRepresentationP(binaryString, flower, 0, 1);
+}
@@ -47,6 +47,12 @@ Block *block_construct2(Name name, int64_t length, End *leftEnd, End *rightEnd,
  */
 void block_destruct(Block *block);
 
+/*
+ * Destructs the block and its segments as part of destructing their flower, so they are not detached from the
+ * flower, and their memory is left to be released with the arena of the flower.
+ */
+void block_destructWithFlower(Block *block);
+
 /*
  * Adds in the instance to the block.
  */
@@ -67,6 +73,17 @@ void block_writeBinaryRepresentation(Block *block, void (*writeFn)(const void *
  */
 Block *block_loadFromBinaryRepresentation(void **binaryString, Flower *flower);
 
+/*
+ * As block_loadFromBinaryRepresentation, but reads past the segments of the block rather than constructing them.
+ */
+Block *block_loadSkeletonFromBinaryRepresentation(void **binaryString, Flower *flower);
+
+/*
+ * Reads the binary representation of a block already loaded by block_loadSkeletonFromBinaryRepresentation,
+ * constructing its segments, and returns the block, or NULL if no block is next.
+ */
+Block *block_loadSegmentsFromBinaryRepresentation(void **binaryString, Flower *flower);
+
 /*
  * Sets the flower associated with the block.
  */
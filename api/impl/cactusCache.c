@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+/*
+ * The entries are kept in a hash, keyed by the entries themselves, and in a doubly linked list
+ * from the most to the least recently used.
+ */
+typedef struct _cacheEntry CacheEntry;
+
+struct _cacheEntry {
+    int64_t key;
+    void *value;
+    int64_t size;
+    CacheEntry *previous;
+    CacheEntry *next;
+};
+
+struct _cactusCache {
+    stHash *entries;
+    CacheEntry *mostRecentlyUsed;
+    CacheEntry *leastRecentlyUsed;
+    void (*destructValue)(void *);
+    int64_t size;
+    int64_t maxSize;
+    int64_t hits;
+    int64_t misses;
+    int64_t evictions;
+};
+
+static uint64_t cacheEntry_hashKey(const CacheEntry *entry) {
+    return (uint64_t) entry->key * 0x9E3779B97F4A7C15ULL;
+}
+
+static int cacheEntry_equalsFn(const CacheEntry *entry1, const CacheEntry *entry2) {
+    return entry1->key == entry2->key;
+}
+
+static CacheEntry *getEntry(CactusCache *cache, int64_t key) {
+    CacheEntry entry; //Probe
+    entry.key = key;
+    return stHash_search(cache->entries, &entry);
+}
+
+static void unlinkEntry(CactusCache *cache, CacheEntry *entry) {
+    if (entry->previous != NULL) {
+        entry->previous->next = entry->next;
+    } else {
+        cache->mostRecentlyUsed = entry->next;
+    }
+    if (entry->next != NULL) {
+        entry->next->previous = entry->previous;
+    } else {
+        cache->leastRecentlyUsed = entry->previous;
+    }
+    entry->previous = NULL;
+    entry->next = NULL;
+}
+
+static void linkEntry(CactusCache *cache, CacheEntry *entry) {
+    entry->previous = NULL;
+    entry->next = cache->mostRecentlyUsed;
+    if (cache->mostRecentlyUsed != NULL) {
+        cache->mostRecentlyUsed->previous = entry;
+    } else {
+        cache->leastRecentlyUsed = entry;
+    }
+    cache->mostRecentlyUsed = entry;
+}
+
+static void removeEntry(CactusCache *cache, CacheEntry *entry) {
+    unlinkEntry(cache, entry);
+    stHash_remove(cache->entries, entry);
+    cache->size -= entry->size;
+    if (cache->destructValue != NULL) {
+        cache->destructValue(entry->value);
+    }
+    free(entry);
+}
+
+static void evict(CactusCache *cache) {
+    /*
+     * Evicts the least recently used entries until the cache is in budget, leaving at least the most recently used.
+     */
+    while (cache->size > cache->maxSize && cache->leastRecentlyUsed != cache->mostRecentlyUsed) {
+        removeEntry(cache, cache->leastRecentlyUsed);
+        cache->evictions++;
+    }
+}
+
+CactusCache *cactusCache_construct(int64_t maxSize, void (*destructValue)(void *)) {
+    assert(maxSize >= 0);
+    CactusCache *cache = st_calloc(1, sizeof(CactusCache));
+    cache->entries = stHash_construct3((uint64_t (*)(const void *)) cacheEntry_hashKey,
+            (int (*)(const void *, const void *)) cacheEntry_equalsFn, NULL, NULL);
+    cache->destructValue = destructValue;
+    cache->maxSize = maxSize;
+    return cache;
+}
+
+void cactusCache_destruct(CactusCache *cache) {
+    cactusCache_clear(cache);
+    stHash_destruct(cache->entries);
+    free(cache);
+}
+
+void *cactusCache_get(CactusCache *cache, int64_t key, int64_t *size) {
+    CacheEntry *entry = getEntry(cache, key);
+    if (entry == NULL) {
+        cache->misses++;
+        return NULL;
+    }
+    cache->hits++;
+    unlinkEntry(cache, entry);
+    linkEntry(cache, entry);
+    if (size != NULL) {
+        *size = entry->size;
+    }
+    return entry->value;
+}
+
+bool cactusCache_contains(CactusCache *cache, int64_t key) {
+    return getEntry(cache, key) != NULL;
+}
+
+void cactusCache_insert(CactusCache *cache, int64_t key, void *value, int64_t size) {
+    assert(size >= 0);
+    cactusCache_remove(cache, key);
+    CacheEntry *entry = st_malloc(sizeof(CacheEntry));
+    entry->key = key;
+    entry->value = value;
+    entry->size = size;
+    stHash_insert(cache->entries, entry, entry);
+    linkEntry(cache, entry);
+    cache->size += size;
+    evict(cache);
+}
+
+void cactusCache_remove(CactusCache *cache, int64_t key) {
+    CacheEntry *entry = getEntry(cache, key);
+    if (entry != NULL) {
+        removeEntry(cache, entry);
+    }
+}
+
+void cactusCache_clear(CactusCache *cache) {
+    while (cache->mostRecentlyUsed != NULL) {
+        removeEntry(cache, cache->mostRecentlyUsed);
+    }
+    assert(cache->size == 0);
+}
+
+int64_t cactusCache_getSize(CactusCache *cache) {
+    return cache->size;
+}
+
+int64_t cactusCache_getMaxSize(CactusCache *cache) {
+    return cache->maxSize;
+}
+
+void cactusCache_setMaxSize(CactusCache *cache, int64_t maxSize) {
+    assert(maxSize >= 0);
+    cache->maxSize = maxSize;
+    evict(cache);
+}
+
+int64_t cactusCache_getHits(CactusCache *cache) {
+    return cache->hits;
+}
+
+int64_t cactusCache_getMisses(CactusCache *cache) {
+    return cache->misses;
+}
+
+int64_t cactusCache_getEvictions(CactusCache *cache) {
+    return cache->evictions;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_CACHE_H_
+#define CACTUS_CACHE_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Caches.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * A cache of values keyed by int64s, each with a size in bytes. When the total size of the values
+ * exceeds the cache's budget the least recently used values are evicted (and destructed) until it is back within it.
+ * The cache keeps counts of its hits, misses and evictions.
+ */
+typedef struct _cactusCache CactusCache;
+
+/*
+ * Constructs a cache with the given budget in bytes. The destructor, if non-null, is called on
+ * each value as it is evicted or removed.
+ */
+CactusCache *cactusCache_construct(int64_t maxSize, void (*destructValue)(void *));
+
+/*
+ * Destructs the cache and its values.
+ */
+void cactusCache_destruct(CactusCache *cache);
+
+/*
+ * Gets the value with the given key, making it the most recently used, or returns NULL (and counts a miss)
+ * if it is not in the cache. If size is non-null the size of the value is placed in it.
+ */
+void *cactusCache_get(CactusCache *cache, int64_t key, int64_t *size);
+
+/*
+ * Returns non-zero if the cache contains a value with the given key. Does not change the order of use or the counts.
+ */
+bool cactusCache_contains(CactusCache *cache, int64_t key);
+
+/*
+ * Inserts the value as the most recently used, replacing (and destructing) any value with the same key,
+ * then evicts the least recently used values until the cache is within its budget. The value just
+ * inserted is never evicted, so a value bigger than the budget is held until the next insert.
+ */
+void cactusCache_insert(CactusCache *cache, int64_t key, void *value, int64_t size);
+
+/*
+ * Removes (and destructs) the value with the given key, if there is one.
+ */
+void cactusCache_remove(CactusCache *cache, int64_t key);
+
+/*
+ * Removes (and destructs) all the values.
+ */
+void cactusCache_clear(CactusCache *cache);
+
+/*
+ * Gets the total size of the values in the cache.
+ */
+int64_t cactusCache_getSize(CactusCache *cache);
+
+/*
+ * Gets the budget of the cache.
+ */
+int64_t cactusCache_getMaxSize(CactusCache *cache);
+
+/*
+ * Sets the budget of the cache, evicting values until it is within it.
+ */
+void cactusCache_setMaxSize(CactusCache *cache, int64_t maxSize);
+
+/*
+ * Get the counts of hits, misses and evictions.
+ */
+int64_t cactusCache_getHits(CactusCache *cache);
+
+int64_t cactusCache_getMisses(CactusCache *cache);
+
+int64_t cactusCache_getEvictions(CactusCache *cache);
+
+#endif
@@ -14,6 +14,47 @@
 ////////////////////////////////////////////////
 ////////////////////////////////////////////////
 
+/*
+ * A cap, its reverse and their contents are a single allocation from the arena of the cap's flower.
+ */
+#define CAP_ALLOCATION_SIZE (2 * sizeof(Cap) + sizeof(CapContents))
+
+static inline CapContents *cap_getContents(Cap *cap) {
+    return (CapContents *) (cap_getPositiveOrientation(cap) + 2);
+}
+
+/*
+ * The children of a cap, which are few, are kept in an array of exactly their number.
+ */
+static bool hasChild(Cap *cap, Cap *capChild) {
+    CapContents *capContents = cap_getContents(cap);
+    for (int64_t i = 0; i < capContents->childNumber; i++) {
+        if (capContents->children[i] == capChild) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void addChild(Cap *cap, Cap *capChild) {
+    CapContents *capContents = cap_getContents(cap);
+    assert(capContents->childNumber < INT32_MAX);
+    capContents->children = st_realloc(capContents->children, (capContents->childNumber + 1) * sizeof(Cap *));
+    capContents->children[capContents->childNumber++] = capChild;
+}
+
+static void removeChild(Cap *cap, Cap *capChild) {
+    CapContents *capContents = cap_getContents(cap);
+    for (int64_t i = 0; i < capContents->childNumber; i++) {
+        if (capContents->children[i] == capChild) {
+            memmove(capContents->children + i, capContents->children + i + 1,
+                    (capContents->childNumber - i - 1) * sizeof(Cap *));
+            capContents->childNumber--;
+            return;
+        }
+    }
+}
+
 Cap *cap_construct(End *end, Event *event) {
     return cap_construct3(cactusDisk_getUniqueID(flower_getCactusDisk(end_getFlower(end))), event, end);
 }
@@ -24,26 +65,24 @@ Cap *cap_construct3(Name instance, Event *event, End *end) {
     assert(instance != NULL_NAME);
     Cap *cap;
 
-    cap = st_malloc(sizeof(Cap));
-    cap->capContents = st_malloc(sizeof(CapContents));
-    cap->rCap = st_malloc(sizeof(Cap));
-    cap->rCap->rCap = cap;
-    cap->rCap->capContents = cap->capContents;
-
-    cap->end = end;
-    cap->rCap->end = end_getReverse(end);
-
-    cap->capContents->instance = instance;
-    cap->capContents->coordinate = INT64_MAX;
-    cap->capContents->sequence = NULL;
-    cap->capContents->adjacency = NULL;
-    cap->capContents->adjacency2 = NULL;
-    cap->capContents->face = NULL;
-    cap->capContents->segment = NULL;
-    cap->capContents->parent = NULL;
-    cap->capContents->children = constructEmptyList(0, NULL);
-    cap->capContents->event = event;
-    cap->capContents->strand = end_getOrientation(end);
+    Cap *caps = cactusArena_malloc(flower_getArena(end_getFlower(end)), CAP_ALLOCATION_SIZE);
+    caps[0].end = end_getPositiveOrientation(end);
+    caps[1].end = end_getReverse(caps[0].end);
+    cap = end_getOrientation(end) ? caps : caps + 1;
+
+    CapContents *capContents = cap_getContents(cap);
+    capContents->instance = instance;
+    capContents->coordinate = INT64_MAX;
+    capContents->sequence = NULL;
+    capContents->adjacency = NULL;
+    capContents->adjacency2 = NULL;
+    capContents->face = NULL;
+    capContents->segment = NULL;
+    capContents->parent = NULL;
+    capContents->children = NULL;
+    capContents->childNumber = 0;
+    capContents->event = event;
+    capContents->strand = end_getOrientation(end);
 
     end_addInstance(end, cap);
     flower_addCap(end_getFlower(end), cap);
@@ -58,9 +97,9 @@ Cap *cap_construct2(End *end, int64_t coordinate, bool strand, Sequence *sequenc
 Cap *cap_construct4(Name instance, End *end, int64_t coordinate, bool strand, Sequence *sequence) {
     Cap *cap;
     cap = cap_construct3(instance, sequence_getEvent(sequence), end);
-    cap->capContents->coordinate = coordinate;
-    cap->capContents->strand = cap_getOrientation(cap) ? strand : !strand;
-    cap->capContents->sequence = sequence;
+    cap_getContents(cap)->coordinate = coordinate;
+    cap_getContents(cap)->strand = cap_getOrientation(cap) ? strand : !strand;
+    cap_getContents(cap)->sequence = sequence;
     return cap;
 }
 
@@ -69,9 +108,9 @@ Cap *cap_construct5(Event *event, End *end) {
 }
 
 void cap_setCoordinates(Cap *cap, int64_t coordinate, bool strand, Sequence *sequence) {
-    cap->capContents->coordinate = coordinate;
-    cap->capContents->strand = cap_getOrientation(cap) ? strand : !strand;
-    cap->capContents->sequence = sequence;
+    cap_getContents(cap)->coordinate = coordinate;
+    cap_getContents(cap)->strand = cap_getOrientation(cap) ? strand : !strand;
+    cap_getContents(cap)->sequence = sequence;
 }
 
 Cap *cap_copyConstruct(End *end, Cap *cap) {
@@ -106,25 +145,28 @@ void cap_destruct(Cap *cap) {
     flower_removeCap(end_getFlower(cap_getEnd(cap)), cap);
 
     // Remove parent->child link from parent (if any).
-    Cap *capParent = cap->capContents->parent;
+    cap = cap_getPositiveOrientation(cap);
+    Cap *capParent = cap_getContents(cap)->parent;
     if (capParent != NULL) {
-        listRemove(capParent->capContents->children, cap);
+        removeChild(capParent, cap);
     }
 
     // Remove child->parent link from children (if any).
-    for (int64_t i = 0; i < cap->capContents->children->length; i++) {
-        Cap *capChild = cap->capContents->children->list[i];
-        capChild->capContents->parent = NULL;
+    for (int64_t i = 0; i < cap_getContents(cap)->childNumber; i++) {
+        Cap *capChild = cap_getContents(cap)->children[i];
+        cap_getContents(capChild)->parent = NULL;
     }
 
-    destructList(cap->capContents->children);
-    free(cap->rCap);
-    free(cap->capContents);
-    free(cap);
+    free(cap_getContents(cap)->children);
+    cactusArena_free(flower_getArena(end_getFlower(cap_getEnd(cap))), cap, CAP_ALLOCATION_SIZE);
+}
+
+void cap_destructWithFlower(Cap *cap) {
+    free(cap_getContents(cap)->children);
 }
 
 Name cap_getName(Cap *cap) {
-    return cap->capContents->instance;
+    return cap_getContents(cap)->instance;
 }
 
 bool cap_getOrientation(Cap *cap) {
@@ -136,11 +178,11 @@ Cap *cap_getPositiveOrientation(Cap *cap) {
 }
 
 Cap *cap_getReverse(Cap *cap) {
-    return cap->rCap;
+    return cap_getOrientation(cap) ? cap + 1 : cap - 1;
 }
 
 Event *cap_getEvent(Cap *cap) {
-    return cap->capContents->event;
+    return cap_getContents(cap)->event;
 }
 
 End *cap_getEnd(Cap *cap) {
@@ -148,8 +190,8 @@ End *cap_getEnd(Cap *cap) {
 }
 
 Segment *cap_getSegment(Cap *cap) {
-    return cap_getOrientation(cap) ? cap->capContents->segment
-            : (cap->capContents->segment != NULL ? segment_getReverse(cap->capContents->segment) : NULL);
+    return cap_getOrientation(cap) ? cap_getContents(cap)->segment
+            : (cap_getContents(cap)->segment != NULL ? segment_getReverse(cap_getContents(cap)->segment) : NULL);
 }
 
 Cap *cap_getOtherSegmentCap(Cap *cap) {
@@ -165,11 +207,11 @@ Cap *cap_getOtherSegmentCap(Cap *cap) {
 }
 
 int64_t cap_getCoordinate(Cap *cap) {
-    return cap->capContents->coordinate;
+    return cap_getContents(cap)->coordinate;
 }
 
 bool cap_getStrand(Cap *cap) {
-    return cap_getOrientation(cap) ? cap->capContents->strand : !cap->capContents->strand;
+    return cap_getOrientation(cap) ? cap_getContents(cap)->strand : !cap_getContents(cap)->strand;
 }
 
 bool cap_getSide(Cap *cap) {
@@ -177,7 +219,7 @@ bool cap_getSide(Cap *cap) {
 }
 
 Sequence *cap_getSequence(Cap *cap) {
-    return cap->capContents->sequence;
+    return cap_getContents(cap)->sequence;
 }
 
 void cap_makeAdjacent(Cap *cap, Cap *cap2) {
@@ -189,8 +231,8 @@ void cap_makeAdjacent(Cap *cap, Cap *cap2) {
     cap_breakAdjacency(cap);
     cap_breakAdjacency(cap2);
     //we ensure we have them right with respect there orientation.
-    cap->capContents->adjacency = cap_getOrientation(cap) ? cap2 : cap_getReverse(cap2);
-    cap2->capContents->adjacency = cap_getOrientation(cap2) ? cap : cap_getReverse(cap);
+    cap_getContents(cap)->adjacency = cap_getOrientation(cap) ? cap2 : cap_getReverse(cap2);
+    cap_getContents(cap2)->adjacency = cap_getOrientation(cap2) ? cap : cap_getReverse(cap);
 }
 
 Cap *cap_getP(Cap *cap, Cap *connectedCap) {
@@ -198,7 +240,7 @@ Cap *cap_getP(Cap *cap, Cap *connectedCap) {
 }
 
 Cap *cap_getAdjacency(Cap *cap) {
-    return cap_getP(cap, cap->capContents->adjacency);
+    return cap_getP(cap, cap_getContents(cap)->adjacency);
 }
 
 Cap *cap_getTopCap(Cap *cap) {
@@ -221,7 +263,7 @@ Cap *cap_getTopCap(Cap *cap) {
 }
 
 Face *cap_getTopFace(Cap *cap) {
-    return cap->capContents->face;
+    return cap_getContents(cap)->face;
 }
 
 FaceEnd *cap_getTopFaceEnd(Cap *cap) {
@@ -243,42 +285,42 @@ FaceEnd *cap_getBottomFaceEnd(Cap *cap) {
 }
 
 Cap *cap_getParent(Cap *cap) {
-    Cap *e = cap->capContents->parent;
+    Cap *e = cap_getContents(cap)->parent;
     return e == NULL ? NULL : cap_getOrientation(cap) ? e : cap_getReverse(e);
 }
 
 int64_t cap_getChildNumber(Cap *cap) {
-    return cap->capContents->children->length;
+    return cap_getContents(cap)->childNumber;
 }
 
 Cap *cap_getChild(Cap *cap, int64_t index) {
     assert(cap_getChildNumber(cap) > index);
     assert(index >= 0);
-    return cap_getP(cap, cap->capContents->children->list[index]);
+    return cap_getP(cap, cap_getContents(cap)->children[index]);
 }
 
 void cap_makeParentAndChild(Cap *capParent, Cap *capChild) {
     capParent = cap_getPositiveOrientation(capParent);
     capChild = cap_getPositiveOrientation(capChild);
-    assert(capChild->capContents->parent == NULL);
+    assert(cap_getContents(capChild)->parent == NULL);
 
-    if (!listContains(capParent->capContents->children, capChild)) { //defensive, means second calls will have no effect.
+    if (!hasChild(capParent, capChild)) { //defensive, means second calls will have no effect.
         assert(event_isDescendant(cap_getEvent(capParent), cap_getEvent(capChild)));
-        listAppend(capParent->capContents->children, capChild);
+        addChild(capParent, capChild);
     }
-    capChild->capContents->parent = capParent;
+    cap_getContents(capChild)->parent = capParent;
 }
 
 void cap_changeParentAndChild(Cap* newCapParent, Cap* capChild) {
-    Cap * oldCapParent = cap_getParent(capChild);
+    Cap * oldCapParent = cap_getPositiveOrientation(cap_getParent(capChild));
     newCapParent = cap_getPositiveOrientation(newCapParent);
     capChild = cap_getPositiveOrientation(capChild);
     assert(oldCapParent);
-    if (!listContains(newCapParent->capContents->children, capChild)) { //defensive, means second calls will have no effect.
-        listAppend(newCapParent->capContents->children, capChild);
+    if (!hasChild(newCapParent, capChild)) { //defensive, means second calls will have no effect.
+        addChild(newCapParent, capChild);
     }
-    listRemove(oldCapParent->capContents->children, capChild);
-    capChild->capContents->parent = newCapParent;
+    removeChild(oldCapParent, capChild);
+    cap_getContents(capChild)->parent = newCapParent;
 }
 
 bool cap_isInternal(Cap *cap) {
@@ -404,19 +446,19 @@ void cap_check(Cap *cap) {
  */
 
 void cap_setSegment(Cap *cap, Segment *segment) {
-    cap->capContents->segment = cap_getOrientation(cap) ? segment : segment_getReverse(segment);
+    cap_getContents(cap)->segment = cap_getOrientation(cap) ? segment : segment_getReverse(segment);
 }
 
 void cap_setTopFace(Cap *cap, Face *face) {
-    cap->capContents->face = face;
+    cap_getContents(cap)->face = face;
 }
 
 void cap_breakAdjacency(Cap *cap) {
     Cap *cap2;
     cap2 = cap_getAdjacency(cap);
     if (cap2 != NULL) {
-        cap2->capContents->adjacency = NULL;
-        cap->capContents->adjacency = NULL;
+        cap_getContents(cap2)->adjacency = NULL;
+        cap_getContents(cap)->adjacency = NULL;
     }
 }
 
@@ -519,10 +561,34 @@ Cap *cap_loadFromBinaryRepresentation(void **binaryString, End *end) {
     return cap;
 }
 
+bool cap_skipBinaryRepresentation(void **binaryString) {
+    char elementType = binaryRepresentation_peekNextElementType(*binaryString);
+    if (elementType != CODE_CAP && elementType != CODE_CAP_WITH_COORDINATES
+            && elementType != CODE_CAP_WITH_COORDINATES_BUT_NO_SEQUENCE) {
+        return 0;
+    }
+    binaryRepresentation_popNextElementType(binaryString);
+    binaryRepresentation_getName(binaryString); //The names are read, not skipped, as each may be a delta from the last.
+    if (elementType != CODE_CAP) {
+        binaryRepresentation_getInteger(binaryString);
+    }
+    binaryRepresentation_getBool(binaryString);
+    binaryRepresentation_getName(binaryString);
+    if (binaryRepresentation_peekNextElementType(*binaryString) == CODE_ADJACENCY) {
+        binaryRepresentation_popNextElementType(binaryString);
+        binaryRepresentation_getName(binaryString);
+    }
+    if (binaryRepresentation_peekNextElementType(*binaryString) == CODE_PARENT) {
+        binaryRepresentation_popNextElementType(binaryString);
+        binaryRepresentation_getName(binaryString);
+    }
+    return 1;
+}
+
 void cap_setEvent(Cap *cap, Event *event) {
-    cap->capContents->event = event;
+    cap_getContents(cap)->event = event;
 }
 
 void cap_setSequence(Cap *cap, Sequence *sequence) {
-    cap->capContents->sequence = sequence;
+    cap_getContents(cap)->sequence = sequence;
 }
@@ -12,7 +12,6 @@
 typedef struct _capContents {
     Name instance;
     int64_t coordinate;
-    bool strand;
     Event *event;
     Sequence *sequence;
     Cap *adjacency;
@@ -20,13 +19,17 @@ typedef struct _capContents {
     Face *face;
     Segment *segment;
     Cap *parent;
-    struct List *children;
+    Cap **children;
+    int32_t childNumber;
+    bool strand;
 } CapContents;
 
+/*
+ * A cap is stored compactly, as only its end. The positive and negative orientations of a cap are allocated together,
+ * in that order, and followed by their contents, so the reverse and contents of a cap are found from its address.
+ */
 struct _cap {
-    CapContents *capContents;
     End *end;
-    Cap *rCap;
 };
 
 ////////////////////////////////////////////////
@@ -58,6 +61,12 @@ Cap *cap_construct5(Event *event, End *end);
  */
 void cap_destruct(Cap *cap);
 
+/*
+ * Destructs the cap as part of destructing its flower, so it is not detached from its end, flower, parent or
+ * children, and its memory is left to be released with the arena of the flower.
+ */
+void cap_destructWithFlower(Cap *cap);
+
 /*
  * Gets the segment associated with the end, or NULL, if the end has no associated block end at this level.
  * The segment returned will have the cap on its left side.
@@ -85,6 +94,11 @@ void cap_writeBinaryRepresentation(Cap *cap, void(*writeFn)(const void * ptr,
  */
 Cap *cap_loadFromBinaryRepresentation(void **binaryString, End *end);
 
+/*
+ * Reads past the binary representation of a cap, without constructing it, returning non-zero if there was one.
+ */
+bool cap_skipBinaryRepresentation(void **binaryString);
+
 /*
  * Sets the event associated with the cap. Dangerous method, must be used carefully.
  */
@@ -182,6 +182,7 @@ void chain_check(Chain *chain) {
 
 void chain_addLink(Chain *chain, Link *childLink) {
     Link *pLink;
+    flower_materialise(chain_getFlower(chain));
     assert(chain->linkNumber >= 0);
     if (chain->linkNumber != 0) {
         pLink = chain_getLast(chain);
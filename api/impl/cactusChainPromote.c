@@ -19,6 +19,7 @@ static void promoteBlock(Block *block, Flower *flower, Flower *parentFlower) {
      * Redirects all the pointers in the block to the higher level.
      */
     Segment *segment;
+    cactusArena_retain(flower_getArena(parentFlower), flower_getArena(flower)); //The block and its segments are allocated from it.
     Block_InstanceIterator *it = block_getInstanceIterator(block);
     while ((segment = block_getNext(it)) != NULL) {
         flower_removeSegment(flower, segment);
@@ -88,16 +89,17 @@ static void promoteBlockEnd(End *end, Flower *flower, Flower *parentFlower) {
     assert(flower != parentFlower);
     assert(flower_getEnd(parentFlower, end_getName(end)) == NULL);
     Cap *cap;
+    cactusArena_retain(flower_getArena(parentFlower), flower_getArena(flower)); //The end and its caps are allocated from it.
     End_InstanceIterator *it = end_getInstanceIterator(end);
     EventTree *eventTree = flower_getEventTree(parentFlower);
     while ((cap = end_getNext(it)) != NULL) {
         Event *event = eventTree_getEvent(eventTree, event_getName(cap_getEvent(cap)));
         assert(event != NULL);
-        cap->capContents->event = event;
+        cap_setEvent(cap, event);
         if (cap_getSequence(cap) != NULL) {
             Sequence *sequence = flower_getSequence(parentFlower, sequence_getName(cap_getSequence(cap)));
             assert(sequence != NULL);
-            cap->capContents->sequence = sequence;
+            cap_setSequence(cap, sequence);
         }
         flower_removeCap(flower, cap);
         flower_addCap(parentFlower, cap);
@@ -411,6 +413,9 @@ void chain_promote(Chain *chain) {
     assert(chain_getLength(chain)> 0);
     assert(parentGroup != NULL);
     Flower *parentFlower = group_getFlower(parentGroup);
+    //The links of both chains are edited in place, below, so both flowers are materialised first.
+    flower_materialise(flower);
+    flower_materialise(parentFlower);
 
 #ifndef NDEBUG
     if (group_getLink(parentGroup) != NULL) { //Check we will be merging it into a higher level chain..
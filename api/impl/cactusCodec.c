@@ -0,0 +1,323 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#include <zdict.h>
+#endif
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+const char *CACTUS_CODEC_EXCEPTION_ID = "CACTUS_CODEC_EXCEPTION_ID";
+
+/*
+ * A tagged record is a one byte magic number, which can not start a zlib stream or a
+ * sequence string, the codec type, the uncompressed size and then the compressed data.
+ */
+#define CODEC_MAGIC ((char) 0xCA)
+#define CODEC_HEADER_SIZE (2 + sizeof(int64_t))
+
+struct _cactusCodec {
+    CactusCodecType type;
+    int64_t level;
+    CactusCodecType untaggedType;
+    int64_t dictionaryID;
+#ifdef HAVE_ZSTD
+    ZSTD_CDict *compressionDictionary;
+    ZSTD_DDict *decompressionDictionary;
+#endif
+};
+
+bool cactusCodec_isAvailable(CactusCodecType type) {
+    switch (type) {
+        case CACTUS_CODEC_NONE:
+        case CACTUS_CODEC_ZLIB:
+            return 1;
+        case CACTUS_CODEC_LZ4:
+#ifdef HAVE_LZ4
+            return 1;
+#else
+            return 0;
+#endif
+        case CACTUS_CODEC_ZSTD:
+#ifdef HAVE_ZSTD
+            return 1;
+#else
+            return 0;
+#endif
+    }
+    return 0;
+}
+
+static const char *codecNames[] = { "none", "zlib", "lz4", "zstd" };
+
+CactusCodecType cactusCodec_getTypeFromString(const char *string) {
+    for (int64_t i = 0; i < 4; i++) {
+        if (strcmp(string, codecNames[i]) == 0) {
+            return (CactusCodecType) i;
+        }
+    }
+    stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "Unrecognised codec: %s", string);
+    return CACTUS_CODEC_NONE;
+}
+
+const char *cactusCodec_getTypeString(CactusCodecType type) {
+    assert(type >= CACTUS_CODEC_NONE && type <= CACTUS_CODEC_ZSTD);
+    return codecNames[type];
+}
+
+CactusCodec *cactusCodec_construct(CactusCodecType type, int64_t level, CactusCodecType untaggedType) {
+    assert(untaggedType == CACTUS_CODEC_NONE || untaggedType == CACTUS_CODEC_ZLIB);
+    if (!cactusCodec_isAvailable(type)) {
+        stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "The %s codec is not available in this build of cactus",
+                cactusCodec_getTypeString(type));
+    }
+    CactusCodec *codec = st_calloc(1, sizeof(CactusCodec));
+    codec->type = type;
+    codec->level = level;
+    codec->untaggedType = untaggedType;
+    return codec;
+}
+
+static void clearDictionary(CactusCodec *codec) {
+#ifdef HAVE_ZSTD
+    ZSTD_freeCDict(codec->compressionDictionary);
+    ZSTD_freeDDict(codec->decompressionDictionary);
+    codec->compressionDictionary = NULL;
+    codec->decompressionDictionary = NULL;
+#endif
+    codec->dictionaryID = 0;
+}
+
+void cactusCodec_destruct(CactusCodec *codec) {
+    clearDictionary(codec);
+    free(codec);
+}
+
+CactusCodecType cactusCodec_getType(CactusCodec *codec) {
+    return codec->type;
+}
+
+int64_t cactusCodec_getLevel(CactusCodec *codec) {
+    return codec->level;
+}
+
+/*
+ * Compression.
+ */
+
+static void *compressPayload(CactusCodec *codec, const void *data, int64_t dataSize, int64_t headerSize,
+        int64_t *compressedSize) {
+    /*
+     * Returns the compressed data, preceded by headerSize bytes of space for the header.
+     */
+    char *record = NULL;
+    switch (codec->type) {
+        case CACTUS_CODEC_NONE:
+            record = st_malloc(headerSize + dataSize);
+            memcpy(record + headerSize, data, dataSize);
+            *compressedSize = dataSize;
+            break;
+        case CACTUS_CODEC_ZLIB: {
+            void *payload = stCompression_compress((void *) data, dataSize, compressedSize, codec->level);
+            record = st_malloc(headerSize + *compressedSize);
+            memcpy(record + headerSize, payload, *compressedSize);
+            free(payload);
+            break;
+        }
+#ifdef HAVE_LZ4
+        case CACTUS_CODEC_LZ4: {
+            assert(dataSize <= LZ4_MAX_INPUT_SIZE);
+            int64_t bound = LZ4_compressBound(dataSize);
+            record = st_malloc(headerSize + bound);
+            *compressedSize = LZ4_compress_fast(data, record + headerSize, dataSize, bound,
+                    codec->level > 1 ? codec->level : 1);
+            if (*compressedSize <= 0) {
+                free(record);
+                stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "LZ4 compression failed");
+            }
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case CACTUS_CODEC_ZSTD: {
+            int64_t bound = ZSTD_compressBound(dataSize);
+            record = st_malloc(headerSize + bound);
+            ZSTD_CCtx *context = ZSTD_createCCtx();
+            size_t i = codec->compressionDictionary != NULL ?
+                    ZSTD_compress_usingCDict(context, record + headerSize, bound, data, dataSize,
+                            codec->compressionDictionary) :
+                    ZSTD_compressCCtx(context, record + headerSize, bound, data, dataSize, codec->level);
+            ZSTD_freeCCtx(context);
+            if (ZSTD_isError(i)) {
+                free(record);
+                stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "zstd compression failed: %s", ZSTD_getErrorName(i));
+            }
+            *compressedSize = i;
+            break;
+        }
+#endif
+        default:
+            stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "The %s codec is not available in this build of cactus",
+                    cactusCodec_getTypeString(codec->type));
+    }
+    return record;
+}
+
+void *cactusCodec_compress(CactusCodec *codec, const void *data, int64_t dataSize, int64_t *compressedSize) {
+    if (codec->type == codec->untaggedType) {
+        return compressPayload(codec, data, dataSize, 0, compressedSize);
+    }
+    char *record = compressPayload(codec, data, dataSize, CODEC_HEADER_SIZE, compressedSize);
+    record[0] = CODEC_MAGIC;
+    record[1] = (char) codec->type;
+    memcpy(record + 2, &dataSize, sizeof(int64_t));
+    *compressedSize += CODEC_HEADER_SIZE;
+    return record;
+}
+
+/*
+ * Decompression.
+ */
+
+static bool isTagged(const void *record, int64_t recordSize) {
+    return recordSize >= CODEC_HEADER_SIZE && ((const char *) record)[0] == CODEC_MAGIC;
+}
+
+static void *decompressPayload(CactusCodec *codec, CactusCodecType type, const char *payload, int64_t payloadSize,
+        int64_t uncompressedSize, int64_t *size) {
+    /*
+     * Decompresses the payload. If the uncompressed size is not known it is -1.
+     */
+    char *data = NULL;
+    switch (type) {
+        case CACTUS_CODEC_NONE:
+            data = st_malloc(payloadSize);
+            memcpy(data, payload, payloadSize);
+            *size = payloadSize;
+            break;
+        case CACTUS_CODEC_ZLIB:
+            data = stCompression_decompress((void *) payload, payloadSize, size);
+            break;
+#ifdef HAVE_LZ4
+        case CACTUS_CODEC_LZ4: {
+            assert(uncompressedSize >= 0);
+            data = st_malloc(uncompressedSize > 0 ? uncompressedSize : 1);
+            *size = LZ4_decompress_safe(payload, data, payloadSize, uncompressedSize);
+            break;
+        }
+#endif
+#ifdef HAVE_ZSTD
+        case CACTUS_CODEC_ZSTD: {
+            assert(uncompressedSize >= 0);
+            int64_t dictionaryID = ZSTD_getDictID_fromFrame(payload, payloadSize);
+            if (dictionaryID != 0 && dictionaryID != codec->dictionaryID) {
+                stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "A record needs the zstd dictionary %" PRIi64 ", which is not loaded",
+                        dictionaryID);
+            }
+            data = st_malloc(uncompressedSize > 0 ? uncompressedSize : 1);
+            ZSTD_DCtx *context = ZSTD_createDCtx();
+            size_t i = dictionaryID != 0 ?
+                    ZSTD_decompress_usingDDict(context, data, uncompressedSize, payload, payloadSize,
+                            codec->decompressionDictionary) :
+                    ZSTD_decompressDCtx(context, data, uncompressedSize, payload, payloadSize);
+            ZSTD_freeDCtx(context);
+            *size = ZSTD_isError(i) ? -1 : (int64_t) i;
+            break;
+        }
+#endif
+        default:
+            stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "A record was written with the %s codec, which is not available in this build of cactus",
+                    cactusCodec_getTypeString(type));
+    }
+    if (uncompressedSize >= 0 && *size != uncompressedSize) {
+        free(data);
+        stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "Failed to decompress a %s record", cactusCodec_getTypeString(type));
+    }
+    return data;
+}
+
+void *cactusCodec_decompress(CactusCodec *codec, const void *record, int64_t recordSize, int64_t *uncompressedSize) {
+    if (!isTagged(record, recordSize)) {
+        return decompressPayload(codec, codec->untaggedType, record, recordSize, -1, uncompressedSize);
+    }
+    const char *cA = record;
+    CactusCodecType type = (CactusCodecType) cA[1];
+    if (type < CACTUS_CODEC_NONE || type > CACTUS_CODEC_ZSTD) {
+        stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "Unrecognised codec tag: %i", (int) cA[1]);
+    }
+    int64_t size;
+    memcpy(&size, cA + 2, sizeof(int64_t));
+    return decompressPayload(codec, type, cA + CODEC_HEADER_SIZE, recordSize - CODEC_HEADER_SIZE, size,
+            uncompressedSize);
+}
+
+/*
+ * Dictionaries.
+ */
+
+void *cactusCodec_trainDictionary(stList *samples, stList *sampleSizes, int64_t maxDictionarySize,
+        int64_t *dictionarySize) {
+#ifdef HAVE_ZSTD
+    assert(stList_length(samples) == stList_length(sampleSizes));
+    int64_t sampleNumber = stList_length(samples);
+    size_t *sizes = st_malloc(sizeof(size_t) * (sampleNumber > 0 ? sampleNumber : 1));
+    int64_t totalSize = 0;
+    for (int64_t i = 0; i < sampleNumber; i++) {
+        sizes[i] = *(int64_t *) stList_get(sampleSizes, i);
+        totalSize += sizes[i];
+    }
+    char *buffer = st_malloc(totalSize > 0 ? totalSize : 1);
+    for (int64_t i = 0, j = 0; i < sampleNumber; j += sizes[i++]) {
+        memcpy(buffer + j, stList_get(samples, i), sizes[i]);
+    }
+    void *dictionary = st_malloc(maxDictionarySize);
+    size_t i = ZDICT_trainFromBuffer(dictionary, maxDictionarySize, buffer, sizes, sampleNumber);
+    free(buffer);
+    free(sizes);
+    if (ZDICT_isError(i)) {
+        st_logDebug("Failed to train a zstd dictionary from %" PRIi64 " samples: %s\n", sampleNumber,
+                ZDICT_getErrorName(i));
+        free(dictionary);
+        return NULL;
+    }
+    *dictionarySize = i;
+    return dictionary;
+#else
+    return NULL;
+#endif
+}
+
+void cactusCodec_setDictionary(CactusCodec *codec, const void *dictionary, int64_t dictionarySize) {
+    clearDictionary(codec);
+#ifdef HAVE_ZSTD
+    codec->dictionaryID = ZSTD_getDictID_fromDict(dictionary, dictionarySize);
+    if (codec->dictionaryID == 0) {
+        stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "Not a valid zstd dictionary");
+    }
+    codec->compressionDictionary = ZSTD_createCDict(dictionary, dictionarySize,
+            codec->type == CACTUS_CODEC_ZSTD ? codec->level : ZSTD_CLEVEL_DEFAULT);
+    codec->decompressionDictionary = ZSTD_createDDict(dictionary, dictionarySize);
+#else
+    stThrowNew(CACTUS_CODEC_EXCEPTION_ID, "Dictionaries need the zstd codec, which is not available in this build of cactus");
+#endif
+}
+
+int64_t cactusCodec_getDictionaryID(CactusCodec *codec) {
+    return codec->dictionaryID;
+}
+
+int64_t cactusCodec_getRecordDictionaryID(const void *record, int64_t recordSize) {
+#ifdef HAVE_ZSTD
+    const char *cA = record;
+    if (isTagged(record, recordSize) && cA[1] == CACTUS_CODEC_ZSTD) {
+        return ZSTD_getDictID_fromFrame(cA + CODEC_HEADER_SIZE, recordSize - CODEC_HEADER_SIZE);
+    }
+#endif
+    return 0;
+}
@@ -12,56 +12,550 @@
 #include <unistd.h>
 #include <math.h>
 #include <time.h>
+#include <pthread.h>
 #define CACTUS_DISK_NAME_INCREMENT 16384
+#define CACTUS_DISK_MAX_NAME_INCREMENT 16777216
 #define CACTUS_DISK_BUCKET_NUMBER 65536
 #define CACTUS_DISK_PARAMETER_KEY -100000
-#define CACTUS_DISK_SEQUENCE_CHUNK_SIZE 500
+#define CACTUS_DISK_SEQUENCE_CHUNK_SIZE 65536
+#define CACTUS_DISK_LEGACY_SEQUENCE_CHUNK_SIZE 500
+#define CACTUS_DISK_RECORD_CACHE_SIZE 10000000
+#define CACTUS_DISK_STRING_CACHE_SIZE 10000000
+#define CACTUS_DISK_FLOWER_DICTIONARY_KEY -100001
+#define CACTUS_DISK_GENERATION_KEY -100002
+#define CACTUS_DISK_FLOWER_DICTIONARY_SIZE 112640
+#define CACTUS_DISK_WRITE_BATCH_SIZE 1024
+#define CACTUS_DISK_FLOWER_DICTIONARY_MIN_SAMPLES 100
+#define CACTUS_DISK_EXPORT_BATCH_SIZE 1000
+
+/*
+ * Functions that guard the shared state of the disk (its sets of loaded objects, caches and unique ids)
+ * in thread-safe mode. The mutex is recursive, as loading an object loads the objects it contains.
+ */
+
+static void lock(CactusDisk *cactusDisk) {
+    if (cactusDisk->mutex != NULL) {
+        pthread_mutex_lock(cactusDisk->mutex);
+    }
+}
+
+static void unlock(CactusDisk *cactusDisk) {
+    if (cactusDisk->mutex != NULL) {
+        pthread_mutex_unlock(cactusDisk->mutex);
+    }
+}
+
+void cactusDisk_setThreadSafe(CactusDisk *cactusDisk, bool threadSafe) {
+    if (threadSafe && cactusDisk->mutex == NULL) {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+        cactusDisk->mutex = st_malloc(sizeof(pthread_mutex_t));
+        pthread_mutex_init(cactusDisk->mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+    } else if (!threadSafe && cactusDisk->mutex != NULL) {
+        pthread_mutex_destroy(cactusDisk->mutex);
+        free(cactusDisk->mutex);
+        cactusDisk->mutex = NULL;
+    }
+}
+
+bool cactusDisk_isThreadSafe(CactusDisk *cactusDisk) {
+    return cactusDisk->mutex != NULL;
+}
+
+/*
+ * Functions that pass database requests to the backend, either a stKVDatabase
+ * or the embedded local database, reading from the snapshot first if one is open.
+ *
+ * Requests to the backend are serialised by the database mutex, as the thread prefetching unique ids
+ * makes requests while the disk is in use. The mutex is released if the backend throws an exception.
+ * Each request to the backend is counted and timed in the disk's statistics.
+ */
+
+#define DATABASE_REQUEST(cactusDisk, request) \
+    do { \
+        pthread_mutex_lock(&(cactusDisk)->databaseMutex); \
+        stTry { \
+            request; \
+        } stCatch(except) { \
+            pthread_mutex_unlock(&(cactusDisk)->databaseMutex); \
+            stThrow(except); \
+        } stTryEnd; \
+        pthread_mutex_unlock(&(cactusDisk)->databaseMutex); \
+    } while (0)
+
+static const void *database_getSnapshotRecord(CactusDisk *cactusDisk, Name key, int64_t *recordSize) {
+    /*
+     * Returns the record in place in the snapshot, or NULL if there is no snapshot, it does not contain the record
+     * or the record has been written since the snapshot was opened.
+     */
+    if (cactusDisk->snapshot == NULL) {
+        return NULL;
+    }
+    stIntTuple *k = stIntTuple_construct1(key);
+    bool overridden = stSortedSet_search(cactusDisk->snapshotOverrides, k) != NULL;
+    stIntTuple_destruct(k);
+    return overridden ? NULL : cactusSnapshot_getRecord(cactusDisk->snapshot, key, recordSize);
+}
+
+static void database_overrideSnapshotRecord(CactusDisk *cactusDisk, Name key) {
+    if (cactusDisk->snapshot != NULL) {
+        stIntTuple *k = stIntTuple_construct1(key);
+        if (stSortedSet_search(cactusDisk->snapshotOverrides, k) == NULL) {
+            stSortedSet_insert(cactusDisk->snapshotOverrides, k);
+        } else {
+            stIntTuple_destruct(k);
+        }
+    }
+}
+
+static bool database_containsRecord(CactusDisk *cactusDisk, Name key) {
+    //Not answered from the snapshot, as this decides whether records are inserted or updated.
+    bool containsRecord = 0;
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, containsRecord = cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_containsRecord(cactusDisk->localDatabase, key)
+            : stKVDatabase_containsRecord(cactusDisk->database, key));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_CONTAINS, startTime, 1, 0, 0);
+    return containsRecord;
+}
+
+static void *database_getRecord2(CactusDisk *cactusDisk, Name key, int64_t *recordSize) {
+    const void *snapshotRecord = database_getSnapshotRecord(cactusDisk, key, recordSize);
+    if (snapshotRecord != NULL) {
+        void *record = st_malloc(*recordSize);
+        memcpy(record, snapshotRecord, *recordSize);
+        return record;
+    }
+    void *record = NULL;
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, record = cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_getRecord2(cactusDisk->localDatabase, key, recordSize)
+            : stKVDatabase_getRecord2(cactusDisk->database, key, recordSize));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_GET, startTime, record != NULL,
+            record != NULL ? *recordSize : 0, 0);
+    return record;
+}
+
+static stList *database_bulkGetRecords2(CactusDisk *cactusDisk, stList *keys) {
+    stList *records = NULL;
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, records = cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_bulkGetRecords(cactusDisk->localDatabase, keys)
+            : stKVDatabase_bulkGetRecords(cactusDisk->database, keys));
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < stList_length(records); i++) {
+        int64_t recordSize;
+        stKVDatabaseBulkResult_getRecord(stList_get(records, i), &recordSize);
+        bytes += recordSize;
+    }
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_GET, startTime, stList_length(records), bytes, 0);
+    return records;
+}
+
+static stList *database_bulkGetRecords(CactusDisk *cactusDisk, stList *keys) {
+    if (cactusDisk->snapshot == NULL) {
+        return database_bulkGetRecords2(cactusDisk, keys);
+    }
+    /*
+     * Copy the records in the snapshot, then get the rest from the database in one bulk request.
+     */
+    stList *results = stList_construct3(stList_length(keys), (void (*)(void *)) stKVDatabaseBulkResult_destruct);
+    stList *missingKeys = stList_construct();
+    stList *missingIndices = stList_construct3(0, free);
+    for (int64_t i = 0; i < stList_length(keys); i++) {
+        int64_t recordSize;
+        const void *snapshotRecord = database_getSnapshotRecord(cactusDisk, *(int64_t *) stList_get(keys, i), &recordSize);
+        if (snapshotRecord != NULL) {
+            void *record = st_malloc(recordSize);
+            memcpy(record, snapshotRecord, recordSize);
+            stList_set(results, i, stKVDatabaseBulkResult_construct(record, recordSize));
+        } else {
+            stList_append(missingKeys, stList_get(keys, i));
+            int64_t *j = st_malloc(sizeof(int64_t));
+            j[0] = i;
+            stList_append(missingIndices, j);
+        }
+    }
+    if (stList_length(missingKeys) > 0) {
+        stList *missingResults = database_bulkGetRecords2(cactusDisk, missingKeys);
+        assert(stList_length(missingResults) == stList_length(missingKeys));
+        stList_setDestructor(missingResults, NULL); //The results are moved to the list of all results.
+        for (int64_t i = 0; i < stList_length(missingResults); i++) {
+            stList_set(results, *(int64_t *) stList_get(missingIndices, i), stList_get(missingResults, i));
+        }
+        stList_destruct(missingResults);
+    }
+    stList_destruct(missingKeys);
+    stList_destruct(missingIndices);
+    return results;
+}
+
+static void database_bulkSetRecords(CactusDisk *cactusDisk, stList *requests) {
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < stList_length(requests); i++) {
+        stKVDatabaseBulkRequest *request = stList_get(requests, i);
+        database_overrideSnapshotRecord(cactusDisk, request->key);
+        bytes += request->size;
+    }
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_bulkSetRecords(cactusDisk->localDatabase, requests)
+            : stKVDatabase_bulkSetRecords(cactusDisk->database, requests));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_SET, startTime, stList_length(requests), bytes, 0);
+}
+
+static void database_bulkRemoveRecords(CactusDisk *cactusDisk, stList *keys) {
+    for (int64_t i = 0; i < stList_length(keys); i++) {
+        database_overrideSnapshotRecord(cactusDisk, stIntTuple_get(stList_get(keys, i), 0));
+    }
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_bulkRemoveRecords(cactusDisk->localDatabase, keys)
+            : stKVDatabase_bulkRemoveRecords(cactusDisk->database, keys));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_REMOVE, startTime, stList_length(keys), 0, 0);
+}
+
+/*
+ * The int64 records are the unique id buckets and the generation, which are never in a snapshot, so need not override it.
+ * This leaves the overrides to the thread using the disk.
+ */
+
+static void database_insertInt64(CactusDisk *cactusDisk, Name key, int64_t value) {
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_insertInt64(cactusDisk->localDatabase, key, value)
+            : stKVDatabase_insertInt64(cactusDisk->database, key, value));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_INSERT_INT64, startTime, 1, sizeof(int64_t), 0);
+}
+
+static int64_t database_incrementInt64(CactusDisk *cactusDisk, Name key, int64_t incrementAmount) {
+    int64_t value = 0;
+    int64_t startTime = cactusDiskStats_getTime();
+    DATABASE_REQUEST(cactusDisk, value = cactusDisk->localDatabase != NULL
+            ? cactusLocalDatabase_incrementInt64(cactusDisk->localDatabase, key, incrementAmount)
+            : stKVDatabase_incrementInt64(cactusDisk->database, key, incrementAmount));
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_INCREMENT_INT64, startTime, 1, sizeof(int64_t), 0);
+    return value;
+}
+
+/*
+ * The generation of the database counts the writes that have changed or removed records, so a snapshot
+ * stamped with an older generation may hold stale records. Writes that only insert records leave it
+ * unchanged, as the records they insert are in no snapshot.
+ */
+
+static int64_t getGeneration(CactusDisk *cactusDisk) {
+    return database_containsRecord(cactusDisk, CACTUS_DISK_GENERATION_KEY)
+            ? database_incrementInt64(cactusDisk, CACTUS_DISK_GENERATION_KEY, 0) : 0;
+}
+
+static void incrementGeneration(CactusDisk *cactusDisk) {
+    if (!database_containsRecord(cactusDisk, CACTUS_DISK_GENERATION_KEY)) {
+        stTry {
+            database_insertInt64(cactusDisk, CACTUS_DISK_GENERATION_KEY, 0);
+        } stCatch(except) {
+            stExcept_free(except); //Another process inserted it first.
+        } stTryEnd;
+    }
+    database_incrementInt64(cactusDisk, CACTUS_DISK_GENERATION_KEY, 1);
+}
+
+/*
+ * Record codecs. Each class of record is compressed with its own codec, which
+ * tags the records it writes, so records can be read whatever codec wrote them.
+ */
+
+static const char *recordClassNames[] = { "flower", "metaSequence", "sequenceChunk", "threadString" };
+
+static CactusCodecType getUntaggedCodecType(CactusRecordClass recordClass) {
+    return recordClass == CACTUS_RECORD_SEQUENCE_CHUNK ? CACTUS_CODEC_NONE : CACTUS_CODEC_ZLIB;
+}
+
+void cactusDisk_setRecordCodec(CactusDisk *cactusDisk, CactusRecordClass recordClass, CactusCodecType codecType,
+        int64_t level) {
+    CactusCodec *codec = cactusCodec_construct(codecType, level, getUntaggedCodecType(recordClass));
+    if (recordClass == CACTUS_RECORD_FLOWER && cactusDisk->flowerDictionary != NULL) {
+        cactusCodec_setDictionary(codec, cactusDisk->flowerDictionary, cactusDisk->flowerDictionarySize);
+    }
+    if (cactusDisk->codecs[recordClass] != NULL) {
+        cactusCodec_destruct(cactusDisk->codecs[recordClass]);
+    }
+    cactusDisk->codecs[recordClass] = codec;
+}
+
+void cactusDisk_setRecordCodecs(CactusDisk *cactusDisk, const char *codecsString) {
+    stList *tokens = stString_split(codecsString);
+    for (int64_t i = 0; i < stList_length(tokens); i++) {
+        char *token = stList_get(tokens, i);
+        if (strcmp(token, "flowerDictionary") == 0) {
+            cactusDisk_setTrainFlowerDictionary(cactusDisk, 1);
+            continue;
+        }
+        char *codecString = strchr(token, '=');
+        if (codecString == NULL) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Expected a record codec of the form class=codec[:level], got: %s", token);
+        }
+        *codecString++ = '\0';
+        char *levelString = strchr(codecString, ':');
+        int64_t level = -1;
+        if (levelString != NULL) {
+            *levelString++ = '\0';
+            if (sscanf(levelString, "%" SCNi64 "", &level) != 1) {
+                stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Invalid codec level: %s", levelString);
+            }
+        }
+        int64_t recordClass = 0;
+        while (recordClass < CACTUS_RECORD_CLASS_NUMBER && strcmp(recordClassNames[recordClass], token) != 0) {
+            recordClass++;
+        }
+        if (recordClass == CACTUS_RECORD_CLASS_NUMBER) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Unrecognised record class: %s", token);
+        }
+        cactusDisk_setRecordCodec(cactusDisk, recordClass, cactusCodec_getTypeFromString(codecString), level);
+    }
+    stList_destruct(tokens);
+}
+
+void cactusDisk_setTrainFlowerDictionary(CactusDisk *cactusDisk, bool trainFlowerDictionary) {
+    cactusDisk->trainFlowerDictionary = trainFlowerDictionary;
+}
+
+static void setFlowerDictionary(CactusDisk *cactusDisk, void *dictionary, int64_t dictionarySize) {
+    free(cactusDisk->flowerDictionary);
+    cactusDisk->flowerDictionary = dictionary;
+    cactusDisk->flowerDictionarySize = dictionarySize;
+    cactusCodec_setDictionary(cactusDisk->codecs[CACTUS_RECORD_FLOWER], dictionary, dictionarySize);
+}
+
+static bool loadFlowerDictionary(CactusDisk *cactusDisk) {
+    /*
+     * Loads the flower dictionary, if one has been stored, returning non-zero if it was.
+     * The dictionary is stored uncompressed and outside of the cache.
+     */
+    int64_t dictionarySize;
+    void *dictionary = NULL;
+    stTry
+        {
+            dictionary = database_getRecord2(cactusDisk, CACTUS_DISK_FLOWER_DICTIONARY_KEY, &dictionarySize);
+        }
+        stCatch(except)
+            {
+                stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
+                        "An unknown database error occurred when getting the flower dictionary");
+            }stTryEnd
+    ;
+    if (dictionary == NULL) {
+        return 0;
+    }
+    setFlowerDictionary(cactusDisk, dictionary, dictionarySize);
+    return 1;
+}
+
+static void trainFlowerDictionary(CactusDisk *cactusDisk, stList *samples, stList *sampleSizes) {
+    /*
+     * Trains the flower dictionary from the given (uncompressed) flower records, and stores it,
+     * unless another process has already stored one, in which case that is used.
+     */
+    if (loadFlowerDictionary(cactusDisk) || stList_length(samples) < CACTUS_DISK_FLOWER_DICTIONARY_MIN_SAMPLES) {
+        return;
+    }
+    int64_t dictionarySize;
+    void *dictionary = cactusCodec_trainDictionary(samples, sampleSizes, CACTUS_DISK_FLOWER_DICTIONARY_SIZE,
+            &dictionarySize);
+    if (dictionary == NULL) {
+        return;
+    }
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(CACTUS_DISK_FLOWER_DICTIONARY_KEY,
+            dictionary, dictionarySize));
+    bool inserted = 1;
+    stTry
+        {
+            database_bulkSetRecords(cactusDisk, requests);
+        }
+        stCatch(except)
+            {
+                //Most likely another process stored a dictionary first.
+                stExcept_free(except);
+                inserted = 0;
+            }stTryEnd
+    ;
+    stList_destruct(requests);
+    if (inserted) {
+        st_logDebug("Trained a flower dictionary of %" PRIi64 " bytes from %" PRIi64 " flowers\n", dictionarySize,
+                stList_length(samples));
+        setFlowerDictionary(cactusDisk, dictionary, dictionarySize);
+    } else {
+        free(dictionary);
+        if (!loadFlowerDictionary(cactusDisk)) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to store the flower dictionary");
+        }
+    }
+}
+
+void *cactusDisk_compressRecord(CactusDisk *cactusDisk, CactusRecordClass recordClass, const void *record,
+        int64_t recordSize, int64_t *compressedSize) {
+    int64_t startTime = cactusDiskStats_getTime();
+    void *compressedRecord = cactusCodec_compress(cactusDisk->codecs[recordClass], record, recordSize, compressedSize);
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_COMPRESS, startTime, 1, *compressedSize, recordSize);
+    return compressedRecord;
+}
+
+static void loadRecordDictionary(CactusDisk *cactusDisk, CactusRecordClass recordClass, const void *record,
+        int64_t recordSize) {
+    /*
+     * Loads the dictionary needed to decompress the record, if it is not loaded.
+     */
+    int64_t dictionaryID = cactusCodec_getRecordDictionaryID(record, recordSize);
+    if (dictionaryID != 0 && dictionaryID != cactusCodec_getDictionaryID(cactusDisk->codecs[recordClass])
+            && recordClass == CACTUS_RECORD_FLOWER) {
+        loadFlowerDictionary(cactusDisk); //The dictionary was stored by another process after we started.
+    }
+}
+
+void *cactusDisk_decompressRecord(CactusDisk *cactusDisk, CactusRecordClass recordClass, const void *record,
+        int64_t recordSize, int64_t *uncompressedSize) {
+    loadRecordDictionary(cactusDisk, recordClass, record, recordSize);
+    int64_t startTime = cactusDiskStats_getTime();
+    void *uncompressedRecord = cactusCodec_decompress(cactusDisk->codecs[recordClass], record, recordSize,
+            uncompressedSize);
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_DECOMPRESS, startTime, 1, recordSize, *uncompressedSize);
+    return uncompressedRecord;
+}
 
 /*
  * Functions on meta sequences.
  */
 
 void cactusDisk_addMetaSequence(CactusDisk *cactusDisk, MetaSequence *metaSequence) {
+    lock(cactusDisk);
     assert(stSortedSet_search(cactusDisk->metaSequences, metaSequence) == NULL);
     stSortedSet_insert(cactusDisk->metaSequences, metaSequence);
+    unlock(cactusDisk);
 }
 
 void cactusDisk_removeMetaSequence(CactusDisk *cactusDisk, MetaSequence *metaSequence) {
+    lock(cactusDisk);
     assert(stSortedSet_search(cactusDisk->metaSequences, metaSequence) != NULL);
     stSortedSet_remove(cactusDisk->metaSequences, metaSequence);
+    unlock(cactusDisk);
 }
 
 /*
  * Functions on strings stored by the flower disk.
+ *
+ * A string is stored as an index record, under the name of the string, followed by the chunks of
+ * the string, each a packed sequence of CACTUS_DISK_SEQUENCE_CHUNK_SIZE bases (bar the last), under the
+ * names that follow it. Strings written by older versions have no index record and are stored in chunks of
+ * CACTUS_DISK_LEGACY_SEQUENCE_CHUNK_SIZE bases, the first under the name of the string.
  */
 
+static const char sequenceIndexMagic[8] = { (char) 0xCC, 'S', 'E', 'Q', 'I', 'D', 'X', '\0' };
+
+typedef struct _sequenceIndex {
+    int64_t length; //The length of the string, or -1 if not known.
+    int64_t chunkSize;
+    int64_t firstChunkOffset; //The name of the first chunk, less the name of the string.
+} SequenceIndex;
+
+static SequenceIndex *sequenceIndex_construct(int64_t length, int64_t chunkSize, int64_t firstChunkOffset) {
+    SequenceIndex *sequenceIndex = st_malloc(sizeof(SequenceIndex));
+    sequenceIndex->length = length;
+    sequenceIndex->chunkSize = chunkSize;
+    sequenceIndex->firstChunkOffset = firstChunkOffset;
+    return sequenceIndex;
+}
+
+static void *sequenceIndex_getRecord(int64_t length, int64_t chunkSize, int64_t *recordSize) {
+    *recordSize = sizeof(sequenceIndexMagic) + 2 * sizeof(int64_t);
+    char *record = st_malloc(*recordSize);
+    int64_t values[2] = { length, chunkSize };
+    memcpy(record, sequenceIndexMagic, sizeof(sequenceIndexMagic));
+    memcpy(record + sizeof(sequenceIndexMagic), values, sizeof(values));
+    return record;
+}
+
+static SequenceIndex *sequenceIndex_parseRecord(const void *record, int64_t recordSize) {
+    /*
+     * Parses an index record, returning NULL if the record is not an index record, in which case it is the first
+     * chunk of a string written by an older version.
+     */
+    if (recordSize != sizeof(sequenceIndexMagic) + 2 * sizeof(int64_t)
+            || memcmp(record, sequenceIndexMagic, sizeof(sequenceIndexMagic)) != 0) {
+        return NULL;
+    }
+    int64_t values[2];
+    memcpy(values, (const char *) record + sizeof(sequenceIndexMagic), sizeof(values));
+    if (values[0] < 0 || values[1] <= 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The sequence index record is corrupt");
+    }
+    return sequenceIndex_construct(values[0], values[1], 1);
+}
+
+static int64_t sequenceIndex_getFirstChunk(SequenceIndex *sequenceIndex, int64_t start) {
+    return start / sequenceIndex->chunkSize;
+}
+
+static int64_t sequenceIndex_getLastChunk(SequenceIndex *sequenceIndex, int64_t start, int64_t length) {
+    /*
+     * Returns the last chunk spanned by the range, which is before the first if the range is empty.
+     */
+    assert(sequenceIndex->length == -1 || start + length <= sequenceIndex->length);
+    return length > 0 ? (start + length - 1) / sequenceIndex->chunkSize : start / sequenceIndex->chunkSize - 1;
+}
+
+static Name sequenceIndex_getChunkName(SequenceIndex *sequenceIndex, Name name, int64_t chunk) {
+    return name + sequenceIndex->firstChunkOffset + chunk;
+}
+
+static SequenceIndex *getSequenceIndex(CactusDisk *cactusDisk, Name name) {
+    stIntTuple *key = stIntTuple_construct1(name);
+    SequenceIndex *sequenceIndex = stHash_search(cactusDisk->sequenceIndexes, key);
+    stIntTuple_destruct(key);
+    return sequenceIndex;
+}
+
 Name cactusDisk_addString(CactusDisk *cactusDisk, const char *string) {
     /*
      * Adds a string to the database.
      */
     int64_t stringSize = strlen(string);
-    int64_t intervalSize = ceil((double) stringSize / CACTUS_DISK_SEQUENCE_CHUNK_SIZE);
-    Name name = cactusDisk_getUniqueIDInterval(cactusDisk, intervalSize);
+    int64_t chunkNumber = (stringSize + CACTUS_DISK_SEQUENCE_CHUNK_SIZE - 1) / CACTUS_DISK_SEQUENCE_CHUNK_SIZE;
+    Name name = cactusDisk_getUniqueIDInterval(cactusDisk, chunkNumber + 1);
+    lock(cactusDisk); //The codecs may be shared by the threads
     stList *insertRequests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
-    for (int64_t i = 0; i * CACTUS_DISK_SEQUENCE_CHUNK_SIZE < stringSize; i++) {
-        int64_t j =
-            (i + 1) * CACTUS_DISK_SEQUENCE_CHUNK_SIZE < stringSize ?
-            CACTUS_DISK_SEQUENCE_CHUNK_SIZE : stringSize - i * CACTUS_DISK_SEQUENCE_CHUNK_SIZE;
-        char *subString = stString_getSubString(string, i * CACTUS_DISK_SEQUENCE_CHUNK_SIZE, j);
-        stList_append(insertRequests, stKVDatabaseBulkRequest_constructInsertRequest(name + i, subString, j + 1));
-        free(subString);
-    }
     stTry
     {
-        stKVDatabase_bulkSetRecords(cactusDisk->database, insertRequests);
+        int64_t indexRecordSize;
+        void *indexRecord = sequenceIndex_getRecord(stringSize, CACTUS_DISK_SEQUENCE_CHUNK_SIZE, &indexRecordSize);
+        stList_append(insertRequests, stKVDatabaseBulkRequest_constructInsertRequest(name, indexRecord, indexRecordSize));
+        free(indexRecord);
+        for (int64_t i = 0; i < chunkNumber; i++) {
+            int64_t j =
+                (i + 1) * CACTUS_DISK_SEQUENCE_CHUNK_SIZE < stringSize ?
+                CACTUS_DISK_SEQUENCE_CHUNK_SIZE : stringSize - i * CACTUS_DISK_SEQUENCE_CHUNK_SIZE;
+            int64_t packedSize, recordSize;
+            void *packedSequence = packedSequence_pack(string + i * CACTUS_DISK_SEQUENCE_CHUNK_SIZE, j, &packedSize);
+            void *record = cactusDisk_compressRecord(cactusDisk, CACTUS_RECORD_SEQUENCE_CHUNK, packedSequence, packedSize,
+                    &recordSize);
+            free(packedSequence);
+            stList_append(insertRequests, stKVDatabaseBulkRequest_constructInsertRequest(name + 1 + i, record, recordSize));
+            free(record);
+        }
+        database_bulkSetRecords(cactusDisk, insertRequests);
     }
     stCatch(except)
     {
+        stList_destruct(insertRequests);
+        unlock(cactusDisk);
         stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
                         "An unknown database error occurred when we tried to add a string to the cactus disk");
     }stTryEnd
          ;
     stList_destruct(insertRequests);
+    unlock(cactusDisk);
     return name;
 }
 
@@ -136,34 +630,153 @@ static stList *mergeSubstrings(stList *substrings, int64_t proximityToMerge) {
     return mergedSubstrings;
 }
 
+/*
+ * The string cache holds the sequence chunks that have been read, as packed sequences, keyed by
+ * the name of their record.
+ */
+
+static PackedSequence *stringCache_get(CactusDisk *cactusDisk, Name chunkName) {
+    return cactusCache_get(cactusDisk->stringCache, chunkName, NULL);
+}
+
+static void stringCache_insert(CactusDisk *cactusDisk, Name chunkName, PackedSequence *packedSequence) {
+    assert(!cactusCache_contains(cactusDisk->stringCache, chunkName));
+    cactusCache_insert(cactusDisk->stringCache, chunkName, packedSequence, packedSequence_getMemorySize(packedSequence));
+}
+
+static PackedSequence *getPackedSequenceChunk(CactusDisk *cactusDisk, void *record, int64_t recordSize,
+        int64_t chunkSize) {
+    /*
+     * Decompresses a sequence chunk record. Chunks written by older versions, which are null terminated strings, are packed.
+     */
+    record = cactusDisk_decompressRecord(cactusDisk, CACTUS_RECORD_SEQUENCE_CHUNK, record, recordSize, &recordSize);
+    if (!packedSequence_isPacked(record, recordSize)) {
+        assert(recordSize > 0 && strlen(record) == recordSize - 1);
+        void *packedRecord = packedSequence_pack(record, recordSize - 1, &recordSize);
+        free(record);
+        record = packedRecord;
+    }
+    PackedSequence *packedSequence = packedSequence_construct(record, recordSize);
+    if (packedSequence_getLength(packedSequence) > chunkSize) {
+        packedSequence_destruct(packedSequence);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "A sequence chunk is longer than the chunk size");
+    }
+    return packedSequence;
+}
+
+static void cacheSequenceIndexes(CactusDisk *cactusDisk, stList *substrings) {
+    /*
+     * Caches the indexes of the strings of the given substrings that are not already cached. A string written
+     * without an index has its first chunk in place of its index record, which is cached with it.
+     */
+    stList *getRequests = stList_construct3(0, free);
+    stSortedSet *requestedNames = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+            (void (*)(void *)) stIntTuple_destruct);
+    for (int64_t i = 0; i < stList_length(substrings); i++) {
+        Substring *substring = stList_get(substrings, i);
+        stIntTuple *key = stIntTuple_construct1(substring->name);
+        if (getSequenceIndex(cactusDisk, substring->name) != NULL || stSortedSet_search(requestedNames, key) != NULL) {
+            stIntTuple_destruct(key);
+            continue;
+        }
+        stSortedSet_insert(requestedNames, key);
+        int64_t *k = st_malloc(sizeof(int64_t));
+        k[0] = substring->name;
+        stList_append(getRequests, k);
+    }
+    stSortedSet_destruct(requestedNames);
+    if (stList_length(getRequests) == 0) {
+        stList_destruct(getRequests);
+        return;
+    }
+    stList *records = NULL;
+    stTry
+    {
+        records = database_bulkGetRecords(cactusDisk, getRequests);
+    }
+    stCatch(except)
+    {
+        stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
+                        "An unknown database error occurred when getting a sequence index");
+    }stTryEnd
+         ;
+    assert(stList_length(records) == stList_length(getRequests));
+    for (int64_t i = 0; i < stList_length(getRequests); i++) {
+        Name name = *(int64_t *) stList_get(getRequests, i);
+        int64_t recordSize;
+        void *record = stKVDatabaseBulkResult_getRecord(stList_get(records, i), &recordSize);
+        if (record == NULL) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The sequence %" PRIi64 " is missing from the database", name);
+        }
+        SequenceIndex *sequenceIndex = sequenceIndex_parseRecord(record, recordSize);
+        if (sequenceIndex == NULL) { //A string written by an older version, the record is its first chunk.
+            sequenceIndex = sequenceIndex_construct(-1, CACTUS_DISK_LEGACY_SEQUENCE_CHUNK_SIZE, 0);
+            if (!cactusCache_contains(cactusDisk->stringCache, name)) {
+                stringCache_insert(cactusDisk, name,
+                        getPackedSequenceChunk(cactusDisk, record, recordSize, sequenceIndex->chunkSize));
+            }
+        }
+        stHash_insert(cactusDisk->sequenceIndexes, stIntTuple_construct1(name), sequenceIndex);
+    }
+    stList_destruct(getRequests);
+    stList_destruct(records);
+}
+
 static void cacheSubstringsFromDB(CactusDisk *cactusDisk, stList *substrings) {
     if (cactusDisk->stringCache == NULL) {
         // No string cache.
         return;
     }
     /*
-     * Caches the given set of substrings in the cactusDisk cache.
+     * Caches the chunks spanned by the given set of substrings in the cactusDisk cache, fetching only those
+     * chunks not already cached.
      */
+    cacheSequenceIndexes(cactusDisk, substrings);
     stList *getRequests = stList_construct3(0, free);
+    stList *chunkSizes = stList_construct();
+    stSortedSet *requestedChunks = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+            (void (*)(void *)) stIntTuple_destruct);
     for (int64_t i = 0; i < stList_length(substrings); i++) {
         Substring *substring = stList_get(substrings, i);
-        int64_t intervalSize = (substring->length + substring->start - 1) / CACTUS_DISK_SEQUENCE_CHUNK_SIZE
-            - substring->start / CACTUS_DISK_SEQUENCE_CHUNK_SIZE + 1;
-        Name shiftedName = substring->name + substring->start / CACTUS_DISK_SEQUENCE_CHUNK_SIZE;
-        for (int64_t j = 0; j < intervalSize; j++) {
+        SequenceIndex *sequenceIndex = getSequenceIndex(cactusDisk, substring->name);
+        int64_t lastChunk = sequenceIndex_getLastChunk(sequenceIndex, substring->start, substring->length);
+        for (int64_t j = sequenceIndex_getFirstChunk(sequenceIndex, substring->start); j <= lastChunk; j++) {
+            Name chunkName = sequenceIndex_getChunkName(sequenceIndex, substring->name, j);
+            stIntTuple *chunkKey = stIntTuple_construct1(chunkName);
+            if (stringCache_get(cactusDisk, chunkName) != NULL || stSortedSet_search(requestedChunks, chunkKey) != NULL) {
+                stIntTuple_destruct(chunkKey);
+                continue;
+            }
+            int64_t recordSize;
+            const void *snapshotRecord = database_getSnapshotRecord(cactusDisk, chunkName, &recordSize);
+            if (snapshotRecord != NULL && packedSequence_isPacked(snapshotRecord, recordSize)) {
+                //An uncompressed packed chunk in the snapshot is read in place.
+                stIntTuple_destruct(chunkKey);
+                PackedSequence *packedSequence = packedSequence_construct2(snapshotRecord, recordSize);
+                if (packedSequence_getLength(packedSequence) > sequenceIndex->chunkSize) {
+                    packedSequence_destruct(packedSequence);
+                    stThrowNew(CACTUS_DISK_EXCEPTION_ID, "A sequence chunk is longer than the chunk size");
+                }
+                stringCache_insert(cactusDisk, chunkName, packedSequence);
+                continue;
+            }
+            stSortedSet_insert(requestedChunks, chunkKey);
             int64_t *k = st_malloc(sizeof(int64_t));
-            k[0] = shiftedName + j;
+            k[0] = chunkName;
             stList_append(getRequests, k);
+            stList_append(chunkSizes, &sequenceIndex->chunkSize);
         }
     }
+    stSortedSet_destruct(requestedChunks);
     if (stList_length(getRequests) == 0) {
         stList_destruct(getRequests);
+        stList_destruct(chunkSizes);
         return;
     }
     stList *records = NULL;
     stTry
     {
-        records = stKVDatabase_bulkGetRecords(cactusDisk->database, getRequests);
+        records = database_bulkGetRecords(cactusDisk, getRequests);
     }
     stCatch(except)
     {
@@ -173,33 +786,18 @@ static void cacheSubstringsFromDB(CactusDisk *cactusDisk, stList *substrings) {
          ;
     assert(records != NULL);
     assert(stList_length(records) == stList_length(getRequests));
+    for (int64_t i = 0; i < stList_length(getRequests); i++) {
+        int64_t recordSize;
+        void *record = stKVDatabaseBulkResult_getRecord(stList_get(records, i), &recordSize);
+        if (record == NULL) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The sequence chunk %" PRIi64 " is missing from the database",
+                    *(int64_t *) stList_get(getRequests, i));
+        }
+        stringCache_insert(cactusDisk, *(int64_t *) stList_get(getRequests, i),
+                getPackedSequenceChunk(cactusDisk, record, recordSize, *(int64_t *) stList_get(chunkSizes, i)));
+    }
     stList_destruct(getRequests);
-    stListIterator *recordsIt = stList_getIterator(records);
-    for (int64_t i = 0; i < stList_length(substrings); i++) {
-        Substring *substring = stList_get(substrings, i);
-        int64_t intervalSize = (substring->length + substring->start - 1) / CACTUS_DISK_SEQUENCE_CHUNK_SIZE
-            - substring->start / CACTUS_DISK_SEQUENCE_CHUNK_SIZE + 1;
-        stList *strings = stList_construct();
-        while (intervalSize-- > 0) {
-            int64_t recordSize;
-            stKVDatabaseBulkResult *result = stList_getNext(recordsIt);
-            assert(result != NULL);
-            char *string = stKVDatabaseBulkResult_getRecord(result, &recordSize);
-            assert(string != NULL);
-            assert(strlen(string) == recordSize - 1);
-            stList_append(strings, string);
-            assert(recordSize <= CACTUS_DISK_SEQUENCE_CHUNK_SIZE + 1);
-        }
-        assert(stList_length(strings) > 0);
-        char *joinedString = stString_join2("", strings);
-        stCache_setRecord(cactusDisk->stringCache, substring->name,
-                          (substring->start / CACTUS_DISK_SEQUENCE_CHUNK_SIZE) * CACTUS_DISK_SEQUENCE_CHUNK_SIZE,
-                          strlen(joinedString), joinedString);
-        free(joinedString);
-        stList_destruct(strings);
-    }
-    assert(stList_getNext(recordsIt) == NULL);
-    stList_destructIterator(recordsIt);
+    stList_destruct(chunkSizes);
     stList_destruct(records);
 }
 
@@ -211,10 +809,21 @@ void cactusDisk_preCacheStrings2(CactusDisk *cactusDisk, stList *substrings) {
         // No string cache.
         return;
     }
-    //Now do some simple merging to reduce granularity
-    stList *mergedSubstrings = mergeSubstrings(substrings, CACTUS_DISK_SEQUENCE_CHUNK_SIZE);
+    //Now do some simple merging to reduce granularity. Only chunks not already requested are fetched, so the
+    //merging is kept within the size of the smallest (legacy) chunks, to avoid fetching chunks between substrings.
+    stList *mergedSubstrings = mergeSubstrings(substrings, CACTUS_DISK_LEGACY_SEQUENCE_CHUNK_SIZE);
     //Now cache the sequences
-    cacheSubstringsFromDB(cactusDisk, mergedSubstrings);
+    lock(cactusDisk);
+    int64_t startTime = cactusDiskStats_getTime();
+    stTry {
+        cacheSubstringsFromDB(cactusDisk, mergedSubstrings);
+    } stCatch(except) {
+        unlock(cactusDisk);
+        stList_destruct(mergedSubstrings);
+        stThrow(except);
+    } stTryEnd;
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_PRE_CACHE_STRINGS, startTime, stList_length(substrings), 0, 0);
+    unlock(cactusDisk);
     stList_destruct(mergedSubstrings);
 }
 
@@ -312,51 +921,120 @@ void cactusDisk_preCacheSegmentStrings(CactusDisk *cactusDisk, stList *flowers)
     stList_destruct(substrings);
 }
 
-char *cactusDisk_getStringFromCache(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand) {
+static bool getStringFromCache2(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, char *string) {
     /*
-     * Gets a sequence from the cache.
+     * Unpacks the forward strand of a sequence from the chunks it spans in the cache into string, which must have room
+     * for length + 1 characters. Returns zero, leaving string unset, if any of the chunks is not cached.
      */
     if (cactusDisk->stringCache == NULL) {
         // No cache.
-        return NULL;
+        return 0;
     }
-    char *string = NULL;
-    if (stCache_containsRecord(cactusDisk->stringCache, name, start, sizeof(char) * length)) {
-        int64_t recordSize;
-        string = stCache_getRecord(cactusDisk->stringCache, name, start, sizeof(char) * length, &recordSize);
-        assert(string != NULL);
-        assert(recordSize == length);
-        string = st_realloc(string, sizeof(char) * (length + 1));
-        string[length] = '\0';
-        if (!strand) {
-            char *string2 = stString_reverseComplementString(string);
-            free(string);
-            string = string2;
+    assert(start >= 0 && length >= 0);
+    SequenceIndex *sequenceIndex = getSequenceIndex(cactusDisk, name);
+    if (sequenceIndex == NULL) {
+        return 0;
+    }
+    int64_t firstChunk = sequenceIndex_getFirstChunk(sequenceIndex, start);
+    int64_t lastChunk = sequenceIndex_getLastChunk(sequenceIndex, start, length);
+    for (int64_t i = firstChunk; i <= lastChunk; i++) {
+        if (!cactusCache_contains(cactusDisk->stringCache, sequenceIndex_getChunkName(sequenceIndex, name, i))) {
+            return 0;
         }
     }
+    for (int64_t i = firstChunk; i <= lastChunk; i++) {
+        PackedSequence *packedSequence = stringCache_get(cactusDisk, sequenceIndex_getChunkName(sequenceIndex, name, i));
+        int64_t chunkStart = i * sequenceIndex->chunkSize;
+        int64_t substringStart = start > chunkStart ? start : chunkStart;
+        int64_t substringEnd = start + length < chunkStart + packedSequence_getLength(packedSequence) ? start + length
+                : chunkStart + packedSequence_getLength(packedSequence);
+        assert(substringEnd > substringStart);
+        packedSequence_getSubstring(packedSequence, substringStart - chunkStart, substringEnd - substringStart,
+                string + substringStart - start);
+    }
+    string[length] = '\0';
+    return 1;
+}
+
+static void reverseComplementInPlace(char *string, int64_t length) {
+    for (int64_t i = 0, j = length - 1; i <= j; i++, j--) {
+        char c = string[i];
+        string[i] = stString_reverseComplementChar(string[j]);
+        string[j] = stString_reverseComplementChar(c);
+    }
+}
+
+static char *getStringFromCache(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand) {
+    /*
+     * Gets a sequence from the cache, unpacking it from the chunks it spans. Returns NULL if any of the chunks is not cached.
+     */
+    char *string = st_malloc(sizeof(char) * (length + 1));
+    if (!getStringFromCache2(cactusDisk, name, start, length, string)) {
+        free(string);
+        return NULL;
+    }
+    if (!strand) {
+        reverseComplementInPlace(string, length);
+    }
     return string;
 }
 
-char *cactusDisk_getString(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
-        int64_t totalSequenceLength) {
+char *cactusDisk_getStringFromCache(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand) {
+    lock(cactusDisk);
+    char *string = getStringFromCache(cactusDisk, name, start, length, strand);
+    unlock(cactusDisk);
+    return string;
+}
+
+void cactusDisk_getStringInBuffer(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, char *string) {
     /*
-     * Gets a string from the database.
-     *
+     * Gets the forward strand of a string from the database, into the given buffer.
      */
     assert(length >= 0);
     if (length == 0) {
-        return stString_copy("");
+        string[0] = '\0';
+        return;
     }
     //First try getting it from the cache
-    char *string = cactusDisk_getStringFromCache(cactusDisk, name, start, length, strand);
-    if (string == NULL) { //If not in the cache, add it to the cache and then get it from the cache.
+    lock(cactusDisk);
+    int64_t startTime = cactusDiskStats_getTime();
+    if (!getStringFromCache2(cactusDisk, name, start, length, string)) { //If not in the cache, add it to the cache and then get it from the cache.
         stList *list = stList_construct3(0, (void (*)(void *)) substring_destruct);
         stList_append(list, substring_construct(name, start, length));
-        cacheSubstringsFromDB(cactusDisk, list);
+        int64_t maxSize = cactusCache_getMaxSize(cactusDisk->stringCache);
+        stTry {
+            cacheSubstringsFromDB(cactusDisk, list);
+            if (!getStringFromCache2(cactusDisk, name, start, length, string)) { //The chunks of the string do not all fit in the cache, so it is read with the budget lifted.
+                cactusCache_setMaxSize(cactusDisk->stringCache, INT64_MAX);
+                cacheSubstringsFromDB(cactusDisk, list);
+                bool found = getStringFromCache2(cactusDisk, name, start, length, string);
+                (void) found;
+                assert(found);
+                cactusCache_setMaxSize(cactusDisk->stringCache, maxSize);
+            }
+        } stCatch(except) {
+            cactusCache_setMaxSize(cactusDisk->stringCache, maxSize);
+            stList_destruct(list);
+            unlock(cactusDisk);
+            stThrow(except);
+        } stTryEnd;
         stList_destruct(list);
-        string = cactusDisk_getStringFromCache(cactusDisk, name, start, length, strand);
     }
-    assert(string != NULL);
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_GET_STRING, startTime, 1, 0, length);
+    unlock(cactusDisk);
+}
+
+char *cactusDisk_getString(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, int64_t strand,
+        int64_t totalSequenceLength) {
+    /*
+     * Gets a string from the database.
+     *
+     */
+    char *string = st_malloc(sizeof(char) * (length + 1));
+    cactusDisk_getStringInBuffer(cactusDisk, name, start, length, string);
+    if (!strand) {
+        reverseComplementInPlace(string, length);
+    }
     return string;
 }
 
@@ -396,80 +1074,43 @@ static void cactusDisk_loadFromBinaryRepresentation(void **binaryString, CactusD
 }
 
 /*
- * The following two functions compress and decompress the data in the cactus disk..
+ * The following two functions compress and decompress the data in the cactus disk, using the codec for the class of record.
  */
 
-static void *compress(void *data, int64_t *dataSize) {
+static void *compress(CactusDisk *cactusDisk, CactusRecordClass recordClass, void *data, int64_t *dataSize) {
     //Compression
     int64_t compressedSize;
-    void *data2 = stCompression_compress(data, *dataSize, &compressedSize, -1);
+    void *data2 = cactusDisk_compressRecord(cactusDisk, recordClass, data, *dataSize, &compressedSize);
     free(data);
     *dataSize = compressedSize;
     return data2;
 }
 
-static void *decompress(void *data, int64_t *dataSize) {
+static void *decompress(CactusDisk *cactusDisk, CactusRecordClass recordClass, void *data, int64_t *dataSize) {
     //Decompression
     int64_t uncompressedSize;
-    void *data2 = stCompression_decompress(data, *dataSize, &uncompressedSize);
+    void *data2 = cactusDisk_decompressRecord(cactusDisk, recordClass, data, *dataSize, &uncompressedSize);
     *dataSize = uncompressedSize;
     return data2;
 }
 
-static stList *getRecords(CactusDisk *cactusDisk, stList *objectNames, char *type) {
-    if (stList_length(objectNames) == 0) {
-        return stList_construct3(0, NULL);
-    }
-    stList *records = NULL;
-    stTry
-        {
-            records = stKVDatabase_bulkGetRecords(cactusDisk->database, objectNames);
-        }
-        stCatch(except)
-            {
-                stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
-                        "An unknown database error occurred when getting a bulk set of %s", type);
-            }stTryEnd
-    ;
-    assert(records != NULL);
-    assert(stList_length(objectNames) == stList_length(records));
-    stList_setDestructor(records, free);
-    for (int64_t i = 0; i < stList_length(objectNames); i++) {
-        Name objectName = *((int64_t *) stList_get(objectNames, i));
-        int64_t recordSize;
-        void *record;
-        stKVDatabaseBulkResult *result = stList_get(records, i);
-        assert(result != NULL);
-        if (cactusDisk->cache == NULL
-            || !stCache_containsRecord(cactusDisk->cache, objectName, 0, INT64_MAX)) {
-            record = stKVDatabaseBulkResult_getRecord(result, &recordSize);
-            assert(recordSize >= 0);
-            assert(record != NULL);
-            record = decompress(record, &recordSize);
-            if (cactusDisk->cache != NULL) {
-                stCache_setRecord(cactusDisk->cache, objectName, 0, recordSize, record);
-            }
-        } else {
-            record = stCache_getRecord(cactusDisk->cache, objectName, 0, INT64_MAX, &recordSize);
-            assert(recordSize >= 0);
-            assert(record != NULL);
-        }
-        stKVDatabaseBulkResult_destruct(result);
-        stList_set(records, i, record);
-    }
-    return records;
-}
-
-static void *getRecord(CactusDisk *cactusDisk, Name objectName, char *type, int64_t *size) {
+static void *getRecord(CactusDisk *cactusDisk, Name objectName, CactusRecordClass recordClass, char *type,
+        int64_t *size) {
     void *cA = NULL;
     int64_t recordSize = 0;
+    void *cachedRecord;
+    const void *snapshotRecord;
     if (cactusDisk->cache != NULL
-        && stCache_containsRecord(cactusDisk->cache, objectName, 0, INT64_MAX)) { //If we already have the record, we won't update it.
-        cA = stCache_getRecord(cactusDisk->cache, objectName, 0, INT64_MAX, &recordSize);
+        && (cachedRecord = cactusCache_get(cactusDisk->cache, objectName, &recordSize)) != NULL) { //If we already have the record, we won't update it.
+        cA = st_malloc(recordSize);
+        memcpy(cA, cachedRecord, recordSize);
+    } else if ((snapshotRecord = database_getSnapshotRecord(cactusDisk, objectName, &recordSize)) != NULL) {
+        //Decompress the record in place in the snapshot, which, being already in memory, is not cached.
+        cA = cactusDisk_decompressRecord(cactusDisk, recordClass, snapshotRecord, recordSize, &recordSize);
     } else {
         stTry
             {
-                cA = stKVDatabase_getRecord2(cactusDisk->database, objectName, &recordSize);
+                cA = database_getRecord2(cactusDisk, objectName, &recordSize);
             }
             stCatch(except)
                 {
@@ -482,12 +1123,14 @@ static void *getRecord(CactusDisk *cactusDisk, Name objectName, char *type, int6
         }
         //Decompression
         assert(recordSize > 0);
-        void *cA2 = decompress(cA, &recordSize);
+        void *cA2 = decompress(cactusDisk, recordClass, cA, &recordSize);
         free(cA);
         cA = cA2;
         // Add the uncompressed record to the cache.
         if (cactusDisk->cache != NULL) {
-            stCache_setRecord(cactusDisk->cache, objectName, 0, recordSize, cA);
+            cachedRecord = st_malloc(recordSize);
+            memcpy(cachedRecord, cA, recordSize);
+            cactusCache_insert(cactusDisk->cache, objectName, cachedRecord, recordSize);
         }
     }
     if (size != NULL) {
@@ -497,13 +1140,15 @@ static void *getRecord(CactusDisk *cactusDisk, Name objectName, char *type, int6
 }
 
 static bool containsRecord(CactusDisk *cactusDisk, Name objectName) {
-    return (cactusDisk->cache != NULL
-            && stCache_containsRecord(cactusDisk->cache, objectName, 0, INT64_MAX))
-        || stKVDatabase_containsRecord(cactusDisk->database, objectName);
+    return (cactusDisk->cache != NULL && cactusCache_contains(cactusDisk->cache, objectName))
+        || database_containsRecord(cactusDisk, objectName);
 }
 
-static CactusDisk *cactusDisk_constructPrivate(stKVDatabaseConf *conf, bool create, bool cache) {
+static CactusDisk *cactusDisk_constructPrivate(stKVDatabaseConf *conf, const char *localDatabaseDir, bool create,
+        bool cache) {
     CactusDisk *cactusDisk = st_calloc(1, sizeof(CactusDisk));
+    pthread_mutex_init(&cactusDisk->databaseMutex, NULL);
+    cactusDisk->stats = cactusDiskStats_construct();
 
     //construct lists of in memory objects
     cactusDisk->metaSequences = stSortedSet_construct3(cactusDisk_constructMetaSequencesP, NULL);
@@ -515,27 +1160,47 @@ static CactusDisk *cactusDisk_constructPrivate(stKVDatabaseConf *conf, bool crea
     cactusDisk->eventTree = NULL;
 
     //Now open the database
-    cactusDisk->database = stKVDatabase_construct(conf, create);
+    if (localDatabaseDir != NULL) {
+        cactusDisk->localDatabase = cactusLocalDatabase_construct(localDatabaseDir, create);
+    } else {
+        cactusDisk->database = stKVDatabase_construct(conf, create);
+    }
     if (cache) {
-        // 10MB for general DB responses
-        cactusDisk->cache = stCache_construct2(10000000);
+        cactusDisk->cache = cactusCache_construct(CACTUS_DISK_RECORD_CACHE_SIZE, free);
     }
-    // 100MB for strings
-    cactusDisk->stringCache = stCache_construct2(10000000);
+    cactusDisk->stringCache = cactusCache_construct(CACTUS_DISK_STRING_CACHE_SIZE,
+            (void (*)(void *)) packedSequence_destruct);
+    cactusDisk->sequenceIndexes = stHash_construct3((uint64_t (*)(const void *)) stIntTuple_hashKey,
+            (int (*)(const void *, const void *)) stIntTuple_equalsFn, (void (*)(void *)) stIntTuple_destruct, free);
 
     //initialise the unique ids.
     int64_t seed = (clock() << 24) | (time(NULL) << 16) | (getpid() & 65535); //Likely to be unique
     st_logDebug("The cactus disk is seeding the random number generator with the value %" PRIi64 "\n", seed);
     st_randomSeed(seed);
+    cactusDisk->uniqueIDSeed = (unsigned int) seed;
     cactusDisk->uniqueNumber = 0;
     cactusDisk->maxUniqueNumber = 0;
+    cactusDisk->leaseSize = CACTUS_DISK_NAME_INCREMENT;
+
+    cactusDisk->writeThreads = 1;
+    cactusDisk->readThreads = 1;
+
+    //The default codecs, which write the same records as versions of cactus without codecs.
+    cactusDisk_setRecordCodec(cactusDisk, CACTUS_RECORD_FLOWER, CACTUS_CODEC_ZLIB, -1);
+    cactusDisk_setRecordCodec(cactusDisk, CACTUS_RECORD_META_SEQUENCE, CACTUS_CODEC_ZLIB, -1);
+    cactusDisk_setRecordCodec(cactusDisk, CACTUS_RECORD_SEQUENCE_CHUNK, CACTUS_CODEC_NONE, 0);
+    cactusDisk_setRecordCodec(cactusDisk, CACTUS_RECORD_THREAD_STRING, CACTUS_CODEC_ZLIB, 1);
+    if (!create && cactusCodec_isAvailable(CACTUS_CODEC_ZSTD)) {
+        loadFlowerDictionary(cactusDisk);
+    }
 
     //Now load any stuff..
     if (containsRecord(cactusDisk, CACTUS_DISK_PARAMETER_KEY)) {
         if (create) {
             stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Tried to create a cactus disk, but the cactus disk already exists");
         }
-        void *record = getRecord(cactusDisk, CACTUS_DISK_PARAMETER_KEY, "cactus_disk parameters", NULL);
+        void *record = getRecord(cactusDisk, CACTUS_DISK_PARAMETER_KEY, CACTUS_RECORD_META_SEQUENCE,
+                "cactus_disk parameters", NULL);
         void *record2 = record;
         cactusDisk_loadFromBinaryRepresentation(&record, cactusDisk, conf);
         free(record2);
@@ -547,7 +1212,114 @@ static CactusDisk *cactusDisk_constructPrivate(stKVDatabaseConf *conf, bool crea
 }
 
 CactusDisk *cactusDisk_construct(stKVDatabaseConf *conf, bool create, bool cache) {
-    return cactusDisk_constructPrivate(conf, create, cache);
+    return cactusDisk_constructPrivate(conf, NULL, create, cache);
+}
+
+static char *getAttributeFromConfString(const char *databaseString, const char *attributeName) {
+    /*
+     * Returns the value of the given attribute of the conf string, or NULL if it has none.
+     */
+    char *attribute = stString_print(" %s=\"", attributeName);
+    const char *start = strstr(databaseString, attribute);
+    if (start == NULL) {
+        free(attribute);
+        return NULL;
+    }
+    start += strlen(attribute);
+    free(attribute);
+    const char *end = strchr(start, '"');
+    if (end == NULL) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Unterminated %s attribute in the database conf string: %s",
+                attributeName, databaseString);
+    }
+    return stString_getSubString(start, 0, end - start);
+}
+
+static int64_t getSizeFromConfString(const char *databaseString, const char *attributeName, int64_t defaultSize) {
+    /*
+     * Returns the value of the given size attribute of the conf string, a number of bytes optionally followed
+     * by K, M or G, or the default if it has none.
+     */
+    char *sizeString = getAttributeFromConfString(databaseString, attributeName);
+    if (sizeString == NULL) {
+        return defaultSize;
+    }
+    int64_t size;
+    char units = '\0';
+    int64_t i = sscanf(sizeString, "%" SCNi64 "%c", &size, &units);
+    int64_t multiplier = units == '\0' ? 1 : units == 'K' || units == 'k' ? 1024 : units == 'M' || units == 'm' ?
+            1024 * 1024 : units == 'G' || units == 'g' ? 1024 * 1024 * 1024 : -1;
+    bool valid = i >= 1 && size >= 0 && multiplier != -1 && size <= INT64_MAX / multiplier; //Checked before multiplying.
+    free(sizeString);
+    if (!valid) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Could not parse the %s attribute of the database conf string, or it is too large: %s",
+                attributeName, databaseString);
+    }
+    return size * multiplier;
+}
+
+CactusDisk *cactusDisk_constructFromString(const char *databaseString, bool create, bool cache) {
+    //The sizes are parsed first, so a bad size throws before the disk is constructed.
+    int64_t recordCacheSize = getSizeFromConfString(databaseString, "record_cache_size", CACTUS_DISK_RECORD_CACHE_SIZE);
+    int64_t stringCacheSize = getSizeFromConfString(databaseString, "string_cache_size", CACTUS_DISK_STRING_CACHE_SIZE);
+    CactusDisk *cactusDisk;
+    char *localDatabaseDir = cactusLocalDatabase_getDatabaseDirFromConfString(databaseString);
+    if (localDatabaseDir != NULL) {
+        cactusDisk = cactusDisk_constructPrivate(NULL, localDatabaseDir, create, cache);
+        free(localDatabaseDir);
+    } else {
+        stKVDatabaseConf *conf = stKVDatabaseConf_constructFromString(databaseString);
+        cactusDisk = cactusDisk_constructPrivate(conf, NULL, create, cache);
+        stKVDatabaseConf_destruct(conf);
+    }
+    char *recordCodecs = getAttributeFromConfString(databaseString, "record_codecs");
+    if (recordCodecs != NULL) {
+        cactusDisk_setRecordCodecs(cactusDisk, recordCodecs);
+        free(recordCodecs);
+    }
+    cactusDisk_setCacheSizes(cactusDisk, recordCacheSize, stringCacheSize);
+    char *snapshotFile = getAttributeFromConfString(databaseString, "snapshot");
+    if (snapshotFile != NULL) {
+        cactusDisk_openSnapshot(cactusDisk, snapshotFile);
+        free(snapshotFile);
+    }
+    char *lazyFlowers = getAttributeFromConfString(databaseString, "lazy_flowers");
+    if (lazyFlowers != NULL) {
+        cactusDisk_setLazyFlowers(cactusDisk, strcmp(lazyFlowers, "0") != 0);
+        free(lazyFlowers);
+    }
+    char *statsFile = getAttributeFromConfString(databaseString, "stats_file");
+    if (statsFile != NULL) {
+        cactusDisk_setStatsFile(cactusDisk, statsFile);
+        free(statsFile);
+    }
+    return cactusDisk;
+}
+
+static char *getCacheStatsString(CactusCache *cache, const char *name) {
+    return stString_print("%s cache: %" PRIi64 " of %" PRIi64 " bytes used, %" PRIi64 " hits, %" PRIi64 " misses, %"
+            PRIi64 " evictions", name, cactusCache_getSize(cache), cactusCache_getMaxSize(cache),
+            cactusCache_getHits(cache), cactusCache_getMisses(cache), cactusCache_getEvictions(cache));
+}
+
+static void logCacheStats(CactusCache *cache, const char *name) {
+    char *string = getCacheStatsString(cache, name);
+    st_logDebug("%s\n", string);
+    free(string);
+}
+
+static void appendStats(CactusDisk *cactusDisk) {
+    /*
+     * Appends the statistics, as one line of JSON, to the stats file.
+     */
+    FILE *fileHandle = fopen(cactusDisk->statsFile, "a");
+    if (fileHandle == NULL) {
+        st_logCritical("Could not open the cactus disk stats file %s\n", cactusDisk->statsFile);
+        return;
+    }
+    cactusDisk_printStats(cactusDisk, fileHandle);
+    fprintf(fileHandle, "\n");
+    fclose(fileHandle);
 }
 
 void cactusDisk_destruct(CactusDisk *cactusDisk) {
@@ -566,44 +1338,222 @@ void cactusDisk_destruct(CactusDisk *cactusDisk) {
     }
     stSortedSet_destruct(cactusDisk->metaSequences);
 
-    //close DB
-    stKVDatabase_destruct(cactusDisk->database);
+    //close DB, once any lease being prefetched is in.
+    if (cactusDisk->prefetching) {
+        pthread_join(cactusDisk->prefetchThread, NULL);
+    }
+    if (cactusDisk->localDatabase != NULL) {
+        cactusLocalDatabase_destruct(cactusDisk->localDatabase);
+    } else {
+        stKVDatabase_destruct(cactusDisk->database);
+    }
 
+    if (cactusDisk->statsFile != NULL) {
+        appendStats(cactusDisk);
+        free(cactusDisk->statsFile);
+    }
     if (cactusDisk->cache != NULL) {
-        stCache_destruct(cactusDisk->cache);
+        logCacheStats(cactusDisk->cache, "Record");
+        cactusCache_destruct(cactusDisk->cache);
     }
     if (cactusDisk->stringCache != NULL) {
-        stCache_destruct(cactusDisk->stringCache);
+        logCacheStats(cactusDisk->stringCache, "String");
+        cactusCache_destruct(cactusDisk->stringCache);
+    }
+    stHash_destruct(cactusDisk->sequenceIndexes);
+    if (cactusDisk->snapshot != NULL) { //After the string cache, which may hold chunks read in place from it.
+        cactusSnapshot_destruct(cactusDisk->snapshot);
+        stSortedSet_destruct(cactusDisk->snapshotOverrides);
     }
+    cactusDisk_setThreadSafe(cactusDisk, 0);
 
     stList_destruct(cactusDisk->updateRequests);
 
+    for (int64_t i = 0; i < CACTUS_RECORD_CLASS_NUMBER; i++) {
+        cactusCodec_destruct(cactusDisk->codecs[i]);
+    }
+    free(cactusDisk->flowerDictionary);
+    pthread_mutex_destroy(&cactusDisk->databaseMutex);
+    cactusDiskStats_destruct(cactusDisk->stats);
+
     free(cactusDisk);
 }
 
-void cactusDisk_addUpdateRequest(CactusDisk *cactusDisk, Flower *flower) {
+/*
+ * Serialisation and compression of the records written by cactusDisk_write, which
+ * is done by a pool of threads if cactusDisk->writeThreads > 1.
+ */
+
+typedef struct _serialisedRecord {
+    CactusDisk *cactusDisk;
+    CactusRecordClass recordClass;
+    void *object;
+    void (*writeBinaryRepresentation)(void *, void (*writeFn)(const void * ptr, size_t size, size_t count));
+    void *record;
     int64_t recordSize;
-    void *vA = binaryRepresentation_makeBinaryRepresentation(flower,
-            (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) flower_writeBinaryRepresentation,
-            &recordSize);
-    //Compression
+    uint64_t recordHash;
+    void *compressedRecord;
     int64_t compressedSize;
-    void *compressed = stCompression_compress(vA, recordSize, &compressedSize, -1);
-    if (containsRecord(cactusDisk, flower_getName(flower))) {
-        // Check if this is a redundant update.
-        int64_t recordSize2;
-        void *vA2 = getRecord(cactusDisk, flower_getName(flower), "flower", &recordSize2);
-        if (!stCache_recordsIdentical(vA, recordSize, vA2, recordSize2)) { //Only rewrite if we actually did something
-            stList_append(cactusDisk->updateRequests,
-                    stKVDatabaseBulkRequest_constructUpdateRequest(flower_getName(flower), compressed, compressedSize));
-        }
-        free(vA2);
+} SerialisedRecord;
+
+static SerialisedRecord *serialisedRecord_construct(CactusDisk *cactusDisk, CactusRecordClass recordClass, void *object,
+        void (*writeBinaryRepresentation)(void *, void (*writeFn)(const void * ptr, size_t size, size_t count))) {
+    SerialisedRecord *serialisedRecord = st_calloc(1, sizeof(SerialisedRecord));
+    serialisedRecord->cactusDisk = cactusDisk;
+    serialisedRecord->recordClass = recordClass;
+    serialisedRecord->object = object;
+    serialisedRecord->writeBinaryRepresentation = writeBinaryRepresentation;
+    return serialisedRecord;
+}
+
+static void serialisedRecord_destruct(SerialisedRecord *serialisedRecord) {
+    free(serialisedRecord->record);
+    free(serialisedRecord->compressedRecord);
+    free(serialisedRecord);
+}
+
+static SerialisedRecord *serialiseRecord(SerialisedRecord *serialisedRecord) {
+    serialisedRecord->record = binaryRepresentation_makeBinaryRepresentation(serialisedRecord->object,
+            serialisedRecord->writeBinaryRepresentation, &serialisedRecord->recordSize);
+    serialisedRecord->recordHash = binaryRepresentation_hash(serialisedRecord->record, serialisedRecord->recordSize);
+    return serialisedRecord;
+}
+
+static SerialisedRecord *compressSerialisedRecord(SerialisedRecord *serialisedRecord) {
+    serialisedRecord->compressedRecord = cactusDisk_compressRecord(serialisedRecord->cactusDisk,
+            serialisedRecord->recordClass, serialisedRecord->record, serialisedRecord->recordSize,
+            &serialisedRecord->compressedSize);
+    return serialisedRecord;
+}
+
+static void serialiseRecords(CactusDisk *cactusDisk, stList *serialisedRecords,
+        SerialisedRecord *(*serialiseFn)(SerialisedRecord *)) {
+    /*
+     * Applies the function, which serialises or compresses, to each of the records. The results are placed in each record, so the
+     * order of the list, and hence of the writes, does not depend on the order the threads finish.
+     */
+    int64_t threadNumber = cactusDisk->writeThreads < stList_length(serialisedRecords) ? cactusDisk->writeThreads
+            : stList_length(serialisedRecords);
+    if (threadNumber <= 1) {
+        for (int64_t i = 0; i < stList_length(serialisedRecords); i++) {
+            serialiseFn(stList_get(serialisedRecords, i));
+        }
+        return;
+    }
+    stThreadPool *threadPool = stThreadPool_construct(threadNumber, (void *(*)(void *)) serialiseFn,
+            cactusMisc_threadPoolNoFinish);
+    for (int64_t i = 0; i < stList_length(serialisedRecords); i++) {
+        stThreadPool_push(threadPool, stList_get(serialisedRecords, i));
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+}
+
+static void addFlowerUpdateRequest(CactusDisk *cactusDisk, Flower *flower, uint64_t recordHash,
+        void *compressed, int64_t compressedSize) {
+    /*
+     * Redundant updates are detected by comparing the hash of the new record with the hash
+     * of the record the flower was loaded from (or last written as), so the old record
+     * need not be fetched and decompressed.
+     */
+    Name flowerName = flower_getName(flower);
+    if (flower->hasRecordHash) {
+        if (flower->recordHash == recordHash) { //Only rewrite if we actually did something
+            return;
+        }
+        stList_append(cactusDisk->updateRequests,
+                stKVDatabaseBulkRequest_constructUpdateRequest(flowerName, compressed, compressedSize));
+    } else if (containsRecord(cactusDisk, flowerName)) { //A record we know nothing about, so we must overwrite it.
+        stList_append(cactusDisk->updateRequests,
+                stKVDatabaseBulkRequest_constructUpdateRequest(flowerName, compressed, compressedSize));
+    } else {
+        stList_append(cactusDisk->updateRequests,
+                stKVDatabaseBulkRequest_constructInsertRequest(flowerName, compressed, compressedSize));
+    }
+    flower->hasRecordHash = 1;
+    flower->recordHash = recordHash;
+}
+
+void cactusDisk_addUpdateRequest(CactusDisk *cactusDisk, Flower *flower) {
+    SerialisedRecord *serialisedRecord = compressSerialisedRecord(serialiseRecord(serialisedRecord_construct(cactusDisk,
+            CACTUS_RECORD_FLOWER, flower,
+            (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) flower_writeBinaryRepresentation)));
+    addFlowerUpdateRequest(cactusDisk, flower, serialisedRecord->recordHash,
+            serialisedRecord->compressedRecord, serialisedRecord->compressedSize);
+    serialisedRecord_destruct(serialisedRecord);
+}
+
+static void addFlowerUpdateRequest2(CactusDisk *cactusDisk, SerialisedRecord *serialisedRecord) {
+    addFlowerUpdateRequest(cactusDisk, serialisedRecord->object, serialisedRecord->recordHash,
+            serialisedRecord->compressedRecord, serialisedRecord->compressedSize);
+}
+
+static void addMetaSequenceUpdateRequest(CactusDisk *cactusDisk, SerialisedRecord *serialisedRecord) {
+    Name metaSequenceName = metaSequence_getName(serialisedRecord->object);
+    if (!containsRecord(cactusDisk, metaSequenceName)) {
+        stList_append(cactusDisk->updateRequests,
+                stKVDatabaseBulkRequest_constructInsertRequest(metaSequenceName, serialisedRecord->compressedRecord,
+                        serialisedRecord->compressedSize));
     } else {
         stList_append(cactusDisk->updateRequests,
-                stKVDatabaseBulkRequest_constructInsertRequest(flower_getName(flower), compressed, compressedSize));
+                stKVDatabaseBulkRequest_constructUpdateRequest(metaSequenceName, serialisedRecord->compressedRecord,
+                        serialisedRecord->compressedSize));
+    }
+}
+
+static void serialiseRecordsInBatches(CactusDisk *cactusDisk, stList *objects, CactusRecordClass recordClass,
+        void (*writeBinaryRepresentation)(void *, void (*writeFn)(const void * ptr, size_t size, size_t count)),
+        void (*addUpdateRequest)(CactusDisk *, SerialisedRecord *)) {
+    /*
+     * Serialises and compresses the objects, CACTUS_DISK_WRITE_BATCH_SIZE at a time, adding the update request
+     * for each, so only a batch of uncompressed records is held at once. A flower dictionary, if one is to be
+     * trained, is trained from the first batch of flowers.
+     */
+    for (int64_t i = 0; i < stList_length(objects); i += CACTUS_DISK_WRITE_BATCH_SIZE) {
+        stList *serialisedRecords = stList_construct3(0, (void (*)(void *)) serialisedRecord_destruct);
+        for (int64_t j = i; j < stList_length(objects) && j < i + CACTUS_DISK_WRITE_BATCH_SIZE; j++) {
+            stList_append(serialisedRecords, serialisedRecord_construct(cactusDisk, recordClass,
+                    stList_get(objects, j), writeBinaryRepresentation));
+        }
+        serialiseRecords(cactusDisk, serialisedRecords, serialiseRecord);
+        if (recordClass == CACTUS_RECORD_FLOWER && cactusDisk->trainFlowerDictionary
+                && cactusDisk->flowerDictionary == NULL
+                && cactusCodec_getType(cactusDisk->codecs[CACTUS_RECORD_FLOWER]) == CACTUS_CODEC_ZSTD) {
+            stList *samples = stList_construct();
+            stList *sampleSizes = stList_construct();
+            for (int64_t j = 0; j < stList_length(serialisedRecords); j++) {
+                SerialisedRecord *serialisedRecord = stList_get(serialisedRecords, j);
+                stList_append(samples, serialisedRecord->record);
+                stList_append(sampleSizes, &serialisedRecord->recordSize);
+            }
+            trainFlowerDictionary(cactusDisk, samples, sampleSizes);
+            stList_destruct(samples);
+            stList_destruct(sampleSizes);
+        }
+        serialiseRecords(cactusDisk, serialisedRecords, compressSerialisedRecord);
+        for (int64_t j = 0; j < stList_length(serialisedRecords); j++) {
+            addUpdateRequest(cactusDisk, stList_get(serialisedRecords, j));
+        }
+        stList_destruct(serialisedRecords);
     }
-    free(vA);
-    free(compressed);
+}
+
+void cactusDisk_setWriteThreads(CactusDisk *cactusDisk, int64_t writeThreads) {
+    assert(writeThreads >= 1);
+    cactusDisk->writeThreads = writeThreads;
+}
+
+void cactusDisk_setReadThreads(CactusDisk *cactusDisk, int64_t readThreads) {
+    assert(readThreads >= 1);
+    cactusDisk->readThreads = readThreads;
+}
+
+void cactusDisk_setLazyFlowers(CactusDisk *cactusDisk, bool lazyFlowers) {
+    cactusDisk->lazyFlowers = lazyFlowers;
+}
+
+bool cactusDisk_getLazyFlowers(CactusDisk *cactusDisk) {
+    return cactusDisk->lazyFlowers;
 }
 
 void cactusDisk_forceParameterUpdate(CactusDisk *cactusDisk, bool keyAlreadyExists) {
@@ -613,7 +1563,7 @@ void cactusDisk_forceParameterUpdate(CactusDisk *cactusDisk, bool keyAlreadyExis
                                                       (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) cactusDisk_writeBinaryRepresentation,
                                                       &recordSize);
     //Compression
-    cactusDiskParameters = compress(cactusDiskParameters, &recordSize);
+    cactusDiskParameters = compress(cactusDisk, CACTUS_RECORD_META_SEQUENCE, cactusDiskParameters, &recordSize);
     if (keyAlreadyExists) {
         stList_append(cactusDisk->updateRequests,
                       stKVDatabaseBulkRequest_constructUpdateRequest(CACTUS_DISK_PARAMETER_KEY, cactusDiskParameters,
@@ -628,20 +1578,41 @@ void cactusDisk_forceParameterUpdate(CactusDisk *cactusDisk, bool keyAlreadyExis
 
 void cactusDisk_write(CactusDisk *cactusDisk) {
     Flower *flower;
-    int64_t recordSize;
+    int64_t startTime = cactusDiskStats_getTime();
 
     stList *removeRequests = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
 
     st_logDebug("Starting to write the cactus to disk\n");
 
+    //Serialise and compress the flowers and meta sequences, in parallel if we have write threads.
+    stList *flowers = stList_construct();
     stSortedSetIterator *it = stSortedSet_getIterator(cactusDisk->flowers);
-    //Sort flowers to update.
     while ((flower = stSortedSet_getNext(it)) != NULL) {
-        cactusDisk_addUpdateRequest(cactusDisk, flower);
+        if (!flower_isMaterialised(flower) && flower->hasRecordHash) {
+            continue; //A lazily loaded flower which has not been changed, so whose record on disk is the same.
+        }
+        flower_materialise(flower); //Here, rather than in the serialising threads, as it constructs the flower's caps.
+        stList_append(flowers, flower);
     }
     stSortedSet_destructIterator(it);
+    serialiseRecordsInBatches(cactusDisk, flowers, CACTUS_RECORD_FLOWER,
+            (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) flower_writeBinaryRepresentation,
+            addFlowerUpdateRequest2);
+    stList *metaSequences = stList_construct();
+    it = stSortedSet_getIterator(cactusDisk->metaSequences);
+    MetaSequence *metaSequence;
+    while ((metaSequence = stSortedSet_getNext(it)) != NULL) {
+        stList_append(metaSequences, metaSequence);
+    }
+    stSortedSet_destructIterator(it);
+    serialiseRecordsInBatches(cactusDisk, metaSequences, CACTUS_RECORD_META_SEQUENCE,
+            (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) metaSequence_writeBinaryRepresentation,
+            addMetaSequenceUpdateRequest);
 
-    st_logDebug("Got the flowers to update\n");
+    st_logDebug("Serialised %" PRIi64 " flowers and %" PRIi64 " meta sequences\n", stList_length(flowers),
+            stList_length(metaSequences));
+    stList_destruct(flowers);
+    stList_destruct(metaSequences);
 
     //Remove nets that are marked for deletion..
     it = stSortedSet_getIterator(cactusDisk->flowerNamesMarkedForDeletion);
@@ -657,27 +1628,6 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
 
     st_logDebug("Avoided updating nets marked for deletion\n");
 
-    // Insert and/or update meta-sequences.
-    it = stSortedSet_getIterator(cactusDisk->metaSequences);
-    MetaSequence *metaSequence;
-    while ((metaSequence = stSortedSet_getNext(it)) != NULL) {
-        void *vA =
-                binaryRepresentation_makeBinaryRepresentation(metaSequence,
-                        (void (*)(void *, void (*)(const void * ptr, size_t size, size_t count))) metaSequence_writeBinaryRepresentation,
-                        &recordSize);
-        //Compression
-        vA = compress(vA, &recordSize);
-        if (!containsRecord(cactusDisk, metaSequence_getName(metaSequence))) {
-            stList_append(cactusDisk->updateRequests,
-                    stKVDatabaseBulkRequest_constructInsertRequest(metaSequence_getName(metaSequence), vA, recordSize));
-        } else {
-            stList_append(cactusDisk->updateRequests,
-                    stKVDatabaseBulkRequest_constructUpdateRequest(metaSequence_getName(metaSequence), vA, recordSize));
-        }
-        free(vA);
-    }
-    stSortedSet_destructIterator(it);
-
     st_logDebug("Got the sequences we are going to add to the database.\n");
 
     if (!containsRecord(cactusDisk, CACTUS_DISK_PARAMETER_KEY)) { //We only write the parameters once.
@@ -692,7 +1642,7 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
             {
                 st_logDebug("Writing %" PRIi64 " updates\n", stList_length(cactusDisk->updateRequests));
                 assert(stList_length(cactusDisk->updateRequests) > 0);
-                stKVDatabase_bulkSetRecords(cactusDisk->database, cactusDisk->updateRequests);
+                database_bulkSetRecords(cactusDisk, cactusDisk->updateRequests);
             }
             stCatch(except)
                 {
@@ -707,7 +1657,7 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
     if (stList_length(removeRequests) > 0) {
         stTry
             {
-                stKVDatabase_bulkRemoveRecords(cactusDisk->database, removeRequests);
+                database_bulkRemoveRecords(cactusDisk, removeRequests);
             }
             stCatch(except)
                 {
@@ -719,6 +1669,21 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
 
     st_logDebug("Now removed flowers we don't need\n");
 
+    bool changedRecords = stList_length(removeRequests) > 0;
+    for (int64_t i = 0; i < stList_length(cactusDisk->updateRequests) && !changedRecords; i++) {
+        changedRecords = ((stKVDatabaseBulkRequest *) stList_get(cactusDisk->updateRequests, i))->type != INSERT;
+    }
+    if (changedRecords) {
+        incrementGeneration(cactusDisk);
+    }
+
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < stList_length(cactusDisk->updateRequests); i++) {
+        bytes += ((stKVDatabaseBulkRequest *) stList_get(cactusDisk->updateRequests, i))->size;
+    }
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_WRITE, startTime,
+            stList_length(cactusDisk->updateRequests) + stList_length(removeRequests), bytes, 0);
+
     stList_destruct(cactusDisk->updateRequests);
     cactusDisk->updateRequests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
     stList_destruct(removeRequests);
@@ -726,54 +1691,260 @@ void cactusDisk_write(CactusDisk *cactusDisk) {
     st_logDebug("Finished writing to the database\n");
 }
 
-stList *cactusDisk_getFlowers(CactusDisk *cactusDisk, stList *flowerNames) {
-    stList *records = getRecords(cactusDisk, flowerNames, "flowers");
-    assert(stList_length(flowerNames) == stList_length(records));
-    stList *flowers = stList_construct();
-    for (int64_t i = 0; i < stList_length(flowerNames); i++) {
-        Name flowerName = *((int64_t *) stList_get(flowerNames, i));
-        static Flower flower;
-        flower.name = flowerName;
-        Flower *flower2;
-        if ((flower2 = stSortedSet_search(cactusDisk->flowers, &flower)) == NULL) {
-            void *record = stList_get(records, i);
-            assert(record != NULL);
-            void *cA = record;
-            flower2 = flower_loadFromBinaryRepresentation(&cA, cactusDisk);
-            assert(flower2 != NULL);
-        }
-        stList_append(flowers, flower2);
-    }
-    stList_destruct(records);
-    return flowers;
+static Flower *getLoadedFlower(CactusDisk *cactusDisk, Name flowerName) {
+    Flower flower; //The probe is per call, so that several threads can search at once.
+    flower.name = flowerName;
+    return stSortedSet_search(cactusDisk->flowers, &flower);
 }
 
-Flower *cactusDisk_getFlower(CactusDisk *cactusDisk, Name flowerName) {
-    static Flower flower;
-    flower.name = flowerName;
+static Flower *loadFlower(CactusDisk *cactusDisk, void *record) {
+    /*
+     * Loads a flower from its (uncompressed) record, remembering the hash of the record
+     * so that cactusDisk_write can tell if the flower has changed.
+     */
+    void *cA = record;
+    Flower *flower = cactusDisk->lazyFlowers ? flower_loadSkeletonFromBinaryRepresentation(&cA, cactusDisk)
+            : flower_loadFromBinaryRepresentation(&cA, cactusDisk);
+    assert(flower != NULL);
+    flower->hasRecordHash = 1;
+    flower->recordHash = binaryRepresentation_hash(record, (char *) cA - (char *) record);
+    return flower;
+}
+
+static Flower *getFlower(CactusDisk *cactusDisk, Name flowerName) {
     Flower *flower2;
-    if ((flower2 = stSortedSet_search(cactusDisk->flowers, &flower)) != NULL) {
+    if ((flower2 = getLoadedFlower(cactusDisk, flowerName)) != NULL) {
         return flower2;
     }
-    void *cA = getRecord(cactusDisk, flowerName, "flower", NULL);
+    void *cA = getRecord(cactusDisk, flowerName, CACTUS_RECORD_FLOWER, "flower", NULL);
 
     if (cA == NULL) {
         return NULL;
     }
-    void *cA2 = cA;
-    flower2 = flower_loadFromBinaryRepresentation(&cA2, cactusDisk);
+    stTry {
+        flower2 = loadFlower(cactusDisk, cA);
+    } stCatch(except) {
+        free(cA);
+        stThrow(except);
+    } stTryEnd;
     free(cA);
     return flower2;
 }
 
-MetaSequence *cactusDisk_getMetaSequence(CactusDisk *cactusDisk, Name metaSequenceName) {
-    static MetaSequence metaSequence;
+/*
+ * Decompression of the flower records read by cactusDisk_getFlowers, which is done by a pool of
+ * threads if cactusDisk->readThreads > 1. Loading the flowers from the records, which links them
+ * into the disk, is done afterwards by the calling thread.
+ */
+
+typedef struct _flowerRecord {
+    CactusCodec *codec;
+    CactusDiskStats *stats; //The statistics of the disk, in which the decompression is counted.
+    stKVDatabaseBulkResult *result;
+    const void *snapshotRecord; //If non-null, the compressed record in place in the snapshot, in place of the result.
+    int64_t snapshotRecordSize;
+    int64_t compressedSize;
+    void *record;
+    int64_t recordSize;
+} FlowerRecord;
+
+static FlowerRecord *flowerRecord_construct(CactusCodec *codec, CactusDiskStats *stats, stKVDatabaseBulkResult *result) {
+    FlowerRecord *flowerRecord = st_calloc(1, sizeof(FlowerRecord));
+    flowerRecord->codec = codec;
+    flowerRecord->stats = stats;
+    flowerRecord->result = result;
+    return flowerRecord;
+}
+
+static void flowerRecord_destruct(FlowerRecord *flowerRecord) {
+    if (flowerRecord->result != NULL) {
+        stKVDatabaseBulkResult_destruct(flowerRecord->result);
+    }
+    free(flowerRecord->record);
+    free(flowerRecord);
+}
+
+static FlowerRecord *decompressFlowerRecord(FlowerRecord *flowerRecord) {
+    int64_t startTime = cactusDiskStats_getTime();
+    if (flowerRecord->snapshotRecord != NULL) {
+        flowerRecord->compressedSize = flowerRecord->snapshotRecordSize;
+        flowerRecord->record = cactusCodec_decompress(flowerRecord->codec, flowerRecord->snapshotRecord,
+                flowerRecord->snapshotRecordSize, &flowerRecord->recordSize);
+    } else {
+        void *compressedRecord = stKVDatabaseBulkResult_getRecord(flowerRecord->result, &flowerRecord->compressedSize);
+        flowerRecord->record = cactusCodec_decompress(flowerRecord->codec, compressedRecord,
+                flowerRecord->compressedSize, &flowerRecord->recordSize);
+        stKVDatabaseBulkResult_destruct(flowerRecord->result); //Free the compressed record as soon as we are done with it.
+        flowerRecord->result = NULL;
+    }
+    cactusDiskStats_add(flowerRecord->stats, CACTUS_DISK_OP_DECOMPRESS, startTime, 1, flowerRecord->compressedSize,
+            flowerRecord->recordSize);
+    return flowerRecord;
+}
+
+static void decompressFlowerRecords(CactusDisk *cactusDisk, stList *flowerRecords) {
+    int64_t threadNumber = cactusDisk->readThreads < stList_length(flowerRecords) ? cactusDisk->readThreads
+            : stList_length(flowerRecords);
+    if (threadNumber <= 1) {
+        for (int64_t i = 0; i < stList_length(flowerRecords); i++) {
+            decompressFlowerRecord(stList_get(flowerRecords, i));
+        }
+        return;
+    }
+    stThreadPool *threadPool = stThreadPool_construct(threadNumber, (void *(*)(void *)) decompressFlowerRecord,
+            cactusMisc_threadPoolNoFinish);
+    for (int64_t i = 0; i < stList_length(flowerRecords); i++) {
+        stThreadPool_push(threadPool, stList_get(flowerRecords, i));
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+}
+
+static void fetchFlowerRecords(CactusDisk *cactusDisk, stList *getRequests, stList *fetchedFlowerRecords) {
+    /*
+     * Fetches the compressed records of the flowers in one bulk request, placing each in its flower record.
+     */
+    stList *records = NULL;
+    stTry
+        {
+            records = database_bulkGetRecords(cactusDisk, getRequests);
+        }
+        stCatch(except)
+            {
+                stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
+                        "An unknown database error occurred when getting a bulk set of flowers");
+            }stTryEnd
+    ;
+    assert(stList_length(records) == stList_length(getRequests));
+    for (int64_t i = 0; i < stList_length(records); i++) {
+        ((FlowerRecord *) stList_get(fetchedFlowerRecords, i))->result = stList_get(records, i);
+    }
+    stList_setDestructor(records, NULL); //The results are now owned by the flower records.
+    stList_destruct(records);
+    for (int64_t i = 0; i < stList_length(fetchedFlowerRecords); i++) {
+        FlowerRecord *flowerRecord = stList_get(fetchedFlowerRecords, i);
+        int64_t recordSize;
+        void *record = stKVDatabaseBulkResult_getRecord(flowerRecord->result, &recordSize);
+        if (record == NULL) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The flower %" PRIi64 " is missing from the database",
+                    *((int64_t *) stList_get(getRequests, i)));
+        }
+        //Any dictionary needed is loaded before the records are decompressed in parallel.
+        loadRecordDictionary(cactusDisk, CACTUS_RECORD_FLOWER, record, recordSize);
+    }
+}
+
+static void getFlowers(CactusDisk *cactusDisk, stList *flowerNames, stList *flowers, stList *flowerRecords,
+        stHash *flowerRecordsByName) {
+    /*
+     * Fetch the records of the flowers that are neither loaded nor cached in one bulk request. Records in
+     * the snapshot are decompressed in place. The flower records are placed in flowerRecords and flowerRecordsByName,
+     * which the caller frees, so nothing is leaked if an exception is thrown.
+     */
+    int64_t startTime = cactusDiskStats_getTime();
+    stList *getRequests = stList_construct();
+    stList *fetchedFlowerRecords = stList_construct(); //The flower records not in the snapshot, in the order of getRequests.
+    stTry {
+        for (int64_t i = 0; i < stList_length(flowerNames); i++) {
+            Name flowerName = *((int64_t *) stList_get(flowerNames, i));
+            stIntTuple *key = stIntTuple_construct1(flowerName);
+            if (getLoadedFlower(cactusDisk, flowerName) != NULL || stHash_search(flowerRecordsByName, key) != NULL
+                    || (cactusDisk->cache != NULL && cactusCache_contains(cactusDisk->cache, flowerName))) {
+                stIntTuple_destruct(key);
+                continue;
+            }
+            FlowerRecord *flowerRecord = flowerRecord_construct(cactusDisk->codecs[CACTUS_RECORD_FLOWER], cactusDisk->stats, NULL);
+            stList_append(flowerRecords, flowerRecord);
+            stHash_insert(flowerRecordsByName, key, flowerRecord);
+            flowerRecord->snapshotRecord = database_getSnapshotRecord(cactusDisk, flowerName, &flowerRecord->snapshotRecordSize);
+            if (flowerRecord->snapshotRecord != NULL) {
+                loadRecordDictionary(cactusDisk, CACTUS_RECORD_FLOWER, flowerRecord->snapshotRecord,
+                        flowerRecord->snapshotRecordSize);
+            } else {
+                stList_append(getRequests, stList_get(flowerNames, i));
+                stList_append(fetchedFlowerRecords, flowerRecord);
+            }
+        }
+        if (stList_length(getRequests) > 0) {
+            fetchFlowerRecords(cactusDisk, getRequests, fetchedFlowerRecords);
+        }
+        decompressFlowerRecords(cactusDisk, flowerRecords);
+    } stCatch(except) {
+        stList_destruct(getRequests);
+        stList_destruct(fetchedFlowerRecords);
+        stThrow(except);
+    } stTryEnd;
+    stList_destruct(getRequests);
+    stList_destruct(fetchedFlowerRecords);
+
+    /*
+     * Load the flowers, in order. The decompressed records are parsed directly, without being copied into the cache.
+     */
+    int64_t bytes = 0, rawBytes = 0; //The sizes of the records read, compressed and decompressed.
+    for (int64_t i = 0; i < stList_length(flowerRecords); i++) {
+        FlowerRecord *flowerRecord = stList_get(flowerRecords, i);
+        bytes += flowerRecord->compressedSize;
+        rawBytes += flowerRecord->recordSize;
+    }
+    for (int64_t i = 0; i < stList_length(flowerNames); i++) {
+        Name flowerName = *((int64_t *) stList_get(flowerNames, i));
+        Flower *flower = getLoadedFlower(cactusDisk, flowerName);
+        if (flower == NULL) {
+            stIntTuple *key = stIntTuple_construct1(flowerName);
+            FlowerRecord *flowerRecord = stHash_search(flowerRecordsByName, key);
+            stIntTuple_destruct(key);
+            flower = flowerRecord != NULL ? loadFlower(cactusDisk, flowerRecord->record) : getFlower(cactusDisk, flowerName);
+            assert(flower != NULL);
+        }
+        stList_append(flowers, flower);
+    }
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS, startTime, stList_length(flowers), bytes, rawBytes);
+}
+
+stList *cactusDisk_getFlowers(CactusDisk *cactusDisk, stList *flowerNames) {
+    lock(cactusDisk);
+    stList *flowers = stList_construct();
+    stList *flowerRecords = stList_construct3(0, (void (*)(void *)) flowerRecord_destruct);
+    stHash *flowerRecordsByName = stHash_construct3((uint64_t (*)(const void *)) stIntTuple_hashKey,
+            (int (*)(const void *, const void *)) stIntTuple_equalsFn, (void (*)(void *)) stIntTuple_destruct, NULL);
+    stTry {
+        getFlowers(cactusDisk, flowerNames, flowers, flowerRecords, flowerRecordsByName);
+    } stCatch(except) {
+        stHash_destruct(flowerRecordsByName);
+        stList_destruct(flowerRecords);
+        stList_destruct(flowers);
+        unlock(cactusDisk);
+        stThrow(except);
+    } stTryEnd;
+    stHash_destruct(flowerRecordsByName);
+    stList_destruct(flowerRecords);
+    unlock(cactusDisk);
+    return flowers;
+}
+
+Flower *cactusDisk_getFlower(CactusDisk *cactusDisk, Name flowerName) {
+    lock(cactusDisk);
+    int64_t startTime = cactusDiskStats_getTime();
+    Flower *flower = NULL;
+    stTry {
+        flower = getFlower(cactusDisk, flowerName);
+    } stCatch(except) {
+        unlock(cactusDisk);
+        stThrow(except);
+    } stTryEnd;
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWER, startTime, flower != NULL, 0, 0);
+    unlock(cactusDisk);
+    return flower;
+}
+
+static MetaSequence *getMetaSequence(CactusDisk *cactusDisk, Name metaSequenceName) {
+    MetaSequence metaSequence;
     metaSequence.name = metaSequenceName;
     MetaSequence *metaSequence2;
     if ((metaSequence2 = stSortedSet_search(cactusDisk->metaSequences, &metaSequence)) != NULL) {
         return metaSequence2;
     }
-    void *cA = getRecord(cactusDisk, metaSequenceName, "metaSequence", NULL);
+    void *cA = getRecord(cactusDisk, metaSequenceName, CACTUS_RECORD_META_SEQUENCE, "metaSequence", NULL);
     if (cA == NULL) {
         return NULL;
     }
@@ -783,33 +1954,338 @@ MetaSequence *cactusDisk_getMetaSequence(CactusDisk *cactusDisk, Name metaSequen
     return metaSequence2;
 }
 
+MetaSequence *cactusDisk_getMetaSequence(CactusDisk *cactusDisk, Name metaSequenceName) {
+    lock(cactusDisk);
+    int64_t startTime = cactusDiskStats_getTime();
+    MetaSequence *metaSequence = NULL;
+    stTry {
+        metaSequence = getMetaSequence(cactusDisk, metaSequenceName);
+    } stCatch(except) {
+        unlock(cactusDisk);
+        stThrow(except);
+    } stTryEnd;
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_GET_META_SEQUENCE, startTime, metaSequence != NULL, 0, 0);
+    unlock(cactusDisk);
+    return metaSequence;
+}
+
+/*
+ * Snapshots and archives. A snapshot holds the records, as stored in the database, that the workers
+ * processing a set of flowers read: the flowers and the flowers nested in them, their meta
+ * sequences and the chunks of their strings. An archive holds the same records for the root flower,
+ * and the unique id buckets, so holds the whole database.
+ *
+ * The records are exported to a writer, a snapshot or archive writer, through its add function.
+ */
+
+typedef void (*AddRecordFn)(void *writer, int64_t key, const void *record, int64_t recordSize);
+
+static void exportRecordsWithKeys(CactusDisk *cactusDisk, AddRecordFn addRecord, void *writer, stList *keys,
+        bool mustExist) {
+    /*
+     * Copies the records with the given keys from the database to the writer, in bulk requests
+     * of up to CACTUS_DISK_EXPORT_BATCH_SIZE records.
+     */
+    for (int64_t i = 0; i < stList_length(keys); i += CACTUS_DISK_EXPORT_BATCH_SIZE) {
+        stList *batch = stList_construct();
+        for (int64_t j = i; j < stList_length(keys) && j < i + CACTUS_DISK_EXPORT_BATCH_SIZE; j++) {
+            stList_append(batch, stList_get(keys, j));
+        }
+        stList *records = database_bulkGetRecords(cactusDisk, batch);
+        assert(stList_length(records) == stList_length(batch));
+        for (int64_t j = 0; j < stList_length(batch); j++) {
+            int64_t recordSize;
+            void *record = stKVDatabaseBulkResult_getRecord(stList_get(records, j), &recordSize);
+            if (record != NULL) {
+                addRecord(writer, *(int64_t *) stList_get(batch, j), record, recordSize);
+            } else if (mustExist) {
+                stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The record %" PRIi64 " is missing from the database",
+                        *(int64_t *) stList_get(batch, j));
+            }
+        }
+        stList_destruct(records);
+        stList_destruct(batch);
+    }
+}
+
+static void appendKey(stList *keys, Name key) {
+    int64_t *k = st_malloc(sizeof(int64_t));
+    k[0] = key;
+    stList_append(keys, k);
+}
+
+static void exportStrings(CactusDisk *cactusDisk, AddRecordFn addRecord, void *writer, stHash *stringLengths) {
+    /*
+     * Copies the index records and chunks of the given strings to the writer. The hash maps the name of
+     * each string to its length, which gives the number of chunks of a string written without an index.
+     */
+    stList *stringNames = stList_construct3(0, free);
+    stHashIterator *it = stHash_getIterator(stringLengths);
+    stIntTuple *stringName;
+    while ((stringName = stHash_getNext(it)) != NULL) {
+        appendKey(stringNames, stIntTuple_get(stringName, 0));
+    }
+    stHash_destructIterator(it);
+
+    stList *chunkNames = stList_construct3(0, free);
+    for (int64_t i = 0; i < stList_length(stringNames); i += CACTUS_DISK_EXPORT_BATCH_SIZE) {
+        stList *batch = stList_construct();
+        for (int64_t j = i; j < stList_length(stringNames) && j < i + CACTUS_DISK_EXPORT_BATCH_SIZE; j++) {
+            stList_append(batch, stList_get(stringNames, j));
+        }
+        stList *records = database_bulkGetRecords(cactusDisk, batch);
+        assert(stList_length(records) == stList_length(batch));
+        for (int64_t j = 0; j < stList_length(batch); j++) {
+            Name name = *(int64_t *) stList_get(batch, j);
+            int64_t recordSize;
+            void *record = stKVDatabaseBulkResult_getRecord(stList_get(records, j), &recordSize);
+            if (record == NULL) {
+                stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The sequence %" PRIi64 " is missing from the database", name);
+            }
+            addRecord(writer, name, record, recordSize);
+            SequenceIndex *sequenceIndex = sequenceIndex_parseRecord(record, recordSize);
+            int64_t firstChunk = 0;
+            if (sequenceIndex == NULL) { //A string written by an older version, the record is its first chunk.
+                stIntTuple *key = stIntTuple_construct1(name);
+                int64_t length = stIntTuple_get(stHash_search(stringLengths, key), 0);
+                stIntTuple_destruct(key);
+                sequenceIndex = sequenceIndex_construct(length, CACTUS_DISK_LEGACY_SEQUENCE_CHUNK_SIZE, 0);
+                firstChunk = 1;
+            }
+            int64_t chunkNumber = (sequenceIndex->length + sequenceIndex->chunkSize - 1) / sequenceIndex->chunkSize;
+            for (int64_t k = firstChunk; k < chunkNumber; k++) {
+                appendKey(chunkNames, sequenceIndex_getChunkName(sequenceIndex, name, k));
+            }
+            free(sequenceIndex);
+        }
+        stList_destruct(records);
+        stList_destruct(batch);
+    }
+    exportRecordsWithKeys(cactusDisk, addRecord, writer, chunkNames, 1);
+    stList_destruct(chunkNames);
+    stList_destruct(stringNames);
+}
+
+static void addExportedFlower(Flower *flower, stList *flowerNames, stList *pendingFlowerNames,
+        stSortedSet *metaSequenceNames, stHash *stringLengths) {
+    /*
+     * Adds the name of the flower, of the flowers nested in it and of its meta sequences and strings to the given collections.
+     */
+    appendKey(flowerNames, flower_getName(flower));
+    Flower_GroupIterator *groupIt = flower_getGroupIterator(flower);
+    Group *group;
+    while ((group = flower_getNextGroup(groupIt)) != NULL) {
+        if (!group_isLeaf(group)) {
+            appendKey(pendingFlowerNames, group_getName(group));
+        }
+    }
+    flower_destructGroupIterator(groupIt);
+    Flower_SequenceIterator *sequenceIt = flower_getSequenceIterator(flower);
+    Sequence *sequence;
+    while ((sequence = flower_getNextSequence(sequenceIt)) != NULL) {
+        MetaSequence *metaSequence = sequence_getMetaSequence(sequence);
+        stIntTuple *metaSequenceName = stIntTuple_construct1(metaSequence_getName(metaSequence));
+        if (stSortedSet_search(metaSequenceNames, metaSequenceName) != NULL) {
+            stIntTuple_destruct(metaSequenceName);
+            continue;
+        }
+        stSortedSet_insert(metaSequenceNames, metaSequenceName);
+        stIntTuple *stringName = stIntTuple_construct1(metaSequence->stringName);
+        if (stHash_search(stringLengths, stringName) == NULL) {
+            stHash_insert(stringLengths, stringName, stIntTuple_construct1(metaSequence_getLength(metaSequence)));
+        } else {
+            stIntTuple_destruct(stringName);
+        }
+    }
+    flower_destructSequenceIterator(sequenceIt);
+}
+
+static void exportRecords(CactusDisk *cactusDisk, stList *flowerNames, AddRecordFn addRecord, void *writer) {
+    /*
+     * Walk the flowers, nested flowers first, in batches, unloading again those that were not already loaded.
+     */
+    stList *snapshotFlowerNames = stList_construct3(0, free);
+    stList *pendingFlowerNames = stList_construct3(0, free);
+    stSortedSet *visitedFlowerNames = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+            (void (*)(void *)) stIntTuple_destruct);
+    stSortedSet *metaSequenceNames = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+            (void (*)(void *)) stIntTuple_destruct);
+    stHash *stringLengths = stHash_construct3((uint64_t (*)(const void *)) stIntTuple_hashKey,
+            (int (*)(const void *, const void *)) stIntTuple_equalsFn, (void (*)(void *)) stIntTuple_destruct,
+            (void (*)(void *)) stIntTuple_destruct);
+    for (int64_t i = stList_length(flowerNames) - 1; i >= 0; i--) {
+        appendKey(pendingFlowerNames, *(int64_t *) stList_get(flowerNames, i));
+    }
+    while (stList_length(pendingFlowerNames) > 0) {
+        stList *batch = stList_construct3(0, free);
+        while (stList_length(pendingFlowerNames) > 0 && stList_length(batch) < CACTUS_DISK_EXPORT_BATCH_SIZE) {
+            int64_t *flowerName = stList_pop(pendingFlowerNames);
+            stIntTuple *key = stIntTuple_construct1(*flowerName);
+            if (stSortedSet_search(visitedFlowerNames, key) != NULL) { //Named twice.
+                stIntTuple_destruct(key);
+                free(flowerName);
+                continue;
+            }
+            stSortedSet_insert(visitedFlowerNames, key);
+            stList_append(batch, flowerName);
+        }
+        stList *wasLoaded = stList_construct();
+        for (int64_t i = 0; i < stList_length(batch); i++) {
+            stList_append(wasLoaded, getLoadedFlower(cactusDisk, *(int64_t *) stList_get(batch, i)));
+        }
+        stList *flowers = cactusDisk_getFlowers(cactusDisk, batch);
+        for (int64_t i = 0; i < stList_length(flowers); i++) {
+            addExportedFlower(stList_get(flowers, i), snapshotFlowerNames, pendingFlowerNames, metaSequenceNames,
+                    stringLengths);
+        }
+        for (int64_t i = 0; i < stList_length(flowers); i++) {
+            if (stList_get(wasLoaded, i) == NULL) {
+                flower_unload(stList_get(flowers, i));
+            }
+        }
+        stList_destruct(flowers);
+        stList_destruct(wasLoaded);
+        stList_destruct(batch);
+    }
+    stList_destruct(pendingFlowerNames);
+    stSortedSet_destruct(visitedFlowerNames);
+
+    /*
+     * Copy the records.
+     */
+    stList *keys = stList_construct3(0, free);
+    appendKey(keys, CACTUS_DISK_PARAMETER_KEY);
+    appendKey(keys, CACTUS_DISK_FLOWER_DICTIONARY_KEY);
+    exportRecordsWithKeys(cactusDisk, addRecord, writer, keys, 0);
+    stList_destruct(keys);
+    exportRecordsWithKeys(cactusDisk, addRecord, writer, snapshotFlowerNames, 1);
+    keys = stList_construct3(0, free);
+    stSortedSetIterator *it = stSortedSet_getIterator(metaSequenceNames);
+    stIntTuple *metaSequenceName;
+    while ((metaSequenceName = stSortedSet_getNext(it)) != NULL) {
+        appendKey(keys, stIntTuple_get(metaSequenceName, 0));
+    }
+    stSortedSet_destructIterator(it);
+    exportRecordsWithKeys(cactusDisk, addRecord, writer, keys, 1);
+    stList_destruct(keys);
+    exportStrings(cactusDisk, addRecord, writer, stringLengths);
+
+    stList_destruct(snapshotFlowerNames);
+    stSortedSet_destruct(metaSequenceNames);
+    stHash_destruct(stringLengths);
+}
+
+void cactusDisk_exportSnapshot(CactusDisk *cactusDisk, stList *flowerNames, const char *snapshotFile) {
+    lock(cactusDisk);
+    CactusSnapshotWriter *writer = cactusSnapshotWriter_construct(snapshotFile, getGeneration(cactusDisk));
+    exportRecords(cactusDisk, flowerNames, (AddRecordFn) cactusSnapshotWriter_add, writer);
+    cactusSnapshotWriter_finish(writer);
+    unlock(cactusDisk);
+}
+
+static void exportUniqueIDBuckets(CactusDisk *cactusDisk, CactusArchiveWriter *writer) {
+    /*
+     * Copies the unique id buckets that have been used to the archive, as counters. Their values are read
+     * by incrementing them by zero, as the database may not store them as plain int64 records.
+     */
+    stList *keys = stList_construct3(0, free);
+    for (int64_t i = 1; i <= CACTUS_DISK_BUCKET_NUMBER; i++) {
+        appendKey(keys, -i);
+    }
+    for (int64_t i = 0; i < stList_length(keys); i += CACTUS_DISK_EXPORT_BATCH_SIZE) {
+        stList *batch = stList_construct();
+        for (int64_t j = i; j < stList_length(keys) && j < i + CACTUS_DISK_EXPORT_BATCH_SIZE; j++) {
+            stList_append(batch, stList_get(keys, j));
+        }
+        stList *records = database_bulkGetRecords2(cactusDisk, batch);
+        for (int64_t j = 0; j < stList_length(batch); j++) {
+            int64_t recordSize;
+            if (stKVDatabaseBulkResult_getRecord(stList_get(records, j), &recordSize) != NULL) {
+                Name bucket = *(int64_t *) stList_get(batch, j);
+                cactusArchiveWriter_addInt64(writer, bucket, database_incrementInt64(cactusDisk, bucket, 0));
+            }
+        }
+        stList_destruct(records);
+        stList_destruct(batch);
+    }
+    stList_destruct(keys);
+}
+
+void cactusDisk_exportArchive(CactusDisk *cactusDisk, Name rootFlowerName, const char *archiveFile,
+        int64_t threadNumber) {
+    lock(cactusDisk);
+    CactusArchiveWriter *writer = cactusArchiveWriter_construct(archiveFile, threadNumber);
+    stList *flowerNames = stList_construct3(0, free);
+    appendKey(flowerNames, rootFlowerName);
+    exportRecords(cactusDisk, flowerNames, (AddRecordFn) cactusArchiveWriter_add, writer);
+    stList_destruct(flowerNames);
+    exportUniqueIDBuckets(cactusDisk, writer);
+    cactusArchiveWriter_finish(writer);
+    unlock(cactusDisk);
+}
+
+void cactusDisk_openSnapshot(CactusDisk *cactusDisk, const char *snapshotFile) {
+    lock(cactusDisk);
+    CactusSnapshot *snapshot = NULL;
+    stTry {
+        snapshot = cactusSnapshot_construct(snapshotFile);
+        int64_t generation = getGeneration(cactusDisk);
+        if (cactusSnapshot_getGeneration(snapshot) != generation) {
+            int64_t snapshotGeneration = cactusSnapshot_getGeneration(snapshot);
+            cactusSnapshot_destruct(snapshot);
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The snapshot %s is stale: it was exported at generation %" PRIi64
+                    " of the database, which is now at generation %" PRIi64, snapshotFile, snapshotGeneration, generation);
+        }
+    } stCatch(except) {
+        unlock(cactusDisk);
+        stThrow(except);
+    } stTryEnd;
+    if (cactusDisk->snapshot != NULL) {
+        cactusCache_clear(cactusDisk->stringCache); //It may hold chunks read in place from the old snapshot.
+        cactusSnapshot_destruct(cactusDisk->snapshot);
+    }
+    cactusDisk->snapshot = snapshot;
+    if (cactusDisk->snapshotOverrides == NULL) { //Records already written by the disk stay overridden.
+        cactusDisk->snapshotOverrides = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+                (void (*)(void *)) stIntTuple_destruct);
+    }
+    unlock(cactusDisk);
+}
+
 /*
  * Private functions.
  */
 
 bool cactusDisk_flowerIsLoaded(CactusDisk *cactusDisk, Name flowerName) {
-    static Flower flower;
-    flower.name = flowerName;
-    return stSortedSet_search(cactusDisk->flowers, &flower) != NULL;
+    lock(cactusDisk);
+    bool loaded = getLoadedFlower(cactusDisk, flowerName) != NULL;
+    unlock(cactusDisk);
+    return loaded;
 }
 
 void cactusDisk_addFlower(CactusDisk *cactusDisk, Flower *flower) {
+    lock(cactusDisk);
     assert(stSortedSet_search(cactusDisk->flowers, flower) == NULL);
     stSortedSet_insert(cactusDisk->flowers, flower);
+    unlock(cactusDisk);
 }
 
 void cactusDisk_removeFlower(CactusDisk *cactusDisk, Flower *flower) {
+    lock(cactusDisk);
     assert(cactusDisk_flowerIsLoaded(cactusDisk, flower_getName(flower)));
     stSortedSet_remove(cactusDisk->flowers, flower);
+    unlock(cactusDisk);
 }
 
 void cactusDisk_deleteFlowerFromDisk(CactusDisk *cactusDisk, Flower *flower) {
+    lock(cactusDisk);
     char *nameString = cactusMisc_nameToString(flower_getName(flower));
     if (stSortedSet_search(cactusDisk->flowerNamesMarkedForDeletion, nameString) == NULL) {
         stSortedSet_insert(cactusDisk->flowerNamesMarkedForDeletion, nameString);
     } else {
         free(nameString);
     }
+    unlock(cactusDisk);
 }
 
 void cactusDisk_setEventTree(CactusDisk *cactusDisk, EventTree *eventTree) {
@@ -820,14 +2296,24 @@ void cactusDisk_setEventTree(CactusDisk *cactusDisk, EventTree *eventTree) {
  * Function to get unique ID.
  */
 
-void cactusDisk_getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize) {
-    intervalSize = intervalSize < CACTUS_DISK_NAME_INCREMENT ? CACTUS_DISK_NAME_INCREMENT : intervalSize;
+static int64_t getUniqueIDBucket(CactusDisk *cactusDisk) {
+    /*
+     * Picks a bucket at random, with the disk's own random state, as the prefetch thread also picks buckets.
+     */
+    uint64_t r = ((uint64_t) rand_r(&cactusDisk->uniqueIDSeed) << 16) ^ (uint64_t) rand_r(&cactusDisk->uniqueIDSeed);
+    return -1 - (int64_t) (r % CACTUS_DISK_BUCKET_NUMBER);
+}
+
+static void getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize, Name *uniqueNumber, Name *maxUniqueNumber) {
+    /*
+     * Leases the interval of unique ids [uniqueNumber, maxUniqueNumber) of the given size from a bucket in the database.
+     */
     bool done = 0;
     int64_t collisionCount = 0;
     while (!done) {
         stTry
             {
-                Name keyName = st_randomInt(-CACTUS_DISK_BUCKET_NUMBER, 0);
+                Name keyName = getUniqueIDBucket(cactusDisk);
                 assert(keyName >= -CACTUS_DISK_BUCKET_NUMBER);
                 assert(keyName < 0);
                 int64_t bucketSize = INT64_MAX / CACTUS_DISK_BUCKET_NUMBER;
@@ -836,22 +2322,20 @@ void cactusDisk_getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize
                 assert(minimumValue >= 1);
                 assert(maximumValue <= INT64_MAX);
                 assert(minimumValue < maximumValue);
-                if (stKVDatabase_containsRecord(cactusDisk->database, keyName)) {
-                    cactusDisk->maxUniqueNumber = stKVDatabase_incrementInt64(cactusDisk->database, keyName,
-                            intervalSize);
-                    cactusDisk->uniqueNumber = cactusDisk->maxUniqueNumber - intervalSize;
-                    if (cactusDisk->uniqueNumber <= 0 || cactusDisk->uniqueNumber < minimumValue
-                            || cactusDisk->uniqueNumber > maximumValue) {
-                        st_errAbort("Got a non positive unique number %lli %lli %lli %lli", cactusDisk->uniqueNumber,
-                                cactusDisk->maxUniqueNumber, minimumValue, maximumValue);
+                if (database_containsRecord(cactusDisk, keyName)) {
+                    *maxUniqueNumber = database_incrementInt64(cactusDisk, keyName, intervalSize);
+                    *uniqueNumber = *maxUniqueNumber - intervalSize;
+                    if (*uniqueNumber <= 0 || *uniqueNumber < minimumValue || *uniqueNumber > maximumValue) {
+                        st_errAbort("Got a non positive unique number %lli %lli %lli %lli", *uniqueNumber,
+                                *maxUniqueNumber, minimumValue, maximumValue);
                     }
-                    assert(cactusDisk->uniqueNumber >= minimumValue);
-                    assert(cactusDisk->uniqueNumber <= maximumValue);
-                    assert(cactusDisk->uniqueNumber > 0);
+                    assert(*uniqueNumber >= minimumValue);
+                    assert(*uniqueNumber <= maximumValue);
+                    assert(*uniqueNumber > 0);
                 } else {
                     stTry
                         {
-                            stKVDatabase_insertInt64(cactusDisk->database, keyName, minimumValue);
+                            database_insertInt64(cactusDisk, keyName, minimumValue);
                         }
                         stCatch(except)
                             {
@@ -868,7 +2352,7 @@ void cactusDisk_getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize
                     ;
                     continue;
                 }
-                if (cactusDisk->maxUniqueNumber >= maximumValue) {
+                if (*maxUniqueNumber >= maximumValue) {
                     st_errAbort("We have exhausted a bucket, which seems really unlikely");
                 }
                 done = 1;
@@ -888,13 +2372,79 @@ void cactusDisk_getBlockOfUniqueIDs(CactusDisk *cactusDisk, int64_t intervalSize
     }
 }
 
+/*
+ * Unique ids are leased from the database in intervals. The size of the lease doubles each time one is taken,
+ * from CACTUS_DISK_NAME_INCREMENT up to CACTUS_DISK_MAX_NAME_INCREMENT, so that callers needing many ids make
+ * few requests. Once half of the current lease is used the next is fetched by a background thread, so in the
+ * steady state the thread using the disk does not wait on the database for ids.
+ */
+
+static void *prefetchUniqueIDs(CactusDisk *cactusDisk) {
+    stTry
+        {
+            getBlockOfUniqueIDs(cactusDisk, cactusDisk->prefetchedLeaseSize, &cactusDisk->prefetchedUniqueNumber,
+                    &cactusDisk->prefetchedMaxUniqueNumber);
+            cactusDisk->hasPrefetchedLease = 1;
+        }
+        stCatch(except)
+            { //The lease is fetched again, synchronously, when it is needed, which reports any error.
+                st_logDebug("Failed to prefetch a lease of unique ids: %s\n", stExcept_getMsg(except));
+                stExcept_free(except);
+            }stTryEnd
+    ;
+    return NULL;
+}
+
+static void startPrefetchingUniqueIDs(CactusDisk *cactusDisk) {
+    cactusDisk->prefetchedLeaseSize = cactusDisk->leaseSize;
+    if (pthread_create(&cactusDisk->prefetchThread, NULL, (void *(*)(void *)) prefetchUniqueIDs, cactusDisk) == 0) {
+        cactusDisk->prefetching = 1;
+    } else {
+        st_logDebug("Failed to start a thread to prefetch unique ids\n");
+    }
+}
+
+static void waitForPrefetchedUniqueIDs(CactusDisk *cactusDisk) {
+    if (cactusDisk->prefetching) {
+        pthread_join(cactusDisk->prefetchThread, NULL);
+        cactusDisk->prefetching = 0;
+    }
+}
+
+static void takeLease(CactusDisk *cactusDisk, int64_t intervalSize) {
+    /*
+     * Replaces the current lease with one of at least the given size, using the prefetched lease if it is big enough.
+     */
+    waitForPrefetchedUniqueIDs(cactusDisk);
+    if (cactusDisk->hasPrefetchedLease
+            && cactusDisk->prefetchedMaxUniqueNumber - cactusDisk->prefetchedUniqueNumber >= intervalSize) {
+        cactusDisk->uniqueNumber = cactusDisk->prefetchedUniqueNumber;
+        cactusDisk->maxUniqueNumber = cactusDisk->prefetchedMaxUniqueNumber;
+        cactusDisk->hasPrefetchedLease = 0;
+    } else { //Any prefetched lease is too small for the interval, and is kept for the next lease.
+        getBlockOfUniqueIDs(cactusDisk, intervalSize > cactusDisk->leaseSize ? intervalSize : cactusDisk->leaseSize,
+                &cactusDisk->uniqueNumber, &cactusDisk->maxUniqueNumber);
+    }
+    cactusDisk->leaseStart = cactusDisk->uniqueNumber;
+    cactusDisk->leaseSize = cactusDisk->leaseSize * 2 < CACTUS_DISK_MAX_NAME_INCREMENT ? cactusDisk->leaseSize * 2
+            : CACTUS_DISK_MAX_NAME_INCREMENT;
+}
+
 int64_t cactusDisk_getUniqueIDInterval(CactusDisk *cactusDisk, int64_t intervalSize) {
+    lock(cactusDisk);
+    int64_t startTime = cactusDiskStats_getTime();
     assert(cactusDisk->uniqueNumber <= cactusDisk->maxUniqueNumber);
     if (cactusDisk->uniqueNumber + intervalSize > cactusDisk->maxUniqueNumber) {
-        cactusDisk_getBlockOfUniqueIDs(cactusDisk, intervalSize);
+        takeLease(cactusDisk, intervalSize);
     }
     Name uniqueNumber = cactusDisk->uniqueNumber;
     cactusDisk->uniqueNumber += intervalSize;
+    if (!cactusDisk->prefetching && !cactusDisk->hasPrefetchedLease
+            && cactusDisk->uniqueNumber - cactusDisk->leaseStart >= cactusDisk->maxUniqueNumber - cactusDisk->uniqueNumber) {
+        startPrefetchingUniqueIDs(cactusDisk);
+    }
+    cactusDiskStats_add(cactusDisk->stats, CACTUS_DISK_OP_GET_UNIQUE_ID_INTERVAL, startTime, intervalSize, 0, 0);
+    unlock(cactusDisk);
     return uniqueNumber;
 }
 
@@ -903,11 +2453,69 @@ int64_t cactusDisk_getUniqueID(CactusDisk *cactusDisk) {
 }
 
 void cactusDisk_clearStringCache(CactusDisk *cactusDisk) {
-    stCache_clear(cactusDisk->stringCache);
+    lock(cactusDisk);
+    cactusCache_clear(cactusDisk->stringCache);
+    unlock(cactusDisk);
 }
 
 void cactusDisk_clearCache(CactusDisk *cactusDisk) {
-    stCache_clear(cactusDisk->cache);
+    lock(cactusDisk);
+    if (cactusDisk->cache != NULL) {
+        cactusCache_clear(cactusDisk->cache);
+    }
+    unlock(cactusDisk);
+}
+
+void cactusDisk_setCacheSizes(CactusDisk *cactusDisk, int64_t recordCacheSize, int64_t stringCacheSize) {
+    lock(cactusDisk);
+    if (cactusDisk->cache != NULL) {
+        cactusCache_setMaxSize(cactusDisk->cache, recordCacheSize);
+    }
+    cactusCache_setMaxSize(cactusDisk->stringCache, stringCacheSize);
+    unlock(cactusDisk);
+}
+
+void cactusDisk_printCacheStats(CactusDisk *cactusDisk, FILE *fileHandle) {
+    lock(cactusDisk);
+    if (cactusDisk->cache != NULL) {
+        char *string = getCacheStatsString(cactusDisk->cache, "Record");
+        fprintf(fileHandle, "%s\n", string);
+        free(string);
+    }
+    char *string = getCacheStatsString(cactusDisk->stringCache, "String");
+    fprintf(fileHandle, "%s\n", string);
+    free(string);
+    unlock(cactusDisk);
+}
+
+static void printCacheStatsJson(CactusCache *cache, FILE *fileHandle) {
+    int64_t hits = cactusCache_getHits(cache), misses = cactusCache_getMisses(cache);
+    fprintf(fileHandle, "{\"size\": %" PRIi64 ", \"maxSize\": %" PRIi64 ", \"hits\": %" PRIi64 ", \"misses\": %" PRIi64
+            ", \"evictions\": %" PRIi64 ", \"hitRate\": %f}", cactusCache_getSize(cache), cactusCache_getMaxSize(cache),
+            hits, misses, cactusCache_getEvictions(cache), hits + misses > 0 ? ((double) hits) / (hits + misses) : 0.0);
+}
+
+void cactusDisk_printStats(CactusDisk *cactusDisk, FILE *fileHandle) {
+    lock(cactusDisk);
+    fprintf(fileHandle, "{\"operations\": ");
+    cactusDiskStats_printJson(cactusDisk->stats, fileHandle);
+    fprintf(fileHandle, ", \"caches\": {");
+    if (cactusDisk->cache != NULL) {
+        fprintf(fileHandle, "\"record\": ");
+        printCacheStatsJson(cactusDisk->cache, fileHandle);
+        fprintf(fileHandle, ", ");
+    }
+    fprintf(fileHandle, "\"string\": ");
+    printCacheStatsJson(cactusDisk->stringCache, fileHandle);
+    fprintf(fileHandle, "}}");
+    unlock(cactusDisk);
+}
+
+void cactusDisk_setStatsFile(CactusDisk *cactusDisk, const char *statsFile) {
+    lock(cactusDisk);
+    free(cactusDisk->statsFile);
+    cactusDisk->statsFile = statsFile != NULL ? stString_copy(statsFile) : NULL;
+    unlock(cactusDisk);
 }
 
 EventTree *cactusDisk_getEventTree(CactusDisk *cactusDisk) {
@@ -8,18 +8,48 @@
 #define CACTUS_DISK_PRIVATE_H_
 
 #include "cactusGlobals.h"
+#include "cactusLocalDatabase.h"
+#include "cactusPackedSequence.h"
+#include "cactusCache.h"
+#include "cactusSnapshot.h"
+#include "cactusDiskStats.h"
+#include <pthread.h>
 
 struct _cactusDisk {
     stKVDatabase *database;
+    CactusLocalDatabase *localDatabase; //If non-null, used in place of database.
+    CactusSnapshot *snapshot; //If non-null, records are read from the snapshot in preference to the database.
+    stSortedSet *snapshotOverrides; //The keys written since the snapshot was opened, which are read from the database.
     stSortedSet *metaSequences;
     stSortedSet *flowers;
     stSortedSet *flowerNamesMarkedForDeletion;
     stList *updateRequests;
-    stCache *cache;
-    stCache *stringCache;
+    CactusCache *cache; //Decompressed records, keyed by their names.
+    CactusCache *stringCache; //Packed sequence chunks, keyed by the names of their records.
+    stHash *sequenceIndexes; //The chunk indexes of the strings read, keyed by the names of the strings.
     EventTree *eventTree;
-    Name uniqueNumber;
-    Name maxUniqueNumber;
+    Name uniqueNumber; //The next unique id of the current lease.
+    Name maxUniqueNumber; //The end (exclusive) of the current lease.
+    Name leaseStart; //The start of the current lease.
+    int64_t leaseSize; //The size of the next lease of unique ids, which doubles each time one is taken.
+    unsigned int uniqueIDSeed; //The random state used to choose unique id buckets.
+    pthread_t prefetchThread; //Prefetches the next lease, if prefetching is non-zero.
+    bool prefetching;
+    bool hasPrefetchedLease; //If non-zero, [prefetchedUniqueNumber, prefetchedMaxUniqueNumber) is the next lease.
+    int64_t prefetchedLeaseSize;
+    Name prefetchedUniqueNumber;
+    Name prefetchedMaxUniqueNumber;
+    pthread_mutex_t databaseMutex; //Serialises the requests to the database, which the prefetch thread also makes.
+    int64_t writeThreads; //Number of threads used to serialise and compress records in cactusDisk_write.
+    int64_t readThreads; //Number of threads used to decompress records in cactusDisk_getFlowers.
+    CactusCodec *codecs[CACTUS_RECORD_CLASS_NUMBER]; //The codec used to write each class of record.
+    void *flowerDictionary; //The zstd dictionary for flower records, or NULL if there is none.
+    int64_t flowerDictionarySize;
+    bool trainFlowerDictionary; //If non-zero, cactusDisk_write trains a flower dictionary if there is none.
+    pthread_mutex_t *mutex; //If non-null, the disk is in thread-safe mode and this guards its shared state.
+    bool lazyFlowers; //If non-zero, flowers are loaded without their caps, segments and faces, until they are accessed.
+    CactusDiskStats *stats; //Counts and times the operations of the disk.
+    char *statsFile; //If non-null, the statistics are appended to this file when the disk is destructed.
 };
 
 ////////////////////////////////////////////////
@@ -85,6 +115,12 @@ Name cactusDisk_addString(CactusDisk *cactusDisk, const char *string);
 char *cactusDisk_getString(CactusDisk *cactusDisk, Name name,
         int64_t start, int64_t length, int64_t strand, int64_t totalSequenceLength);
 
+/*
+ * Retrieves the forward strand of a string from the bucket of sequence into string, which must have room for
+ * length + 1 characters, so callers reusing a buffer avoid allocating each string.
+ */
+void cactusDisk_getStringInBuffer(CactusDisk *cactusDisk, Name name, int64_t start, int64_t length, char *string);
+
 /*
  * Gets the string from a cache.
  */
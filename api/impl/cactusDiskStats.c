@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+// For clock_gettime (POSIX extension).
+#define _POSIX_C_SOURCE 200809L
+
+#include "cactusGlobalsPrivate.h"
+#include <time.h>
+#include <pthread.h>
+
+#define CACTUS_DISK_STATS_BUCKET_NUMBER 40
+
+static const char *operationNames[] = { "getFlower", "getFlowers", "getMetaSequence", "getString", "preCacheStrings",
+        "write", "getUniqueIDInterval", "databaseContains", "databaseGet", "databaseBulkGet", "databaseBulkSet",
+        "databaseBulkRemove", "databaseInsertInt64", "databaseIncrementInt64", "compress", "decompress" };
+
+typedef struct _operationStats {
+    int64_t calls;
+    int64_t records;
+    int64_t bytes;
+    int64_t rawBytes;
+    int64_t totalTime;
+    int64_t latencies[CACTUS_DISK_STATS_BUCKET_NUMBER]; //Bucket i counts the latencies less than 2^i and (bar bucket 0) at least 2^(i-1) microseconds.
+} OperationStats;
+
+struct _cactusDiskStats {
+    OperationStats operations[CACTUS_DISK_OPERATION_NUMBER];
+    pthread_mutex_t mutex;
+};
+
+CactusDiskStats *cactusDiskStats_construct(void) {
+    CactusDiskStats *stats = st_calloc(1, sizeof(CactusDiskStats));
+    pthread_mutex_init(&stats->mutex, NULL);
+    return stats;
+}
+
+void cactusDiskStats_destruct(CactusDiskStats *stats) {
+    pthread_mutex_destroy(&stats->mutex);
+    free(stats);
+}
+
+int64_t cactusDiskStats_getTime(void) {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+static int64_t getBucket(int64_t latency) {
+    int64_t bucket = 0;
+    while (latency > 0 && bucket < CACTUS_DISK_STATS_BUCKET_NUMBER - 1) {
+        latency >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void cactusDiskStats_add(CactusDiskStats *stats, CactusDiskOperation operation, int64_t startTime, int64_t records,
+        int64_t bytes, int64_t rawBytes) {
+    int64_t latency = cactusDiskStats_getTime() - startTime;
+    pthread_mutex_lock(&stats->mutex);
+    OperationStats *operationStats = &stats->operations[operation];
+    operationStats->calls++;
+    operationStats->records += records;
+    operationStats->bytes += bytes;
+    operationStats->rawBytes += rawBytes;
+    operationStats->totalTime += latency;
+    operationStats->latencies[getBucket(latency)]++;
+    pthread_mutex_unlock(&stats->mutex);
+}
+
+const char *cactusDiskStats_getOperationName(CactusDiskOperation operation) {
+    assert(operation >= 0 && operation < CACTUS_DISK_OPERATION_NUMBER);
+    return operationNames[operation];
+}
+
+int64_t cactusDiskStats_getCalls(CactusDiskStats *stats, CactusDiskOperation operation) {
+    return stats->operations[operation].calls;
+}
+
+int64_t cactusDiskStats_getRecords(CactusDiskStats *stats, CactusDiskOperation operation) {
+    return stats->operations[operation].records;
+}
+
+int64_t cactusDiskStats_getBytes(CactusDiskStats *stats, CactusDiskOperation operation) {
+    return stats->operations[operation].bytes;
+}
+
+int64_t cactusDiskStats_getRawBytes(CactusDiskStats *stats, CactusDiskOperation operation) {
+    return stats->operations[operation].rawBytes;
+}
+
+int64_t cactusDiskStats_getTotalTime(CactusDiskStats *stats, CactusDiskOperation operation) {
+    return stats->operations[operation].totalTime;
+}
+
+static int64_t getLatencyPercentile(OperationStats *operationStats, double fraction) {
+    int64_t calls = 0;
+    for (int64_t i = 0; i < CACTUS_DISK_STATS_BUCKET_NUMBER; i++) {
+        calls += operationStats->latencies[i];
+        if (calls > 0 && calls >= fraction * operationStats->calls) {
+            return ((int64_t) 1) << i;
+        }
+    }
+    return 0;
+}
+
+int64_t cactusDiskStats_getLatencyPercentile(CactusDiskStats *stats, CactusDiskOperation operation, double fraction) {
+    pthread_mutex_lock(&stats->mutex);
+    int64_t latency = getLatencyPercentile(&stats->operations[operation], fraction);
+    pthread_mutex_unlock(&stats->mutex);
+    return latency;
+}
+
+void cactusDiskStats_printJson(CactusDiskStats *stats, FILE *fileHandle) {
+    pthread_mutex_lock(&stats->mutex);
+    fprintf(fileHandle, "{");
+    bool first = 1;
+    for (int64_t i = 0; i < CACTUS_DISK_OPERATION_NUMBER; i++) {
+        OperationStats *operationStats = &stats->operations[i];
+        if (operationStats->calls == 0) {
+            continue;
+        }
+        fprintf(fileHandle, "%s\"%s\": {\"calls\": %" PRIi64 ", \"records\": %" PRIi64 ", \"bytes\": %" PRIi64
+                ", \"rawBytes\": %" PRIi64 ", \"totalMicroseconds\": %" PRIi64 ", \"p50Microseconds\": %" PRIi64
+                ", \"p99Microseconds\": %" PRIi64 ", \"latencyHistogram\": [", first ? "" : ", ", operationNames[i],
+                operationStats->calls, operationStats->records, operationStats->bytes, operationStats->rawBytes,
+                operationStats->totalTime, getLatencyPercentile(operationStats, 0.5),
+                getLatencyPercentile(operationStats, 0.99));
+        //The histogram is a list of the non-empty buckets, each the upper bound of the bucket in microseconds and its count.
+        bool firstBucket = 1;
+        for (int64_t j = 0; j < CACTUS_DISK_STATS_BUCKET_NUMBER; j++) {
+            if (operationStats->latencies[j] > 0) {
+                fprintf(fileHandle, "%s[%" PRIi64 ", %" PRIi64 "]", firstBucket ? "" : ", ", ((int64_t) 1) << j,
+                        operationStats->latencies[j]);
+                firstBucket = 0;
+            }
+        }
+        fprintf(fileHandle, "]}");
+        first = 0;
+    }
+    fprintf(fileHandle, "}");
+    pthread_mutex_unlock(&stats->mutex);
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_DISK_STATS_H_
+#define CACTUS_DISK_STATS_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Cactus disk statistics.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * The operations of a cactus disk that are counted and timed: the public operations,
+ * the requests made to the database, and the compression and decompression of records.
+ */
+typedef enum {
+    CACTUS_DISK_OP_GET_FLOWER = 0,
+    CACTUS_DISK_OP_GET_FLOWERS,
+    CACTUS_DISK_OP_GET_META_SEQUENCE,
+    CACTUS_DISK_OP_GET_STRING,
+    CACTUS_DISK_OP_PRE_CACHE_STRINGS,
+    CACTUS_DISK_OP_WRITE,
+    CACTUS_DISK_OP_GET_UNIQUE_ID_INTERVAL,
+    CACTUS_DISK_OP_DATABASE_CONTAINS,
+    CACTUS_DISK_OP_DATABASE_GET,
+    CACTUS_DISK_OP_DATABASE_BULK_GET,
+    CACTUS_DISK_OP_DATABASE_BULK_SET,
+    CACTUS_DISK_OP_DATABASE_BULK_REMOVE,
+    CACTUS_DISK_OP_DATABASE_INSERT_INT64,
+    CACTUS_DISK_OP_DATABASE_INCREMENT_INT64,
+    CACTUS_DISK_OP_COMPRESS,
+    CACTUS_DISK_OP_DECOMPRESS
+} CactusDiskOperation;
+
+#define CACTUS_DISK_OPERATION_NUMBER 16
+
+/*
+ * For each operation the statistics count the calls, the records and bytes moved (bytes as stored,
+ * so compressed, and raw bytes, uncompressed) and keep a histogram of the latencies of the calls, in
+ * power of two buckets of microseconds. Statistics may be added from several threads at once.
+ */
+typedef struct _cactusDiskStats CactusDiskStats;
+
+/*
+ * Constructs empty statistics.
+ */
+CactusDiskStats *cactusDiskStats_construct(void);
+
+/*
+ * Destructs the statistics.
+ */
+void cactusDiskStats_destruct(CactusDiskStats *stats);
+
+/*
+ * Gets the current time, in microseconds, from a monotonic clock, to pass as the start time of an operation to cactusDiskStats_add.
+ */
+int64_t cactusDiskStats_getTime(void);
+
+/*
+ * Adds a call of the operation, begun at the given start time and ending now, which moved the given numbers of records, bytes and raw bytes.
+ */
+void cactusDiskStats_add(CactusDiskStats *stats, CactusDiskOperation operation, int64_t startTime, int64_t records,
+        int64_t bytes, int64_t rawBytes);
+
+/*
+ * Gets the name of the operation, as used in the JSON.
+ */
+const char *cactusDiskStats_getOperationName(CactusDiskOperation operation);
+
+/*
+ * Gets the number of calls of the operation.
+ */
+int64_t cactusDiskStats_getCalls(CactusDiskStats *stats, CactusDiskOperation operation);
+
+/*
+ * Gets the number of records moved by the operation.
+ */
+int64_t cactusDiskStats_getRecords(CactusDiskStats *stats, CactusDiskOperation operation);
+
+/*
+ * Gets the number of bytes, as stored, moved by the operation.
+ */
+int64_t cactusDiskStats_getBytes(CactusDiskStats *stats, CactusDiskOperation operation);
+
+/*
+ * Gets the number of raw (uncompressed) bytes moved by the operation.
+ */
+int64_t cactusDiskStats_getRawBytes(CactusDiskStats *stats, CactusDiskOperation operation);
+
+/*
+ * Gets the total time, in microseconds, of the calls of the operation.
+ */
+int64_t cactusDiskStats_getTotalTime(CactusDiskStats *stats, CactusDiskOperation operation);
+
+/*
+ * Gets an upper bound, in microseconds, on the latency of the given fraction (between 0 and 1) of the calls of the
+ * operation, from the histogram, or 0 if there have been no calls.
+ */
+int64_t cactusDiskStats_getLatencyPercentile(CactusDiskStats *stats, CactusDiskOperation operation, double fraction);
+
+/*
+ * Prints the statistics of the operations that have been called as a JSON object, keyed by the names of the operations.
+ */
+void cactusDiskStats_printJson(CactusDiskStats *stats, FILE *fileHandle);
+
+#endif
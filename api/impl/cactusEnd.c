@@ -18,6 +18,15 @@ static int end_constructP(const void *o1, const void *o2) {
     return cactusMisc_nameCompare(cap_getName((Cap *) o1), cap_getName((Cap *) o2));
 }
 
+/*
+ * An end, its reverse and their contents are a single allocation from the arena of the end's flower.
+ */
+#define END_ALLOCATION_SIZE (2 * sizeof(End) + sizeof(EndContents))
+
+static void *end_getAllocation(End *end) {
+    return end < end->rEnd ? end : end->rEnd;
+}
+
 End *end_construct(bool isAttached, Flower *flower) {
     return end_construct3(cactusDisk_getUniqueID(flower_getCactusDisk(flower)), 1,
             isAttached, 1, flower);
@@ -31,10 +40,10 @@ End *end_construct2(bool side, bool isAttached, Flower *flower) {
 End *end_construct3(Name name, int64_t isStub, int64_t isAttached,
         int64_t side, Flower *flower) {
     End *end;
-    end = st_malloc(sizeof(End));
-    end->rEnd = st_malloc(sizeof(End));
+    end = cactusArena_malloc(flower_getArena(flower), END_ALLOCATION_SIZE);
+    end->rEnd = end + 1;
     end->rEnd->rEnd = end;
-    end->endContents = st_malloc(sizeof(EndContents));
+    end->endContents = (EndContents *) (end + 2);
     end->rEnd->endContents = end->endContents;
 
     end->orientation = 1;
@@ -111,9 +120,17 @@ void end_destruct(End *end) {
     //now the actual instances.
     stSortedSet_destruct(end->endContents->caps);
 
-    free(end->endContents);
-    free(end->rEnd);
-    free(end);
+    cactusArena_free(flower_getArena(end_getFlower(end)), end_getAllocation(end), END_ALLOCATION_SIZE);
+}
+
+void end_destructWithFlower(End *end) {
+    Cap *cap;
+    stSortedSetIterator *iterator = stSortedSet_getIterator(end->endContents->caps);
+    while ((cap = stSortedSet_getNext(iterator)) != NULL) {
+        cap_destructWithFlower(cap);
+    }
+    stSortedSet_destructIterator(iterator);
+    stSortedSet_destruct(end->endContents->caps);
 }
 
 void end_setBlock(End *end, Block *block) {
@@ -169,6 +186,7 @@ Group *end_getGroup(End *end) {
 }
 
 int64_t end_getInstanceNumber(End *end) {
+    flower_materialise(end_getFlower(end));
     return stSortedSet_size(end->endContents->caps);
 }
 
@@ -179,28 +197,28 @@ Cap *end_getInstanceP(End *end, Cap *connectedCap) {
 }
 
 Cap *end_getInstance(End *end, Name name) {
-    Cap cap;
-    CapContents capContents;
-    cap.capContents = &capContents;
-    capContents.instance = name;
-    return end_getInstanceP(end,
-            stSortedSet_search(end->endContents->caps, &cap));
+    Cap *cap = flower_getCap(end_getFlower(end), name);
+    return cap != NULL && cap_getEnd(cap) == end_getPositiveOrientation(end) ? end_getInstanceP(end, cap) : NULL;
 }
 
 Cap *end_getFirst(End *end) {
+    flower_materialise(end_getFlower(end));
     return end_getInstanceP(end, stSortedSet_getFirst(end->endContents->caps));
 }
 
 Cap *end_getRootInstance(End *end) {
+    flower_materialise(end_getFlower(end));
     return end_getInstanceP(end, end->endContents->rootInstance);
 }
 
 void end_setRootInstance(End *end, Cap *cap) {
+    flower_materialise(end_getFlower(end));
     end->endContents->rootInstance = cap_getOrientation(cap) ? cap
             : cap_getReverse(cap);
 }
 
 End_InstanceIterator *end_getInstanceIterator(End *end) {
+    flower_materialise(end_getFlower(end));
     End_InstanceIterator *iterator;
     iterator = st_malloc(sizeof(struct _end_instanceIterator));
     iterator->end = end;
@@ -264,6 +282,7 @@ void end_makeAttached(End *end) {
     if(end_getGroup(end) != NULL) {
         assert(group_isLeaf(end_getGroup(end)));
     }
+    flower_materialise(end_getFlower(end));
     end->endContents->isAttached = 1;
 }
 
@@ -364,14 +383,17 @@ Cap *end_getCapForEvent(End *end, Name eventName) {
  */
 
 void end_addInstance(End *end, Cap *cap) {
+    flower_materialise(end_getFlower(end));
     stSortedSet_insert(end->endContents->caps, cap_getPositiveOrientation(cap));
 }
 
 void end_removeInstance(End *end, Cap *cap) {
+    flower_materialise(end_getFlower(end));
     stSortedSet_remove(end->endContents->caps, cap);
 }
 
 void end_setFlower(End *end, Flower *flower) {
+    cactusArena_retain(flower_getArena(flower), flower_getArena(end_getFlower(end)));
     flower_removeEnd(end_getFlower(end), end);
     end->endContents->flower = flower;
     flower_addEnd(flower, end);
@@ -417,47 +439,60 @@ void end_writeBinaryRepresentation(End *end, void(*writeFn)(const void * ptr,
     binaryRepresentation_writeElementType(endType, writeFn);
 }
 
-End *end_loadFromBinaryRepresentation(void **binaryString, Flower *flower) {
+static End *end_loadFromBinaryRepresentationP(void **binaryString, Flower *flower, bool loadEnd, bool loadCaps) {
+    /*
+     * Reads an end, if one is next. If loadEnd is non-zero the end is constructed, else it is found in the flower.
+     * If loadCaps is non-zero its caps are constructed, else they are read past.
+     */
     End *end;
     Name name;
     int64_t isStub;
     int64_t isAttached;
     int64_t side;
 
-    end = NULL;
-    if (binaryRepresentation_peekNextElementType(*binaryString)
-            == CODE_END_WITHOUT_PHYLOGENY) {
-        binaryRepresentation_popNextElementType(binaryString);
-        name = binaryRepresentation_getName(binaryString);
-        isStub = binaryRepresentation_getBool(binaryString);
-        isAttached = binaryRepresentation_getBool(binaryString);
-        side = binaryRepresentation_getBool(binaryString);
+    char endType = binaryRepresentation_peekNextElementType(*binaryString);
+    if (endType != CODE_END_WITHOUT_PHYLOGENY && endType != CODE_END_WITH_PHYLOGENY) {
+        return NULL;
+    }
+    binaryRepresentation_popNextElementType(binaryString);
+    name = binaryRepresentation_getName(binaryString);
+    isStub = binaryRepresentation_getBool(binaryString);
+    isAttached = binaryRepresentation_getBool(binaryString);
+    side = binaryRepresentation_getBool(binaryString);
+    if (loadEnd) {
         end = end_construct3(name, isStub, isAttached, side, flower);
-        while (cap_loadFromBinaryRepresentation(binaryString, end) != NULL)
+    } else {
+        end = flower_getEnd(flower, name);
+        assert(end != NULL);
+    }
+    if (!loadCaps) {
+        while (cap_skipBinaryRepresentation(binaryString))
             ;
-        assert(binaryRepresentation_peekNextElementType(*binaryString)  == CODE_END_WITHOUT_PHYLOGENY);
-        binaryRepresentation_popNextElementType(binaryString);
     } else {
-        if (binaryRepresentation_peekNextElementType(*binaryString)
-                == CODE_END_WITH_PHYLOGENY) {
-            binaryRepresentation_popNextElementType(binaryString);
-            name = binaryRepresentation_getName(binaryString);
-            isStub = binaryRepresentation_getBool(binaryString);
-            isAttached = binaryRepresentation_getBool(binaryString);
-            side = binaryRepresentation_getBool(binaryString);
-            end = end_construct3(name, isStub, isAttached, side, flower);
-            end_setRootInstance(end, cap_loadFromBinaryRepresentation(
-                    binaryString, end));
-            while (cap_loadFromBinaryRepresentation(binaryString, end) != NULL)
-                ;
-            assert(binaryRepresentation_peekNextElementType(*binaryString)  == CODE_END_WITH_PHYLOGENY);
-            binaryRepresentation_popNextElementType(binaryString);
+        if (endType == CODE_END_WITH_PHYLOGENY) {
+            end_setRootInstance(end, cap_loadFromBinaryRepresentation(binaryString, end));
         }
+        while (cap_loadFromBinaryRepresentation(binaryString, end) != NULL)
+            ;
     }
+    assert(binaryRepresentation_peekNextElementType(*binaryString) == endType);
+    binaryRepresentation_popNextElementType(binaryString);
 
     return end;
 }
 
+End *end_loadFromBinaryRepresentation(void **binaryString, Flower *flower) {
+    return end_loadFromBinaryRepresentationP(binaryString, flower, 1, 1);
+}
+
+End *end_loadSkeletonFromBinaryRepresentation(void **binaryString, Flower *flower) {
+    return end_loadFromBinaryRepresentationP(binaryString, flower, 1, 0);
+}
+
+End *end_loadCapsFromBinaryRepresentation(void **binaryString, Flower *flower) {
+    return end_loadFromBinaryRepresentationP(binaryString, flower, 0, 1);
+}
+
 uint64_t end_hashKey(const void *o) {
     return end_getName((End *) o);
 }
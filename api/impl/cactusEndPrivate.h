@@ -51,6 +51,12 @@ End *end_construct3(Name name, int64_t isStub, int64_t isAttached, int64_t side,
  */
 void end_destruct(End *end);
 
+/*
+ * Destructs the end and its caps as part of destructing their flower, so they are not detached from the flower or
+ * their group, and their memory is left to be released with the arena of the flower.
+ */
+void end_destructWithFlower(End *end);
+
 /*
  * Sets the attached block.
  */
@@ -76,6 +82,17 @@ void end_writeBinaryRepresentation(End *end, void (*writeFn)(const void * ptr, s
  */
 End *end_loadFromBinaryRepresentation(void **binaryString, Flower *flower);
 
+/*
+ * As end_loadFromBinaryRepresentation, but reads past the caps of the end rather than constructing them.
+ */
+End *end_loadSkeletonFromBinaryRepresentation(void **binaryString, Flower *flower);
+
+/*
+ * Reads the binary representation of an end already loaded by end_loadSkeletonFromBinaryRepresentation,
+ * constructing its caps, and returns the end, or NULL if no end is next.
+ */
+End *end_loadCapsFromBinaryRepresentation(void **binaryString, Flower *flower);
+
 /*
  * Hash key for an end, uses the name of the end to hash.. hence
  * the key doesn't care about the orientation.
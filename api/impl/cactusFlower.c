@@ -63,6 +63,15 @@ static Flower *flower_construct3(Name name, CactusDisk *cactusDisk) {
     flower->chains = stSortedSet_construct3(flower_constructChainsP, NULL);
     flower->faces = stSortedSet_construct3(flower_constructFacesP, NULL);
 
+    flower->sequencesByName = cactusNameIndex_construct();
+    flower->endsByName = cactusNameIndex_construct();
+    flower->capsByName = cactusNameIndex_construct();
+    flower->blocksByName = cactusNameIndex_construct();
+    flower->segmentsByName = cactusNameIndex_construct();
+    flower->groupsByName = cactusNameIndex_construct();
+    flower->chainsByName = cactusNameIndex_construct();
+    flower->arena = cactusArena_construct();
+
     flower->parentFlowerName = NULL_NAME;
     flower->cactusDisk = cactusDisk;
     flower->faceIndex = 0;
@@ -72,6 +81,11 @@ static Flower *flower_construct3(Name name, CactusDisk *cactusDisk) {
     flower->builtFaces = 0;
     flower->builtTrees = 0;
 
+    flower->hasRecordHash = 0;
+    flower->recordHash = 0;
+    flower->lazyRecord = NULL;
+    flower->lazyRecordSize = 0;
+
     cactusDisk_addFlower(flower->cactusDisk, flower);
 
     return flower;
@@ -94,6 +108,7 @@ void flower_destruct(Flower *flower, int64_t recursive) {
     Group *group;
     Chain *chain;
     Flower *nestedFlower;
+    stSortedSetIterator *setIterator;
 
     if (recursive) {
         iterator = flower_getGroupIterator(flower);
@@ -108,6 +123,11 @@ void flower_destruct(Flower *flower, int64_t recursive) {
 
     cactusDisk_removeFlower(flower->cactusDisk, flower);
 
+    //The caps, segments and faces of a flower which is not materialised need not be loaded to be destructed.
+    free(flower->lazyRecord);
+    flower->lazyRecord = NULL;
+    flower->lazyRecordSize = 0;
+
     flower_destructFaces(flower);
     stSortedSet_destruct(flower->faces);
 
@@ -115,29 +135,42 @@ void flower_destruct(Flower *flower, int64_t recursive) {
         sequence_destruct(sequence);
     }
     stSortedSet_destruct(flower->sequences);
+    cactusNameIndex_destruct(flower->sequencesByName);
 
     while ((chain = flower_getFirstChain(flower)) != NULL) {
         chain_destruct(chain);
     }
     stSortedSet_destruct(flower->chains);
+    cactusNameIndex_destruct(flower->chainsByName);
 
-    while ((end = flower_getFirstEnd(flower)) != NULL) {
-        end_destruct(end);
+    while ((group = flower_getFirstGroup(flower)) != NULL) {
+        group_destruct(group);
     }
+    stSortedSet_destruct(flower->groups);
+    cactusNameIndex_destruct(flower->groupsByName);
+
+    //The ends, caps, blocks and segments are released with the arena, rather than one by one.
+    setIterator = stSortedSet_getIterator(flower->ends);
+    while ((end = stSortedSet_getNext(setIterator)) != NULL) {
+        end_destructWithFlower(end);
+    }
+    stSortedSet_destructIterator(setIterator);
     stSortedSet_destruct(flower->caps);
     stSortedSet_destruct(flower->ends);
+    cactusNameIndex_destruct(flower->capsByName);
+    cactusNameIndex_destruct(flower->endsByName);
 
-    while ((block = flower_getFirstBlock(flower)) != NULL) {
-        block_destruct(block);
+    setIterator = stSortedSet_getIterator(flower->blocks);
+    while ((block = stSortedSet_getNext(setIterator)) != NULL) {
+        block_destructWithFlower(block);
     }
+    stSortedSet_destructIterator(setIterator);
     stSortedSet_destruct(flower->segments);
     stSortedSet_destruct(flower->blocks);
+    cactusNameIndex_destruct(flower->segmentsByName);
+    cactusNameIndex_destruct(flower->blocksByName);
 
-    while ((group = flower_getFirstGroup(flower)) != NULL) {
-        group_destruct(group);
-    }
-    stSortedSet_destruct(flower->groups);
-
+    cactusArena_release(flower->arena);
     free(flower);
 }
 
@@ -145,6 +178,10 @@ Name flower_getName(Flower *flower) {
     return flower->name;
 }
 
+CactusArena *flower_getArena(Flower *flower) {
+    return flower->arena;
+}
+
 CactusDisk *flower_getCactusDisk(Flower *flower) {
     return flower->cactusDisk;
 }
@@ -158,11 +195,7 @@ Sequence *flower_getFirstSequence(Flower *flower) {
 }
 
 Sequence *flower_getSequence(Flower *flower, Name name) {
-    Sequence sequence;
-    MetaSequence metaSequence;
-    sequence.metaSequence = &metaSequence;
-    metaSequence.name = name;
-    return stSortedSet_search(flower->sequences, &sequence);
+    return cactusNameIndex_search(flower->sequencesByName, name);
 }
 
 int64_t flower_getSequenceNumber(Flower *flower) {
@@ -190,22 +223,22 @@ void flower_destructSequenceIterator(Flower_SequenceIterator *sequenceIterator)
 }
 
 Cap *flower_getFirstCap(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getFirst(flower->caps);
 }
 
 Cap *flower_getCap(Flower *flower, Name name) {
-    Cap cap;
-    CapContents capContents;
-    cap.capContents = &capContents;
-    cap.capContents->instance = name;
-    return stSortedSet_search(flower->caps, &cap);
+    flower_materialise(flower);
+    return cactusNameIndex_search(flower->capsByName, name);
 }
 
 int64_t flower_getCapNumber(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_size(flower->caps);
 }
 
 Flower_CapIterator *flower_getCapIterator(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getIterator(flower->caps);
 }
 
@@ -230,12 +263,7 @@ End *flower_getFirstEnd(Flower *flower) {
 }
 
 End *flower_getEnd(Flower *flower, Name name) {
-    End end;
-    EndContents endContents;
-    end.endContents = &endContents;
-    endContents.name = name;
-    end.orientation = 1;
-    return stSortedSet_search(flower->ends, &end);
+    return cactusNameIndex_search(flower->endsByName, name);
 }
 
 int64_t flower_getEndNumber(Flower *flower) {
@@ -288,20 +316,22 @@ void flower_destructEndIterator(Flower_EndIterator *endIterator) {
 }
 
 Segment *flower_getFirstSegment(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getFirst(flower->segments);
 }
 
 Segment *flower_getSegment(Flower *flower, Name name) {
-    Segment segment;
-    segment.name = name;
-    return stSortedSet_search(flower->segments, &segment);
+    flower_materialise(flower);
+    return cactusNameIndex_search(flower->segmentsByName, name);
 }
 
 int64_t flower_getSegmentNumber(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_size(flower->segments);
 }
 
 Flower_SegmentIterator *flower_getSegmentIterator(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getIterator(flower->segments);
 }
 
@@ -326,11 +356,7 @@ Block *flower_getFirstBlock(Flower *flower) {
 }
 
 Block *flower_getBlock(Flower *flower, Name name) {
-    Block block;
-    BlockContents blockContents;
-    block.blockContents = &blockContents;
-    blockContents.name = name;
-    return stSortedSet_search(flower->blocks, &block);
+    return cactusNameIndex_search(flower->blocksByName, name);
 }
 
 int64_t flower_getBlockNumber(Flower *flower) {
@@ -362,9 +388,7 @@ Group *flower_getFirstGroup(Flower *flower) {
 }
 
 Group *flower_getGroup(Flower *flower, Name flowerName) {
-    Group group;
-    group.name = flowerName;
-    return stSortedSet_search(flower->groups, &group);
+    return cactusNameIndex_search(flower->groupsByName, flowerName);
 }
 
 int64_t flower_getGroupNumber(Flower *flower) {
@@ -409,9 +433,7 @@ Chain *flower_getFirstChain(Flower *flower) {
 }
 
 Chain *flower_getChain(Flower *flower, Name name) {
-    Chain chain;
-    chain.name = name;
-    return stSortedSet_search(flower->chains, &chain);
+    return cactusNameIndex_search(flower->chainsByName, name);
 }
 
 int64_t flower_getChainNumber(Flower *flower) {
@@ -452,14 +474,17 @@ void flower_destructChainIterator(Flower_ChainIterator *chainIterator) {
 }
 
 Face *flower_getFirstFace(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getFirst(flower->faces);
 }
 
 int64_t flower_getFaceNumber(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_size(flower->faces);
 }
 
 Flower_FaceIterator *flower_getFaceIterator(Flower *flower) {
+    flower_materialise(flower);
     return stSortedSet_getIterator(flower->faces);
 }
 
@@ -615,6 +640,7 @@ bool flower_builtBlocks(Flower *flower) {
 }
 
 void flower_setBuiltBlocks(Flower *flower, bool b) {
+    flower_materialise(flower);
     flower->builtBlocks = b;
 }
 
@@ -623,6 +649,7 @@ bool flower_builtTrees(Flower *flower) {
 }
 
 void flower_setBuiltTrees(Flower *flower, bool b) {
+    flower_materialise(flower);
     flower->builtTrees = b;
 }
 
@@ -631,6 +658,7 @@ bool flower_builtFaces(Flower *flower) {
 }
 
 void flower_setBuildFaces(Flower *flower, bool b) {
+    flower_materialise(flower);
     flower->builtFaces = b;
     if (flower_builtFaces(flower)) {
         flower_reconstructFaces(flower);
@@ -714,6 +742,7 @@ void flower_delete2(Flower *flower, bool isOnDisk) {
     flower_destructGroupIterator(groupIt);
     Group *parentGroup = flower_getParentGroup(flower);
     if(parentGroup != NULL) {
+        flower_materialise(group_getFlower(parentGroup));
         parentGroup->leafGroup = 1;
     }
     //This needs modification so that we don't do this directly..
@@ -797,94 +826,125 @@ void flower_unloadParent(Flower *flower) {
  */
 
 void flower_addSequence(Flower *flower, Sequence *sequence) {
-    assert(stSortedSet_search(flower->sequences, sequence) == NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->sequencesByName, sequence_getName(sequence)) == NULL);
     stSortedSet_insert(flower->sequences, sequence);
+    cactusNameIndex_insert(flower->sequencesByName, sequence_getName(sequence), sequence);
 }
 
 void flower_removeSequence(Flower *flower, Sequence *sequence) {
-    assert(stSortedSet_search(flower->sequences, sequence) != NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->sequencesByName, sequence_getName(sequence)) != NULL);
     stSortedSet_remove(flower->sequences, sequence);
+    cactusNameIndex_remove(flower->sequencesByName, sequence_getName(sequence));
 }
 
 void flower_addCap(Flower *flower, Cap *cap) {
+    flower_materialise(flower);
     cap = cap_getPositiveOrientation(cap);
-    assert(stSortedSet_search(flower->caps, cap) == NULL);
+    assert(cactusNameIndex_search(flower->capsByName, cap_getName(cap)) == NULL);
     stSortedSet_insert(flower->caps, cap);
+    cactusNameIndex_insert(flower->capsByName, cap_getName(cap), cap);
 }
 
 void flower_removeCap(Flower *flower, Cap *cap) {
+    flower_materialise(flower);
     cap = cap_getPositiveOrientation(cap);
-    assert(stSortedSet_search(flower->caps, cap) != NULL);
+    assert(cactusNameIndex_search(flower->capsByName, cap_getName(cap)) != NULL);
     stSortedSet_remove(flower->caps, cap);
+    cactusNameIndex_remove(flower->capsByName, cap_getName(cap));
 }
 
 void flower_addEnd(Flower *flower, End *end) {
+    flower_materialise(flower);
     end = end_getPositiveOrientation(end);
-    assert(stSortedSet_search(flower->ends, end) == NULL);
+    assert(cactusNameIndex_search(flower->endsByName, end_getName(end)) == NULL);
     stSortedSet_insert(flower->ends, end);
+    cactusNameIndex_insert(flower->endsByName, end_getName(end), end);
 }
 
 void flower_removeEnd(Flower *flower, End *end) {
+    flower_materialise(flower);
     end = end_getPositiveOrientation(end);
-    assert(stSortedSet_search(flower->ends, end) != NULL);
+    assert(cactusNameIndex_search(flower->endsByName, end_getName(end)) != NULL);
     stSortedSet_remove(flower->ends, end);
+    cactusNameIndex_remove(flower->endsByName, end_getName(end));
 }
 
 void flower_addSegment(Flower *flower, Segment *segment) {
+    flower_materialise(flower);
     segment = segment_getPositiveOrientation(segment);
-    assert(stSortedSet_search(flower->segments, segment) == NULL);
+    assert(cactusNameIndex_search(flower->segmentsByName, segment_getName(segment)) == NULL);
     stSortedSet_insert(flower->segments, segment);
+    cactusNameIndex_insert(flower->segmentsByName, segment_getName(segment), segment);
 }
 
 void flower_removeSegment(Flower *flower, Segment *segment) {
+    flower_materialise(flower);
     segment = segment_getPositiveOrientation(segment);
-    assert(stSortedSet_search(flower->segments, segment) != NULL);
+    assert(cactusNameIndex_search(flower->segmentsByName, segment_getName(segment)) != NULL);
     stSortedSet_remove(flower->segments, segment);
+    cactusNameIndex_remove(flower->segmentsByName, segment_getName(segment));
 }
 
 void flower_addBlock(Flower *flower, Block *block) {
+    flower_materialise(flower);
     block = block_getPositiveOrientation(block);
-    assert(stSortedSet_search(flower->blocks, block) == NULL);
+    assert(cactusNameIndex_search(flower->blocksByName, block_getName(block)) == NULL);
     stSortedSet_insert(flower->blocks, block);
+    cactusNameIndex_insert(flower->blocksByName, block_getName(block), block);
 }
 
 void flower_removeBlock(Flower *flower, Block *block) {
+    flower_materialise(flower);
     block = block_getPositiveOrientation(block);
-    assert(stSortedSet_search(flower->blocks, block) != NULL);
+    assert(cactusNameIndex_search(flower->blocksByName, block_getName(block)) != NULL);
     stSortedSet_remove(flower->blocks, block);
+    cactusNameIndex_remove(flower->blocksByName, block_getName(block));
 }
 
 void flower_addChain(Flower *flower, Chain *chain) {
-    assert(stSortedSet_search(flower->chains, chain) == NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->chainsByName, chain_getName(chain)) == NULL);
     stSortedSet_insert(flower->chains, chain);
+    cactusNameIndex_insert(flower->chainsByName, chain_getName(chain), chain);
 }
 
 void flower_removeChain(Flower *flower, Chain *chain) {
-    assert(stSortedSet_search(flower->chains, chain) != NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->chainsByName, chain_getName(chain)) != NULL);
     stSortedSet_remove(flower->chains, chain);
+    cactusNameIndex_remove(flower->chainsByName, chain_getName(chain));
 }
 
 void flower_addGroup(Flower *flower, Group *group) {
-    assert(stSortedSet_search(flower->groups, group) == NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->groupsByName, group_getName(group)) == NULL);
     stSortedSet_insert(flower->groups, group);
+    cactusNameIndex_insert(flower->groupsByName, group_getName(group), group);
 }
 
 void flower_removeGroup(Flower *flower, Group *group) {
-    assert(stSortedSet_search(flower->groups, group) != NULL);
+    flower_materialise(flower);
+    assert(cactusNameIndex_search(flower->groupsByName, group_getName(group)) != NULL);
     stSortedSet_remove(flower->groups, group);
+    cactusNameIndex_remove(flower->groupsByName, group_getName(group));
 }
 
 void flower_setParentGroup(Flower *flower, Group *group) {
     //assert(flower->parentFlowerName == NULL_NAME); we can change this if merging the parent flowers, so this no longer applies.
+    flower_materialise(flower);
     flower->parentFlowerName = flower_getName(group_getFlower(group));
 }
 
 void flower_addFace(Flower *flower, Face *face) {
+    flower_materialise(flower);
     assert(stSortedSet_search(flower->faces, face) == NULL);
     stSortedSet_insert(flower->faces, face);
 }
 
 void flower_removeFace(Flower *flower, Face *face) {
+    flower_materialise(flower);
     assert(stSortedSet_search(flower->faces, face) != NULL);
     stSortedSet_remove(flower->faces, face);
 }
@@ -893,6 +953,13 @@ void flower_removeFace(Flower *flower, Face *face) {
  * Serialisation functions.
  */
 
+static int64_t flower_binaryRepresentationVersion = BINARY_REPRESENTATION_VERSION_2;
+
+void flower_setBinaryRepresentationVersion(int64_t version) {
+    assert(version == BINARY_REPRESENTATION_VERSION_1 || version == BINARY_REPRESENTATION_VERSION_2);
+    flower_binaryRepresentationVersion = version;
+}
+
 void flower_writeBinaryRepresentation(Flower *flower, void(*writeFn)(const void * ptr, size_t size, size_t count)) {
     Flower_SequenceIterator *sequenceIterator;
     Flower_EndIterator *endIterator;
@@ -905,7 +972,13 @@ void flower_writeBinaryRepresentation(Flower *flower, void(*writeFn)(const void
     Group *group;
     Chain *chain;
 
-    binaryRepresentation_writeElementType(CODE_FLOWER, writeFn);
+    if (flower->lazyRecord != NULL) { //The flower is unchanged since it was loaded, so its record is written as it was.
+        writeFn(flower->lazyRecord, 1, flower->lazyRecordSize);
+        return;
+    }
+    char flowerCode = flower_binaryRepresentationVersion == BINARY_REPRESENTATION_VERSION_2 ? CODE_FLOWER_V2 : CODE_FLOWER;
+    BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(flower_binaryRepresentationVersion);
+    binaryRepresentation_writeElementType(flowerCode, writeFn);
     binaryRepresentation_writeName(flower_getName(flower), writeFn);
     binaryRepresentation_writeBool(flower_builtBlocks(flower), writeFn);
     binaryRepresentation_writeBool(flower_builtTrees(flower), writeFn);
@@ -942,14 +1015,19 @@ void flower_writeBinaryRepresentation(Flower *flower, void(*writeFn)(const void
     }
     flower_destructChainIterator(chainIterator);
 
-    binaryRepresentation_writeElementType(CODE_FLOWER, writeFn); //this avoids interpretting things wrong.
+    binaryRepresentation_writeElementType(flowerCode, writeFn); //this avoids interpretting things wrong.
+    binaryRepresentation_restoreFormat(previousFormat);
 }
 
-Flower *flower_loadFromBinaryRepresentation(void **binaryString, CactusDisk *cactusDisk) {
+static Flower *flower_loadFromBinaryRepresentationP(void **binaryString, CactusDisk *cactusDisk, bool skeleton) {
     Flower *flower = NULL;
     bool buildFaces;
-    if (binaryRepresentation_peekNextElementType(*binaryString) == CODE_FLOWER) {
+    void *record = *binaryString;
+    char flowerCode = binaryRepresentation_peekNextElementType(*binaryString);
+    if (flowerCode == CODE_FLOWER || flowerCode == CODE_FLOWER_V2) {
         binaryRepresentation_popNextElementType(binaryString);
+        BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(
+                flowerCode == CODE_FLOWER_V2 ? BINARY_REPRESENTATION_VERSION_2 : BINARY_REPRESENTATION_VERSION_1);
         flower = flower_construct3(binaryRepresentation_getName(binaryString), cactusDisk);
         flower_setBuiltBlocks(flower, binaryRepresentation_getBool(binaryString));
         flower_setBuiltTrees(flower, binaryRepresentation_getBool(binaryString));
@@ -957,16 +1035,74 @@ Flower *flower_loadFromBinaryRepresentation(void **binaryString, CactusDisk *cac
         flower->parentFlowerName = binaryRepresentation_getName(binaryString);
         while (sequence_loadFromBinaryRepresentation(binaryString, flower) != NULL)
             ;
-        while (end_loadFromBinaryRepresentation(binaryString, flower) != NULL)
+        while ((skeleton ? end_loadSkeletonFromBinaryRepresentation(binaryString, flower)
+                : end_loadFromBinaryRepresentation(binaryString, flower)) != NULL)
             ;
-        while (block_loadFromBinaryRepresentation(binaryString, flower) != NULL)
+        while ((skeleton ? block_loadSkeletonFromBinaryRepresentation(binaryString, flower)
+                : block_loadFromBinaryRepresentation(binaryString, flower)) != NULL)
             ;
         while (group_loadFromBinaryRepresentation(binaryString, flower) != NULL)
             ;
         while (chain_loadFromBinaryRepresentation(binaryString, flower) != NULL)
             ;
-        flower_setBuildFaces(flower, buildFaces);
-        assert(binaryRepresentation_popNextElementType(binaryString) == CODE_FLOWER);
+        assert(binaryRepresentation_popNextElementType(binaryString) == flowerCode);
+        binaryRepresentation_restoreFormat(previousFormat);
+        if (skeleton) {
+            //The faces are built when the flower is materialised, as they need the caps.
+            flower->builtFaces = buildFaces;
+            flower->lazyRecordSize = (char *) *binaryString - (char *) record;
+            flower->lazyRecord = st_malloc(flower->lazyRecordSize);
+            memcpy(flower->lazyRecord, record, flower->lazyRecordSize);
+        } else {
+            flower_setBuildFaces(flower, buildFaces);
+        }
     }
     return flower;
 }
+
+Flower *flower_loadFromBinaryRepresentation(void **binaryString, CactusDisk *cactusDisk) {
+    return flower_loadFromBinaryRepresentationP(binaryString, cactusDisk, 0);
+}
+
+Flower *flower_loadSkeletonFromBinaryRepresentation(void **binaryString, CactusDisk *cactusDisk) {
+    return flower_loadFromBinaryRepresentationP(binaryString, cactusDisk, 1);
+}
+
+void flower_materialise(Flower *flower) {
+    if (flower->lazyRecord == NULL) {
+        return;
+    }
+    /*
+     * Reads the record again, loading the caps of the ends and the segments of the blocks. The record is detached from
+     * the flower first, so the functions called to construct the caps and segments do not materialise it again.
+     * Removing or moving ends, blocks and sequences materialises the flower, so those in the record are all still there.
+     */
+    void *record = flower->lazyRecord;
+    flower->lazyRecord = NULL;
+    flower->lazyRecordSize = 0;
+    void *binaryString = record;
+    char flowerCode = binaryRepresentation_popNextElementType(&binaryString);
+    BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(
+            flowerCode == CODE_FLOWER_V2 ? BINARY_REPRESENTATION_VERSION_2 : BINARY_REPRESENTATION_VERSION_1);
+    binaryRepresentation_getName(&binaryString);
+    binaryRepresentation_getBool(&binaryString);
+    binaryRepresentation_getBool(&binaryString);
+    binaryRepresentation_getBool(&binaryString);
+    binaryRepresentation_getName(&binaryString);
+    while (sequence_skipBinaryRepresentation(&binaryString))
+        ;
+    while (end_loadCapsFromBinaryRepresentation(&binaryString, flower) != NULL)
+        ;
+    while (block_loadSegmentsFromBinaryRepresentation(&binaryString, flower) != NULL)
+        ;
+    //The groups and chains were loaded with the skeleton.
+    binaryRepresentation_restoreFormat(previousFormat);
+    free(record);
+    if (flower_builtFaces(flower)) {
+        flower_reconstructFaces(flower);
+    }
+}
+
+bool flower_isMaterialised(Flower *flower) {
+    return flower->lazyRecord == NULL;
+}
@@ -19,6 +19,15 @@ struct _flower {
     stSortedSet *groups;
     stSortedSet *chains;
     stSortedSet *faces;
+    //The above, indexed by name for lookups. The sorted sets are kept for ordered iteration.
+    CactusNameIndex *sequencesByName;
+    CactusNameIndex *endsByName;
+    CactusNameIndex *capsByName;
+    CactusNameIndex *blocksByName;
+    CactusNameIndex *segmentsByName;
+    CactusNameIndex *groupsByName;
+    CactusNameIndex *chainsByName;
+    CactusArena *arena; //The caps, ends, segments and blocks of the flower are allocated from it.
     Name parentFlowerName;
     CactusDisk *cactusDisk;
     int64_t faceIndex;
@@ -26,6 +35,10 @@ struct _flower {
     bool builtBlocks;
     bool builtTrees;
     bool builtFaces;
+    bool hasRecordHash; //If non-zero the record of the flower on disk is known to have the hash recordHash.
+    uint64_t recordHash;
+    void *lazyRecord; //If non-null, a copy of the record the flower was loaded from, whose caps, segments and faces are yet to be loaded.
+    int64_t lazyRecordSize;
 };
 
 ////////////////////////////////////////////////
@@ -42,6 +55,11 @@ struct _flower {
  */
 void flower_destruct(Flower *flower, int64_t recursive);
 
+/*
+ * Gets the arena the caps, ends, segments and blocks of the flower are allocated from.
+ */
+CactusArena *flower_getArena(Flower *flower);
+
 /*
  * Adds the event tree for the flower to the flower.
  * If an previous event tree exists for the flower
@@ -151,6 +169,12 @@ void flower_reconstructFaces(Flower * flower);
  */
 void flower_destructFaces(Flower *flower);
 
+/*
+ * Sets the binary format version (see cactusSerialisation.h) used by flower_writeBinaryRepresentation,
+ * by default BINARY_REPRESENTATION_VERSION_2. flower_loadFromBinaryRepresentation reads either version.
+ */
+void flower_setBinaryRepresentationVersion(int64_t version);
+
 /*
  * Write a binary representation of the flower to the write function.
  */
@@ -162,4 +186,24 @@ void flower_writeBinaryRepresentation(Flower *flower, void(*writeFn)(const void
  */
 Flower *flower_loadFromBinaryRepresentation(void **binaryString, CactusDisk *cactusDisk);
 
+/*
+ * Loads the skeleton of a flower from a binary representation of the flower: its sequences, ends, blocks, groups
+ * and chains, but not the caps, segments and faces, which are loaded from a copy of the representation by
+ * flower_materialise when they are first accessed (or the flower is changed in a way that needs them).
+ */
+Flower *flower_loadSkeletonFromBinaryRepresentation(void **binaryString, CactusDisk *cactusDisk);
+
+/*
+ * Loads the caps, segments and faces of a flower loaded by flower_loadSkeletonFromBinaryRepresentation,
+ * if they are not yet loaded. It is called by the functions that access or change them, and by those that change
+ * anything else written in the record of the flower, so need not otherwise be called. A flower which is not
+ * materialised is therefore unchanged since it was loaded, and its record is written back as it was.
+ */
+void flower_materialise(Flower *flower);
+
+/*
+ * Returns non-zero if the caps, segments and faces of the flower are loaded.
+ */
+bool flower_isMaterialised(Flower *flower);
+
 #endif
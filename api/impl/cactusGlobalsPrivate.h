@@ -47,7 +47,17 @@
 #include "cactusMetaSequence.h"
 #include "cactusMetaSequencePrivate.h"
 #include "cactusFlower.h"
+#include "cactusCodec.h"
+#include "cactusArchive.h"
+#include "cactusSecondaryDatabase.h"
 #include "cactusDisk.h"
+#include "cactusLocalDatabase.h"
+#include "cactusPackedSequence.h"
+#include "cactusCache.h"
+#include "cactusNameIndex.h"
+#include "cactusArena.h"
+#include "cactusSnapshot.h"
+#include "cactusDiskStats.h"
 #include "cactusDiskPrivate.h"
 #include "cactusMisc.h"
 #include "cactusFlowerPrivate.h"
@@ -57,6 +67,7 @@
 #include "cactusFaceEndPrivate.h"
 #include "cactusSequence.h"
 #include "cactusSequencePrivate.h"
+#include "cactusSequenceView.h"
 #include "cactusSerialisation.h"
 #include "cactusTestCommon.h"
 #include "cactusFlowerWriter.h"
@@ -73,6 +73,7 @@ static void copyAdjacencies(Group *group, Flower *nestedFlower) {
 
 Flower *group_makeEmptyNestedFlower(Group *group) {
     assert(group_isLeaf(group));
+    flower_materialise(group_getFlower(group));
     group->leafGroup = 0;
     Flower *nestedFlower = flower_construct2(group_getName(group), flower_getCactusDisk(group_getFlower(group)));
     flower_setParentGroup(nestedFlower, group);
@@ -122,6 +123,7 @@ void group_updateContainedEnds(Group *group) {
 }
 
 void group_addEnd(Group *group, End *end) {
+    flower_materialise(group_getFlower(group));
     end = end_getPositiveOrientation(end);
     stSortedSet_insert(group->ends, end);
 }
@@ -166,8 +168,8 @@ End *group_getFirstEnd(Group *group) {
 }
 
 End *group_getEnd(Group *group, Name name) {
-    static End end;
-    static EndContents endContents;
+    End end;
+    EndContents endContents;
     end.endContents = &endContents;
     endContents.name = name;
     return stSortedSet_search(group->ends, &end);
@@ -398,6 +400,7 @@ void group_setLink(Group *group, Link *link) {
 }
 
 void group_removeEnd(Group *group, End *end) {
+    flower_materialise(group_getFlower(group));
     assert(group_getEnd(group, end_getName(end)) == end);
     stSortedSet_remove(group->ends, end);
 }
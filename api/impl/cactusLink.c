@@ -69,6 +69,7 @@ Chain *link_getChain(Link *link) {
  */
 
 void link_destruct(Link *link) {
+	flower_materialise(chain_getFlower(link_getChain(link)));
 	group_setLink(link_getGroup(link), NULL);
     int64_t i = 1;
     Link *link2 = link->nLink;
@@ -0,0 +1,652 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+// For pread/pwrite, ftruncate and fcntl locks (POSIX extensions).
+#define _POSIX_C_SOURCE 200809L
+
+#include "cactusGlobalsPrivate.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#define LOCAL_DATABASE_LOG_FILE "cactusDisk.log"
+#define LOCAL_DATABASE_COMPACT_FILE "cactusDisk.log.compact"
+#define LOCAL_DATABASE_MAGIC "CACTUSL1"
+#define LOCAL_DATABASE_HEADER_SIZE 8
+#define LOCAL_DATABASE_REMOVED_RECORD -1
+#define LOCAL_DATABASE_MAP_GRANULARITY (64 * 1024 * 1024)
+#define LOCAL_DATABASE_EMPTY_SLOT -1
+#define LOCAL_DATABASE_COMPACTION_MIN_LENGTH (64 * 1024 * 1024)
+#define LOCAL_DATABASE_COMPACTION_BUFFER_LENGTH (16 * 1024 * 1024)
+
+/*
+ * Each record in the log is a key, a size and then size bytes of value. A size of
+ * LOCAL_DATABASE_REMOVED_RECORD marks the removal of the key.
+ */
+typedef struct _logRecordHeader {
+    int64_t key;
+    int64_t size;
+} LogRecordHeader;
+
+/*
+ * Slot of the open addressing index. The offset is the offset of the value in the log.
+ */
+typedef struct _indexSlot {
+    int64_t key;
+    int64_t offset;
+    int64_t size;
+} IndexSlot;
+
+/*
+ * fcntl locks are held by the process, not the handle, so handles on the same log within a
+ * process (or one handle shared by several threads) are serialised by a process wide mutex
+ * per log, keyed by the device and inode of the log.
+ */
+typedef struct _logMutex {
+    char *key;
+    pthread_mutex_t mutex;
+    int64_t references;
+} LogMutex;
+
+struct _cactusLocalDatabase {
+    char *databaseDir;
+    char *logFile;
+    char *compactFile;
+    int fd;
+    LogMutex *logMutex;
+    char *map;
+    int64_t mapSize;
+    int64_t indexedLength; //Length of the prefix of the log that has been indexed.
+    IndexSlot *slots;
+    int64_t slotNumber; //Always a power of two.
+    int64_t occupiedSlots;
+    int64_t recordNumber;
+    int64_t liveLength; //Length the log would have if it held only the live records.
+};
+
+/*
+ * The hash index.
+ */
+
+static uint64_t hashKey(int64_t key) {
+    uint64_t i = key;
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return i ^ (i >> 31);
+}
+
+static IndexSlot *index_getSlot(IndexSlot *slots, int64_t slotNumber, int64_t key) {
+    /*
+     * Returns the slot containing the key, or the empty slot where it would be placed.
+     */
+    uint64_t mask = slotNumber - 1;
+    for (uint64_t i = hashKey(key) & mask;; i = (i + 1) & mask) {
+        if (slots[i].offset == LOCAL_DATABASE_EMPTY_SLOT || slots[i].key == key) {
+            return slots + i;
+        }
+    }
+}
+
+static IndexSlot *index_search(CactusLocalDatabase *database, int64_t key) {
+    IndexSlot *slot = index_getSlot(database->slots, database->slotNumber, key);
+    return slot->offset == LOCAL_DATABASE_EMPTY_SLOT || slot->size == LOCAL_DATABASE_REMOVED_RECORD ? NULL : slot;
+}
+
+static int64_t index_getRecordLength(IndexSlot *slot) {
+    return slot->offset == LOCAL_DATABASE_EMPTY_SLOT || slot->size == LOCAL_DATABASE_REMOVED_RECORD ? 0
+            : sizeof(LogRecordHeader) + slot->size;
+}
+
+static IndexSlot *index_constructSlots(int64_t slotNumber) {
+    IndexSlot *slots = st_malloc(sizeof(IndexSlot) * slotNumber);
+    for (int64_t i = 0; i < slotNumber; i++) {
+        slots[i].offset = LOCAL_DATABASE_EMPTY_SLOT;
+    }
+    return slots;
+}
+
+static void index_set(CactusLocalDatabase *database, int64_t key, int64_t offset, int64_t size) {
+    if (2 * (database->occupiedSlots + 1) > database->slotNumber) { //Keep the load below a half.
+        IndexSlot *slots = index_constructSlots(database->slotNumber * 2);
+        for (int64_t i = 0; i < database->slotNumber; i++) {
+            if (database->slots[i].offset != LOCAL_DATABASE_EMPTY_SLOT) {
+                *index_getSlot(slots, database->slotNumber * 2, database->slots[i].key) = database->slots[i];
+            }
+        }
+        free(database->slots);
+        database->slots = slots;
+        database->slotNumber *= 2;
+    }
+    IndexSlot *slot = index_getSlot(database->slots, database->slotNumber, key);
+    database->liveLength -= index_getRecordLength(slot);
+    if (slot->offset == LOCAL_DATABASE_EMPTY_SLOT) {
+        database->occupiedSlots++;
+    } else if (slot->size != LOCAL_DATABASE_REMOVED_RECORD) {
+        database->recordNumber--;
+    }
+    if (size != LOCAL_DATABASE_REMOVED_RECORD) {
+        database->recordNumber++;
+    }
+    slot->key = key;
+    slot->offset = offset;
+    slot->size = size;
+    database->liveLength += index_getRecordLength(slot);
+}
+
+static void index_reset(CactusLocalDatabase *database) {
+    /*
+     * Empties the index, so the log is read again from its header.
+     */
+    free(database->slots);
+    database->slotNumber = 1024;
+    database->slots = index_constructSlots(database->slotNumber);
+    database->occupiedSlots = 0;
+    database->recordNumber = 0;
+    database->liveLength = LOCAL_DATABASE_HEADER_SIZE;
+    database->indexedLength = LOCAL_DATABASE_HEADER_SIZE;
+}
+
+/*
+ * The process wide log mutexes.
+ */
+
+static pthread_mutex_t logMutexesMutex = PTHREAD_MUTEX_INITIALIZER;
+static stHash *logMutexes = NULL;
+
+static LogMutex *logMutex_get(struct stat *fileStat) {
+    char *key = stString_print("%" PRIi64 ":%" PRIi64, (int64_t) fileStat->st_dev, (int64_t) fileStat->st_ino);
+    pthread_mutex_lock(&logMutexesMutex);
+    if (logMutexes == NULL) {
+        logMutexes = stHash_construct3(stHash_stringKey, stHash_stringEqualKey, NULL, NULL);
+    }
+    LogMutex *logMutex = stHash_search(logMutexes, key);
+    if (logMutex == NULL) {
+        logMutex = st_malloc(sizeof(LogMutex));
+        logMutex->key = key;
+        pthread_mutex_init(&logMutex->mutex, NULL);
+        logMutex->references = 0;
+        stHash_insert(logMutexes, key, logMutex);
+    } else {
+        free(key);
+    }
+    logMutex->references++;
+    pthread_mutex_unlock(&logMutexesMutex);
+    return logMutex;
+}
+
+static void logMutex_release(LogMutex *logMutex) {
+    pthread_mutex_lock(&logMutexesMutex);
+    if (--logMutex->references == 0) {
+        stHash_remove(logMutexes, logMutex->key);
+        pthread_mutex_destroy(&logMutex->mutex);
+        free(logMutex->key);
+        free(logMutex);
+    }
+    pthread_mutex_unlock(&logMutexesMutex);
+}
+
+/*
+ * Locking and reading the log written by this and other processes. Functions that throw
+ * while the log is locked release the lock first.
+ */
+
+static void setLogLock(CactusLocalDatabase *database, bool exclusive) {
+    /*
+     * Takes the fcntl lock on the log, which must be called holding the mutex of the log.
+     */
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = exclusive ? F_WRLCK : F_RDLCK;
+    lock.l_whence = SEEK_SET;
+    while (fcntl(database->fd, F_SETLKW, &lock) == -1) {
+        if (errno != EINTR) {
+            pthread_mutex_unlock(&database->logMutex->mutex);
+            stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to lock the local database log %s: %s", database->logFile,
+                    strerror(errno));
+        }
+    }
+}
+
+static void switchLog(CactusLocalDatabase *database, int fd) {
+    /*
+     * Replaces the descriptor of the log, which must be called holding the mutex of the log, with the given
+     * descriptor of the log that replaced it, emptying the index. Leaves the mutex of the new log unlocked.
+     */
+    if (database->map != NULL) {
+        munmap(database->map, database->mapSize);
+        database->map = NULL;
+        database->mapSize = 0;
+    }
+    close(database->fd);
+    database->fd = fd;
+    struct stat fileStat;
+    fstat(fd, &fileStat);
+    LogMutex *logMutex = database->logMutex;
+    database->logMutex = logMutex_get(&fileStat);
+    pthread_mutex_unlock(&logMutex->mutex);
+    logMutex_release(logMutex);
+    index_reset(database);
+}
+
+static void unlockLog(CactusLocalDatabase *database) {
+    struct flock lock;
+    memset(&lock, 0, sizeof(lock));
+    lock.l_type = F_UNLCK;
+    lock.l_whence = SEEK_SET;
+    fcntl(database->fd, F_SETLK, &lock);
+    pthread_mutex_unlock(&database->logMutex->mutex);
+}
+
+static bool logWasReplaced(CactusLocalDatabase *database) {
+    /*
+     * Returns non-zero if the log file has been replaced by a compaction since this handle opened it.
+     * Compaction renames the new log into place holding the exclusive lock on the old one, so a handle
+     * that holds the lock on its log sees any compaction that has happened.
+     */
+    struct stat fileStat, pathStat;
+    return fstat(database->fd, &fileStat) == 0 && stat(database->logFile, &pathStat) == 0
+            && (fileStat.st_dev != pathStat.st_dev || fileStat.st_ino != pathStat.st_ino);
+}
+
+static void lockLog(CactusLocalDatabase *database, bool exclusive) {
+    while (1) {
+        pthread_mutex_lock(&database->logMutex->mutex);
+        setLogLock(database, exclusive);
+        if (!logWasReplaced(database)) {
+            return;
+        }
+        int fd = open(database->logFile, O_RDWR);
+        if (fd < 0) {
+            unlockLog(database);
+            stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to reopen the compacted local database log %s",
+                    database->logFile);
+        }
+        switchLog(database, fd);
+    }
+}
+
+
+static int64_t getLogLength(CactusLocalDatabase *database) {
+    struct stat fileStat;
+    if (fstat(database->fd, &fileStat) != 0) {
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to stat the local database log %s", database->logFile);
+    }
+    return fileStat.st_size;
+}
+
+static void mapLog(CactusLocalDatabase *database, int64_t length) {
+    /*
+     * Ensures at least the first length bytes of the log are mapped. The mapping is made in large
+     * steps, so growing logs are rarely remapped; pages past the end of the file are never touched.
+     */
+    if (length <= database->mapSize) {
+        return;
+    }
+    if (database->map != NULL) {
+        munmap(database->map, database->mapSize);
+    }
+    database->mapSize = ((length / LOCAL_DATABASE_MAP_GRANULARITY) + 1) * LOCAL_DATABASE_MAP_GRANULARITY;
+    database->map = mmap(NULL, database->mapSize, PROT_READ, MAP_SHARED, database->fd, 0);
+    if (database->map == MAP_FAILED) {
+        database->map = NULL;
+        database->mapSize = 0;
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to memory map the local database log %s", database->logFile);
+    }
+}
+
+static void catchUp(CactusLocalDatabase *database) {
+    /*
+     * Indexes any records appended to the log since it was last read. A torn record at the end
+     * of the log (from a process that died mid write) is left unindexed.
+     */
+    int64_t logLength = getLogLength(database);
+    if (logLength <= database->indexedLength) {
+        return;
+    }
+    mapLog(database, logLength);
+    while (database->indexedLength + (int64_t) sizeof(LogRecordHeader) <= logLength) {
+        LogRecordHeader header;
+        memcpy(&header, database->map + database->indexedLength, sizeof(LogRecordHeader));
+        int64_t valueOffset = database->indexedLength + sizeof(LogRecordHeader);
+        int64_t valueSize = header.size == LOCAL_DATABASE_REMOVED_RECORD ? 0 : header.size;
+        if (valueSize < 0 || valueOffset + valueSize > logLength) {
+            break;
+        }
+        index_set(database, header.key, valueOffset, header.size);
+        database->indexedLength = valueOffset + valueSize;
+    }
+}
+
+static void *copyValue(CactusLocalDatabase *database, IndexSlot *slot) {
+    void *value = st_malloc(slot->size > 0 ? slot->size : 1);
+    memcpy(value, database->map + slot->offset, slot->size);
+    return value;
+}
+
+/*
+ * Appending to the log.
+ */
+
+typedef struct _logBuffer {
+    char *buffer;
+    int64_t length;
+    int64_t maxLength;
+} LogBuffer;
+
+static void logBuffer_append(LogBuffer *logBuffer, const void *data, int64_t size) {
+    if (logBuffer->length + size > logBuffer->maxLength) {
+        logBuffer->maxLength = 2 * (logBuffer->length + size);
+        logBuffer->buffer = st_realloc(logBuffer->buffer, logBuffer->maxLength);
+    }
+    memcpy(logBuffer->buffer + logBuffer->length, data, size);
+    logBuffer->length += size;
+}
+
+static void logBuffer_appendRecord(LogBuffer *logBuffer, int64_t key, const void *value, int64_t size) {
+    LogRecordHeader header;
+    header.key = key;
+    header.size = size;
+    logBuffer_append(logBuffer, &header, sizeof(LogRecordHeader));
+    if (size > 0) {
+        logBuffer_append(logBuffer, value, size);
+    }
+}
+
+static bool writeAll(int fd, const char *buffer, int64_t length, int64_t offset) {
+    int64_t written = 0;
+    while (written < length) {
+        ssize_t i = pwrite(fd, buffer + written, length - written, offset + written);
+        if (i < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return 0;
+        }
+        written += i;
+    }
+    return 1;
+}
+
+static void writeLogBuffer(CactusLocalDatabase *database, LogBuffer *logBuffer) {
+    /*
+     * Appends the buffer to the log and indexes it. Must be called holding the exclusive lock, after catching up.
+     */
+    if (getLogLength(database) > database->indexedLength && ftruncate(database->fd, database->indexedLength) != 0) {
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to truncate a torn record from the local database log %s",
+                database->logFile);
+    }
+    if (!writeAll(database->fd, logBuffer->buffer, logBuffer->length, database->indexedLength)) {
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to append to the local database log %s: %s",
+                database->logFile, strerror(errno));
+    }
+    catchUp(database);
+}
+
+/*
+ * Compaction. Updates, removals and increments all append to the log, so the log is rewritten with
+ * just the live records once most of it is dead.
+ */
+
+static void compactLog(CactusLocalDatabase *database) {
+    /*
+     * Writes the live records to a new log, which is renamed over the log. Must be called holding the exclusive
+     * lock, after catching up. Other handles notice the rename when they next lock the log and reread it. Leaves
+     * the log unlocked.
+     */
+    int fd = open(database->compactFile, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to create the compacted local database log %s",
+                database->compactFile);
+    }
+    LogBuffer logBuffer = { NULL, 0, 0 };
+    logBuffer_append(&logBuffer, LOCAL_DATABASE_MAGIC, LOCAL_DATABASE_HEADER_SIZE);
+    int64_t written = 0;
+    bool failed = 0;
+    for (int64_t i = 0; i < database->slotNumber && !failed; i++) {
+        IndexSlot *slot = database->slots + i;
+        if (index_getRecordLength(slot) > 0) {
+            logBuffer_appendRecord(&logBuffer, slot->key, database->map + slot->offset, slot->size);
+        }
+        if (logBuffer.length >= LOCAL_DATABASE_COMPACTION_BUFFER_LENGTH || i == database->slotNumber - 1) {
+            failed = !writeAll(fd, logBuffer.buffer, logBuffer.length, written);
+            written += logBuffer.length;
+            logBuffer.length = 0;
+        }
+    }
+    free(logBuffer.buffer);
+    if (failed || fsync(fd) != 0 || rename(database->compactFile, database->logFile) != 0) {
+        close(fd);
+        unlink(database->compactFile);
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to compact the local database log %s", database->logFile);
+    }
+    switchLog(database, fd);
+}
+
+static void unlockLogAfterWrite(CactusLocalDatabase *database) {
+    /*
+     * Releases the exclusive lock taken to write to the log, first compacting the log if less than half of it is live.
+     */
+    if (database->indexedLength >= LOCAL_DATABASE_COMPACTION_MIN_LENGTH && database->indexedLength > 2 * database->liveLength) {
+        compactLog(database);
+    } else {
+        unlockLog(database);
+    }
+}
+
+/*
+ * Public functions.
+ */
+
+char *cactusLocalDatabase_getDatabaseDirFromConfString(const char *confString) {
+    if (strstr(confString, "type=\"local\"") == NULL && strstr(confString, "type='local'") == NULL) {
+        return NULL;
+    }
+    const char *attribute = strstr(confString, "database_dir=");
+    if (attribute == NULL) {
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "The local database conf string has no database_dir attribute: %s",
+                confString);
+    }
+    attribute += strlen("database_dir=");
+    char quote = *attribute++;
+    const char *end = strchr(attribute, quote);
+    if ((quote != '"' && quote != '\'') || end == NULL) {
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "The local database conf string is improperly formatted: %s",
+                confString);
+    }
+    return stString_getSubString(attribute, 0, end - attribute);
+}
+
+CactusLocalDatabase *cactusLocalDatabase_construct(const char *databaseDir, bool create) {
+    if (create && mkdir(databaseDir, 0777) != 0 && errno != EEXIST) {
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to create the local database directory %s", databaseDir);
+    }
+    CactusLocalDatabase *database = st_calloc(1, sizeof(CactusLocalDatabase));
+    database->databaseDir = stString_copy(databaseDir);
+    database->logFile = stString_print("%s/%s", databaseDir, LOCAL_DATABASE_LOG_FILE);
+    database->compactFile = stString_print("%s/%s", databaseDir, LOCAL_DATABASE_COMPACT_FILE);
+    database->fd = open(database->logFile, create ? O_RDWR | O_CREAT : O_RDWR, 0666);
+    if (database->fd < 0) {
+        char *logFile = database->logFile;
+        free(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to open the local database log %s", logFile);
+    }
+    struct stat fileStat;
+    if (fstat(database->fd, &fileStat) != 0) {
+        char *logFile = database->logFile;
+        close(database->fd);
+        free(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to stat the local database log %s", logFile);
+    }
+    database->logMutex = logMutex_get(&fileStat);
+    index_reset(database);
+
+    lockLog(database, true);
+    int64_t logLength = getLogLength(database);
+    if (logLength == 0) {
+        if (pwrite(database->fd, LOCAL_DATABASE_MAGIC, LOCAL_DATABASE_HEADER_SIZE, 0) != LOCAL_DATABASE_HEADER_SIZE) {
+            unlockLog(database);
+            stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Failed to write the header of the local database log %s",
+                    database->logFile);
+        }
+    } else {
+        char magic[LOCAL_DATABASE_HEADER_SIZE];
+        if (pread(database->fd, magic, LOCAL_DATABASE_HEADER_SIZE, 0) != LOCAL_DATABASE_HEADER_SIZE
+                || memcmp(magic, LOCAL_DATABASE_MAGIC, LOCAL_DATABASE_HEADER_SIZE) != 0) {
+            unlockLog(database);
+            stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "The file %s is not a local database log", database->logFile);
+        }
+    }
+    catchUp(database);
+    unlockLog(database);
+    return database;
+}
+
+void cactusLocalDatabase_destruct(CactusLocalDatabase *database) {
+    if (database->map != NULL) {
+        munmap(database->map, database->mapSize);
+    }
+    //Closing any descriptor of the log drops all the fcntl locks of the process on it, so is done holding the mutex.
+    pthread_mutex_lock(&database->logMutex->mutex);
+    close(database->fd);
+    pthread_mutex_unlock(&database->logMutex->mutex);
+    logMutex_release(database->logMutex);
+    free(database->slots);
+    free(database->databaseDir);
+    free(database->logFile);
+    free(database->compactFile);
+    free(database);
+}
+
+void cactusLocalDatabase_deleteFromDisk(CactusLocalDatabase *database) {
+    char *databaseDir = stString_copy(database->databaseDir);
+    unlink(database->logFile);
+    unlink(database->compactFile);
+    cactusLocalDatabase_destruct(database);
+    if (rmdir(databaseDir) != 0) {
+        st_logInfo("Could not remove the local database directory %s\n", databaseDir);
+    }
+    free(databaseDir);
+}
+
+void cactusLocalDatabase_compact(CactusLocalDatabase *database) {
+    lockLog(database, true);
+    catchUp(database);
+    compactLog(database);
+}
+
+bool cactusLocalDatabase_containsRecord(CactusLocalDatabase *database, int64_t key) {
+    lockLog(database, false);
+    catchUp(database);
+    bool containsRecord = index_search(database, key) != NULL;
+    unlockLog(database);
+    return containsRecord;
+}
+
+void *cactusLocalDatabase_getRecord2(CactusLocalDatabase *database, int64_t key, int64_t *recordSize) {
+    lockLog(database, false);
+    catchUp(database);
+    IndexSlot *slot = index_search(database, key);
+    void *record = NULL;
+    if (slot != NULL) {
+        record = copyValue(database, slot);
+        *recordSize = slot->size;
+    }
+    unlockLog(database);
+    return record;
+}
+
+stList *cactusLocalDatabase_bulkGetRecords(CactusLocalDatabase *database, stList *keys) {
+    stList *results = stList_construct3(stList_length(keys), (void (*)(void *)) stKVDatabaseBulkResult_destruct);
+    lockLog(database, false);
+    catchUp(database);
+    for (int64_t i = 0; i < stList_length(keys); i++) {
+        IndexSlot *slot = index_search(database, *((int64_t *) stList_get(keys, i)));
+        stList_set(results, i, slot != NULL ? stKVDatabaseBulkResult_construct(copyValue(database, slot), slot->size)
+                : stKVDatabaseBulkResult_construct(NULL, 0));
+    }
+    unlockLog(database);
+    return results;
+}
+
+void cactusLocalDatabase_bulkSetRecords(CactusLocalDatabase *database, stList *requests) {
+    LogBuffer logBuffer = { NULL, 0, 0 };
+    lockLog(database, true);
+    catchUp(database);
+    for (int64_t i = 0; i < stList_length(requests); i++) {
+        stKVDatabaseBulkRequest *request = stList_get(requests, i);
+        bool present = index_search(database, request->key) != NULL;
+        if ((request->type == INSERT && present) || (request->type == UPDATE && !present)) {
+            unlockLog(database);
+            free(logBuffer.buffer);
+            stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Tried to %s the record with key %" PRIi64 " in the local database, but it %s",
+                    request->type == INSERT ? "insert" : "update", request->key, present ? "already exists" : "does not exist");
+        }
+        logBuffer_appendRecord(&logBuffer, request->key, request->value, request->size);
+    }
+    writeLogBuffer(database, &logBuffer);
+    free(logBuffer.buffer);
+    unlockLogAfterWrite(database);
+}
+
+void cactusLocalDatabase_bulkRemoveRecords(CactusLocalDatabase *database, stList *keys) {
+    LogBuffer logBuffer = { NULL, 0, 0 };
+    for (int64_t i = 0; i < stList_length(keys); i++) {
+        logBuffer_appendRecord(&logBuffer, stIntTuple_get(stList_get(keys, i), 0), NULL, LOCAL_DATABASE_REMOVED_RECORD);
+    }
+    lockLog(database, true);
+    catchUp(database);
+    writeLogBuffer(database, &logBuffer);
+    free(logBuffer.buffer);
+    unlockLogAfterWrite(database);
+}
+
+void cactusLocalDatabase_insertInt64(CactusLocalDatabase *database, int64_t key, int64_t value) {
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(key, &value, sizeof(int64_t)));
+    stTry {
+        cactusLocalDatabase_bulkSetRecords(database, requests);
+    } stCatch(except) {
+        stList_destruct(requests);
+        stThrow(except);
+    } stTryEnd;
+    stList_destruct(requests);
+}
+
+int64_t cactusLocalDatabase_incrementInt64(CactusLocalDatabase *database, int64_t key, int64_t incrementAmount) {
+    lockLog(database, true);
+    catchUp(database);
+    IndexSlot *slot = index_search(database, key);
+    if (slot == NULL || slot->size != sizeof(int64_t)) {
+        unlockLog(database);
+        stThrowNew(ST_KV_DATABASE_EXCEPTION_ID, "Tried to increment the record with key %" PRIi64 " in the local database, but it is not an int64 record",
+                key);
+    }
+    int64_t value;
+    memcpy(&value, database->map + slot->offset, sizeof(int64_t));
+    value += incrementAmount;
+    LogBuffer logBuffer = { NULL, 0, 0 };
+    logBuffer_appendRecord(&logBuffer, key, &value, sizeof(int64_t));
+    writeLogBuffer(database, &logBuffer);
+    free(logBuffer.buffer);
+    unlockLogAfterWrite(database);
+    return value;
+}
+
+int64_t cactusLocalDatabase_getNumberOfRecords(CactusLocalDatabase *database) {
+    lockLog(database, false);
+    catchUp(database);
+    int64_t recordNumber = database->recordNumber;
+    unlockLog(database);
+    return recordNumber;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_LOCAL_DATABASE_H_
+#define CACTUS_LOCAL_DATABASE_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Embedded, memory mapped key/value store.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * The local database is an append only log of records, stored in a single
+ * file in the database directory, which is memory mapped for reading. An in
+ * memory hash index maps each key to its most recent record in the log.
+ *
+ * Several processes on the same node may share a local database: every
+ * operation takes an fcntl lock on the log and first indexes any records other
+ * handles have appended since it last looked. As fcntl locks belong to the process,
+ * handles on the same log within a process, and threads sharing a handle, are
+ * serialised by a process wide mutex per log. It is intended for single node
+ * runs, as a replacement for a ktserver, and is selected with a conf string of the form:
+ *
+ * <st_kv_database_conf type="local"><local database_dir="path"/></st_kv_database_conf>
+ *
+ * Errors are reported by throwing ST_KV_DATABASE_EXCEPTION_ID exceptions, as
+ * the stKVDatabase functions do.
+ *
+ * Updates, removals and increments append to the log, so once the log is over 64MB and less than
+ * half of it is live records, the write that made it so rewrites the live records to a new log and
+ * renames it over the old one. Other handles reopen the log the next time they lock it.
+ *
+ * The CactusDisk, cactusArchive and CactusSecondaryDatabase go through the local database.
+ */
+typedef struct _cactusLocalDatabase CactusLocalDatabase;
+
+/*
+ * If the conf string describes a local database returns its database directory,
+ * as a newly allocated string, else returns NULL.
+ */
+char *cactusLocalDatabase_getDatabaseDirFromConfString(const char *confString);
+
+/*
+ * Opens the local database in the given directory. If create is non-zero the directory
+ * and the log are created if needed; an existing database is opened as is.
+ */
+CactusLocalDatabase *cactusLocalDatabase_construct(const char *databaseDir, bool create);
+
+/*
+ * Unmaps and closes the database.
+ */
+void cactusLocalDatabase_destruct(CactusLocalDatabase *database);
+
+/*
+ * Closes the database and removes its log and directory.
+ */
+void cactusLocalDatabase_deleteFromDisk(CactusLocalDatabase *database);
+
+/*
+ * Returns non-zero if the database contains a record for the key.
+ */
+bool cactusLocalDatabase_containsRecord(CactusLocalDatabase *database, int64_t key);
+
+/*
+ * Returns a copy of the record for the key, or NULL if it is not present. The size of the record
+ * is placed in recordSize.
+ */
+void *cactusLocalDatabase_getRecord2(CactusLocalDatabase *database, int64_t key, int64_t *recordSize);
+
+/*
+ * Gets the records for a list of int64_t keys, returning a list of stKVDatabaseBulkResults in the same order.
+ * Missing records give results with a NULL record.
+ */
+stList *cactusLocalDatabase_bulkGetRecords(CactusLocalDatabase *database, stList *keys);
+
+/*
+ * Applies a list of stKVDatabaseBulkRequests. The requests are validated before any are written,
+ * so either all of them are applied or an exception is thrown and none are.
+ */
+void cactusLocalDatabase_bulkSetRecords(CactusLocalDatabase *database, stList *requests);
+
+/*
+ * Removes the records for a list of stIntTuple keys.
+ */
+void cactusLocalDatabase_bulkRemoveRecords(CactusLocalDatabase *database, stList *keys);
+
+/*
+ * Inserts an int64_t record. Throws an exception if the key already exists.
+ */
+void cactusLocalDatabase_insertInt64(CactusLocalDatabase *database, int64_t key, int64_t value);
+
+/*
+ * Atomically adds the increment to an int64_t record, returning the new value.
+ */
+int64_t cactusLocalDatabase_incrementInt64(CactusLocalDatabase *database, int64_t key, int64_t incrementAmount);
+
+/*
+ * Returns the number of records in the database.
+ */
+int64_t cactusLocalDatabase_getNumberOfRecords(CactusLocalDatabase *database);
+
+/*
+ * Rewrites the log with just the live records, reclaiming the space of updated and removed records.
+ */
+void cactusLocalDatabase_compact(CactusLocalDatabase *database);
+
+#endif
@@ -78,6 +78,13 @@ char *metaSequence_getString(MetaSequence *metaSequence, int64_t start, int64_t
 	return cactusDisk_getString(metaSequence->cactusDisk, metaSequence->stringName, start - metaSequence_getStart(metaSequence), length, strand, metaSequence->length);
 }
 
+void metaSequence_getStringInBuffer(MetaSequence *metaSequence, int64_t start, int64_t length, char *string) {
+	assert(start >= metaSequence_getStart(metaSequence));
+	assert(length >= 0);
+	assert(start + length <= metaSequence_getStart(metaSequence) + metaSequence_getLength(metaSequence));
+	cactusDisk_getStringInBuffer(metaSequence->cactusDisk, metaSequence->stringName, start - metaSequence_getStart(metaSequence), length, string);
+}
+
 const char *metaSequence_getHeader(MetaSequence *metaSequence) {
 	return metaSequence->header;
 }
@@ -99,6 +106,7 @@ void metaSequence_setHeader(MetaSequence *metaSequence,
 
 void metaSequence_writeBinaryRepresentation(MetaSequence *metaSequence,
 		void (*writeFn)(const void * ptr, size_t size, size_t count)) {
+	BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(BINARY_REPRESENTATION_VERSION_1);
 	binaryRepresentation_writeElementType(CODE_META_SEQUENCE, writeFn);
 	binaryRepresentation_writeName(metaSequence_getName(metaSequence), writeFn);
 	binaryRepresentation_writeInteger(metaSequence_getStart(metaSequence), writeFn);
@@ -107,6 +115,7 @@ void metaSequence_writeBinaryRepresentation(MetaSequence *metaSequence,
 	binaryRepresentation_writeName(metaSequence->stringName, writeFn);
 	binaryRepresentation_writeString(metaSequence_getHeader(metaSequence), writeFn);
 	binaryRepresentation_writeBool(metaSequence_isTrivialSequence(metaSequence), writeFn);
+	binaryRepresentation_restoreFormat(previousFormat);
 }
 
 MetaSequence *metaSequence_loadFromBinaryRepresentation(void **binaryString,
@@ -120,6 +129,8 @@ MetaSequence *metaSequence_loadFromBinaryRepresentation(void **binaryString,
 	char *header;
 
 	metaSequence = NULL;
+	//Meta sequences are always version 1, and may be loaded while parsing a flower record (see sequence_loadFromBinaryRepresentation).
+	BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(BINARY_REPRESENTATION_VERSION_1);
 	if(binaryRepresentation_peekNextElementType(*binaryString) == CODE_META_SEQUENCE) {
 		binaryRepresentation_popNextElementType(binaryString);
 		name = binaryRepresentation_getName(binaryString);
@@ -133,6 +144,7 @@ MetaSequence *metaSequence_loadFromBinaryRepresentation(void **binaryString,
 				stringName, header, eventName, isTrivialSequence, cactusDisk);
 		free(header);
 	}
+	binaryRepresentation_restoreFormat(previousFormat);
 	return metaSequence;
 }
 
@@ -34,6 +34,12 @@ struct _metaSequence {
 MetaSequence *metaSequence_construct2(Name name, int64_t start, int64_t length, Name stringName, const char *header,
 		Name eventName, bool isTrivialSequence, CactusDisk *cactusDisk);
 
+/*
+ * As metaSequence_getString, but writes the forward strand of the subsequence into string, which must have room for
+ * length + 1 characters.
+ */
+void metaSequence_getStringInBuffer(MetaSequence *metaSequence, int64_t start, int64_t length, char *string);
+
 /*
  * Destructs a meta sequence.
  */
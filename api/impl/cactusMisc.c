@@ -39,7 +39,7 @@ char *cactusMisc_nameToString(Name name) {
 }
 
 const char *cactusMisc_nameToStringStatic(Name name) {
-    static char cA[100];
+    static __thread char cA[100]; //Per thread, so threads can use the disk in thread-safe mode.
     sprintf(cA, NAME_STRING, name);
     return cA;
 }
@@ -69,6 +69,9 @@ void preCacheNestedFlowers(CactusDisk *cactusDisk, stList *flowers) {
     stList_destruct(nestedFlowerNames);
 }
 
+void cactusMisc_threadPoolNoFinish(void *item) {
+}
+
 const char *CACTUS_CHECK_EXCEPTION_ID = "CACTUS_CHECK_EXCEPTION_ID";
 
 void cactusCheck(bool condition) {
@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+/*
+ * The table holds a power of two number of slots, and is kept at most half full, so probes are short. A slot
+ * whose object is NULL is empty. Objects are removed by shifting back the objects after them in their probe
+ * sequence, so there are no tombstones and lookups never slow down as objects are removed.
+ */
+typedef struct _nameIndexSlot {
+    Name name;
+    void *object;
+} NameIndexSlot;
+
+struct _cactusNameIndex {
+    NameIndexSlot *slots;
+    int64_t size;
+    int64_t capacity;
+    int64_t shift; //64 - log2(capacity), to take the top bits of the hash.
+};
+
+static inline int64_t getHomeSlot(CactusNameIndex *index, Name name) {
+    /*
+     * Names are mostly handed out in runs of consecutive ids, so they are multiplied by the golden ratio
+     * (Fibonacci hashing) to spread them over the table.
+     */
+    return (int64_t) (((uint64_t) name * 0x9E3779B97F4A7C15ULL) >> index->shift);
+}
+
+static void insert(CactusNameIndex *index, Name name, void *object) {
+    int64_t mask = index->capacity - 1;
+    int64_t i = getHomeSlot(index, name);
+    while (index->slots[i].object != NULL) {
+        assert(index->slots[i].name != name);
+        i = (i + 1) & mask;
+    }
+    index->slots[i].name = name;
+    index->slots[i].object = object;
+    index->size++;
+}
+
+static void resize(CactusNameIndex *index, int64_t capacity) {
+    NameIndexSlot *slots = index->slots;
+    int64_t oldCapacity = index->capacity;
+    index->slots = st_calloc(capacity, sizeof(NameIndexSlot));
+    index->capacity = capacity;
+    index->shift = 64;
+    while (capacity > 1) {
+        index->shift--;
+        capacity >>= 1;
+    }
+    index->size = 0;
+    for (int64_t i = 0; i < oldCapacity; i++) {
+        if (slots[i].object != NULL) {
+            insert(index, slots[i].name, slots[i].object);
+        }
+    }
+    free(slots);
+}
+
+CactusNameIndex *cactusNameIndex_construct(void) {
+    return st_calloc(1, sizeof(CactusNameIndex));
+}
+
+void cactusNameIndex_destruct(CactusNameIndex *index) {
+    free(index->slots);
+    free(index);
+}
+
+void *cactusNameIndex_search(CactusNameIndex *index, Name name) {
+    if (index->size == 0) {
+        return NULL;
+    }
+    int64_t mask = index->capacity - 1;
+    for (int64_t i = getHomeSlot(index, name); index->slots[i].object != NULL; i = (i + 1) & mask) {
+        if (index->slots[i].name == name) {
+            return index->slots[i].object;
+        }
+    }
+    return NULL;
+}
+
+void cactusNameIndex_insert(CactusNameIndex *index, Name name, void *object) {
+    assert(object != NULL);
+    if ((index->size + 1) * 2 > index->capacity) {
+        resize(index, index->capacity == 0 ? 8 : index->capacity * 2);
+    }
+    insert(index, name, object);
+}
+
+void *cactusNameIndex_remove(CactusNameIndex *index, Name name) {
+    if (index->size == 0) {
+        return NULL;
+    }
+    int64_t mask = index->capacity - 1;
+    int64_t i = getHomeSlot(index, name);
+    while (index->slots[i].name != name || index->slots[i].object == NULL) {
+        if (index->slots[i].object == NULL) {
+            return NULL;
+        }
+        i = (i + 1) & mask;
+    }
+    void *object = index->slots[i].object;
+    index->size--;
+    //Shift back each following object in the run which may sit in the emptied slot, i.e. whose home slot is not
+    //cyclically after the emptied slot and at or before its current slot.
+    int64_t j = i;
+    while (1) {
+        j = (j + 1) & mask;
+        if (index->slots[j].object == NULL) {
+            break;
+        }
+        int64_t k = getHomeSlot(index, index->slots[j].name);
+        if (((j - k) & mask) >= ((j - i) & mask)) {
+            index->slots[i] = index->slots[j];
+            i = j;
+        }
+    }
+    index->slots[i].object = NULL;
+    return object;
+}
+
+int64_t cactusNameIndex_size(CactusNameIndex *index) {
+    return index->size;
+}
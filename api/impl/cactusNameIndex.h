@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_NAME_INDEX_H_
+#define CACTUS_NAME_INDEX_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Name indices.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * An index of objects by name, for point lookups of the objects in a flower. It is an open addressing
+ * hash table with linear probing, so a lookup is usually a single cache line, rather than the walk of a tree. It
+ * does not own the objects, which must not be NULL, and does not keep any order.
+ */
+typedef struct _cactusNameIndex CactusNameIndex;
+
+/*
+ * Constructs an empty index. No table is allocated until the first object is inserted.
+ */
+CactusNameIndex *cactusNameIndex_construct(void);
+
+/*
+ * Destructs the index, but not the objects in it.
+ */
+void cactusNameIndex_destruct(CactusNameIndex *index);
+
+/*
+ * Gets the object with the given name, or NULL if the index does not contain it.
+ */
+void *cactusNameIndex_search(CactusNameIndex *index, Name name);
+
+/*
+ * Inserts the object with the given name, which must not already be in the index.
+ */
+void cactusNameIndex_insert(CactusNameIndex *index, Name name, void *object);
+
+/*
+ * Removes the object with the given name, returning it, or NULL if the index does not contain it.
+ */
+void *cactusNameIndex_remove(CactusNameIndex *index, Name name);
+
+/*
+ * Gets the number of objects in the index.
+ */
+int64_t cactusNameIndex_size(CactusNameIndex *index);
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+/*
+ * The record is laid out as:
+ *
+ * magic (8 bytes), length, exception run number (n), mask run number (m) (int64s),
+ * exception runs (n pairs of int64 start and length), mask runs (m pairs of int64 start and length),
+ * exception characters (n chars), bases (2 bits per base, four bases per byte, first base in the low bits).
+ *
+ * Positions covered by an exception run are stored as A in the bases.
+ */
+static const char packedSequenceMagic[8] = { (char) 0xCB, 'P', 'S', 'E', 'Q', '2', 'B', '\0' };
+#define PACKED_SEQUENCE_HEADER_SIZE (sizeof(packedSequenceMagic) + 3 * sizeof(int64_t))
+
+struct _packedSequence {
+    char *record;
+    int64_t recordSize;
+    bool ownsRecord; //If zero the record belongs to someone else, such as a memory mapped snapshot.
+    int64_t length;
+    int64_t exceptionRunNumber;
+    int64_t *exceptionRuns;
+    char *exceptionCharacters;
+    int64_t maskRunNumber;
+    int64_t *maskRuns;
+    uint8_t *bases;
+};
+
+static int64_t getBaseCode(char c) {
+    switch (c) {
+        case 'A':
+        case 'a':
+            return 0;
+        case 'C':
+        case 'c':
+            return 1;
+        case 'G':
+        case 'g':
+            return 2;
+        case 'T':
+        case 't':
+            return 3;
+        default:
+            return -1;
+    }
+}
+
+static bool isLowerCase(char c) {
+    return c >= 'a' && c <= 'z';
+}
+
+static char toUpperCase(char c) {
+    return isLowerCase(c) ? c - 'a' + 'A' : c;
+}
+
+static char toLowerCase(char c) {
+    return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static int64_t getRecordSize(int64_t length, int64_t exceptionRunNumber, int64_t maskRunNumber) {
+    return PACKED_SEQUENCE_HEADER_SIZE + 2 * sizeof(int64_t) * (exceptionRunNumber + maskRunNumber)
+            + exceptionRunNumber + (length + 3) / 4;
+}
+
+static void setPointers(PackedSequence *packedSequence) {
+    char *cA = packedSequence->record + PACKED_SEQUENCE_HEADER_SIZE;
+    packedSequence->exceptionRuns = (int64_t *) cA;
+    cA += 2 * sizeof(int64_t) * packedSequence->exceptionRunNumber;
+    packedSequence->maskRuns = (int64_t *) cA;
+    cA += 2 * sizeof(int64_t) * packedSequence->maskRunNumber;
+    packedSequence->exceptionCharacters = cA;
+    cA += packedSequence->exceptionRunNumber;
+    packedSequence->bases = (uint8_t *) cA;
+}
+
+void *packedSequence_pack(const char *string, int64_t length, int64_t *recordSize) {
+    //Count the runs
+    int64_t exceptionRunNumber = 0, maskRunNumber = 0;
+    for (int64_t i = 0; i < length; i++) {
+        if (getBaseCode(string[i]) == -1 && (i == 0 || toUpperCase(string[i - 1]) != toUpperCase(string[i]))) {
+            exceptionRunNumber++;
+        }
+        if (isLowerCase(string[i]) && (i == 0 || !isLowerCase(string[i - 1]))) {
+            maskRunNumber++;
+        }
+    }
+
+    //Make the record
+    PackedSequence packedSequence;
+    packedSequence.recordSize = getRecordSize(length, exceptionRunNumber, maskRunNumber);
+    packedSequence.record = st_calloc(packedSequence.recordSize, 1);
+    packedSequence.length = length;
+    packedSequence.exceptionRunNumber = exceptionRunNumber;
+    packedSequence.maskRunNumber = maskRunNumber;
+    memcpy(packedSequence.record, packedSequenceMagic, sizeof(packedSequenceMagic));
+    int64_t header[3] = { length, exceptionRunNumber, maskRunNumber };
+    memcpy(packedSequence.record + sizeof(packedSequenceMagic), header, sizeof(header));
+    setPointers(&packedSequence);
+
+    //Fill in the runs and bases
+    int64_t exceptionRun = -1, maskRun = -1;
+    for (int64_t i = 0; i < length; i++) {
+        int64_t baseCode = getBaseCode(string[i]);
+        if (baseCode == -1) {
+            if (i == 0 || toUpperCase(string[i - 1]) != toUpperCase(string[i])) {
+                exceptionRun++;
+                packedSequence.exceptionRuns[2 * exceptionRun] = i;
+                packedSequence.exceptionCharacters[exceptionRun] = toUpperCase(string[i]);
+            }
+            packedSequence.exceptionRuns[2 * exceptionRun + 1]++;
+        } else {
+            packedSequence.bases[i / 4] |= baseCode << (2 * (i % 4));
+        }
+        if (isLowerCase(string[i])) {
+            if (i == 0 || !isLowerCase(string[i - 1])) {
+                maskRun++;
+                packedSequence.maskRuns[2 * maskRun] = i;
+            }
+            packedSequence.maskRuns[2 * maskRun + 1]++;
+        }
+    }
+    assert(exceptionRun + 1 == exceptionRunNumber);
+    assert(maskRun + 1 == maskRunNumber);
+    *recordSize = packedSequence.recordSize;
+    return packedSequence.record;
+}
+
+bool packedSequence_isPacked(const void *record, int64_t recordSize) {
+    return recordSize >= PACKED_SEQUENCE_HEADER_SIZE
+            && memcmp(record, packedSequenceMagic, sizeof(packedSequenceMagic)) == 0;
+}
+
+static PackedSequence *packedSequence_construct3(void *record, int64_t recordSize, bool ownsRecord) {
+    if (!packedSequence_isPacked(record, recordSize)) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Not a packed sequence record");
+    }
+    int64_t header[3];
+    memcpy(header, (char *) record + sizeof(packedSequenceMagic), sizeof(header));
+    if (header[0] < 0 || header[1] < 0 || header[2] < 0 || getRecordSize(header[0], header[1], header[2]) != recordSize) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The packed sequence record is corrupt");
+    }
+    PackedSequence *packedSequence = st_malloc(sizeof(PackedSequence));
+    packedSequence->record = record;
+    packedSequence->recordSize = recordSize;
+    packedSequence->ownsRecord = ownsRecord;
+    packedSequence->length = header[0];
+    packedSequence->exceptionRunNumber = header[1];
+    packedSequence->maskRunNumber = header[2];
+    setPointers(packedSequence);
+    return packedSequence;
+}
+
+PackedSequence *packedSequence_construct(void *record, int64_t recordSize) {
+    return packedSequence_construct3(record, recordSize, 1);
+}
+
+PackedSequence *packedSequence_construct2(const void *record, int64_t recordSize) {
+    if (((uintptr_t) record) % sizeof(int64_t) != 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The packed sequence record is not aligned");
+    }
+    return packedSequence_construct3((void *) record, recordSize, 0);
+}
+
+void packedSequence_destruct(PackedSequence *packedSequence) {
+    if (packedSequence->ownsRecord) {
+        free(packedSequence->record);
+    }
+    free(packedSequence);
+}
+
+int64_t packedSequence_getLength(PackedSequence *packedSequence) {
+    return packedSequence->length;
+}
+
+int64_t packedSequence_getMemorySize(PackedSequence *packedSequence) {
+    return sizeof(PackedSequence) + (packedSequence->ownsRecord ? packedSequence->recordSize : 0);
+}
+
+static int64_t getFirstOverlappingRun(int64_t *runs, int64_t runNumber, int64_t start) {
+    /*
+     * Binary search for the first run that ends after start.
+     */
+    int64_t i = 0, j = runNumber;
+    while (i < j) {
+        int64_t k = (i + j) / 2;
+        if (runs[2 * k] + runs[2 * k + 1] <= start) {
+            i = k + 1;
+        } else {
+            j = k;
+        }
+    }
+    return i;
+}
+
+void packedSequence_getSubstring(PackedSequence *packedSequence, int64_t start, int64_t length, char *string) {
+    assert(start >= 0 && length >= 0 && start + length <= packedSequence->length);
+    static const char bases[] = "ACGT";
+    for (int64_t i = 0; i < length; i++) {
+        int64_t j = start + i;
+        string[i] = bases[(packedSequence->bases[j / 4] >> (2 * (j % 4))) & 3];
+    }
+    int64_t end = start + length;
+    for (int64_t i = getFirstOverlappingRun(packedSequence->exceptionRuns, packedSequence->exceptionRunNumber, start);
+            i < packedSequence->exceptionRunNumber && packedSequence->exceptionRuns[2 * i] < end; i++) {
+        int64_t runStart = packedSequence->exceptionRuns[2 * i];
+        int64_t runEnd = runStart + packedSequence->exceptionRuns[2 * i + 1];
+        for (int64_t j = runStart > start ? runStart : start; j < runEnd && j < end; j++) {
+            string[j - start] = packedSequence->exceptionCharacters[i];
+        }
+    }
+    for (int64_t i = getFirstOverlappingRun(packedSequence->maskRuns, packedSequence->maskRunNumber, start);
+            i < packedSequence->maskRunNumber && packedSequence->maskRuns[2 * i] < end; i++) {
+        int64_t runStart = packedSequence->maskRuns[2 * i];
+        int64_t runEnd = runStart + packedSequence->maskRuns[2 * i + 1];
+        for (int64_t j = runStart > start ? runStart : start; j < runEnd && j < end; j++) {
+            string[j - start] = toLowerCase(string[j - start]);
+        }
+    }
+}
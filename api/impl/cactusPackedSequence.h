@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_PACKED_SEQUENCE_H_
+#define CACTUS_PACKED_SEQUENCE_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Packed sequences.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * A packed sequence stores a DNA string in 2 bits per base. Runs of any other character
+ * (typically N) are kept in a run-length table of exceptions, and lowercase (soft-masked) runs in
+ * a second run-length table, so any string round trips exactly.
+ *
+ * The record form of a packed sequence starts with a magic byte that can not start a
+ * sequence string, so packed records can be told apart from the raw strings written by older versions.
+ */
+typedef struct _packedSequence PackedSequence;
+
+/*
+ * Packs the first length characters of the string, returning the newly allocated record and placing its size in recordSize.
+ */
+void *packedSequence_pack(const char *string, int64_t length, int64_t *recordSize);
+
+/*
+ * Returns non-zero if the record was written by packedSequence_pack.
+ */
+bool packedSequence_isPacked(const void *record, int64_t recordSize);
+
+/*
+ * Constructs a packed sequence from a record written by packedSequence_pack. The packed sequence
+ * takes ownership of the record, which must have been allocated with malloc.
+ */
+PackedSequence *packedSequence_construct(void *record, int64_t recordSize);
+
+/*
+ * As packedSequence_construct, but the packed sequence reads the record in place and does not take ownership of it,
+ * so the record must outlive the packed sequence. The record must be 8 byte aligned.
+ */
+PackedSequence *packedSequence_construct2(const void *record, int64_t recordSize);
+
+/*
+ * Destructs the packed sequence.
+ */
+void packedSequence_destruct(PackedSequence *packedSequence);
+
+/*
+ * Gets the length of the unpacked string.
+ */
+int64_t packedSequence_getLength(PackedSequence *packedSequence);
+
+/*
+ * Gets the number of bytes of memory the packed sequence uses, which excludes the record if it does not own it.
+ */
+int64_t packedSequence_getMemorySize(PackedSequence *packedSequence);
+
+/*
+ * Unpacks the substring starting at start, of the given length, into string, which must have room
+ * for length characters. No terminating null is written.
+ */
+void packedSequence_getSubstring(PackedSequence *packedSequence, int64_t start, int64_t length, char *string);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+/*
+ * Exactly one of the two databases is set.
+ */
+struct _cactusSecondaryDatabase {
+    stKVDatabase *database;
+    CactusLocalDatabase *localDatabase;
+};
+
+CactusSecondaryDatabase *cactusSecondaryDatabase_constructFromString(const char *confString, bool create) {
+    char *localDatabaseDir = cactusLocalDatabase_getDatabaseDirFromConfString(confString);
+    if (localDatabaseDir != NULL) {
+        CactusSecondaryDatabase *database = st_calloc(1, sizeof(CactusSecondaryDatabase));
+        stTry {
+            database->localDatabase = cactusLocalDatabase_construct(localDatabaseDir, create);
+        } stCatch(except) {
+            free(localDatabaseDir);
+            free(database);
+            stThrow(except);
+        } stTryEnd;
+        free(localDatabaseDir);
+        return database;
+    }
+    stKVDatabaseConf *conf = stKVDatabaseConf_constructFromString(confString);
+    CactusSecondaryDatabase *database = cactusSecondaryDatabase_construct(conf, create);
+    stKVDatabaseConf_destruct(conf);
+    return database;
+}
+
+CactusSecondaryDatabase *cactusSecondaryDatabase_construct(stKVDatabaseConf *conf, bool create) {
+    CactusSecondaryDatabase *database = st_calloc(1, sizeof(CactusSecondaryDatabase));
+    database->database = stKVDatabase_construct(conf, create);
+    return database;
+}
+
+void cactusSecondaryDatabase_destruct(CactusSecondaryDatabase *database) {
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_destruct(database->localDatabase);
+    } else {
+        stKVDatabase_destruct(database->database);
+    }
+    free(database);
+}
+
+void cactusSecondaryDatabase_deleteFromDisk(CactusSecondaryDatabase *database) {
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_deleteFromDisk(database->localDatabase);
+    } else {
+        stKVDatabase_deleteFromDisk(database->database);
+    }
+    free(database);
+}
+
+stList *cactusSecondaryDatabase_bulkGetRecords(CactusSecondaryDatabase *database, stList *keys) {
+    return database->localDatabase != NULL ? cactusLocalDatabase_bulkGetRecords(database->localDatabase, keys)
+            : stKVDatabase_bulkGetRecords(database->database, keys);
+}
+
+void cactusSecondaryDatabase_bulkSetRecords(CactusSecondaryDatabase *database, stList *requests) {
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_bulkSetRecords(database->localDatabase, requests);
+    } else {
+        stKVDatabase_bulkSetRecords(database->database, requests);
+    }
+}
+
+void cactusSecondaryDatabase_bulkRemoveRecords(CactusSecondaryDatabase *database, stList *keys) {
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_bulkRemoveRecords(database->localDatabase, keys);
+    } else {
+        stKVDatabase_bulkRemoveRecords(database->database, keys);
+    }
+}
@@ -14,6 +14,11 @@
 ////////////////////////////////////////////////
 ////////////////////////////////////////////////
 
+/*
+ * A segment, its reverse and their name are a single allocation from the arena of the segment's flower.
+ */
+#define SEGMENT_ALLOCATION_SIZE (2 * sizeof(Segment) + sizeof(Name))
+
 Segment *segment_construct(Block *block, Event *event) {
     return segment_construct3(cactusDisk_getUniqueID(flower_getCactusDisk(block_getFlower(
             block))), block, cap_construct5(event, block_get5End(block)),
@@ -40,15 +45,13 @@ Segment *segment_construct2(Block *block, int64_t startCoordinate, bool strand,
 
 Segment *segment_construct3(Name name, Block *block, Cap *_5Cap, Cap *_3Cap) {
     Segment *segment;
-    segment = st_malloc(sizeof(Segment));
-    segment->rInstance = st_malloc(sizeof(Segment));
-    segment->rInstance->rInstance = segment;
-    segment->name = name;
-    segment->rInstance->name = name;
+    Segment *segments = cactusArena_malloc(flower_getArena(block_getFlower(block)), SEGMENT_ALLOCATION_SIZE);
+    segment = block_getOrientation(block) ? segments : segments + 1;
+    *(Name *) (segments + 2) = name;
     segment->block = block;
-    segment->rInstance->block = block_getReverse(block);
+    segment_getReverse(segment)->block = block_getReverse(block);
     segment->_5Cap = _5Cap;
-    segment->rInstance->_5Cap = cap_getReverse(_3Cap);
+    segment_getReverse(segment)->_5Cap = cap_getReverse(_3Cap);
     cap_setSegment(_5Cap, segment);
     cap_setSegment(_3Cap, segment);
     block_addInstance(block, segment);
@@ -59,8 +62,8 @@ Segment *segment_construct3(Name name, Block *block, Cap *_5Cap, Cap *_3Cap) {
 void segment_destruct(Segment *segment) {
     block_removeInstance(segment_getBlock(segment), segment);
     flower_removeSegment(block_getFlower(segment_getBlock(segment)), segment);
-    free(segment->rInstance);
-    free(segment);
+    cactusArena_free(flower_getArena(block_getFlower(segment_getBlock(segment))), segment_getPositiveOrientation(segment),
+            SEGMENT_ALLOCATION_SIZE);
 }
 
 Block *segment_getBlock(Segment *segment) {
@@ -68,7 +71,7 @@ Block *segment_getBlock(Segment *segment) {
 }
 
 Name segment_getName(Segment *segment) {
-    return segment->name;
+    return *(Name *) (segment_getPositiveOrientation(segment) + 2);
 }
 
 bool segment_getOrientation(Segment *segment) {
@@ -81,7 +84,7 @@ Segment *segment_getPositiveOrientation(Segment *segment) {
 }
 
 Segment *segment_getReverse(Segment *segment) {
-    return segment->rInstance;
+    return segment_getOrientation(segment) ? segment + 1 : segment - 1;
 }
 
 Event *segment_getEvent(Segment *segment) {
@@ -117,7 +120,7 @@ Cap *segment_get5Cap(Segment *segment) {
 }
 
 Cap *segment_get3Cap(Segment *segment) {
-    return cap_getReverse(segment->rInstance->_5Cap);
+    return cap_getReverse(segment_getReverse(segment)->_5Cap);
 }
 
 Segment *segment_getParent(Segment *segment) {
@@ -275,3 +278,14 @@ Segment *segment_loadFromBinaryRepresentation(void **binaryString, Block *block)
     }
     return segment;
 }
+
+bool segment_skipBinaryRepresentation(void **binaryString) {
+    if (binaryRepresentation_peekNextElementType(*binaryString) != CODE_SEGMENT) {
+        return 0;
+    }
+    binaryRepresentation_popNextElementType(binaryString);
+    binaryRepresentation_getName(binaryString);
+    binaryRepresentation_getName(binaryString);
+    binaryRepresentation_getName(binaryString);
+    return 1;
+}
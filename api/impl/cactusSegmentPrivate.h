@@ -9,11 +9,14 @@
 
 #include "cactusGlobals.h"
 
+/*
+ * A segment is stored compactly, as only its block and 5 cap. The positive and negative orientations of a segment
+ * are allocated together, in that order, and followed by their name, so the reverse and name of a segment are found
+ * from its address.
+ */
 struct _segment {
-	Cap *_5Cap;
-	Segment *rInstance;
-	Name name;
 	Block *block;
+	Cap *_5Cap;
 };
 
 
@@ -46,4 +49,9 @@ void segment_writeBinaryRepresentation(Segment *segment, void (*writeFn)(const v
  */
 Segment *segment_loadFromBinaryRepresentation(void **binaryString, Block *block);
 
+/*
+ * Reads past the binary representation of a segment, without constructing it, returning non-zero if there was one.
+ */
+bool segment_skipBinaryRepresentation(void **binaryString);
+
 #endif
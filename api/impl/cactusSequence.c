@@ -93,3 +93,12 @@ Sequence *sequence_loadFromBinaryRepresentation(void **binaryString, Flower *flo
 	}
 	return sequence;
 }
+
+bool sequence_skipBinaryRepresentation(void **binaryString) {
+	if(binaryRepresentation_peekNextElementType(*binaryString) != CODE_SEQUENCE) {
+		return 0;
+	}
+	binaryRepresentation_popNextElementType(binaryString);
+	binaryRepresentation_getName(binaryString);
+	return 1;
+}
@@ -33,4 +33,9 @@ void sequence_writeBinaryRepresentation(Sequence *sequence, void (*writeFn)(cons
  */
 Sequence *sequence_loadFromBinaryRepresentation(void **binaryString, Flower *flower);
 
+/*
+ * Reads past the binary representation of a sequence, without constructing it, returning non-zero if there was one.
+ */
+bool sequence_skipBinaryRepresentation(void **binaryString);
+
 #endif
@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+struct _sequenceView {
+    char *string; //The forward strand bases, null terminated.
+    int64_t length;
+    bool strand;
+    int64_t capacity; //The size of the buffer holding the string.
+};
+
+SequenceView *sequenceView_construct(void) {
+    SequenceView *view = st_malloc(sizeof(SequenceView));
+    view->capacity = 64;
+    view->string = st_malloc(view->capacity);
+    view->string[0] = '\0';
+    view->length = 0;
+    view->strand = 1;
+    return view;
+}
+
+void sequenceView_destruct(SequenceView *view) {
+    free(view->string);
+    free(view);
+}
+
+void sequenceView_set(SequenceView *view, Sequence *sequence, int64_t start, int64_t length, bool strand) {
+    assert(length >= 0);
+    if (length + 1 > view->capacity) { //The buffer is only grown, by at least double, so is rarely reallocated.
+        view->capacity = length + 1 > 2 * view->capacity ? length + 1 : 2 * view->capacity;
+        free(view->string);
+        view->string = st_malloc(view->capacity);
+    }
+    metaSequence_getStringInBuffer(sequence_getMetaSequence(sequence), start, length, view->string);
+    view->length = length;
+    view->strand = strand;
+}
+
+bool sequenceView_setToSegment(SequenceView *view, Segment *segment) {
+    Sequence *sequence = segment_getSequence(segment);
+    if (sequence == NULL) {
+        view->string[0] = '\0';
+        view->length = 0;
+        view->strand = 1;
+        return 0;
+    }
+    sequenceView_set(view, sequence, segment_getStart(segment_getStrand(segment) ? segment : segment_getReverse(segment)),
+            segment_getLength(segment), segment_getStrand(segment));
+    return 1;
+}
+
+int64_t sequenceView_getLength(SequenceView *view) {
+    return view->length;
+}
+
+bool sequenceView_getStrand(SequenceView *view) {
+    return view->strand;
+}
+
+const char *sequenceView_getForwardString(SequenceView *view) {
+    return view->string;
+}
+
+char sequenceView_getBase(SequenceView *view, int64_t i) {
+    assert(i >= 0 && i < view->length);
+    return view->strand ? view->string[i] : stString_reverseComplementChar(view->string[view->length - 1 - i]);
+}
+
+void sequenceView_copyString(SequenceView *view, char *string) {
+    if (view->strand) {
+        memcpy(string, view->string, view->length);
+    } else {
+        for (int64_t i = 0; i < view->length; i++) {
+            string[i] = stString_reverseComplementChar(view->string[view->length - 1 - i]);
+        }
+    }
+}
@@ -14,21 +14,89 @@
 ////////////////////////////////////////////////
 ////////////////////////////////////////////////
 
+/*
+ * The format is thread local, so that records can be serialised and parsed concurrently.
+ */
+static __thread BinaryRepresentationFormat binaryRepresentation_format = { BINARY_REPRESENTATION_VERSION_1, 0 };
+
+BinaryRepresentationFormat binaryRepresentation_setFormat(int64_t version) {
+    assert(version == BINARY_REPRESENTATION_VERSION_1 || version == BINARY_REPRESENTATION_VERSION_2);
+    BinaryRepresentationFormat previousFormat = binaryRepresentation_format;
+    binaryRepresentation_format.version = version;
+    binaryRepresentation_format.previousName = 0;
+    return previousFormat;
+}
+
+void binaryRepresentation_restoreFormat(BinaryRepresentationFormat format) {
+    binaryRepresentation_format = format;
+}
+
+static void writeVarint(uint64_t i, void (*writeFn)(const void * ptr, size_t size, size_t count)) {
+    char cA[10];
+    int64_t j = 0;
+    while (i >= 0x80) {
+        cA[j++] = (char) ((i & 0x7F) | 0x80);
+        i >>= 7;
+    }
+    cA[j++] = (char) i;
+    writeFn(cA, sizeof(char), j);
+}
+
+static uint64_t getVarint(void **binaryString) {
+    unsigned char *cA = *binaryString;
+    uint64_t i = 0;
+    int64_t shift = 0;
+    while (*cA & 0x80) {
+        i |= ((uint64_t) (*cA++ & 0x7F)) << shift;
+        shift += 7;
+    }
+    i |= ((uint64_t) *cA++) << shift;
+    *binaryString = cA;
+    return i;
+}
+
+static uint64_t zigZagEncode(int64_t i) {
+    return (((uint64_t) i) << 1) ^ (uint64_t) (i >> 63);
+}
+
+static int64_t zigZagDecode(uint64_t i) {
+    return (int64_t) (i >> 1) ^ -((int64_t) (i & 1));
+}
+
 void binaryRepresentation_writeElementType(char elementCode, void (*writeFn)(const void * ptr, size_t size, size_t count)) {
 	writeFn(&elementCode, sizeof(char), 1);
 }
 
 void binaryRepresentation_writeString(const char *name, void (*writeFn)(const void * ptr, size_t size, size_t count)) {
 	int64_t i = strlen(name);
-	writeFn(&i, sizeof(int64_t), 1);
+	binaryRepresentation_writeInteger(i, writeFn);
 	writeFn(name, sizeof(char), i);
 }
 
 void binaryRepresentation_writeInteger(int64_t i, void (*writeFn)(const void * ptr, size_t size, size_t count)) {
+	if(binaryRepresentation_format.version == BINARY_REPRESENTATION_VERSION_2) {
+		writeVarint(zigZagEncode(i), writeFn);
+		return;
+	}
 	writeFn(&i, sizeof(int64_t), 1);
 }
 
 void binaryRepresentation_writeName(Name name, void (*writeFn)(const void * ptr, size_t size, size_t count)) {
+	if(binaryRepresentation_format.version == BINARY_REPRESENTATION_VERSION_2) {
+		/*
+		 * Zero is reserved for NULL_NAME, which does not move the delta, else we write the zig-zag
+		 * encoded difference from the previous name plus one.
+		 */
+		if(name == NULL_NAME) {
+			writeVarint(0, writeFn);
+			return;
+		}
+		uint64_t i = zigZagEncode((int64_t) ((uint64_t) name - (uint64_t) binaryRepresentation_format.previousName));
+		assert(i != UINT64_MAX);
+		writeVarint(i + 1, writeFn);
+		binaryRepresentation_format.previousName = name;
+		return;
+	}
 	binaryRepresentation_writeInteger(name, writeFn);
 }
 
@@ -72,13 +140,25 @@ const char *binaryRepresentation_getStringStatic(void **binaryString) {
 }
 
 int64_t binaryRepresentation_getInteger(void **binaryString) {
-	int64_t *i;
-	i = *binaryString;
-	*binaryString = i + 1;
-	return *i;
+	if(binaryRepresentation_format.version == BINARY_REPRESENTATION_VERSION_2) {
+		return zigZagDecode(getVarint(binaryString));
+	}
+	int64_t i;
+	memcpy(&i, *binaryString, sizeof(int64_t));
+	*binaryString = *((char **)binaryString) + sizeof(int64_t);
+	return i;
 }
 
 Name binaryRepresentation_getName(void **binaryString) {
+	if(binaryRepresentation_format.version == BINARY_REPRESENTATION_VERSION_2) {
+		uint64_t i = getVarint(binaryString);
+		if(i == 0) {
+			return NULL_NAME;
+		}
+		Name name = (Name) ((uint64_t) binaryRepresentation_format.previousName + (uint64_t) zigZagDecode(i - 1));
+		binaryRepresentation_format.previousName = name;
+		return name;
+	}
 	return binaryRepresentation_getInteger(binaryString);
 }
 
@@ -96,7 +176,11 @@ bool binaryRepresentation_getBool(void **binaryString) {
 	return *i;
 }
 
-int64_t binaryRepresentation_makeBinaryRepresentationP_i = 0;
+/*
+ * The state used by binaryRepresentation_makeBinaryRepresentation is thread local, so that
+ * several objects can be serialised concurrently (see cactusDisk_write).
+ */
+static __thread int64_t binaryRepresentation_makeBinaryRepresentationP_i = 0;
 void binaryRepresentation_makeBinaryRepresentationP(const void * ptr, size_t size, size_t count) {
 	/*
 	 * Records the cummulative size of the substrings written out in creating the flower.
@@ -105,7 +189,7 @@ void binaryRepresentation_makeBinaryRepresentationP(const void * ptr, size_t siz
 	binaryRepresentation_makeBinaryRepresentationP_i += size * count;
 }
 
-char *binaryRepresentation_makeBinaryRepresentationP2_vA = NULL;
+static __thread char *binaryRepresentation_makeBinaryRepresentationP2_vA = NULL;
 void binaryRepresentation_makeBinaryRepresentationP2(const void * ptr, size_t size, size_t count) {
 	/*
 	 * Cummulates all the binary data into one array
@@ -126,6 +210,27 @@ void *binaryRepresentation_makeBinaryRepresentation(void *object, void (*writeBi
 	return vA;
 }
 
+uint64_t binaryRepresentation_hash(const void *record, int64_t recordSize) {
+    const uint64_t multiplier = 0x9e3779b97f4a7c15ULL;
+    const char *cA = record;
+    uint64_t hash = recordSize * multiplier;
+    int64_t i = 0;
+    for (; i + (int64_t) sizeof(uint64_t) <= recordSize; i += sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, cA + i, sizeof(uint64_t));
+        hash = (hash ^ word) * multiplier;
+        hash ^= hash >> 29;
+    }
+    for (; i < recordSize; i++) {
+        hash = (hash ^ (unsigned char) cA[i]) * multiplier;
+    }
+    //Final avalanche
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
 void *binaryRepresentation_resizeObjectAsPowerOf2(void *vA, int64_t *recordSize) {
     if(*recordSize == 0) {
         *recordSize = 1;
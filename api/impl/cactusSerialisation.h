@@ -46,6 +46,34 @@
 #define CODE_PSEUDO_CHROMOSOME 23
 #define CODE_PSEUDO_ADJACENCY 24
 #define CODE_CACTUS_DISK 25
+#define CODE_FLOWER_V2 26
+
+/*
+ * Versions of the binary format. In version 1 integers and names are written as fixed
+ * 8 byte values and strings are prefixed with an 8 byte length. In version 2 integers and string lengths are
+ * written as zig-zag encoded varints and each name is written as a varint of its difference
+ * from the previous name written, so that runs of nearby names take one or two bytes each.
+ * Element codes, floats and bools are the same in both.
+ */
+#define BINARY_REPRESENTATION_VERSION_1 1
+#define BINARY_REPRESENTATION_VERSION_2 2
+
+typedef struct _binaryRepresentationFormat {
+    int64_t version;
+    Name previousName;
+} BinaryRepresentationFormat;
+
+/*
+ * Sets the format used by the write and get functions in the calling thread, resetting the
+ * name delta, and returns the previous format, which should be restored with binaryRepresentation_restoreFormat
+ * once the record has been written or read. The default is version 1.
+ */
+BinaryRepresentationFormat binaryRepresentation_setFormat(int64_t version);
+
+/*
+ * Restores a format returned by binaryRepresentation_setFormat.
+ */
+void binaryRepresentation_restoreFormat(BinaryRepresentationFormat format);
 
 /*
  * Writes a code for the element type.
@@ -124,6 +152,12 @@ bool binaryRepresentation_getBool(void **binaryString);
  */
 void *binaryRepresentation_makeBinaryRepresentation(void *object, void (*writeBinaryRepresentation)(void *, void (*writeFn)(const void * ptr, size_t size, size_t count)), int64_t *recordSize);
 
+/*
+ * Returns a 64 bit hash of a binary representation, used to detect if a
+ * serialised object has changed without keeping or fetching the old one.
+ */
+uint64_t binaryRepresentation_hash(const void *record, int64_t recordSize);
+
 /*
  * Resizes a record as a power of 2.
  */
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+// For mmap and fstat (POSIX extensions).
+#define _POSIX_C_SOURCE 200809L
+
+#include "cactusGlobalsPrivate.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The file is laid out as:
+ *
+ * magic (8 bytes), the records (each padded to a multiple of 8 bytes),
+ * the index (an entry for each record, sorted by key),
+ * the footer (the number of entries, the offset of the index, the generation, then the magic again).
+ */
+static const char snapshotMagic[8] = { 'C', 'A', 'C', 'T', 'S', 'N', 'P', '2' };
+
+typedef struct _snapshotEntry {
+    int64_t key;
+    int64_t offset;
+    int64_t size;
+} SnapshotEntry;
+
+typedef struct _snapshotFooter {
+    int64_t entryNumber;
+    int64_t indexOffset;
+    int64_t generation;
+    char magic[8];
+} SnapshotFooter;
+
+struct _cactusSnapshot {
+    char *snapshotFile;
+    char *map;
+    int64_t mapSize;
+    const SnapshotEntry *entries;
+    int64_t entryNumber;
+    int64_t generation;
+};
+
+struct _cactusSnapshotWriter {
+    char *snapshotFile;
+    char *tempFile;
+    FILE *fileHandle;
+    int64_t offset;
+    SnapshotEntry *entries;
+    int64_t entryNumber;
+    int64_t maxEntryNumber;
+    int64_t generation;
+};
+
+/*
+ * Reading.
+ */
+
+static bool entriesAreValid(const SnapshotEntry *entries, int64_t entryNumber, int64_t indexOffset) {
+    /*
+     * Checks each record lies, aligned, between the magic and the index, and the keys are strictly increasing,
+     * so the records can be read and searched without reading outside the mapping.
+     */
+    for (int64_t i = 0; i < entryNumber; i++) {
+        const SnapshotEntry *entry = entries + i;
+        if (entry->offset < (int64_t) sizeof(snapshotMagic) || entry->offset % sizeof(int64_t) != 0
+                || entry->offset > indexOffset || entry->size < 0 || entry->size > indexOffset - entry->offset
+                || (i > 0 && entries[i - 1].key >= entry->key)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+CactusSnapshot *cactusSnapshot_construct(const char *snapshotFile) {
+    int fd = open(snapshotFile, O_RDONLY);
+    if (fd == -1) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to open the snapshot %s: %s", snapshotFile, strerror(errno));
+    }
+    struct stat fileStat;
+    if (fstat(fd, &fileStat) != 0) {
+        close(fd);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to stat the snapshot %s", snapshotFile);
+    }
+    int64_t mapSize = fileStat.st_size;
+    if (mapSize < (int64_t) (sizeof(snapshotMagic) + sizeof(SnapshotFooter))) {
+        close(fd);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The file %s is not a snapshot", snapshotFile);
+    }
+    char *map = mmap(NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); //The mapping keeps the file open.
+    if (map == MAP_FAILED) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to memory map the snapshot %s", snapshotFile);
+    }
+    SnapshotFooter footer;
+    memcpy(&footer, map + mapSize - sizeof(SnapshotFooter), sizeof(SnapshotFooter));
+    if (memcmp(map, snapshotMagic, sizeof(snapshotMagic)) != 0
+            || memcmp(footer.magic, snapshotMagic, sizeof(snapshotMagic)) != 0 || footer.entryNumber < 0
+            || footer.entryNumber > mapSize / (int64_t) sizeof(SnapshotEntry)
+            || footer.indexOffset < (int64_t) sizeof(snapshotMagic) || footer.indexOffset > mapSize
+            || footer.indexOffset % sizeof(int64_t) != 0
+            || footer.indexOffset + footer.entryNumber * (int64_t) sizeof(SnapshotEntry) + (int64_t) sizeof(SnapshotFooter) != mapSize
+            || !entriesAreValid((const SnapshotEntry *) (map + footer.indexOffset), footer.entryNumber, footer.indexOffset)) {
+        munmap(map, mapSize);
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The file %s is not a snapshot, or is corrupt", snapshotFile);
+    }
+    CactusSnapshot *snapshot = st_malloc(sizeof(CactusSnapshot));
+    snapshot->snapshotFile = stString_copy(snapshotFile);
+    snapshot->map = map;
+    snapshot->mapSize = mapSize;
+    snapshot->entries = (const SnapshotEntry *) (map + footer.indexOffset);
+    snapshot->entryNumber = footer.entryNumber;
+    snapshot->generation = footer.generation;
+    st_logDebug("Opened the snapshot %s, containing %" PRIi64 " records\n", snapshotFile, snapshot->entryNumber);
+    return snapshot;
+}
+
+void cactusSnapshot_destruct(CactusSnapshot *snapshot) {
+    munmap(snapshot->map, snapshot->mapSize);
+    free(snapshot->snapshotFile);
+    free(snapshot);
+}
+
+static const SnapshotEntry *getEntry(CactusSnapshot *snapshot, int64_t key) {
+    /*
+     * Binary search of the index.
+     */
+    int64_t i = 0, j = snapshot->entryNumber;
+    while (i < j) {
+        int64_t k = (i + j) / 2;
+        if (snapshot->entries[k].key < key) {
+            i = k + 1;
+        } else {
+            j = k;
+        }
+    }
+    return i < snapshot->entryNumber && snapshot->entries[i].key == key ? snapshot->entries + i : NULL;
+}
+
+const void *cactusSnapshot_getRecord(CactusSnapshot *snapshot, int64_t key, int64_t *recordSize) {
+    const SnapshotEntry *entry = getEntry(snapshot, key);
+    if (entry == NULL) {
+        return NULL;
+    }
+    *recordSize = entry->size;
+    return snapshot->map + entry->offset;
+}
+
+const void *cactusSnapshot_getRecordByIndex(CactusSnapshot *snapshot, int64_t index, int64_t *key, int64_t *recordSize) {
+    assert(index >= 0 && index < snapshot->entryNumber);
+    const SnapshotEntry *entry = snapshot->entries + index;
+    *key = entry->key;
+    *recordSize = entry->size;
+    return snapshot->map + entry->offset;
+}
+
+bool cactusSnapshot_containsRecord(CactusSnapshot *snapshot, int64_t key) {
+    return getEntry(snapshot, key) != NULL;
+}
+
+int64_t cactusSnapshot_getRecordNumber(CactusSnapshot *snapshot) {
+    return snapshot->entryNumber;
+}
+
+int64_t cactusSnapshot_getGeneration(CactusSnapshot *snapshot) {
+    return snapshot->generation;
+}
+
+/*
+ * Writing.
+ */
+
+static void writeBytes(CactusSnapshotWriter *writer, const void *bytes, int64_t size) {
+    if (size > 0 && fwrite(bytes, 1, size, writer->fileHandle) != (size_t) size) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to write to the snapshot %s", writer->tempFile);
+    }
+    writer->offset += size;
+}
+
+CactusSnapshotWriter *cactusSnapshotWriter_construct(const char *snapshotFile, int64_t generation) {
+    CactusSnapshotWriter *writer = st_calloc(1, sizeof(CactusSnapshotWriter));
+    writer->snapshotFile = stString_copy(snapshotFile);
+    writer->generation = generation;
+    writer->tempFile = stString_print("%s.tmp%i", snapshotFile, (int) getpid());
+    writer->fileHandle = fopen(writer->tempFile, "wb");
+    if (writer->fileHandle == NULL) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to create the snapshot %s: %s", writer->tempFile, strerror(errno));
+    }
+    writer->maxEntryNumber = 1024;
+    writer->entries = st_malloc(writer->maxEntryNumber * sizeof(SnapshotEntry));
+    writeBytes(writer, snapshotMagic, sizeof(snapshotMagic));
+    return writer;
+}
+
+void cactusSnapshotWriter_add(CactusSnapshotWriter *writer, int64_t key, const void *record, int64_t recordSize) {
+    static const char padding[sizeof(int64_t)] = { 0 };
+    if (writer->entryNumber == writer->maxEntryNumber) {
+        writer->maxEntryNumber *= 2;
+        writer->entries = st_realloc(writer->entries, writer->maxEntryNumber * sizeof(SnapshotEntry));
+    }
+    SnapshotEntry *entry = writer->entries + writer->entryNumber++;
+    entry->key = key;
+    entry->offset = writer->offset;
+    entry->size = recordSize;
+    writeBytes(writer, record, recordSize);
+    writeBytes(writer, padding, (sizeof(int64_t) - writer->offset % sizeof(int64_t)) % sizeof(int64_t));
+}
+
+static int snapshotEntry_cmp(const void *o1, const void *o2) {
+    int64_t key1 = ((const SnapshotEntry *) o1)->key, key2 = ((const SnapshotEntry *) o2)->key;
+    return key1 < key2 ? -1 : key1 > key2 ? 1 : 0;
+}
+
+void cactusSnapshotWriter_finish(CactusSnapshotWriter *writer) {
+    qsort(writer->entries, writer->entryNumber, sizeof(SnapshotEntry), snapshotEntry_cmp);
+    for (int64_t i = 1; i < writer->entryNumber; i++) {
+        if (writer->entries[i - 1].key == writer->entries[i].key) {
+            stThrowNew(CACTUS_DISK_EXCEPTION_ID, "The record %" PRIi64 " was written twice to the snapshot %s",
+                    writer->entries[i].key, writer->snapshotFile);
+        }
+    }
+    SnapshotFooter footer;
+    footer.entryNumber = writer->entryNumber;
+    footer.indexOffset = writer->offset;
+    footer.generation = writer->generation;
+    memcpy(footer.magic, snapshotMagic, sizeof(snapshotMagic));
+    writeBytes(writer, writer->entries, writer->entryNumber * sizeof(SnapshotEntry));
+    writeBytes(writer, &footer, sizeof(SnapshotFooter));
+    if (fclose(writer->fileHandle) != 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to close the snapshot %s", writer->tempFile);
+    }
+    if (rename(writer->tempFile, writer->snapshotFile) != 0) {
+        stThrowNew(CACTUS_DISK_EXCEPTION_ID, "Failed to move the snapshot %s to %s: %s", writer->tempFile,
+                writer->snapshotFile, strerror(errno));
+    }
+    st_logDebug("Wrote the snapshot %s, containing %" PRIi64 " records\n", writer->snapshotFile, writer->entryNumber);
+    free(writer->snapshotFile);
+    free(writer->tempFile);
+    free(writer->entries);
+    free(writer);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_SNAPSHOT_H_
+#define CACTUS_SNAPSHOT_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Snapshots.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * A snapshot is an immutable file of records keyed by int64s, with a sorted index at its end. It is
+ * memory mapped shared and read only, so the workers on a node that read the same snapshot share one copy
+ * of it in the page cache, and records are read in place, without being copied.
+ *
+ * Each record starts on an 8 byte boundary of the file, so records holding int64s can be used in place.
+ */
+typedef struct _cactusSnapshot CactusSnapshot;
+
+typedef struct _cactusSnapshotWriter CactusSnapshotWriter;
+
+/*
+ * Opens and memory maps the snapshot file. Throws an exception if the file is not a snapshot, or its index
+ * refers to records outside the file.
+ */
+CactusSnapshot *cactusSnapshot_construct(const char *snapshotFile);
+
+/*
+ * Unmaps and closes the snapshot. Any record returned by cactusSnapshot_getRecord is invalid after this.
+ */
+void cactusSnapshot_destruct(CactusSnapshot *snapshot);
+
+/*
+ * Gets the record with the given key, placing its size in recordSize, or returns NULL if the snapshot does
+ * not contain it. The record points into the mapping of the snapshot and must not be freed or modified.
+ */
+const void *cactusSnapshot_getRecord(CactusSnapshot *snapshot, int64_t key, int64_t *recordSize);
+
+/*
+ * Returns non-zero if the snapshot contains a record with the given key.
+ */
+bool cactusSnapshot_containsRecord(CactusSnapshot *snapshot, int64_t key);
+
+/*
+ * Gets the number of records in the snapshot.
+ */
+int64_t cactusSnapshot_getRecordNumber(CactusSnapshot *snapshot);
+
+/*
+ * Gets the generation the snapshot was written with.
+ */
+int64_t cactusSnapshot_getGeneration(CactusSnapshot *snapshot);
+
+/*
+ * Gets the record at the given index, from 0 to the number of records, placing its key in key and its size in
+ * recordSize. The records are indexed in order of their keys. As with cactusSnapshot_getRecord the record points
+ * into the mapping of the snapshot.
+ */
+const void *cactusSnapshot_getRecordByIndex(CactusSnapshot *snapshot, int64_t index, int64_t *key, int64_t *recordSize);
+
+/*
+ * Starts writing a snapshot to the given file, stamped with the given generation of the records it holds.
+ * The snapshot is written to a temporary file that replaces the given file when it is finished, so readers
+ * never see a partial snapshot.
+ */
+CactusSnapshotWriter *cactusSnapshotWriter_construct(const char *snapshotFile, int64_t generation);
+
+/*
+ * Writes a copy of the record to the snapshot.
+ */
+void cactusSnapshotWriter_add(CactusSnapshotWriter *writer, int64_t key, const void *record, int64_t recordSize);
+
+/*
+ * Writes the index of the snapshot, closes the file and destructs the writer. Throws an exception if
+ * two records were written with the same key.
+ */
+void cactusSnapshotWriter_finish(CactusSnapshotWriter *writer);
+
+#endif
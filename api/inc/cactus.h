@@ -19,12 +19,16 @@
 #include "cactusLink.h"
 #include "cactusMetaSequence.h"
 #include "cactusFlower.h"
+#include "cactusCodec.h"
+#include "cactusArchive.h"
+#include "cactusSecondaryDatabase.h"
 #include "cactusDisk.h"
 #include "cactusMisc.h"
 #include "cactusFace.h"
 #include "cactusFaceEnd.h"
 #include "cactusFacesBuilding.h"
 #include "cactusSequence.h"
+#include "cactusSequenceView.h"
 #include "cactusTestCommon.h"
 #include "cactusFlowerWriter.h"
 
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_ARCHIVE_H_
+#define CACTUS_ARCHIVE_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Archives.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * An archive is a single file holding the records of a cactus database, for checkpointing it and for
+ * restoring it into a database of any type. The records are sorted by key and stored in compressed blocks
+ * (with zstd if cactus was built with it, else zlib), with an index of the blocks at the end of the file, so a
+ * record can be found by reading one block, and the blocks can be restored in parallel.
+ *
+ * Besides records, an archive holds int64 counters (the unique id buckets of a cactus disk), which are restored
+ * with the insertInt64 function of the database, so they can be incremented by a database of any type.
+ *
+ * Archives are written by cactusDisk_exportArchive.
+ */
+typedef struct _cactusArchive CactusArchive;
+typedef struct _cactusArchiveWriter CactusArchiveWriter;
+
+/*
+ * Opens the archive and reads its index. Throws an exception if the file is not an archive.
+ */
+CactusArchive *cactusArchive_construct(const char *archiveFile);
+
+/*
+ * Closes the archive.
+ */
+void cactusArchive_destruct(CactusArchive *archive);
+
+/*
+ * Gets the number of records and counters in the archive.
+ */
+int64_t cactusArchive_getRecordNumber(CactusArchive *archive);
+
+/*
+ * Gets the number of blocks in the archive.
+ */
+int64_t cactusArchive_getBlockNumber(CactusArchive *archive);
+
+/*
+ * Gets a copy of the record with the given key, placing its size in recordSize, or returns NULL if the archive
+ * does not contain it. The record of a counter is its int64 value.
+ */
+void *cactusArchive_getRecord(CactusArchive *archive, int64_t key, int64_t *recordSize);
+
+/*
+ * Inserts the records and counters of the archive into the database described by the database conf string, which
+ * is created if create is non-zero, returning the number inserted. The blocks are decompressed by the given number
+ * of threads, which insert them in bulk requests, one at a time, over a single connection to the database.
+ */
+int64_t cactusArchive_import(CactusArchive *archive, const char *databaseString, bool create, int64_t threadNumber);
+
+/*
+ * Starts writing an archive to the given file. The records are first written to a temporary file next to it,
+ * and sorted into compressed blocks by cactusArchiveWriter_finish, using the given number of threads to compress
+ * them. The archive replaces the given file when it is finished, so readers never see a partial archive.
+ */
+CactusArchiveWriter *cactusArchiveWriter_construct(const char *archiveFile, int64_t threadNumber);
+
+/*
+ * Writes a copy of the record to the archive.
+ */
+void cactusArchiveWriter_add(CactusArchiveWriter *writer, int64_t key, const void *record, int64_t recordSize);
+
+/*
+ * Writes a counter to the archive.
+ */
+void cactusArchiveWriter_addInt64(CactusArchiveWriter *writer, int64_t key, int64_t value);
+
+/*
+ * Writes the blocks and the index of the archive, closes the file and destructs the writer. Throws an exception
+ * if two records (or counters) were written with the same key.
+ */
+void cactusArchiveWriter_finish(CactusArchiveWriter *writer);
+
+#endif
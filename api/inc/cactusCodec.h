@@ -0,0 +1,129 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_CODEC_H_
+#define CACTUS_CODEC_H_
+
+#include "cactusGlobals.h"
+
+// Codec exception id
+extern const char *CACTUS_CODEC_EXCEPTION_ID;
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Record codecs.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * The compression codecs that may be used for records. LZ4 and zstd are only
+ * available if cactus was built with HAVE_LZ4 / HAVE_ZSTD (see include.mk).
+ */
+typedef enum {
+    CACTUS_CODEC_NONE = 0,
+    CACTUS_CODEC_ZLIB = 1,
+    CACTUS_CODEC_LZ4 = 2,
+    CACTUS_CODEC_ZSTD = 3
+} CactusCodecType;
+
+/*
+ * The classes of record stored by cactus, for each of which a codec can be chosen.
+ */
+typedef enum {
+    CACTUS_RECORD_FLOWER = 0,
+    CACTUS_RECORD_META_SEQUENCE = 1,
+    CACTUS_RECORD_SEQUENCE_CHUNK = 2,
+    CACTUS_RECORD_THREAD_STRING = 3
+} CactusRecordClass;
+
+#define CACTUS_RECORD_CLASS_NUMBER 4
+
+/*
+ * A codec compresses records with a given codec type and level. Compressed records are
+ * tagged with the codec that wrote them, so any codec can decompress a record written by any other.
+ *
+ * Records written before codecs were tagged are read as the codec's "untagged type" (zlib
+ * for flowers, meta sequences and thread strings, none for sequence chunks), and a codec
+ * whose type is its untagged type writes untagged records, so by default records are
+ * the same as those written by older versions of cactus.
+ */
+typedef struct _cactusCodec CactusCodec;
+
+/*
+ * Constructs a codec. The level is interpreted by the codec type: it is the compression level for zlib
+ * (-1 is the default) and zstd, the acceleration for LZ4 and ignored for none. Throws an
+ * exception if the codec type is not available.
+ */
+CactusCodec *cactusCodec_construct(CactusCodecType type, int64_t level, CactusCodecType untaggedType);
+
+/*
+ * Destructs the codec.
+ */
+void cactusCodec_destruct(CactusCodec *codec);
+
+/*
+ * Gets the type of the codec.
+ */
+CactusCodecType cactusCodec_getType(CactusCodec *codec);
+
+/*
+ * Gets the level of the codec.
+ */
+int64_t cactusCodec_getLevel(CactusCodec *codec);
+
+/*
+ * Returns non-zero if the codec type was compiled in.
+ */
+bool cactusCodec_isAvailable(CactusCodecType type);
+
+/*
+ * Parses a codec type from its name: "none", "zlib", "lz4" or "zstd". Throws an exception if the name is not recognised.
+ */
+CactusCodecType cactusCodec_getTypeFromString(const char *string);
+
+/*
+ * Gets the name of the codec type.
+ */
+const char *cactusCodec_getTypeString(CactusCodecType type);
+
+/*
+ * Compresses the data, returning a newly allocated record whose size is placed in compressedSize.
+ */
+void *cactusCodec_compress(CactusCodec *codec, const void *data, int64_t dataSize, int64_t *compressedSize);
+
+/*
+ * Decompresses a record written by cactusCodec_compress, with any codec, returning the newly allocated data,
+ * whose size is placed in uncompressedSize. Throws an exception if the record needs a dictionary the codec does not have,
+ * or a codec that is not available.
+ */
+void *cactusCodec_decompress(CactusCodec *codec, const void *record, int64_t recordSize, int64_t *uncompressedSize);
+
+/*
+ * Trains a zstd dictionary from sample records, returning it and placing its size in dictionarySize,
+ * or returns NULL if zstd is not available or there are too few samples to train on.
+ */
+void *cactusCodec_trainDictionary(stList *samples, stList *sampleSizes, int64_t maxDictionarySize,
+        int64_t *dictionarySize);
+
+/*
+ * Sets the dictionary used by the codec. Only zstd uses the dictionary to compress, but a codec
+ * of any type needs it to decompress zstd records written with it.
+ */
+void cactusCodec_setDictionary(CactusCodec *codec, const void *dictionary, int64_t dictionarySize);
+
+/*
+ * Returns the id of the codec's dictionary, or 0 if it has none.
+ */
+int64_t cactusCodec_getDictionaryID(CactusCodec *codec);
+
+/*
+ * Returns the id of the dictionary needed to decompress the record, or 0 if it needs none.
+ */
+int64_t cactusCodec_getRecordDictionaryID(const void *record, int64_t recordSize);
+
+#endif
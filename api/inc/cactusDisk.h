@@ -8,6 +8,7 @@
 #define CACTUS_DISK_H_
 
 #include "cactusGlobals.h"
+#include "cactusCodec.h"
 
 // General database exception id
 extern const char *CACTUS_DISK_EXCEPTION_ID;
@@ -30,6 +31,15 @@ extern const char *CACTUS_DISK_EXCEPTION_ID;
  */
 CactusDisk *cactusDisk_construct(stKVDatabaseConf *conf, bool create, bool cache);
 
+/*
+ * As cactusDisk_construct, but takes the database conf string. As well as the
+ * database types understood by stKVDatabaseConf_constructFromString this accepts
+ * the embedded local database, for single node runs without a ktserver:
+ *
+ * <st_kv_database_conf type="local"><local database_dir="path"/></st_kv_database_conf>
+ */
+CactusDisk *cactusDisk_constructFromString(const char *databaseString, bool create, bool cache);
+
 /*
  * Destructs the cactus disk and all open flowers and sequences, and
  * then disconnects from the cactus DB.
@@ -43,6 +53,9 @@ int64_t cactusDisk_getUniqueID(CactusDisk *cactusDisk);
 
 /*
  * Retrieves a contiguous interval of unique ids starting from the return value to return value + intervalSize (exclusive).
+ *
+ * Ids are leased from the database in intervals that grow as more are used, and the next lease is fetched
+ * by a background thread before the current one runs out.
  */
 int64_t cactusDisk_getUniqueIDInterval(CactusDisk *cactusDisk, int64_t intervalSize);
 
@@ -52,6 +65,84 @@ int64_t cactusDisk_getUniqueIDInterval(CactusDisk *cactusDisk, int64_t intervalS
  */
 void cactusDisk_write(CactusDisk *cactusDisk);
 
+/*
+ * Sets the number of threads cactusDisk_write uses to serialise and compress flowers and
+ * meta sequences. The records are still written in one bulk request, in the same order
+ * whatever the number of threads. The default is 1.
+ */
+void cactusDisk_setWriteThreads(CactusDisk *cactusDisk, int64_t writeThreads);
+
+/*
+ * Sets the number of threads cactusDisk_getFlowers uses to decompress the flower records it
+ * fetches. The flowers are still loaded one after another, in the order requested. The default is 1.
+ */
+void cactusDisk_setReadThreads(CactusDisk *cactusDisk, int64_t readThreads);
+
+/*
+ * Puts the cactus disk in (or takes it out of) thread-safe mode. In thread-safe mode several threads
+ * may each get, process and destruct their own flowers, and read sequences, using the one disk and its caches:
+ * the functions that get flowers and meta sequences, read strings and allocate unique ids
+ * are serialised by a lock. The threads must work on disjoint sets of flowers,
+ * must not change the event tree, and cactusDisk_write must only be called when one thread uses the disk.
+ * The default is off, in which case no locking is done.
+ */
+void cactusDisk_setThreadSafe(CactusDisk *cactusDisk, bool threadSafe);
+
+/*
+ * Returns non-zero if the cactus disk is in thread-safe mode.
+ */
+bool cactusDisk_isThreadSafe(CactusDisk *cactusDisk);
+
+/*
+ * Sets whether flowers are loaded lazily. A lazily loaded flower has its sequences, ends, blocks, groups and chains
+ * loaded at once, but its caps, segments and faces only when they are first accessed, or when the flower
+ * is changed in a way that needs them, which saves time and memory when only the groups and ends of flowers are
+ * walked. In thread-safe mode a flower is loaded by the thread accessing it, so, as ever, the threads must work
+ * on disjoint sets of flowers. The default is off. It may also be set by the lazy_flowers attribute of the
+ * database conf string passed to cactusDisk_constructFromString, e.g. lazy_flowers="1".
+ */
+void cactusDisk_setLazyFlowers(CactusDisk *cactusDisk, bool lazyFlowers);
+
+/*
+ * Returns non-zero if flowers are loaded lazily.
+ */
+bool cactusDisk_getLazyFlowers(CactusDisk *cactusDisk);
+
+/*
+ * Sets the codec, and its level (see cactusCodec_construct), used to write the given class of records.
+ * Records are read whatever codec wrote them. The defaults are zlib for flowers and meta sequences,
+ * zlib level 1 for thread strings and none for sequence chunks.
+ */
+void cactusDisk_setRecordCodec(CactusDisk *cactusDisk, CactusRecordClass recordClass, CactusCodecType codecType,
+        int64_t level);
+
+/*
+ * Sets the record codecs from a white space separated list of class=codec[:level] settings, where the
+ * classes are flower, metaSequence, sequenceChunk and threadString, and the codecs are none, zlib, lz4 and zstd,
+ * e.g. "flower=zstd:3 sequenceChunk=lz4". A "flowerDictionary" entry calls cactusDisk_setTrainFlowerDictionary.
+ * This string may also be given as the record_codecs attribute of the database conf string passed to
+ * cactusDisk_constructFromString, so that every process writing to the database uses it.
+ */
+void cactusDisk_setRecordCodecs(CactusDisk *cactusDisk, const char *codecsString);
+
+/*
+ * If non-zero and flowers are written with zstd, cactusDisk_write trains a zstd dictionary on the first
+ * large batch of flowers it writes and stores it in the database, where it is used by all later writers and readers.
+ */
+void cactusDisk_setTrainFlowerDictionary(CactusDisk *cactusDisk, bool trainFlowerDictionary);
+
+/*
+ * Compresses a record with the codec for its class, returning the newly allocated record.
+ */
+void *cactusDisk_compressRecord(CactusDisk *cactusDisk, CactusRecordClass recordClass, const void *record,
+        int64_t recordSize, int64_t *compressedSize);
+
+/*
+ * Decompresses a record written by cactusDisk_compressRecord, returning the newly allocated record.
+ */
+void *cactusDisk_decompressRecord(CactusDisk *cactusDisk, CactusRecordClass recordClass, const void *record,
+        int64_t recordSize, int64_t *uncompressedSize);
+
 /*
  * This is used to serialise a flower before a call to a cactusDisk_write, it is exposed for use in the cactus_caf code.
  */
@@ -91,6 +182,73 @@ void cactusDisk_preCacheSegmentStrings(CactusDisk *cactusDisk, stList *flowers);
  */
 void cactusDisk_clearStringCache(CactusDisk *cactusDisk);
 
+/*
+ * Sets the budgets, in bytes, of the cache of records read from the database (if the disk was constructed
+ * with one) and of the cache of sequences. When a cache is over budget the least recently used entries are evicted.
+ * The defaults are 10MB each.
+ *
+ * The budgets may also be given as the record_cache_size and string_cache_size attributes of the
+ * database conf string passed to cactusDisk_constructFromString (and so to the --cactusDisk option of the
+ * cactus binaries), as a number of bytes optionally followed by K, M or G, e.g. record_cache_size="64M".
+ */
+void cactusDisk_setCacheSizes(CactusDisk *cactusDisk, int64_t recordCacheSize, int64_t stringCacheSize);
+
+/*
+ * Prints the size, hits, misses and evictions of each cache.
+ */
+void cactusDisk_printCacheStats(CactusDisk *cactusDisk, FILE *fileHandle);
+
+/*
+ * Prints the statistics of the disk as a JSON object. Its "operations" object has, for each operation called
+ * (the public operations such as getFlowers, getString and write, each kind of request to the database, and the
+ * compression and decompression of records), the number of calls, the records and bytes moved (compressed and raw),
+ * the total time and a histogram of the latencies, in microseconds. Its "caches" object has the size, hits, misses,
+ * evictions and hit rate of each cache.
+ */
+void cactusDisk_printStats(CactusDisk *cactusDisk, FILE *fileHandle);
+
+/*
+ * Sets a file to which the statistics, as printed by cactusDisk_printStats, are appended as one line when the disk is
+ * destructed, or unsets it if statsFile is NULL. It may also be given as the stats_file attribute of the database conf
+ * string passed to cactusDisk_constructFromString, e.g. stats_file="/tmp/cactusDiskStats.jsonl".
+ */
+void cactusDisk_setStatsFile(CactusDisk *cactusDisk, const char *statsFile);
+
+/*
+ * Writes a snapshot of the records of the given flowers, the flowers nested in them, and their meta sequences and strings
+ * (and the disk's parameters) to the given file. The records are copied as stored in the database, so changes not yet written
+ * by cactusDisk_write are not included.
+ */
+void cactusDisk_exportSnapshot(CactusDisk *cactusDisk, stList *flowerNames, const char *snapshotFile);
+
+/*
+ * Opens a snapshot written by cactusDisk_exportSnapshot, replacing any snapshot already open. The snapshot is memory mapped
+ * shared and read only, so the workers on a node reading the same snapshot share one copy of it.
+ *
+ * Records are then read from the snapshot, in place where possible, in preference to the database. Records not in the
+ * snapshot are read from the database. Writes go to the database as usual, and a record written by this disk once the
+ * snapshot is open is read from the database from then on, so the disk sees its own writes.
+ *
+ * The snapshot is stamped with the generation of the database, which cactusDisk_write advances whenever it updates or
+ * removes records. An exception is thrown if the generation has advanced since the snapshot was exported, as the snapshot
+ * may then hold stale records.
+ *
+ * A snapshot may also be given as the snapshot attribute of the database conf string passed to
+ * cactusDisk_constructFromString, e.g. snapshot="/tmp/cactus.snapshot".
+ */
+void cactusDisk_openSnapshot(CactusDisk *cactusDisk, const char *snapshotFile);
+
+/*
+ * Writes an archive (see cactusArchive.h) of the database to the given file: the records of the root flower, the
+ * flowers nested in it, and their meta sequences and strings, the disk's parameters and the unique id buckets. As
+ * with snapshots, changes not yet written by cactusDisk_write are not included. The blocks of the archive are
+ * compressed by the given number of threads.
+ *
+ * The archive is restored into a new database with cactusArchive_import.
+ */
+void cactusDisk_exportArchive(CactusDisk *cactusDisk, Name rootFlowerName, const char *archiveFile,
+        int64_t threadNumber);
+
 /*
  * Clears all cached DB responses (but not cached sequences).
  */
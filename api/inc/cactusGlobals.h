@@ -46,6 +46,7 @@ typedef struct _faceEnd FaceEnd;
 typedef struct _flower Flower;
 typedef struct _cactusDisk CactusDisk;
 typedef struct _flowerWriter FlowerWriter;
+typedef struct _sequenceView SequenceView;
 
 typedef stSortedSetIterator EventTree_Iterator;
 typedef struct _end_instanceIterator End_InstanceIterator;
@@ -59,6 +59,11 @@ const char *cactusMisc_getDefaultReferenceEventHeader();
  */
 void preCacheNestedFlowers(CactusDisk *cactusDisk, stList *flowers);
 
+/*
+ * A thread pool finisher that does nothing, for pools whose workers leave their results in the items pushed.
+ */
+void cactusMisc_threadPoolNoFinish(void *item);
+
 /*
  * Check a condition is true, if not throw an exception - a short hand to defining your own exception.
  */
@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_SECONDARY_DATABASE_H_
+#define CACTUS_SECONDARY_DATABASE_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Secondary databases.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * A secondary database is the scratch key/value store that buildRecursiveThreads writes the reference threads
+ * to and cactus_halGenerator reads them from. It is either an stKVDatabase or, for a conf string of type="local",
+ * the embedded local database used by the cactus disk, so single node runs need no ktserver for either.
+ *
+ * Errors are reported by throwing ST_KV_DATABASE_EXCEPTION_ID exceptions.
+ */
+typedef struct _cactusSecondaryDatabase CactusSecondaryDatabase;
+
+/*
+ * Opens the database described by the conf string, creating it if create is non-zero.
+ */
+CactusSecondaryDatabase *cactusSecondaryDatabase_constructFromString(const char *confString, bool create);
+
+/*
+ * Opens the stKVDatabase described by the conf, creating it if create is non-zero.
+ */
+CactusSecondaryDatabase *cactusSecondaryDatabase_construct(stKVDatabaseConf *conf, bool create);
+
+/*
+ * Closes the database.
+ */
+void cactusSecondaryDatabase_destruct(CactusSecondaryDatabase *database);
+
+/*
+ * Closes the database and removes it from disk.
+ */
+void cactusSecondaryDatabase_deleteFromDisk(CactusSecondaryDatabase *database);
+
+/*
+ * Gets the records for a list of int64_t keys, returning a list of stKVDatabaseBulkResults in the same order.
+ */
+stList *cactusSecondaryDatabase_bulkGetRecords(CactusSecondaryDatabase *database, stList *keys);
+
+/*
+ * Applies a list of stKVDatabaseBulkRequests.
+ */
+void cactusSecondaryDatabase_bulkSetRecords(CactusSecondaryDatabase *database, stList *requests);
+
+/*
+ * Removes the records for a list of stIntTuple keys.
+ */
+void cactusSecondaryDatabase_bulkRemoveRecords(CactusSecondaryDatabase *database, stList *keys);
+
+#endif
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef CACTUS_SEQUENCE_VIEW_H_
+#define CACTUS_SEQUENCE_VIEW_H_
+
+#include "cactusGlobals.h"
+
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+//Sequence views.
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+////////////////////////////////////////////////
+
+/*
+ * A sequence view is a substring of a sequence, on either strand, read without allocating a string. The view
+ * holds the forward strand bases in a buffer it reuses each time it is set, so a loop setting one view to many
+ * substrings makes no allocations once the buffer is big enough, and reverse strand substrings are read through the
+ * view rather than reverse complemented.
+ *
+ * The strings returned by a view are borrowed: they are valid until the view is next set or is destructed.
+ */
+
+/*
+ * Constructs an empty view.
+ */
+SequenceView *sequenceView_construct(void);
+
+/*
+ * Destructs the view.
+ */
+void sequenceView_destruct(SequenceView *view);
+
+/*
+ * Sets the view to the substring of the sequence, with the same arguments as sequence_getString.
+ */
+void sequenceView_set(SequenceView *view, Sequence *sequence, int64_t start, int64_t length, bool strand);
+
+/*
+ * Sets the view to the string of the segment, as returned by segment_getString. Returns non-zero if the segment
+ * has a sequence, else leaves the view empty and returns zero.
+ */
+bool sequenceView_setToSegment(SequenceView *view, Segment *segment);
+
+/*
+ * Gets the length of the substring.
+ */
+int64_t sequenceView_getLength(SequenceView *view);
+
+/*
+ * Gets the strand of the substring.
+ */
+bool sequenceView_getStrand(SequenceView *view);
+
+/*
+ * Gets the forward strand of the substring, null terminated, whatever the strand of the view.
+ */
+const char *sequenceView_getForwardString(SequenceView *view);
+
+/*
+ * Gets the base at the given offset of the substring, reading along the strand of the view, so the first base
+ * of a reverse strand view is the complement of the last base of its forward string.
+ */
+char sequenceView_getBase(SequenceView *view, int64_t i);
+
+/*
+ * Writes the substring, along the strand of the view, into string, which must have room for the length of the
+ * view. No terminating null is written.
+ */
+void sequenceView_copyString(SequenceView *view, char *string);
+
+#endif
@@ -24,6 +24,14 @@ CuSuite *cactusFaceEndTestSuite();
 CuSuite *cactusSequenceTestSuite();
 CuSuite *cactusSerialisationTestSuite();
 CuSuite *cactusFlowerWriterTestSuite();
+CuSuite *cactusLocalDatabaseTestSuite();
+CuSuite *cactusCodecTestSuite();
+CuSuite *cactusPackedSequenceTestSuite();
+CuSuite *cactusCacheTestSuite();
+CuSuite *cactusNameIndexTestSuite();
+CuSuite *cactusArenaTestSuite();
+CuSuite *cactusSnapshotTestSuite();
+CuSuite *cactusArchiveTestSuite();
 
 
 int cactusAPIRunAllTests(void) {
@@ -47,6 +55,14 @@ int cactusAPIRunAllTests(void) {
 	CuSuiteAddSuite(suite, cactusSequenceTestSuite());
 	CuSuiteAddSuite(suite, cactusSerialisationTestSuite());
 	CuSuiteAddSuite(suite, cactusFlowerWriterTestSuite());
+	CuSuiteAddSuite(suite, cactusLocalDatabaseTestSuite());
+	CuSuiteAddSuite(suite, cactusCodecTestSuite());
+	CuSuiteAddSuite(suite, cactusPackedSequenceTestSuite());
+	CuSuiteAddSuite(suite, cactusCacheTestSuite());
+	CuSuiteAddSuite(suite, cactusNameIndexTestSuite());
+	CuSuiteAddSuite(suite, cactusArenaTestSuite());
+	CuSuiteAddSuite(suite, cactusSnapshotTestSuite());
+	CuSuiteAddSuite(suite, cactusArchiveTestSuite());
 	CuSuiteRun(suite);
 	CuSuiteSummary(suite, output);
 	CuSuiteDetails(suite, output);
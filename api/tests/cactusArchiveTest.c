@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+#define TEST_ARCHIVE_FILE "temporaryCactusArchive"
+#define TEST_ARCHIVE_DATABASE_DIR "temporaryCactusArchiveDatabase"
+
+void testCactusArchive_writeAndRead(CuTest* testCase) {
+    /*
+     * Checks records and counters, added out of order and filling several blocks, can be read back.
+     */
+    CactusArchiveWriter *writer = cactusArchiveWriter_construct(TEST_ARCHIVE_FILE, 4);
+    int64_t recordNumber = 5000;
+    char *bigRecord = stRandom_getRandomDNAString(10000, true, true, true);
+    for (int64_t i = recordNumber - 1; i >= 0; i--) {
+        if (i % 100 == 0) {
+            cactusArchiveWriter_addInt64(writer, 3 * i - 500, i * 7);
+        } else if (i % 10 == 0) {
+            cactusArchiveWriter_add(writer, 3 * i - 500, bigRecord, strlen(bigRecord) + 1);
+        } else {
+            char *record = stString_print("record %" PRIi64 "", i);
+            cactusArchiveWriter_add(writer, 3 * i - 500, record, i % 7 == 0 ? 0 : strlen(record) + 1);
+            free(record);
+        }
+    }
+    cactusArchiveWriter_finish(writer);
+    CactusArchive *archive = cactusArchive_construct(TEST_ARCHIVE_FILE);
+    CuAssertIntEquals(testCase, recordNumber, cactusArchive_getRecordNumber(archive));
+    CuAssertTrue(testCase, cactusArchive_getBlockNumber(archive) > 1);
+    for (int64_t i = 0; i < recordNumber; i += 3) {
+        int64_t recordSize;
+        char *record = cactusArchive_getRecord(archive, 3 * i - 500, &recordSize);
+        CuAssertTrue(testCase, record != NULL);
+        if (i % 100 == 0) {
+            CuAssertIntEquals(testCase, sizeof(int64_t), recordSize);
+            CuAssertIntEquals(testCase, i * 7, *(int64_t *) record);
+        } else if (i % 10 == 0) {
+            CuAssertStrEquals(testCase, bigRecord, record);
+        } else if (i % 7 == 0) {
+            CuAssertIntEquals(testCase, 0, recordSize);
+        } else {
+            char *expectedRecord = stString_print("record %" PRIi64 "", i);
+            CuAssertIntEquals(testCase, strlen(expectedRecord) + 1, recordSize);
+            CuAssertStrEquals(testCase, expectedRecord, record);
+            free(expectedRecord);
+        }
+        free(record);
+        int64_t missingRecordSize;
+        CuAssertTrue(testCase, cactusArchive_getRecord(archive, 3 * i - 499, &missingRecordSize) == NULL);
+    }
+    int64_t missingRecordSize;
+    CuAssertTrue(testCase, cactusArchive_getRecord(archive, 3 * recordNumber, &missingRecordSize) == NULL);
+    CuAssertTrue(testCase, cactusArchive_getRecord(archive, -1000, &missingRecordSize) == NULL);
+    cactusArchive_destruct(archive);
+    free(bigRecord);
+    remove(TEST_ARCHIVE_FILE);
+}
+
+void testCactusArchive_exportAndImport(CuTest* testCase) {
+    /*
+     * Exports a cactus disk to an archive and imports it into a new local database, then checks the flowers and
+     * sequences can be read from it, and that unique ids keep being unique.
+     */
+    stKVDatabaseConf *conf = testCommon_getTemporaryKVDatabaseConf();
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    char *string = stRandom_getRandomDNAString(150000, true, true, true);
+    MetaSequence *metaSequence = metaSequence_construct(0, strlen(string), string, "FOO", 10, cactusDisk);
+    Name metaSequenceName = metaSequence_getName(metaSequence);
+    Flower *flower = flower_construct(cactusDisk);
+    Flower *nestedFlower = flower_construct(cactusDisk);
+    group_construct(flower, nestedFlower);
+    sequence_construct(metaSequence, nestedFlower);
+    end_construct(0, nestedFlower);
+    Name flowerName = flower_getName(flower), nestedFlowerName = flower_getName(nestedFlower);
+    cactusDisk_write(cactusDisk);
+    stSortedSet *uniqueIDs = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+            (void (*)(void *)) stIntTuple_destruct);
+    for (int64_t i = 0; i < 1000; i++) {
+        stSortedSet_insert(uniqueIDs, stIntTuple_construct1(cactusDisk_getUniqueID(cactusDisk)));
+    }
+    cactusDisk_exportArchive(cactusDisk, flowerName, TEST_ARCHIVE_FILE, 2);
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+    stKVDatabaseConf_destruct(conf);
+
+    char *databaseString = stString_print("<st_kv_database_conf type=\"local\"><local database_dir=\"%s\"/>"
+            "</st_kv_database_conf>", TEST_ARCHIVE_DATABASE_DIR);
+    CactusArchive *archive = cactusArchive_construct(TEST_ARCHIVE_FILE);
+    CuAssertIntEquals(testCase, cactusArchive_getRecordNumber(archive),
+            cactusArchive_import(archive, databaseString, 1, 3));
+    cactusArchive_destruct(archive);
+
+    cactusDisk = cactusDisk_constructFromString(databaseString, 0, 1);
+    nestedFlower = cactusDisk_getFlower(cactusDisk, nestedFlowerName);
+    CuAssertTrue(testCase, nestedFlower != NULL);
+    CuAssertIntEquals(testCase, 1, flower_getEndNumber(nestedFlower));
+    CuAssertTrue(testCase, cactusDisk_getFlower(cactusDisk, flowerName) != NULL);
+    metaSequence = cactusDisk_getMetaSequence(cactusDisk, metaSequenceName);
+    CuAssertTrue(testCase, metaSequence != NULL);
+    char *string2 = metaSequence_getString(metaSequence, 0, strlen(string), 1);
+    CuAssertStrEquals(testCase, string, string2);
+    free(string2);
+    for (int64_t i = 0; i < 1000; i++) {
+        stIntTuple *uniqueID = stIntTuple_construct1(cactusDisk_getUniqueID(cactusDisk));
+        CuAssertTrue(testCase, stSortedSet_search(uniqueIDs, uniqueID) == NULL);
+        stIntTuple_destruct(uniqueID);
+    }
+    cactusDisk_destruct(cactusDisk);
+
+    stSortedSet_destruct(uniqueIDs);
+    free(string);
+    free(databaseString);
+    int64_t i = system("rm -rf " TEST_ARCHIVE_DATABASE_DIR);
+    CuAssertIntEquals(testCase, 0, i);
+    remove(TEST_ARCHIVE_FILE);
+}
+
+void testCactusArchive_importThreads(CuTest* testCase) {
+    /*
+     * Imports an archive of many blocks with several threads into a local database, then checks every record and
+     * counter is in it, so that the threads' inserts do not clobber each other.
+     */
+    CactusArchiveWriter *writer = cactusArchiveWriter_construct(TEST_ARCHIVE_FILE, 4);
+    int64_t recordNumber = 5000;
+    char *bigRecord = stRandom_getRandomDNAString(10000, true, true, true);
+    for (int64_t i = 0; i < recordNumber; i++) {
+        if (i % 100 == 0) {
+            cactusArchiveWriter_addInt64(writer, i, i * 7);
+        } else if (i % 10 == 0) {
+            cactusArchiveWriter_add(writer, i, bigRecord, strlen(bigRecord) + 1);
+        } else {
+            char *record = stString_print("record %" PRIi64 "", i);
+            cactusArchiveWriter_add(writer, i, record, strlen(record) + 1);
+            free(record);
+        }
+    }
+    cactusArchiveWriter_finish(writer);
+    char *databaseString = stString_print("<st_kv_database_conf type=\"local\"><local database_dir=\"%s\"/>"
+            "</st_kv_database_conf>", TEST_ARCHIVE_DATABASE_DIR);
+    CactusArchive *archive = cactusArchive_construct(TEST_ARCHIVE_FILE);
+    CuAssertTrue(testCase, cactusArchive_getBlockNumber(archive) >= 4);
+    CuAssertIntEquals(testCase, recordNumber, cactusArchive_import(archive, databaseString, 1, 4));
+    cactusArchive_destruct(archive);
+
+    CactusLocalDatabase *database = cactusLocalDatabase_construct(TEST_ARCHIVE_DATABASE_DIR, 0);
+    CuAssertIntEquals(testCase, recordNumber, cactusLocalDatabase_getNumberOfRecords(database));
+    for (int64_t i = 0; i < recordNumber; i++) {
+        int64_t recordSize;
+        char *record = cactusLocalDatabase_getRecord2(database, i, &recordSize);
+        CuAssertTrue(testCase, record != NULL);
+        if (i % 100 == 0) {
+            CuAssertIntEquals(testCase, sizeof(int64_t), recordSize);
+            CuAssertIntEquals(testCase, i * 7, *(int64_t *) record);
+        } else if (i % 10 == 0) {
+            CuAssertStrEquals(testCase, bigRecord, record);
+        } else {
+            char *expectedRecord = stString_print("record %" PRIi64 "", i);
+            CuAssertStrEquals(testCase, expectedRecord, record);
+            free(expectedRecord);
+        }
+        free(record);
+    }
+    cactusLocalDatabase_destruct(database);
+
+    free(bigRecord);
+    free(databaseString);
+    int64_t i = system("rm -rf " TEST_ARCHIVE_DATABASE_DIR);
+    CuAssertIntEquals(testCase, 0, i);
+    remove(TEST_ARCHIVE_FILE);
+}
+
+CuSuite* cactusArchiveTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusArchive_writeAndRead);
+    SUITE_ADD_TEST(suite, testCactusArchive_exportAndImport);
+    SUITE_ADD_TEST(suite, testCactusArchive_importThreads);
+    return suite;
+}
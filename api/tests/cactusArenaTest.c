@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+void testCactusArena_mallocAndFree(CuTest* testCase) {
+    /*
+     * Checks allocations don't overlap, and freed memory is reused for allocations of the same size.
+     */
+    CactusArena *arena = cactusArena_construct();
+    CuAssertIntEquals(testCase, 0, cactusArena_getSize(arena));
+    stList *allocations = stList_construct();
+    for (int64_t i = 0; i < 10000; i++) {
+        int64_t size = st_randomInt64(1, CACTUS_ARENA_MAX_SIZE + 1);
+        char *ptr = cactusArena_malloc(arena, size);
+        CuAssertTrue(testCase, ((uintptr_t) ptr) % sizeof(void *) == 0);
+        memset(ptr, (int) (i % 256), size);
+        stList_append(allocations, ptr);
+        stList_append(allocations, (void *) (intptr_t) size);
+    }
+    for (int64_t i = 0; i < stList_length(allocations); i += 2) { //Check nothing was overwritten.
+        char *ptr = stList_get(allocations, i);
+        int64_t size = (intptr_t) stList_get(allocations, i + 1);
+        for (int64_t j = 0; j < size; j++) {
+            CuAssertIntEquals(testCase, (int) ((i / 2) % 256), (unsigned char) ptr[j]);
+        }
+    }
+    int64_t size = cactusArena_getSize(arena);
+    CuAssertTrue(testCase, size > 0);
+    void *ptr = cactusArena_malloc(arena, 100);
+    cactusArena_free(arena, ptr, 100);
+    CuAssertTrue(testCase, cactusArena_malloc(arena, 97) == ptr); //Sizes are rounded up.
+    cactusArena_free(arena, ptr, 97);
+    CuAssertTrue(testCase, cactusArena_malloc(arena, 50) != ptr);
+    stList_destruct(allocations);
+    cactusArena_release(arena);
+}
+
+void testCactusArena_retain(CuTest* testCase) {
+    /*
+     * Checks an arena's memory is kept until the arenas holding it are released.
+     */
+    CactusArena *arena = cactusArena_construct();
+    CactusArena *otherArena = cactusArena_construct();
+    int64_t *ptr = cactusArena_malloc(otherArena, sizeof(int64_t));
+    *ptr = 5;
+    cactusArena_retain(arena, otherArena);
+    cactusArena_retain(arena, otherArena);
+    cactusArena_retain(arena, arena);
+    cactusArena_release(otherArena);
+    CuAssertIntEquals(testCase, 5, *ptr);
+    //Memory of a retained arena can be freed to the arena holding it, and reused.
+    cactusArena_free(arena, ptr, sizeof(int64_t));
+    CuAssertTrue(testCase, cactusArena_malloc(arena, sizeof(int64_t)) == ptr);
+    cactusArena_release(arena);
+}
+
+void testCactusArena_flowers(CuTest* testCase) {
+    /*
+     * Checks the objects of a flower are allocated from its arena, and can be destructed one by one or with the flower.
+     */
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Flower *flower = flower_construct(cactusDisk);
+    CuAssertIntEquals(testCase, 0, cactusArena_getSize(flower_getArena(flower)));
+    for (int64_t i = 0; i < 100; i++) {
+        Block *block = block_construct(1, flower);
+        segment_construct(block, eventTree_getRootEvent(eventTree));
+        if (i % 2 == 0) {
+            End *_5End = block_get5End(block);
+            End *_3End = block_get3End(block);
+            block_destruct(block);
+            end_destruct(_5End);
+            end_destruct(_3End);
+        }
+    }
+    CuAssertTrue(testCase, cactusArena_getSize(flower_getArena(flower)) > 0);
+    CuAssertIntEquals(testCase, 50, flower_getBlockNumber(flower));
+    CuAssertIntEquals(testCase, 100, flower_getEndNumber(flower));
+    CuAssertIntEquals(testCase, 100, flower_getCapNumber(flower));
+    CuAssertIntEquals(testCase, 50, flower_getSegmentNumber(flower));
+
+    //Objects moved to another flower outlive the flower they were allocated in.
+    Flower *flower2 = flower_construct(cactusDisk);
+    Block *block = block_construct(10, flower2);
+    End *_5End = block_get5End(block);
+    End *_3End = block_get3End(block);
+    end_setFlower(_5End, flower);
+    end_setFlower(_3End, flower);
+    block_setFlower(block, flower);
+    flower_destruct(flower2, 0);
+    CuAssertTrue(testCase, flower_getBlock(flower, block_getName(block)) == block);
+    CuAssertIntEquals(testCase, 10, block_getLength(block));
+    CuAssertTrue(testCase, block_get5End(block) == _5End);
+    CuAssertTrue(testCase, end_getFlower(_3End) == flower);
+    CuAssertIntEquals(testCase, 102, flower_getEndNumber(flower));
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+}
+
+CuSuite* cactusArenaTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusArena_mallocAndFree);
+    SUITE_ADD_TEST(suite, testCactusArena_retain);
+    SUITE_ADD_TEST(suite, testCactusArena_flowers);
+    return suite;
+}
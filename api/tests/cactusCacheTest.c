@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+static int64_t destructCount = 0;
+
+static void destructValue(void *value) {
+    destructCount++;
+    free(value);
+}
+
+static int64_t *getValue(int64_t i) {
+    int64_t *value = st_malloc(sizeof(int64_t));
+    *value = i;
+    return value;
+}
+
+void testCactusCache_lru(CuTest* testCase) {
+    /*
+     * Checks the least recently used values are evicted to keep the cache in budget, and the counts.
+     */
+    destructCount = 0;
+    CactusCache *cache = cactusCache_construct(100, destructValue);
+    for (int64_t i = 0; i < 10; i++) {
+        cactusCache_insert(cache, i, getValue(i), 10);
+    }
+    CuAssertIntEquals(testCase, 100, cactusCache_getSize(cache));
+    CuAssertIntEquals(testCase, 0, cactusCache_getEvictions(cache));
+    int64_t size;
+    CuAssertIntEquals(testCase, 0, *(int64_t *) cactusCache_get(cache, 0, &size)); //Now 1 is least recently used
+    CuAssertIntEquals(testCase, 10, size);
+    cactusCache_insert(cache, 10, getValue(10), 25);
+    CuAssertIntEquals(testCase, 3, cactusCache_getEvictions(cache));
+    CuAssertIntEquals(testCase, 3, destructCount);
+    CuAssertTrue(testCase, cactusCache_contains(cache, 0));
+    for (int64_t i = 1; i < 4; i++) {
+        CuAssertTrue(testCase, !cactusCache_contains(cache, i));
+        CuAssertTrue(testCase, cactusCache_get(cache, i, NULL) == NULL);
+    }
+    for (int64_t i = 4; i < 11; i++) {
+        CuAssertIntEquals(testCase, i, *(int64_t *) cactusCache_get(cache, i, NULL));
+    }
+    CuAssertIntEquals(testCase, 95, cactusCache_getSize(cache));
+    CuAssertIntEquals(testCase, 8, cactusCache_getHits(cache));
+    CuAssertIntEquals(testCase, 3, cactusCache_getMisses(cache));
+
+    //Replacing a value destructs the old one
+    cactusCache_insert(cache, 10, getValue(11), 5);
+    CuAssertIntEquals(testCase, 4, destructCount);
+    CuAssertIntEquals(testCase, 75, cactusCache_getSize(cache));
+
+    //A value bigger than the budget is held until the next insert
+    cactusCache_insert(cache, 11, getValue(11), 1000);
+    CuAssertTrue(testCase, cactusCache_contains(cache, 11));
+    CuAssertIntEquals(testCase, 1000, cactusCache_getSize(cache));
+    cactusCache_insert(cache, 12, getValue(12), 10);
+    CuAssertTrue(testCase, !cactusCache_contains(cache, 11));
+    CuAssertIntEquals(testCase, 10, cactusCache_getSize(cache));
+
+    //Shrinking the budget evicts
+    cactusCache_setMaxSize(cache, 0);
+    CuAssertIntEquals(testCase, 10, cactusCache_getSize(cache));
+    cactusCache_remove(cache, 12);
+    CuAssertIntEquals(testCase, 0, cactusCache_getSize(cache));
+    cactusCache_setMaxSize(cache, 100);
+    cactusCache_insert(cache, 13, getValue(13), 10);
+    cactusCache_clear(cache);
+    CuAssertIntEquals(testCase, 0, cactusCache_getSize(cache));
+    CuAssertTrue(testCase, !cactusCache_contains(cache, 13));
+    cactusCache_insert(cache, 14, getValue(14), 10);
+    cactusCache_destruct(cache);
+    CuAssertIntEquals(testCase, 16, destructCount);
+}
+
+CuSuite* cactusCacheTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusCache_lru);
+    return suite;
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+static char *getTestString(int64_t length) {
+    char *string = st_malloc(length + 1);
+    for (int64_t i = 0; i < length; i++) {
+        string[i] = "ACGTN"[st_randomInt(0, 4) < 3 ? i % 4 : 4];
+    }
+    string[length] = '\0';
+    return string;
+}
+
+void testCactusCodec_roundTrip(CuTest* testCase) {
+    /*
+     * Checks every available codec decompresses what it compresses, and that any codec can read its records.
+     */
+    CactusCodec *reader = cactusCodec_construct(CACTUS_CODEC_ZLIB, -1, CACTUS_CODEC_ZLIB);
+    for (int64_t type = CACTUS_CODEC_NONE; type <= CACTUS_CODEC_ZSTD; type++) {
+        if (!cactusCodec_isAvailable(type)) {
+            continue;
+        }
+        CactusCodec *codec = cactusCodec_construct(type, type == CACTUS_CODEC_ZSTD ? 3 : 1, CACTUS_CODEC_NONE);
+        for (int64_t length = 0; length < 10000; length += 1 + length * 2) {
+            char *string = getTestString(length);
+            int64_t compressedSize, uncompressedSize;
+            void *record = cactusCodec_compress(codec, string, length + 1, &compressedSize);
+            char *string2 = cactusCodec_decompress(codec, record, compressedSize, &uncompressedSize);
+            CuAssertIntEquals(testCase, length + 1, uncompressedSize);
+            CuAssertStrEquals(testCase, string, string2);
+            free(string2);
+            if (type != CACTUS_CODEC_NONE) { //Untagged records are read as the reader's untagged type.
+                string2 = cactusCodec_decompress(reader, record, compressedSize, &uncompressedSize);
+                CuAssertStrEquals(testCase, string, string2);
+                free(string2);
+            }
+            free(record);
+            free(string);
+        }
+        cactusCodec_destruct(codec);
+    }
+    cactusCodec_destruct(reader);
+}
+
+void testCactusCodec_untaggedRecords(CuTest* testCase) {
+    /*
+     * Checks a codec whose type is its untagged type writes the same records as before codecs were added.
+     */
+    char *string = getTestString(1000);
+    CactusCodec *codec = cactusCodec_construct(CACTUS_CODEC_ZLIB, -1, CACTUS_CODEC_ZLIB);
+    int64_t compressedSize, uncompressedSize;
+    void *record = cactusCodec_compress(codec, string, 1001, &compressedSize);
+    char *string2 = stCompression_decompress(record, compressedSize, &uncompressedSize);
+    CuAssertStrEquals(testCase, string, string2);
+    free(string2);
+    free(record);
+    cactusCodec_destruct(codec);
+
+    codec = cactusCodec_construct(CACTUS_CODEC_NONE, 0, CACTUS_CODEC_NONE);
+    record = cactusCodec_compress(codec, string, 1001, &compressedSize);
+    CuAssertIntEquals(testCase, 1001, compressedSize);
+    CuAssertStrEquals(testCase, string, record);
+    free(record);
+    cactusCodec_destruct(codec);
+    free(string);
+}
+
+void testCactusCodec_dictionary(CuTest* testCase) {
+    if (!cactusCodec_isAvailable(CACTUS_CODEC_ZSTD)) {
+        return;
+    }
+    stList *samples = stList_construct3(0, free);
+    stList *sampleSizes = stList_construct3(0, free);
+    for (int64_t i = 0; i < 500; i++) {
+        int64_t *sampleSize = st_malloc(sizeof(int64_t));
+        *sampleSize = 300;
+        stList_append(samples, getTestString(*sampleSize - 1));
+        stList_append(sampleSizes, sampleSize);
+    }
+    int64_t dictionarySize;
+    void *dictionary = cactusCodec_trainDictionary(samples, sampleSizes, 4096, &dictionarySize);
+    CuAssertTrue(testCase, dictionary != NULL);
+    CactusCodec *codec = cactusCodec_construct(CACTUS_CODEC_ZSTD, 3, CACTUS_CODEC_ZLIB);
+    cactusCodec_setDictionary(codec, dictionary, dictionarySize);
+    CuAssertTrue(testCase, cactusCodec_getDictionaryID(codec) != 0);
+    int64_t compressedSize, uncompressedSize;
+    void *record = cactusCodec_compress(codec, stList_get(samples, 0), 300, &compressedSize);
+    CuAssertTrue(testCase, cactusCodec_getRecordDictionaryID(record, compressedSize) == cactusCodec_getDictionaryID(codec));
+    char *string = cactusCodec_decompress(codec, record, compressedSize, &uncompressedSize);
+    CuAssertStrEquals(testCase, stList_get(samples, 0), string);
+    free(string);
+    free(record);
+    free(dictionary);
+    cactusCodec_destruct(codec);
+    stList_destruct(samples);
+    stList_destruct(sampleSizes);
+}
+
+void testCactusCodec_cactusDisk(CuTest* testCase) {
+    /*
+     * Writes flowers, meta sequences and sequences with non default codecs and reads them back with the defaults.
+     */
+    testCommon_deleteTemporaryKVDatabase();
+    const char *databaseString =
+            "<st_kv_database_conf type=\"local\" record_codecs=\"flower=none metaSequence=zlib:9 sequenceChunk=zlib\">"
+            "<local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>";
+    CactusDisk *cactusDisk = cactusDisk_constructFromString(databaseString, true, true);
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    char *string = getTestString(2000);
+    MetaSequence *metaSequence = metaSequence_construct(1, 2000, string, "header", event_getName(
+            eventTree_getRootEvent(eventTree)), cactusDisk);
+    Name metaSequenceName = metaSequence_getName(metaSequence);
+    Name flowerName = flower_getName(flower_construct(cactusDisk));
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_constructFromString(
+            "<st_kv_database_conf type=\"local\"><local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>",
+            false, true);
+    CuAssertTrue(testCase, cactusDisk_getFlower(cactusDisk, flowerName) != NULL);
+    metaSequence = cactusDisk_getMetaSequence(cactusDisk, metaSequenceName);
+    CuAssertTrue(testCase, metaSequence != NULL);
+    char *string2 = metaSequence_getString(metaSequence, 1, 2000, 1);
+    CuAssertStrEquals(testCase, string, string2);
+    free(string2);
+    free(string);
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+}
+
+CuSuite* cactusCodecTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusCodec_roundTrip);
+    SUITE_ADD_TEST(suite, testCactusCodec_untaggedRecords);
+    SUITE_ADD_TEST(suite, testCactusCodec_dictionary);
+    SUITE_ADD_TEST(suite, testCactusCodec_cactusDisk);
+    return suite;
+}
@@ -58,6 +58,430 @@ void testCactusDisk_getFlower(CuTest* testCase) {
     cactusDiskTestTeardown();
 }
 
+void testCactusDisk_writeThreads(CuTest* testCase) {
+    /*
+     * Writes flowers using several write threads, enough to be serialised in several batches,
+     * and checks they can all be reloaded.
+     */
+    cactusDiskTestSetup();
+    cactusDisk_setWriteThreads(cactusDisk, 4);
+    stList *names = stList_construct3(0, free);
+    for (int64_t i = 0; i < 2500; i++) {
+        Name *name = st_malloc(sizeof(Name));
+        *name = flower_getName(flower_construct(cactusDisk));
+        stList_append(names, name);
+    }
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    stList *flowers = cactusDisk_getFlowers(cactusDisk, names);
+    CuAssertIntEquals(testCase, stList_length(names), stList_length(flowers));
+    for (int64_t i = 0; i < stList_length(names); i++) {
+        CuAssertTrue(testCase, flower_getName(stList_get(flowers, i)) == *((Name *) stList_get(names, i)));
+    }
+    stList_destruct(flowers);
+    stList_destruct(names);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_readThreads(CuTest* testCase) {
+    /*
+     * Checks flowers decompressed by several read threads are loaded in the order requested,
+     * including repeated and already loaded flowers.
+     */
+    cactusDiskTestSetup();
+    stList *names = stList_construct3(0, free);
+    for (int64_t i = 0; i < 100; i++) {
+        Flower *flower = flower_construct(cactusDisk);
+        end_construct(0, flower);
+        Name *name = st_malloc(sizeof(Name));
+        *name = flower_getName(flower);
+        stList_append(names, name);
+    }
+    Name *name = st_malloc(sizeof(Name));
+    *name = *((Name *) stList_get(names, 10));
+    stList_append(names, name);
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setReadThreads(cactusDisk, 4);
+    Flower *loadedFlower = cactusDisk_getFlower(cactusDisk, *((Name *) stList_get(names, 20)));
+    stList *flowers = cactusDisk_getFlowers(cactusDisk, names);
+    CuAssertIntEquals(testCase, stList_length(names), stList_length(flowers));
+    for (int64_t i = 0; i < stList_length(names); i++) {
+        Flower *flower = stList_get(flowers, i);
+        CuAssertTrue(testCase, flower_getName(flower) == *((Name *) stList_get(names, i)));
+        CuAssertIntEquals(testCase, 1, flower_getEndNumber(flower));
+    }
+    CuAssertPtrEquals(testCase, loadedFlower, stList_get(flowers, 20));
+    CuAssertPtrEquals(testCase, stList_get(flowers, 10), stList_get(flowers, 100));
+    stList_destruct(flowers);
+    stList_destruct(names);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_redundantUpdates(CuTest* testCase) {
+    /*
+     * Checks that rewriting a loaded flower which has not changed issues no update request,
+     * while changing it does.
+     */
+    cactusDiskTestSetup();
+    Name name = flower_getName(flower_construct(cactusDisk));
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    Flower *flower = cactusDisk_getFlower(cactusDisk, name);
+    CuAssertTrue(testCase, flower != NULL);
+    cactusDisk_addUpdateRequest(cactusDisk, flower);
+    CuAssertIntEquals(testCase, 0, stList_length(cactusDisk->updateRequests));
+    group_construct2(flower);
+    cactusDisk_addUpdateRequest(cactusDisk, flower);
+    CuAssertIntEquals(testCase, 1, stList_length(cactusDisk->updateRequests));
+    cactusDisk_write(cactusDisk);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_readVersion1Flowers(CuTest* testCase) {
+    /*
+     * Checks flowers written in the version 1 binary format can still be loaded.
+     */
+    cactusDiskTestSetup();
+    Flower *flower = flower_construct(cactusDisk);
+    Name name = flower_getName(flower);
+    Group *group = group_construct2(flower);
+    end_construct(0, flower);
+    flower_setBinaryRepresentationVersion(BINARY_REPRESENTATION_VERSION_1);
+    cactusDisk_write(cactusDisk);
+    flower_setBinaryRepresentationVersion(BINARY_REPRESENTATION_VERSION_2);
+    Name groupName = group_getName(group);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    flower = cactusDisk_getFlower(cactusDisk, name);
+    CuAssertTrue(testCase, flower != NULL);
+    CuAssertIntEquals(testCase, 1, flower_getGroupNumber(flower));
+    CuAssertIntEquals(testCase, 1, flower_getEndNumber(flower));
+    CuAssertTrue(testCase, flower_getGroup(flower, groupName) != NULL);
+    cactusDiskTestTeardown();
+}
+
+static char *getTestSequence(int64_t length) {
+    char *string = st_malloc(length + 1);
+    for (int64_t i = 0; i < length; i++) {
+        string[i] = (i / 1000) % 7 == 3 ? 'N' : "ACGTacgt"[st_randomInt(0, 4) + ((i / 300) % 5 == 1 ? 4 : 0)];
+    }
+    string[length] = '\0';
+    return string;
+}
+
+static void checkStrings(CuTest* testCase, Name name, const char *string) {
+    int64_t length = strlen(string);
+    for (int64_t i = 0; i < 100; i++) {
+        int64_t start = st_randomInt(0, length);
+        int64_t subLength = st_randomInt(0, length - start + 1);
+        char *subString = stString_getSubString(string, start, subLength);
+        char *subString2 = cactusDisk_getString(cactusDisk, name, start, subLength, 1, length);
+        CuAssertStrEquals(testCase, subString, subString2);
+        free(subString2);
+        char *reverseSubString = stString_reverseComplementString(subString);
+        subString2 = cactusDisk_getString(cactusDisk, name, start, subLength, 0, length);
+        CuAssertStrEquals(testCase, reverseSubString, subString2);
+        free(subString2);
+        free(reverseSubString);
+        free(subString);
+    }
+}
+
+void testCactusDisk_strings(CuTest* testCase) {
+    /*
+     * Checks ranges of strings spanning many chunks can be read, including those of strings
+     * stored in 500 base chunks without an index, as older versions wrote them, and when the
+     * chunks do not fit in the string cache.
+     */
+    cactusDiskTestSetup();
+    char *string = getTestSequence(200000);
+    Name name = cactusDisk_addString(cactusDisk, string);
+    char *legacyString = getTestSequence(20100);
+    Name legacyName = cactusDisk_getUniqueIDInterval(cactusDisk, 41);
+    stList *insertRequests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    for (int64_t i = 0; i < 41; i++) {
+        char *chunk = stString_getSubString(legacyString, i * 500, i < 40 ? 500 : 100);
+        stList_append(insertRequests,
+                stKVDatabaseBulkRequest_constructInsertRequest(legacyName + i, chunk, strlen(chunk) + 1));
+        free(chunk);
+    }
+    if (cactusDisk->localDatabase != NULL) {
+        cactusLocalDatabase_bulkSetRecords(cactusDisk->localDatabase, insertRequests);
+    } else {
+        stKVDatabase_bulkSetRecords(cactusDisk->database, insertRequests);
+    }
+    stList_destruct(insertRequests);
+    for (int64_t i = 0; i < 3; i++) {
+        if (i == 2) { //A string cache smaller than a chunk
+            cactusDisk_setCacheSizes(cactusDisk, 1000, 10000);
+        }
+        checkStrings(testCase, name, string);
+        checkStrings(testCase, legacyName, legacyString);
+        cactusDisk_clearStringCache(cactusDisk);
+    }
+    free(string);
+    free(legacyString);
+    cactusDiskTestTeardown();
+}
+
+typedef struct _threadSafeTest {
+    Name flowerName;
+    Name stringName;
+    const char *string;
+    bool ok;
+} ThreadSafeTest;
+
+static void *threadSafeTestFn(ThreadSafeTest *test) {
+    Flower *flower = cactusDisk_getFlower(cactusDisk, test->flowerName);
+    test->ok = flower != NULL && flower_getName(flower) == test->flowerName && flower_getEndNumber(flower) == 1;
+    if (test->ok) {
+        end_construct(0, flower); //Allocates a unique id.
+        test->ok = flower_getEndNumber(flower) == 2;
+    }
+    int64_t length = strlen(test->string);
+    for (int64_t i = 0; i < 100 && test->ok; i++) {
+        int64_t start = st_randomInt(0, length);
+        int64_t subLength = st_randomInt(0, length - start + 1);
+        char *subString = cactusDisk_getString(cactusDisk, test->stringName, start, subLength, 1, length);
+        test->ok = strncmp(test->string + start, subString, subLength) == 0 && strlen(subString) == subLength;
+        free(subString);
+    }
+    return test;
+}
+
+void testCactusDisk_threadSafe(CuTest* testCase) {
+    /*
+     * Checks several threads can load flowers and read strings from one disk in thread-safe mode.
+     */
+    cactusDiskTestSetup();
+    char *string = getTestSequence(300000);
+    Name stringName = cactusDisk_addString(cactusDisk, string);
+    int64_t flowerNumber = 50;
+    ThreadSafeTest *tests = st_malloc(sizeof(ThreadSafeTest) * flowerNumber);
+    for (int64_t i = 0; i < flowerNumber; i++) {
+        Flower *flower = flower_construct(cactusDisk);
+        end_construct(0, flower);
+        tests[i].flowerName = flower_getName(flower);
+        tests[i].stringName = stringName;
+        tests[i].string = string;
+        tests[i].ok = 0;
+    }
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setThreadSafe(cactusDisk, 1);
+    CuAssertTrue(testCase, cactusDisk_isThreadSafe(cactusDisk));
+    stThreadPool *threadPool = stThreadPool_construct(4, (void *(*)(void *)) threadSafeTestFn,
+            cactusMisc_threadPoolNoFinish);
+    for (int64_t i = 0; i < flowerNumber; i++) {
+        stThreadPool_push(threadPool, &tests[i]);
+    }
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    for (int64_t i = 0; i < flowerNumber; i++) {
+        CuAssertTrue(testCase, tests[i].ok);
+    }
+    cactusDisk_setThreadSafe(cactusDisk, 0);
+    CuAssertTrue(testCase, !cactusDisk_isThreadSafe(cactusDisk));
+    free(tests);
+    free(string);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_threadSafeExceptions(CuTest* testCase) {
+    /*
+     * Checks a request that throws in thread-safe mode releases the disk, so another thread can then use it.
+     */
+    cactusDiskTestSetup();
+    char *string = getTestSequence(1000);
+    ThreadSafeTest test;
+    test.stringName = cactusDisk_addString(cactusDisk, string);
+    test.string = string;
+    Flower *flower = flower_construct(cactusDisk);
+    end_construct(0, flower);
+    test.flowerName = flower_getName(flower);
+    test.ok = 0;
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setThreadSafe(cactusDisk, 1);
+    stList *names = stList_construct();
+    Name missingName = test.flowerName + 1000000;
+    stList_append(names, &test.flowerName);
+    stList_append(names, &missingName);
+    bool thrown = 0;
+    stTry {
+        stList_destruct(cactusDisk_getFlowers(cactusDisk, names));
+    } stCatch(except) {
+        thrown = 1;
+        stExcept_free(except);
+    } stTryEnd;
+    CuAssertTrue(testCase, thrown);
+    stList_destruct(names);
+    stThreadPool *threadPool = stThreadPool_construct(1, (void *(*)(void *)) threadSafeTestFn,
+            cactusMisc_threadPoolNoFinish);
+    stThreadPool_push(threadPool, &test);
+    stThreadPool_wait(threadPool);
+    stThreadPool_destruct(threadPool);
+    CuAssertTrue(testCase, test.ok);
+    cactusDisk_setThreadSafe(cactusDisk, 0);
+    free(string);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_lazyFlowers(CuTest* testCase) {
+    /*
+     * Checks a lazily loaded flower has its ends, blocks and groups loaded at once, and its caps,
+     * segments and faces when they are first accessed, after which it is the same as the flower written.
+     */
+    cactusDiskTestSetup();
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Event *event = eventTree_getRootEvent(eventTree);
+    Flower *flower = flower_construct(cactusDisk);
+    Name name = flower_getName(flower);
+    group_construct2(flower);
+    End *end1 = end_construct2(0, 0, flower);
+    End *end2 = end_construct2(1, 0, flower);
+    Block *block = block_construct(10, flower);
+    Segment *segment = segment_construct(block, event);
+    Cap *cap1 = cap_construct(end1, event);
+    Cap *cap2 = cap_construct(end2, event);
+    cap_makeAdjacent(cap1, segment_get5Cap(segment));
+    cap_makeAdjacent(segment_get3Cap(segment), cap2);
+    end_setRootInstance(end1, cap1);
+    end_setRootInstance(end2, cap2);
+    block_setRootInstance(block, segment);
+    flower_setBuildFaces(flower, 1);
+    Name capName = cap_getName(cap1);
+    Name end1Name = end_getName(end1);
+    Name adjacentCapName = cap_getName(segment_get5Cap(segment));
+    Name segmentName = segment_getName(segment);
+    int64_t faceNumber = flower_getFaceNumber(flower);
+    Name unusedFlowerName = flower_getName(flower_construct(cactusDisk));
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setLazyFlowers(cactusDisk, 1);
+    CuAssertTrue(testCase, cactusDisk_getLazyFlowers(cactusDisk));
+    flower = cactusDisk_getFlower(cactusDisk, name);
+    CuAssertTrue(testCase, flower != NULL);
+    CuAssertTrue(testCase, !flower_isMaterialised(flower));
+    CuAssertIntEquals(testCase, 1, flower_getGroupNumber(flower));
+    CuAssertIntEquals(testCase, 4, flower_getEndNumber(flower));
+    CuAssertIntEquals(testCase, 1, flower_getBlockNumber(flower));
+    CuAssertTrue(testCase, flower_builtFaces(flower));
+    CuAssertTrue(testCase, !flower_isMaterialised(flower));
+    CuAssertIntEquals(testCase, 4, flower_getCapNumber(flower));
+    CuAssertTrue(testCase, flower_isMaterialised(flower));
+    CuAssertIntEquals(testCase, 1, flower_getSegmentNumber(flower));
+    CuAssertTrue(testCase, flower_getSegment(flower, segmentName) != NULL);
+    CuAssertIntEquals(testCase, faceNumber, flower_getFaceNumber(flower));
+    cap1 = flower_getCap(flower, capName);
+    CuAssertTrue(testCase, cap1 != NULL);
+    CuAssertTrue(testCase, cap_getAdjacency(cap1) != NULL);
+    CuAssertTrue(testCase, cap_getName(cap_getAdjacency(cap1)) == adjacentCapName);
+    //The materialised flower is unchanged, so is not rewritten.
+    cactusDisk_addUpdateRequest(cactusDisk, flower);
+    CuAssertIntEquals(testCase, 0, stList_length(cactusDisk->updateRequests));
+
+    //Flowers which are never materialised can be destructed, and, once changed, rewritten.
+    CuAssertTrue(testCase, !flower_isMaterialised(cactusDisk_getFlower(cactusDisk, unusedFlowerName)));
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setLazyFlowers(cactusDisk, 1);
+    flower = cactusDisk_getFlower(cactusDisk, name);
+    end_construct2(0, 1, flower);
+    CuAssertTrue(testCase, flower_isMaterialised(flower));
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    flower = cactusDisk_getFlower(cactusDisk, name);
+    CuAssertIntEquals(testCase, 5, flower_getEndNumber(flower));
+    CuAssertIntEquals(testCase, 4, flower_getCapNumber(flower));
+    CuAssertTrue(testCase, flower_getEnd(flower, end1Name) != NULL);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_lazyFlowersWrite(CuTest* testCase) {
+    /*
+     * Checks writing a cactus disk does not materialise the lazily loaded flowers which are unchanged, and that those
+     * whose ends, groups or flags are changed, without touching their caps, are still rewritten.
+     */
+    cactusDiskTestSetup();
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Event *event = eventTree_getRootEvent(eventTree);
+    Flower *flower1 = flower_construct(cactusDisk);
+    Flower *flower2 = flower_construct(cactusDisk);
+    Name name1 = flower_getName(flower1), name2 = flower_getName(flower2);
+    group_construct2(flower1);
+    group_construct2(flower2);
+    cap_construct(end_construct2(0, 0, flower1), event);
+    cap_construct(end_construct2(0, 0, flower2), event);
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_setLazyFlowers(cactusDisk, 1);
+    flower1 = cactusDisk_getFlower(cactusDisk, name1);
+    flower2 = cactusDisk_getFlower(cactusDisk, name2);
+    CuAssertTrue(testCase, !flower_isMaterialised(flower1));
+    CuAssertTrue(testCase, !flower_isMaterialised(flower2));
+    //An unchanged flower is written as it was loaded, so is not rewritten.
+    cactusDisk_addUpdateRequest(cactusDisk, flower2);
+    CuAssertIntEquals(testCase, 0, stList_length(cactusDisk->updateRequests));
+    CuAssertTrue(testCase, !flower_isMaterialised(flower2));
+    group_construct2(flower1);
+    flower_setBuiltTrees(flower1, 1);
+    cactusDisk_write(cactusDisk);
+    CuAssertTrue(testCase, flower_isMaterialised(flower1));
+    CuAssertTrue(testCase, !flower_isMaterialised(flower2));
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    flower1 = cactusDisk_getFlower(cactusDisk, name1);
+    flower2 = cactusDisk_getFlower(cactusDisk, name2);
+    CuAssertIntEquals(testCase, 2, flower_getGroupNumber(flower1));
+    CuAssertTrue(testCase, flower_builtTrees(flower1));
+    CuAssertIntEquals(testCase, 1, flower_getCapNumber(flower1));
+    CuAssertIntEquals(testCase, 1, flower_getGroupNumber(flower2));
+    CuAssertTrue(testCase, !flower_builtTrees(flower2));
+    CuAssertIntEquals(testCase, 1, flower_getCapNumber(flower2));
+    cactusDiskTestTeardown();
+}
+
+static bool constructFromStringThrows(const char *databaseString) {
+    bool thrown = 0;
+    stTry {
+        CactusDisk *cactusDisk2 = cactusDisk_constructFromString(databaseString, true, true);
+        testCommon_deleteTemporaryCactusDisk(cactusDisk2);
+    } stCatch(except) {
+        thrown = 1;
+        stExcept_free(except);
+    } stTryEnd;
+    return thrown;
+}
+
+void testCactusDisk_cacheSizesFromConfString(CuTest* testCase) {
+    /*
+     * Checks the cache sizes of the conf string are parsed, and that sizes which are malformed or overflow are rejected.
+     */
+    testCommon_deleteTemporaryKVDatabase();
+    CuAssertTrue(testCase, !constructFromStringThrows("<st_kv_database_conf type=\"local\" record_cache_size=\"2M\" "
+            "string_cache_size=\"1G\"><local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>"));
+    CuAssertTrue(testCase, constructFromStringThrows("<st_kv_database_conf type=\"local\" string_cache_size=\"1X\">"
+            "<local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>"));
+    CuAssertTrue(testCase, constructFromStringThrows("<st_kv_database_conf type=\"local\" string_cache_size=\"9000000000G\">"
+            "<local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>"));
+    CuAssertTrue(testCase, constructFromStringThrows("<st_kv_database_conf type=\"local\" record_cache_size=\"-1\">"
+            "<local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>"));
+    testCommon_deleteTemporaryKVDatabase();
+}
+
 void testCactusDisk_getMetaSequence(CuTest* testCase) {
     cactusDiskTestSetup();
     MetaSequence *metaSequence = metaSequence_construct(1, 10, "ACTGACTGAG",
@@ -134,14 +558,111 @@ void testCactusDisk_getUniqueID_UniqueIntervals(CuTest* testCase) {
     cactusDiskTestTeardown();
 }
 
+static int compareIntervals(const void *a, const void *b) {
+    return cactusMisc_nameCompare(*(const Name *) a, *(const Name *) b);
+}
+
+void testCactusDisk_getUniqueID_Leases(CuTest* testCase) {
+    /*
+     * Gets enough intervals to use many leases, of growing size, most of them prefetched, and checks no two intervals overlap.
+     */
+    cactusDiskTestSetup();
+    int64_t intervalNumber = 5000;
+    Name *intervals = st_malloc(2 * intervalNumber * sizeof(Name));
+    for (int64_t i = 0; i < intervalNumber; i++) {
+        int64_t intervalSize = i % 1000 == 999 ? 100000 : st_randomInt(1, 2000);
+        intervals[2 * i] = cactusDisk_getUniqueIDInterval(cactusDisk, intervalSize);
+        intervals[2 * i + 1] = intervalSize;
+        CuAssertTrue(testCase, intervals[2 * i] > 0);
+    }
+    qsort(intervals, intervalNumber, 2 * sizeof(Name), compareIntervals);
+    for (int64_t i = 1; i < intervalNumber; i++) {
+        CuAssertTrue(testCase, intervals[2 * (i - 1)] + intervals[2 * (i - 1) + 1] <= intervals[2 * i]);
+    }
+    free(intervals);
+    cactusDiskTestTeardown();
+}
+
+void testCactusDisk_stats(CuTest* testCase) {
+    /*
+     * Reads back some flowers and checks the operations are counted, and the statistics printed.
+     */
+    cactusDiskTestSetup();
+    stList *flowerNames = stList_construct3(0, free);
+    for (int64_t i = 0; i < 3; i++) {
+        int64_t *flowerName = st_malloc(sizeof(int64_t));
+        flowerName[0] = flower_getName(flower_construct(cactusDisk));
+        stList_append(flowerNames, flowerName);
+    }
+    cactusDisk_write(cactusDisk);
+    CuAssertIntEquals(testCase, 1, cactusDiskStats_getCalls(cactusDisk->stats, CACTUS_DISK_OP_WRITE));
+    CuAssertTrue(testCase, cactusDiskStats_getRecords(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_SET) >= 3);
+    CuAssertTrue(testCase, cactusDiskStats_getRecords(cactusDisk->stats, CACTUS_DISK_OP_COMPRESS) >= 3);
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    char *statsFile = "cactusDiskStatsTest.jsonl";
+    remove(statsFile);
+    cactusDisk_setStatsFile(cactusDisk, statsFile);
+    //The parameters record is decompressed when the disk is constructed.
+    int64_t decompressedRecords = cactusDiskStats_getRecords(cactusDisk->stats, CACTUS_DISK_OP_DECOMPRESS);
+    stList_destruct(cactusDisk_getFlowers(cactusDisk, flowerNames));
+    CuAssertIntEquals(testCase, 1, cactusDiskStats_getCalls(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS));
+    CuAssertIntEquals(testCase, 3, cactusDiskStats_getRecords(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS));
+    CuAssertIntEquals(testCase, 1, cactusDiskStats_getCalls(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_GET));
+    CuAssertIntEquals(testCase, decompressedRecords + 3,
+            cactusDiskStats_getRecords(cactusDisk->stats, CACTUS_DISK_OP_DECOMPRESS));
+    CuAssertTrue(testCase, cactusDiskStats_getRawBytes(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS) > 0);
+    CuAssertIntEquals(testCase, cactusDiskStats_getBytes(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_GET),
+            cactusDiskStats_getBytes(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS));
+    CuAssertTrue(testCase, cactusDiskStats_getLatencyPercentile(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWERS, 0.99) > 0);
+    //The flowers are now loaded, so are not fetched again.
+    CuAssertTrue(testCase, cactusDisk_getFlower(cactusDisk, *(int64_t *) stList_get(flowerNames, 0)) != NULL);
+    CuAssertIntEquals(testCase, 1, cactusDiskStats_getCalls(cactusDisk->stats, CACTUS_DISK_OP_GET_FLOWER));
+    CuAssertIntEquals(testCase, 1, cactusDiskStats_getCalls(cactusDisk->stats, CACTUS_DISK_OP_DATABASE_BULK_GET));
+
+    //Check the statistics are printed, and appended to the stats file when the disk is destructed.
+    FILE *fileHandle = tmpfile();
+    cactusDisk_printStats(cactusDisk, fileHandle);
+    rewind(fileHandle);
+    char *line = stFile_getLineFromFile(fileHandle);
+    fclose(fileHandle);
+    CuAssertTrue(testCase, strstr(line, "{\"operations\": {") == line);
+    CuAssertTrue(testCase, strstr(line, "\"getFlowers\": {\"calls\": 1, \"records\": 3, ") != NULL);
+    CuAssertTrue(testCase, strstr(line, "\"caches\": {\"record\": {") != NULL);
+    CuAssertTrue(testCase, strstr(line, "\"write\"") == NULL);
+    cactusDiskTestTeardown();
+    fileHandle = fopen(statsFile, "r");
+    CuAssertTrue(testCase, fileHandle != NULL);
+    char *line2 = stFile_getLineFromFile(fileHandle);
+    fclose(fileHandle);
+    CuAssertTrue(testCase, strstr(line2, "\"getFlowers\": {\"calls\": 1, \"records\": 3, ") != NULL);
+    free(line);
+    free(line2);
+    remove(statsFile);
+    stList_destruct(flowerNames);
+}
+
 CuSuite* cactusDiskTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testCactusDisk_write);
     SUITE_ADD_TEST(suite, testCactusDisk_getFlower);
+    SUITE_ADD_TEST(suite, testCactusDisk_writeThreads);
+    SUITE_ADD_TEST(suite, testCactusDisk_readThreads);
+    SUITE_ADD_TEST(suite, testCactusDisk_redundantUpdates);
+    SUITE_ADD_TEST(suite, testCactusDisk_readVersion1Flowers);
+    SUITE_ADD_TEST(suite, testCactusDisk_strings);
+    SUITE_ADD_TEST(suite, testCactusDisk_threadSafe);
+    SUITE_ADD_TEST(suite, testCactusDisk_threadSafeExceptions);
+    SUITE_ADD_TEST(suite, testCactusDisk_lazyFlowers);
+    SUITE_ADD_TEST(suite, testCactusDisk_lazyFlowersWrite);
+    SUITE_ADD_TEST(suite, testCactusDisk_cacheSizesFromConfString);
     SUITE_ADD_TEST(suite, testCactusDisk_getMetaSequence);
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID);
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_Unique);
     SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_UniqueIntervals);
+    SUITE_ADD_TEST(suite, testCactusDisk_getUniqueID_Leases);
+    SUITE_ADD_TEST(suite, testCactusDisk_stats);
     SUITE_ADD_TEST(suite, testCactusDisk_constructAndDestruct);
     return suite;
 }
@@ -0,0 +1,337 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+#include <pthread.h>
+#include <sys/stat.h>
+
+static CactusLocalDatabase *database = NULL;
+
+static void cactusLocalDatabaseTestTeardown() {
+    if (database != NULL) {
+        cactusLocalDatabase_destruct(database);
+        database = NULL;
+        testCommon_deleteTemporaryKVDatabase();
+    }
+}
+
+static void cactusLocalDatabaseTestSetup() {
+    cactusLocalDatabaseTestTeardown();
+    testCommon_deleteTemporaryKVDatabase();
+    database = cactusLocalDatabase_construct("temporaryCactusDisk", true);
+}
+
+static void insertRecords(int64_t firstKey, int64_t recordNumber) {
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    for (int64_t i = firstKey; i < firstKey + recordNumber; i++) {
+        char *value = stString_print("value_%" PRIi64 "", i);
+        stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(i, value, strlen(value) + 1));
+        free(value);
+    }
+    cactusLocalDatabase_bulkSetRecords(database, requests);
+    stList_destruct(requests);
+}
+
+void testCactusLocalDatabase_getDatabaseDirFromConfString(CuTest* testCase) {
+    char *databaseDir = cactusLocalDatabase_getDatabaseDirFromConfString(
+            "<st_kv_database_conf type=\"local\"><local database_dir=\"/tmp/foo\"/></st_kv_database_conf>");
+    CuAssertStrEquals(testCase, "/tmp/foo", databaseDir);
+    free(databaseDir);
+    CuAssertTrue(testCase, cactusLocalDatabase_getDatabaseDirFromConfString(
+            "<st_kv_database_conf type=\"tokyo_cabinet\"><tokyo_cabinet database_dir=\"/tmp/foo\"/></st_kv_database_conf>") == NULL);
+}
+
+void testCactusLocalDatabase_bulkSetAndGetRecords(CuTest* testCase) {
+    cactusLocalDatabaseTestSetup();
+    insertRecords(1, 10000);
+    CuAssertIntEquals(testCase, 10000, cactusLocalDatabase_getNumberOfRecords(database));
+    stList *keys = stList_construct3(0, free);
+    for (int64_t i = 0; i <= 10001; i++) {
+        int64_t *key = st_malloc(sizeof(int64_t));
+        *key = i;
+        stList_append(keys, key);
+    }
+    stList *results = cactusLocalDatabase_bulkGetRecords(database, keys);
+    CuAssertIntEquals(testCase, stList_length(keys), stList_length(results));
+    for (int64_t i = 0; i <= 10001; i++) {
+        int64_t recordSize;
+        char *record = stKVDatabaseBulkResult_getRecord(stList_get(results, i), &recordSize);
+        if (i == 0 || i == 10001) {
+            CuAssertTrue(testCase, record == NULL);
+        } else {
+            char *value = stString_print("value_%" PRIi64 "", i);
+            CuAssertStrEquals(testCase, value, record);
+            CuAssertIntEquals(testCase, strlen(value) + 1, recordSize);
+            free(value);
+        }
+    }
+    stList_destruct(results);
+    stList_destruct(keys);
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_updateAndRemoveRecords(CuTest* testCase) {
+    cactusLocalDatabaseTestSetup();
+    insertRecords(1, 10);
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    stList_append(requests, stKVDatabaseBulkRequest_constructUpdateRequest(5, "updated", 8));
+    cactusLocalDatabase_bulkSetRecords(database, requests);
+    stList_destruct(requests);
+    stList *removeRequests = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+    stList_append(removeRequests, stIntTuple_construct1(6));
+    cactusLocalDatabase_bulkRemoveRecords(database, removeRequests);
+    stList_destruct(removeRequests);
+
+    int64_t recordSize;
+    char *record = cactusLocalDatabase_getRecord2(database, 5, &recordSize);
+    CuAssertStrEquals(testCase, "updated", record);
+    free(record);
+    CuAssertTrue(testCase, !cactusLocalDatabase_containsRecord(database, 6));
+    CuAssertTrue(testCase, cactusLocalDatabase_getRecord2(database, 6, &recordSize) == NULL);
+    CuAssertIntEquals(testCase, 9, cactusLocalDatabase_getNumberOfRecords(database));
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_reopen(CuTest* testCase) {
+    /*
+     * Checks a second handle sees the records written through the first, including ones
+     * written after it was opened, as happens when several processes share the database.
+     */
+    cactusLocalDatabaseTestSetup();
+    insertRecords(1, 100);
+    CactusLocalDatabase *database2 = cactusLocalDatabase_construct("temporaryCactusDisk", false);
+    CuAssertIntEquals(testCase, 100, cactusLocalDatabase_getNumberOfRecords(database2));
+    insertRecords(101, 100);
+    CuAssertTrue(testCase, cactusLocalDatabase_containsRecord(database2, 200));
+    CuAssertIntEquals(testCase, 200, cactusLocalDatabase_getNumberOfRecords(database2));
+    cactusLocalDatabase_destruct(database2);
+    cactusLocalDatabaseTestTeardown();
+}
+
+#define CONCURRENT_WRITERS 4
+#define CONCURRENT_BATCHES 50
+#define CONCURRENT_BATCH_SIZE 20
+
+static void *concurrentWriter(void *arg) {
+    /*
+     * Inserts its own range of keys through its own handle, in many small batches.
+     */
+    int64_t writer = *((int64_t *) arg);
+    CactusLocalDatabase *writerDatabase = cactusLocalDatabase_construct("temporaryCactusDisk", false);
+    for (int64_t i = 0; i < CONCURRENT_BATCHES; i++) {
+        stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+        for (int64_t j = 0; j < CONCURRENT_BATCH_SIZE; j++) {
+            int64_t key = 1 + (writer * CONCURRENT_BATCHES + i) * CONCURRENT_BATCH_SIZE + j;
+            stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(key, &key, sizeof(int64_t)));
+        }
+        cactusLocalDatabase_bulkSetRecords(writerDatabase, requests);
+        stList_destruct(requests);
+        cactusLocalDatabase_incrementInt64(writerDatabase, -1, 1);
+    }
+    cactusLocalDatabase_destruct(writerDatabase);
+    return NULL;
+}
+
+void testCactusLocalDatabase_concurrentHandles(CuTest* testCase) {
+    /*
+     * Checks threads writing through their own handles on the same database, whose fcntl
+     * locks do not exclude each other as they belong to the same process, lose no records.
+     */
+    cactusLocalDatabaseTestSetup();
+    cactusLocalDatabase_insertInt64(database, -1, 0);
+    pthread_t threads[CONCURRENT_WRITERS];
+    int64_t writers[CONCURRENT_WRITERS];
+    for (int64_t i = 0; i < CONCURRENT_WRITERS; i++) {
+        writers[i] = i;
+        pthread_create(&threads[i], NULL, concurrentWriter, &writers[i]);
+    }
+    for (int64_t i = 0; i < CONCURRENT_WRITERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    int64_t recordNumber = CONCURRENT_WRITERS * CONCURRENT_BATCHES * CONCURRENT_BATCH_SIZE;
+    CuAssertIntEquals(testCase, recordNumber + 1, cactusLocalDatabase_getNumberOfRecords(database));
+    for (int64_t key = 1; key <= recordNumber; key++) {
+        int64_t recordSize;
+        int64_t *value = cactusLocalDatabase_getRecord2(database, key, &recordSize);
+        CuAssertTrue(testCase, value != NULL);
+        CuAssertIntEquals(testCase, key, *value);
+        free(value);
+    }
+    CuAssertIntEquals(testCase, CONCURRENT_WRITERS * CONCURRENT_BATCHES + 1,
+            cactusLocalDatabase_incrementInt64(database, -1, 1));
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_incrementInt64(CuTest* testCase) {
+    cactusLocalDatabaseTestSetup();
+    cactusLocalDatabase_insertInt64(database, -1, 10);
+    CuAssertIntEquals(testCase, 15, cactusLocalDatabase_incrementInt64(database, -1, 5));
+    CuAssertIntEquals(testCase, 115, cactusLocalDatabase_incrementInt64(database, -1, 100));
+    CactusLocalDatabase *database2 = cactusLocalDatabase_construct("temporaryCactusDisk", false);
+    CuAssertIntEquals(testCase, 116, cactusLocalDatabase_incrementInt64(database2, -1, 1));
+    cactusLocalDatabase_destruct(database2);
+    CuAssertIntEquals(testCase, 117, cactusLocalDatabase_incrementInt64(database, -1, 1));
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_cactusDisk(CuTest* testCase) {
+    /*
+     * Round trips a flower through a cactus disk backed by the local database.
+     */
+    testCommon_deleteTemporaryKVDatabase();
+    const char *databaseString =
+            "<st_kv_database_conf type=\"local\"><local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>";
+    CactusDisk *cactusDisk = cactusDisk_constructFromString(databaseString, true, true);
+    Name name = flower_getName(flower_construct(cactusDisk));
+    cactusDisk_write(cactusDisk);
+    cactusDisk_destruct(cactusDisk);
+    cactusDisk = cactusDisk_constructFromString(databaseString, false, true);
+    Flower *flower = cactusDisk_getFlower(cactusDisk, name);
+    CuAssertTrue(testCase, flower != NULL);
+    CuAssertTrue(testCase, flower_getName(flower) == name);
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+}
+
+static int64_t getLogLength() {
+    struct stat fileStat;
+    stat("temporaryCactusDisk/cactusDisk.log", &fileStat);
+    return fileStat.st_size;
+}
+
+static void checkRecords(CuTest *testCase, CactusLocalDatabase *database, int64_t firstKey, int64_t recordNumber,
+        const char *prefix) {
+    for (int64_t i = firstKey; i < firstKey + recordNumber; i++) {
+        int64_t recordSize;
+        char *record = cactusLocalDatabase_getRecord2(database, i, &recordSize);
+        char *value = stString_print("%s_%" PRIi64 "", prefix, i);
+        CuAssertTrue(testCase, record != NULL);
+        CuAssertStrEquals(testCase, value, record);
+        free(value);
+        free(record);
+    }
+}
+
+void testCactusLocalDatabase_compact(CuTest* testCase) {
+    /*
+     * Checks compacting the log drops the updated and removed records, and that another handle,
+     * opened on the log before the compaction, reads and writes the compacted log.
+     */
+    cactusLocalDatabaseTestSetup();
+    CactusLocalDatabase *database2 = cactusLocalDatabase_construct("temporaryCactusDisk", false);
+    cactusLocalDatabase_insertInt64(database, -1, 0);
+    for (int64_t i = 0; i < 10; i++) {
+        stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+        for (int64_t j = 1; j <= 1000; j++) {
+            char *value = stString_print("update_%" PRIi64 "", j);
+            stList_append(requests, i == 0 ? stKVDatabaseBulkRequest_constructInsertRequest(j, value, strlen(value) + 1)
+                    : stKVDatabaseBulkRequest_constructUpdateRequest(j, value, strlen(value) + 1));
+            free(value);
+        }
+        cactusLocalDatabase_bulkSetRecords(database, requests);
+        stList_destruct(requests);
+        cactusLocalDatabase_incrementInt64(database, -1, 1);
+    }
+    stList *removeRequests = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+    for (int64_t j = 501; j <= 1000; j++) {
+        stList_append(removeRequests, stIntTuple_construct1(j));
+    }
+    cactusLocalDatabase_bulkRemoveRecords(database, removeRequests);
+    stList_destruct(removeRequests);
+    CuAssertIntEquals(testCase, 501, cactusLocalDatabase_getNumberOfRecords(database2));
+
+    int64_t logLength = getLogLength();
+    cactusLocalDatabase_compact(database);
+    CuAssertTrue(testCase, getLogLength() * 10 < logLength);
+    CuAssertIntEquals(testCase, 501, cactusLocalDatabase_getNumberOfRecords(database));
+    checkRecords(testCase, database, 1, 500, "update");
+
+    //The other handle reopens the compacted log, and what it writes is seen by the first.
+    CuAssertIntEquals(testCase, 501, cactusLocalDatabase_getNumberOfRecords(database2));
+    checkRecords(testCase, database2, 1, 500, "update");
+    CuAssertTrue(testCase, !cactusLocalDatabase_containsRecord(database2, 501));
+    CuAssertIntEquals(testCase, 11, cactusLocalDatabase_incrementInt64(database2, -1, 1));
+    insertRecords(1001, 10);
+    CuAssertTrue(testCase, cactusLocalDatabase_containsRecord(database2, 1010));
+    cactusLocalDatabase_destruct(database2);
+    database2 = cactusLocalDatabase_construct("temporaryCactusDisk", false);
+    CuAssertIntEquals(testCase, 511, cactusLocalDatabase_getNumberOfRecords(database2));
+    CuAssertIntEquals(testCase, 12, cactusLocalDatabase_incrementInt64(database2, -1, 1));
+    cactusLocalDatabase_destruct(database2);
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_automaticCompaction(CuTest* testCase) {
+    /*
+     * Checks a log that is mostly updated records is compacted as it is written, rather than growing.
+     */
+    cactusLocalDatabaseTestSetup();
+    int64_t recordSize = 1024 * 1024;
+    char *value = st_calloc(recordSize, 1);
+    for (int64_t i = 0; i < 200; i++) {
+        sprintf(value, "value_%" PRIi64 "", i);
+        stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+        stList_append(requests, i == 0 ? stKVDatabaseBulkRequest_constructInsertRequest(1, value, recordSize)
+                : stKVDatabaseBulkRequest_constructUpdateRequest(1, value, recordSize));
+        cactusLocalDatabase_bulkSetRecords(database, requests);
+        stList_destruct(requests);
+    }
+    free(value);
+    CuAssertTrue(testCase, getLogLength() < 100 * recordSize);
+    int64_t size;
+    value = cactusLocalDatabase_getRecord2(database, 1, &size);
+    CuAssertIntEquals(testCase, recordSize, size);
+    CuAssertStrEquals(testCase, "value_199", value);
+    free(value);
+    cactusLocalDatabaseTestTeardown();
+}
+
+void testCactusLocalDatabase_secondaryDatabase(CuTest* testCase) {
+    /*
+     * Checks a secondary database with a local conf string is a local database, which deleting removes.
+     */
+    testCommon_deleteTemporaryKVDatabase();
+    const char *databaseString =
+            "<st_kv_database_conf type=\"local\"><local database_dir=\"temporaryCactusDisk\"/></st_kv_database_conf>";
+    CactusSecondaryDatabase *secondaryDatabase = cactusSecondaryDatabase_constructFromString(databaseString, 1);
+    cactusSecondaryDatabase_destruct(secondaryDatabase);
+    secondaryDatabase = cactusSecondaryDatabase_constructFromString(databaseString, 0);
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(1, "one", 4));
+    stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(2, "two", 4));
+    cactusSecondaryDatabase_bulkSetRecords(secondaryDatabase, requests);
+    stList_destruct(requests);
+    stList *removeRequests = stList_construct3(0, (void (*)(void *)) stIntTuple_destruct);
+    stList_append(removeRequests, stIntTuple_construct1(1));
+    cactusSecondaryDatabase_bulkRemoveRecords(secondaryDatabase, removeRequests);
+    stList_destruct(removeRequests);
+    stList *keys = stList_construct();
+    int64_t keyValues[2] = { 1, 2 };
+    stList_append(keys, &keyValues[0]);
+    stList_append(keys, &keyValues[1]);
+    stList *results = cactusSecondaryDatabase_bulkGetRecords(secondaryDatabase, keys);
+    int64_t recordSize;
+    CuAssertTrue(testCase, stKVDatabaseBulkResult_getRecord(stList_get(results, 0), &recordSize) == NULL);
+    CuAssertStrEquals(testCase, "two", stKVDatabaseBulkResult_getRecord(stList_get(results, 1), &recordSize));
+    stList_destruct(results);
+    stList_destruct(keys);
+    cactusSecondaryDatabase_deleteFromDisk(secondaryDatabase);
+    CuAssertTrue(testCase, !stFile_exists("temporaryCactusDisk"));
+}
+
+CuSuite* cactusLocalDatabaseTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_getDatabaseDirFromConfString);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_bulkSetAndGetRecords);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_updateAndRemoveRecords);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_reopen);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_incrementInt64);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_concurrentHandles);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_cactusDisk);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_compact);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_automaticCompaction);
+    SUITE_ADD_TEST(suite, testCactusLocalDatabase_secondaryDatabase);
+    return suite;
+}
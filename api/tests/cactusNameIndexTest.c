@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+void testCactusNameIndex_insertSearchRemove(CuTest* testCase) {
+    /*
+     * Checks the objects inserted are found by name, and removed, including runs of consecutive names.
+     */
+    CactusNameIndex *index = cactusNameIndex_construct();
+    int64_t objects[1000];
+    CuAssertIntEquals(testCase, 0, cactusNameIndex_size(index));
+    CuAssertTrue(testCase, cactusNameIndex_search(index, 1) == NULL);
+    CuAssertTrue(testCase, cactusNameIndex_remove(index, 1) == NULL);
+    for (int64_t i = 0; i < 1000; i++) {
+        cactusNameIndex_insert(index, i + 1, &objects[i]);
+    }
+    CuAssertIntEquals(testCase, 1000, cactusNameIndex_size(index));
+    for (int64_t i = 0; i < 1000; i++) {
+        CuAssertTrue(testCase, cactusNameIndex_search(index, i + 1) == &objects[i]);
+    }
+    CuAssertTrue(testCase, cactusNameIndex_search(index, 0) == NULL);
+    CuAssertTrue(testCase, cactusNameIndex_search(index, 1001) == NULL);
+    //Remove every other object
+    for (int64_t i = 0; i < 1000; i += 2) {
+        CuAssertTrue(testCase, cactusNameIndex_remove(index, i + 1) == &objects[i]);
+    }
+    CuAssertIntEquals(testCase, 500, cactusNameIndex_size(index));
+    for (int64_t i = 0; i < 1000; i++) {
+        CuAssertTrue(testCase, cactusNameIndex_search(index, i + 1) == (i % 2 == 0 ? NULL : &objects[i]));
+    }
+    CuAssertTrue(testCase, cactusNameIndex_remove(index, 1) == NULL);
+    cactusNameIndex_destruct(index);
+}
+
+void testCactusNameIndex_random(CuTest* testCase) {
+    /*
+     * Checks random inserts and removes against a hash, so the probe sequences are often interleaved.
+     */
+    for (int64_t test = 0; test < 10; test++) {
+        CactusNameIndex *index = cactusNameIndex_construct();
+        stHash *hash = stHash_construct3((uint64_t (*)(const void *)) stIntTuple_hashKey,
+                (int (*)(const void *, const void *)) stIntTuple_equalsFn, (void (*)(void *)) stIntTuple_destruct, NULL);
+        for (int64_t i = 0; i < 10000; i++) {
+            Name name = st_randomInt64(-100, 1000);
+            stIntTuple *key = stIntTuple_construct1(name);
+            void *object = stHash_search(hash, key);
+            CuAssertTrue(testCase, cactusNameIndex_search(index, name) == object);
+            if (object == NULL) {
+                object = st_malloc(1);
+                cactusNameIndex_insert(index, name, object);
+                stHash_insert(hash, key, object);
+            } else {
+                CuAssertTrue(testCase, cactusNameIndex_remove(index, name) == object);
+                free(stHash_removeAndFreeKey(hash, key));
+                stIntTuple_destruct(key);
+            }
+            CuAssertIntEquals(testCase, stHash_size(hash), cactusNameIndex_size(index));
+        }
+        stHashIterator *it = stHash_getIterator(hash);
+        stIntTuple *key;
+        while ((key = stHash_getNext(it)) != NULL) {
+            void *object = stHash_search(hash, key);
+            CuAssertTrue(testCase, cactusNameIndex_search(index, stIntTuple_get(key, 0)) == object);
+            free(object);
+        }
+        stHash_destructIterator(it);
+        stHash_destruct(hash);
+        cactusNameIndex_destruct(index);
+    }
+}
+
+CuSuite* cactusNameIndexTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusNameIndex_insertSearchRemove);
+    SUITE_ADD_TEST(suite, testCactusNameIndex_random);
+    return suite;
+}
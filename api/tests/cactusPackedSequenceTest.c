@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+static char *getTestString(int64_t length) {
+    /*
+     * Makes a string of bases with runs of Ns and other characters, and soft-masked runs.
+     */
+    char *string = st_malloc(length + 1);
+    bool masked = false;
+    char runCharacter = 'A';
+    for (int64_t i = 0; i < length; i++) {
+        if (st_random() < 0.05) {
+            masked = !masked;
+        }
+        if (st_random() < 0.05) {
+            runCharacter = runCharacter == 'A' ? "NNNX-"[st_randomInt(0, 5)] : 'A';
+        }
+        char c = runCharacter == 'A' ? "ACGT"[st_randomInt(0, 4)] : runCharacter;
+        string[i] = masked && c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+    }
+    string[length] = '\0';
+    return string;
+}
+
+void testPackedSequence_roundTrip(CuTest* testCase) {
+    /*
+     * Checks packed sequences unpack to the strings they were packed from, and that any substring can be unpacked.
+     */
+    for (int64_t length = 0; length < 2000; length += 1 + length / 2) {
+        char *string = getTestString(length);
+        int64_t recordSize;
+        void *record = packedSequence_pack(string, length, &recordSize);
+        CuAssertTrue(testCase, packedSequence_isPacked(record, recordSize));
+        PackedSequence *packedSequence = packedSequence_construct(record, recordSize);
+        CuAssertIntEquals(testCase, length, packedSequence_getLength(packedSequence));
+        char *string2 = st_calloc(length + 1, sizeof(char));
+        packedSequence_getSubstring(packedSequence, 0, length, string2);
+        CuAssertStrEquals(testCase, string, string2);
+        for (int64_t i = 0; i < 100 && length > 0; i++) {
+            int64_t start = st_randomInt(0, length);
+            int64_t subLength = st_randomInt(0, length - start + 1);
+            memset(string2, 0, length + 1);
+            packedSequence_getSubstring(packedSequence, start, subLength, string2);
+            CuAssertTrue(testCase, strncmp(string + start, string2, subLength) == 0);
+            CuAssertIntEquals(testCase, subLength, strlen(string2));
+        }
+        free(string2);
+        packedSequence_destruct(packedSequence);
+        free(string);
+    }
+}
+
+void testPackedSequence_rawStrings(CuTest* testCase) {
+    /*
+     * Checks the raw strings written by older versions are not mistaken for packed sequences.
+     */
+    const char *strings[] = { "", "A", "ACGTNNNNacgt", "NNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNNN" };
+    for (int64_t i = 0; i < 4; i++) {
+        CuAssertTrue(testCase, !packedSequence_isPacked(strings[i], strlen(strings[i]) + 1));
+    }
+}
+
+CuSuite* cactusPackedSequenceTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testPackedSequence_roundTrip);
+    SUITE_ADD_TEST(suite, testPackedSequence_rawStrings);
+    return suite;
+}
@@ -96,6 +96,38 @@ void testSequence_getString(CuTest* testCase) {
 	cactusSequenceTestTeardown();
 }
 
+void testSequence_getStringView(CuTest* testCase) {
+	/*
+	 * Checks a view, reused for each substring, reads the same strings as sequence_getString on both strands.
+	 */
+	cactusSequenceTestSetup();
+	SequenceView *view = sequenceView_construct();
+	CuAssertIntEquals(testCase, 0, sequenceView_getLength(view));
+	for(int64_t i=1; i<11; i++) {
+		for(int64_t j=11-i; j>=0; j--) {
+			for(int64_t strand=0; strand<2; strand++) {
+				char *string = sequence_getString(sequence, i, j, strand);
+				char *forwardString = sequence_getString(sequence, i, j, 1);
+				sequenceView_set(view, sequence, i, j, strand);
+				CuAssertIntEquals(testCase, j, sequenceView_getLength(view));
+				CuAssertIntEquals(testCase, strand, sequenceView_getStrand(view));
+				CuAssertStrEquals(testCase, forwardString, sequenceView_getForwardString(view));
+				for(int64_t k=0; k<j; k++) {
+					CuAssertIntEquals(testCase, string[k], sequenceView_getBase(view, k));
+				}
+				char *copiedString = st_calloc(j + 1, sizeof(char));
+				sequenceView_copyString(view, copiedString);
+				CuAssertStrEquals(testCase, string, copiedString);
+				free(copiedString);
+				free(forwardString);
+				free(string);
+			}
+		}
+	}
+	sequenceView_destruct(view);
+	cactusSequenceTestTeardown();
+}
+
 static char *getRandomDNASequence(int64_t minSequenceLength, int64_t maxSequenceLength) {
     int64_t stringLength = st_randomInt(minSequenceLength, maxSequenceLength);
     char *string = st_malloc(sizeof(char) * (stringLength + 1));
@@ -265,6 +297,7 @@ CuSuite* cactusSequenceTestSuite(void) {
 	SUITE_ADD_TEST(suite, testSequence_getName);
 	SUITE_ADD_TEST(suite, testSequence_getEvent);
 	SUITE_ADD_TEST(suite, testSequence_getString);
+	SUITE_ADD_TEST(suite, testSequence_getStringView);
 	SUITE_ADD_TEST(suite, testSequence_addAndGetBigStrings);
 	SUITE_ADD_TEST(suite, testSequence_addAndGetBigStrings_preCacheSequences);
 	SUITE_ADD_TEST(suite, testSequence_addAndGetBigStrings_reopenCactusDisk);
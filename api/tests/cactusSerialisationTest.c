@@ -101,6 +101,38 @@ void testBinaryRepresentation_bool(CuTest* testCase) {
     cactusSerialisationTestTeardown();
 }
 
+void testBinaryRepresentation_version2(CuTest* testCase) {
+    /*
+     * Checks integers, names and strings round trip in the varint format, and are smaller than in version 1.
+     */
+    cactusSerialisationTestSetup();
+    void *vA2 = vA;
+    int64_t integers[] = { 0, 1, -1, 63, -64, 128, 537869, INT64_MAX, INT64_MIN };
+    Name names[] = { 543829676894821452, 543829676894821453, NULL_NAME, 543829676894821400, 12, 0 };
+    BinaryRepresentationFormat previousFormat = binaryRepresentation_setFormat(BINARY_REPRESENTATION_VERSION_2);
+    for (int64_t i = 0; i < 9; i++) {
+        binaryRepresentation_writeInteger(integers[i], writeFn);
+    }
+    for (int64_t i = 0; i < 6; i++) {
+        binaryRepresentation_writeName(names[i], writeFn);
+    }
+    binaryRepresentation_writeString("HELLO I AM A STRING", writeFn);
+    CuAssertTrue(testCase, vA3 - vA < 9 * sizeof(int64_t) + 6 * sizeof(int64_t));
+    binaryRepresentation_setFormat(BINARY_REPRESENTATION_VERSION_2);
+    for (int64_t i = 0; i < 9; i++) {
+        CuAssertTrue(testCase, integers[i] == binaryRepresentation_getInteger(&vA2));
+    }
+    for (int64_t i = 0; i < 6; i++) {
+        CuAssertTrue(testCase, names[i] == binaryRepresentation_getName(&vA2));
+    }
+    char *string = binaryRepresentation_getString(&vA2);
+    CuAssertStrEquals(testCase, "HELLO I AM A STRING", string);
+    free(string);
+    CuAssertTrue(testCase, vA2 == (void *) vA3);
+    binaryRepresentation_restoreFormat(previousFormat);
+    cactusSerialisationTestTeardown();
+}
+
 static void testBinaryRepresentation_fn(void *object, void(*writeFn)(const void * ptr, size_t size, size_t count)) {
     binaryRepresentation_writeInteger(*(int64_t *) object, writeFn);
 }
@@ -137,6 +169,7 @@ CuSuite* cactusSerialisationTestSuite(void) {
     SUITE_ADD_TEST(suite, testBinaryRepresentation_name);
     SUITE_ADD_TEST(suite, testBinaryRepresentation_float);
     SUITE_ADD_TEST(suite, testBinaryRepresentation_bool);
+    SUITE_ADD_TEST(suite, testBinaryRepresentation_version2);
     SUITE_ADD_TEST(suite, testBinaryRepresentation_makeBinaryRepresentation);
     SUITE_ADD_TEST(suite, testBinaryRepresentation_resizeObjectAsPowerOf2);
     return suite;
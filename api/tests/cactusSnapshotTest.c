@@ -0,0 +1,247 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "cactusGlobalsPrivate.h"
+
+#define TEST_SNAPSHOT_FILE "temporaryCactusSnapshot"
+
+void testCactusSnapshot_writeAndRead(CuTest* testCase) {
+    /*
+     * Checks records of assorted sizes can be read back, aligned, in any order.
+     */
+    CactusSnapshotWriter *writer = cactusSnapshotWriter_construct(TEST_SNAPSHOT_FILE, 0);
+    int64_t recordNumber = 1000;
+    for (int64_t i = recordNumber - 1; i >= 0; i--) {
+        char *record = stString_print("record %" PRIi64 "", i);
+        cactusSnapshotWriter_add(writer, 3 * i - 500, record, i % 10 == 0 ? 0 : strlen(record) + 1);
+        free(record);
+    }
+    cactusSnapshotWriter_finish(writer);
+    CactusSnapshot *snapshot = cactusSnapshot_construct(TEST_SNAPSHOT_FILE);
+    CuAssertIntEquals(testCase, recordNumber, cactusSnapshot_getRecordNumber(snapshot));
+    for (int64_t i = 0; i < recordNumber; i++) {
+        int64_t recordSize;
+        const char *record = cactusSnapshot_getRecord(snapshot, 3 * i - 500, &recordSize);
+        CuAssertTrue(testCase, record != NULL);
+        CuAssertTrue(testCase, ((uintptr_t) record) % sizeof(int64_t) == 0);
+        if (i % 10 == 0) {
+            CuAssertIntEquals(testCase, 0, recordSize);
+        } else {
+            char *expectedRecord = stString_print("record %" PRIi64 "", i);
+            CuAssertIntEquals(testCase, strlen(expectedRecord) + 1, recordSize);
+            CuAssertStrEquals(testCase, expectedRecord, record);
+            free(expectedRecord);
+        }
+        CuAssertTrue(testCase, !cactusSnapshot_containsRecord(snapshot, 3 * i - 499));
+    }
+    cactusSnapshot_destruct(snapshot);
+    remove(TEST_SNAPSHOT_FILE);
+}
+
+static bool constructThrows(const char *snapshotFile) {
+    bool thrown = 0;
+    stTry {
+        cactusSnapshot_destruct(cactusSnapshot_construct(snapshotFile));
+    } stCatch(except) {
+        thrown = 1;
+        stExcept_free(except);
+    } stTryEnd;
+    return thrown;
+}
+
+static void corruptIndexEntry(CuTest *testCase, int64_t entry, int64_t field, int64_t value) {
+    /*
+     * Overwrites a field (0 the key, 1 the offset, 2 the size) of an entry of the index of the test snapshot.
+     * The footer is the number of entries, the offset of the index, the generation and the magic.
+     */
+    FILE *fileHandle = fopen(TEST_SNAPSHOT_FILE, "r+b");
+    fseek(fileHandle, -4 * (int64_t) sizeof(int64_t), SEEK_END);
+    int64_t footer[2];
+    CuAssertTrue(testCase, fread(footer, sizeof(int64_t), 2, fileHandle) == 2);
+    fseek(fileHandle, footer[1] + (3 * entry + field) * sizeof(int64_t), SEEK_SET);
+    fwrite(&value, sizeof(int64_t), 1, fileHandle);
+    fclose(fileHandle);
+}
+
+static void writeTestSnapshot() {
+    CactusSnapshotWriter *writer = cactusSnapshotWriter_construct(TEST_SNAPSHOT_FILE, 0);
+    for (int64_t i = 0; i < 10; i++) {
+        cactusSnapshotWriter_add(writer, i, "record", 7);
+    }
+    cactusSnapshotWriter_finish(writer);
+}
+
+void testCactusSnapshot_corruptIndex(CuTest* testCase) {
+    /*
+     * Checks a snapshot whose index refers to records outside the file, or is not sorted, is rejected.
+     */
+    writeTestSnapshot();
+    CuAssertTrue(testCase, !constructThrows(TEST_SNAPSHOT_FILE));
+    corruptIndexEntry(testCase, 3, 2, INT64_MAX);
+    CuAssertTrue(testCase, constructThrows(TEST_SNAPSHOT_FILE));
+    writeTestSnapshot();
+    corruptIndexEntry(testCase, 5, 1, 1 << 30);
+    CuAssertTrue(testCase, constructThrows(TEST_SNAPSHOT_FILE));
+    writeTestSnapshot();
+    corruptIndexEntry(testCase, 5, 1, -8);
+    CuAssertTrue(testCase, constructThrows(TEST_SNAPSHOT_FILE));
+    writeTestSnapshot();
+    corruptIndexEntry(testCase, 5, 0, 2);
+    CuAssertTrue(testCase, constructThrows(TEST_SNAPSHOT_FILE));
+    remove(TEST_SNAPSHOT_FILE);
+}
+
+static void corruptRecord(CactusDisk *cactusDisk, Name name) {
+    stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+    stList_append(requests, stKVDatabaseBulkRequest_constructUpdateRequest(name, "corrupt", 8));
+    if (cactusDisk->localDatabase != NULL) {
+        cactusLocalDatabase_bulkSetRecords(cactusDisk->localDatabase, requests);
+    } else {
+        stKVDatabase_bulkSetRecords(cactusDisk->database, requests);
+    }
+    stList_destruct(requests);
+}
+
+void testCactusSnapshot_cactusDisk(CuTest* testCase) {
+    /*
+     * Checks the flowers, nested flowers and sequences exported to a snapshot are read from it, and that
+     * records the disk writes once the snapshot is open are read from the database.
+     */
+    stKVDatabaseConf *conf = testCommon_getTemporaryKVDatabaseConf();
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    char *string = stRandom_getRandomDNAString(150000, true, true, true);
+    MetaSequence *metaSequence = metaSequence_construct(0, strlen(string), string, "FOO", 10, cactusDisk);
+    Name metaSequenceName = metaSequence_getName(metaSequence);
+    Flower *flower = flower_construct(cactusDisk);
+    Flower *nestedFlower = flower_construct(cactusDisk);
+    group_construct(flower, nestedFlower);
+    sequence_construct(metaSequence, nestedFlower);
+    end_construct(0, nestedFlower);
+    Name flowerName = flower_getName(flower), nestedFlowerName = flower_getName(nestedFlower);
+    cactusDisk_write(cactusDisk);
+
+    stList *flowerNames = stList_construct();
+    stList_append(flowerNames, &flowerName);
+    cactusDisk_exportSnapshot(cactusDisk, flowerNames, TEST_SNAPSHOT_FILE);
+    stList_destruct(flowerNames);
+    cactusDisk_destruct(cactusDisk);
+
+    //Open the snapshot, then corrupt the records in the database, so they can only be read from the snapshot.
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_openSnapshot(cactusDisk, TEST_SNAPSHOT_FILE);
+    corruptRecord(cactusDisk, nestedFlowerName);
+    corruptRecord(cactusDisk, metaSequenceName);
+    nestedFlower = cactusDisk_getFlower(cactusDisk, nestedFlowerName);
+    CuAssertTrue(testCase, nestedFlower != NULL);
+    CuAssertIntEquals(testCase, 1, flower_getEndNumber(nestedFlower));
+    CuAssertIntEquals(testCase, 1, flower_getSequenceNumber(nestedFlower));
+    metaSequence = cactusDisk_getMetaSequence(cactusDisk, metaSequenceName);
+    CuAssertTrue(testCase, metaSequence != NULL);
+    for (int64_t i = 0; i < 100; i++) {
+        int64_t start = st_randomInt(0, strlen(string));
+        int64_t length = st_randomInt(0, strlen(string) - start + 1);
+        char *subString = stString_getSubString(string, start, length);
+        char *subString2 = metaSequence_getString(metaSequence, start, length, 1);
+        CuAssertStrEquals(testCase, subString, subString2);
+        free(subString);
+        free(subString2);
+    }
+
+    //Write the nested flower back, which the disk must then read from the database, not the snapshot.
+    end_construct(0, nestedFlower);
+    cactusDisk_write(cactusDisk);
+    flower_unload(nestedFlower);
+    cactusDisk_clearCache(cactusDisk);
+    nestedFlower = cactusDisk_getFlower(cactusDisk, nestedFlowerName);
+    CuAssertIntEquals(testCase, 2, flower_getEndNumber(nestedFlower));
+
+    free(string);
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+    stKVDatabaseConf_destruct(conf);
+    remove(TEST_SNAPSHOT_FILE);
+}
+
+void testCactusSnapshot_stale(CuTest* testCase) {
+    /*
+     * Checks a snapshot is refused once the disk has updated records since it was exported, but not
+     * when the disk has only inserted records.
+     */
+    stKVDatabaseConf *conf = testCommon_getTemporaryKVDatabaseConf();
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    Flower *flower = flower_construct(cactusDisk);
+    Name flowerName = flower_getName(flower);
+    cactusDisk_write(cactusDisk);
+    stList *flowerNames = stList_construct();
+    stList_append(flowerNames, &flowerName);
+    cactusDisk_exportSnapshot(cactusDisk, flowerNames, TEST_SNAPSHOT_FILE);
+    stList_destruct(flowerNames);
+
+    flower_construct(cactusDisk); //Only inserts a record.
+    cactusDisk_write(cactusDisk);
+    cactusDisk_openSnapshot(cactusDisk, TEST_SNAPSHOT_FILE);
+
+    end_construct(0, flower); //Updates the record of the flower in the snapshot.
+    cactusDisk_write(cactusDisk);
+    bool thrown = 0;
+    stTry {
+        cactusDisk_openSnapshot(cactusDisk, TEST_SNAPSHOT_FILE);
+    } stCatch(except) {
+        thrown = 1;
+        stExcept_free(except);
+    } stTryEnd;
+    CuAssertTrue(testCase, thrown);
+
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+    stKVDatabaseConf_destruct(conf);
+    remove(TEST_SNAPSHOT_FILE);
+}
+
+void testCactusSnapshot_remove(CuTest* testCase) {
+    /*
+     * Checks a flower in an open snapshot that the disk then deletes can no longer be loaded.
+     */
+    stKVDatabaseConf *conf = testCommon_getTemporaryKVDatabaseConf();
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    Flower *flower = flower_construct(cactusDisk);
+    Flower *nestedFlower = flower_construct(cactusDisk);
+    group_construct(flower, nestedFlower);
+    Name flowerName = flower_getName(flower), nestedFlowerName = flower_getName(nestedFlower);
+    cactusDisk_write(cactusDisk);
+    stList *flowerNames = stList_construct();
+    stList_append(flowerNames, &flowerName);
+    cactusDisk_exportSnapshot(cactusDisk, flowerNames, TEST_SNAPSHOT_FILE);
+    stList_destruct(flowerNames);
+    cactusDisk_destruct(cactusDisk);
+
+    cactusDisk = cactusDisk_construct(conf, false, true);
+    cactusDisk_openSnapshot(cactusDisk, TEST_SNAPSHOT_FILE);
+    nestedFlower = cactusDisk_getFlower(cactusDisk, nestedFlowerName);
+    CuAssertTrue(testCase, nestedFlower != NULL);
+    cactusDisk_deleteFlowerFromDisk(cactusDisk, nestedFlower);
+    flower_unload(nestedFlower);
+    cactusDisk_write(cactusDisk);
+    cactusDisk_clearCache(cactusDisk);
+    CuAssertTrue(testCase, cactusDisk_getFlower(cactusDisk, nestedFlowerName) == NULL);
+    //The write and the removal of the record of the deleted flower override only its key in the snapshot.
+    CuAssertIntEquals(testCase, 1, stSortedSet_size(cactusDisk->snapshotOverrides));
+    stIntTuple *key = stIntTuple_construct1(nestedFlowerName);
+    CuAssertTrue(testCase, stSortedSet_search(cactusDisk->snapshotOverrides, key) != NULL);
+    stIntTuple_destruct(key);
+
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+    stKVDatabaseConf_destruct(conf);
+    remove(TEST_SNAPSHOT_FILE);
+}
+
+CuSuite* cactusSnapshotTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCactusSnapshot_writeAndRead);
+    SUITE_ADD_TEST(suite, testCactusSnapshot_cactusDisk);
+    SUITE_ADD_TEST(suite, testCactusSnapshot_corruptIndex);
+    SUITE_ADD_TEST(suite, testCactusSnapshot_stale);
+    SUITE_ADD_TEST(suite, testCactusSnapshot_remove);
+    return suite;
+}
@@ -70,6 +70,10 @@ void usage() {
 
     fprintf(stderr, "-M --minimumCoverageToRescue : Unaligned segments must have at least this proportion of their bases covered by an outgroup to be rescued.\n");
 
+    fprintf(stderr, "-O --writeThreads : Number of threads used to serialise and compress the flowers written back to the cactus disk. Default 1.\n");
+
+    fprintf(stderr, "-P --readThreads : Number of threads used to decompress the flowers read from the cactus disk. Default 1.\n");
+
     fprintf(stderr, "-h --help : Print this help screen\n");
 }
 
@@ -111,6 +115,8 @@ int main(int argc, char *argv[]) {
     char *ingroupCoverageFilePath = NULL;
     int64_t minimumSizeToRescue = 1;
     double minimumCoverageToRescue = 0.0;
+    int64_t writeThreads = 1;
+    int64_t readThreads = 1;
 
     PairwiseAlignmentParameters *pairwiseAlignmentBandingParameters = pairwiseAlignmentBandingParameters_construct();
 
@@ -140,11 +146,13 @@ int main(int argc, char *argv[]) {
                         {"minimumSizeToRescue", required_argument, 0, 'K'},
                         {"minimumCoverageToRescue", required_argument, 0, 'M'},
                         { "minimumNumberOfSpecies", required_argument, 0, 'N' },
+                        { "writeThreads", required_argument, 0, 'O' },
+                        { "readThreads", required_argument, 0, 'P' },
                         { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:b:hi:j:kl:o:p:q:r:t:u:wy:A:B:D:E:FGI:J:K:L:M:N:", long_options, &option_index);
+        int key = getopt_long(argc, argv, "a:b:hi:j:kl:o:p:q:r:t:u:wy:A:B:D:E:FGI:J:K:L:M:N:O:P:", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -265,6 +273,18 @@ int main(int argc, char *argv[]) {
                     st_errAbort("Error parsing minimumNumberOfSpecies parameter");
                 }
                 break;
+            case 'O':
+                i = sscanf(optarg, "%" PRIi64, &writeThreads);
+                if (i != 1 || writeThreads < 1) {
+                    st_errAbort("Error parsing writeThreads parameter");
+                }
+                break;
+            case 'P':
+                i = sscanf(optarg, "%" PRIi64, &readThreads);
+                if (i != 1 || readThreads < 1) {
+                    st_errAbort("Error parsing readThreads parameter");
+                }
+                break;
             default:
                 usage();
                 return 1;
@@ -276,8 +296,9 @@ int main(int argc, char *argv[]) {
     /*
      * Load the flowerdisk
      */
-    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskDatabaseString);
-    CactusDisk *cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true); //We precache the sequences
+    CactusDisk *cactusDisk = cactusDisk_constructFromString(cactusDiskDatabaseString, false, true); //We precache the sequences
+    cactusDisk_setWriteThreads(cactusDisk, writeThreads);
+    cactusDisk_setReadThreads(cactusDisk, readThreads);
     st_logInfo("Set up the flower disk\n");
 
     /*
@@ -440,7 +461,6 @@ int main(int argc, char *argv[]) {
 
     stateMachine_destruct(sM);
     cactusDisk_destruct(cactusDisk);
-    stKVDatabaseConf_destruct(kvDatabaseConf);
     //destructCactusCoreInputParameters(cCIP);
     free(cactusDiskDatabaseString);
     if (listOfEndAlignmentFiles != NULL) {
@@ -11,8 +11,15 @@ int main(int argc, char *argv[]) {
 	/*
 	 * Sort cigar file in descending order of score.
 	 */
-	assert(argc == 4);
+	assert(argc == 4 || argc == 5);
 	st_setLogLevelFromString(argv[1]);
-	stCaf_sortCigarsFileByScoreInDescendingOrder(argv[2], argv[3]);
+	int64_t threads = 1; //Optionally given after the files.
+	if (argc == 5) {
+		int i = sscanf(argv[4], "%" PRIi64 "", &threads);
+		if (i != 1 || threads < 1) {
+			st_errAbort("Invalid number of threads: %s", argv[4]);
+		}
+	}
+	stCaf_sortCigarsFileByScoreInDescendingOrder(argv[2], argv[3], threads);
 	return 0;
 }
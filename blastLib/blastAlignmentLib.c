@@ -147,6 +147,7 @@ void setupToChunkSequences(int64_t chunkSize2, int64_t overlapSize2, const char
 
 int64_t writeFlowerSequences(Flower *flower, void(*processSequence)(const char *, const char *, int64_t), int64_t minimumSequenceLength) {
     Flower_EndIterator *endIterator = flower_getEndIterator(flower);
+    SequenceView *view = sequenceView_construct();
     End *end;
     int64_t sequencesWritten = 0;
     while ((end = flower_getNextEnd(endIterator)) != NULL) {
@@ -165,10 +166,9 @@ int64_t writeFlowerSequences(Flower *flower, void(*processSequence)(const char *
                 if (length >= minimumSequenceLength) {
                     Sequence *sequence = cap_getSequence(cap);
                     assert(sequence != NULL);
-                    char *string = sequence_getString(sequence, cap_getCoordinate(cap) + 1, length, 1);
+                    sequenceView_set(view, sequence, cap_getCoordinate(cap) + 1, length, 1);
                     char *header = stString_print("%s|%" PRIi64 "", cactusMisc_nameToStringStatic(cap_getName(cap)), cap_getCoordinate(cap) + 1);
-                    processSequence(header, string, strlen(string));
-                    free(string);
+                    processSequence(header, sequenceView_getForwardString(view), length);
                     free(header);
                     sequencesWritten++;
                 }
@@ -177,6 +177,7 @@ int64_t writeFlowerSequences(Flower *flower, void(*processSequence)(const char *
         end_destructInstanceIterator(instanceIterator);
     }
     flower_destructEndIterator(endIterator);
+    sequenceView_destruct(view);
     return sequencesWritten;
 }
 
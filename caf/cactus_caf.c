@@ -17,6 +17,7 @@
 #include "stLastzAlignments.h"
 #include "stGiantComponent.h"
 #include "stCafPhylogeny.h"
+#include "pairwiseAlignment.h"
 
 static void usage() {
     fprintf(stderr, "cactus_caf, version 0.2\n");
@@ -93,6 +94,9 @@ static void usage() {
     fprintf(stderr, "-T --minimumBlockHomologySupport: Minimum fraction of possible homologies required not to be considered a transitively collapsed megablock.\n");
     fprintf(stderr, "-U --phylogenyNucleotideScalingFactor: Weighting for the nucleotide information in the distance matrix used to build each tree.\n");
     fprintf(stderr, "-V --minimumBlockDegreeToCheckSupport: Minimum degree required to be checked for being a megablock.\n");
+    fprintf(stderr, "--writeThreads : Number of threads used to serialise and compress the flowers written back to the cactus disk. Default 1.\n");
+    fprintf(stderr, "--readThreads : Number of threads used to decompress the flowers read from the cactus disk. Default 1.\n");
+    fprintf(stderr, "--threads : Number of flowers aligned at once, each by its own thread, and of threads sorting the alignments. Default 1.\n");
 }
 
 static int64_t *getInts(const char *string, int64_t *arrayLength) {
@@ -113,7 +117,7 @@ static int64_t *getInts(const char *string, int64_t *arrayLength) {
 
 static int64_t minimumIngroupDegree = 0, minimumOutgroupDegree = 0, minimumDegree = 0, minimumNumberOfSpecies = 0;
 static float minimumTreeCoverage = 0.0;
-static Flower *flower = NULL;
+static __thread Flower *flower = NULL; //The flower being aligned by the thread.
 
 static bool blockFilterFn(stPinchBlock *pinchBlock) {
     if (!stCaf_containsRequiredSpecies(pinchBlock, flower, minimumIngroupDegree,
@@ -144,7 +148,7 @@ void stCaf_printBlock(stPinchBlock *block) {
 static uint64_t choose2(uint64_t n) {
 #define CHOOSE_TWO_CACHE_LEN 256
     // This is filled with 0's at init time by the compiler.
-    static int64_t chooseTwoCache[256];
+    static __thread int64_t chooseTwoCache[256];
     if (n <= 1) {
         return 0;
     } else if (n >= CHOOSE_TWO_CACHE_LEN) {
@@ -275,80 +279,320 @@ static void printThreadSetStatistics(stPinchThreadSet *threadSet, Flower *flower
     free(blockSupports);
 }
 
+///////////////////////////////////////////////////////////////////////////
+// Options, which are set by main and are then read only.
+///////////////////////////////////////////////////////////////////////////
+
+static bool (*filterFn)(stPinchSegment *, stPinchSegment *) = NULL;
+static bool (*secondaryFilterFn)(stPinchSegment *, stPinchSegment *) = NULL;
+
+static char * logLevelString = NULL;
+static char * alignmentsFile = NULL;
+static char * secondaryAlignmentsFile = NULL;
+static char * constraintsFile = NULL;
+static char * cactusDiskDatabaseString = NULL;
+static char * lastzArguments = "";
+static int64_t minimumSequenceLengthForBlast = 1;
+
+//Parameters for annealing/melting rounds
+static int64_t *annealingRounds = NULL;
+static int64_t annealingRoundsLength = 0;
+static int64_t *meltingRounds = NULL;
+static int64_t meltingRoundsLength = 0;
+
+//Parameters for melting
+static float maximumAdjacencyComponentSizeRatio = 10;
+static int64_t blockTrim = 0;
+static int64_t alignmentTrimLength = 0;
+static int64_t *alignmentTrims = NULL;
+static int64_t chainLengthForBigFlower = 1000000;
+static int64_t longChain = 2;
+static int64_t minLengthForChromosome = 1000000;
+static float proportionOfUnalignedBasesForNewChromosome = 0.8;
+static bool breakChainsAtReverseTandems = 1;
+static int64_t maximumMedianSequenceLengthBetweenLinkedEnds = INT64_MAX;
+static bool realign = 0;
+static char *realignArguments = "";
+static bool removeRecoverableChains = false;
+static bool (*recoverableChainsFilter)(stCactusEdgeEnd *, Flower *) = NULL;
+static int64_t maxRecoverableChainsIterations = 1;
+static int64_t maxRecoverableChainLength = INT64_MAX;
+
+//Parameters for removing ancient homologies
+static bool doPhylogeny = false;
+static int64_t phylogenyNumTrees = 1;
+static enum stCaf_RootingMethod phylogenyRootingMethod = BEST_RECON;
+static enum stCaf_ScoringMethod phylogenyScoringMethod = COMBINED_LIKELIHOOD;
+static double breakpointScalingFactor = 1.0;
+static bool phylogenySkipSingleCopyBlocks = 0;
+static int64_t phylogenyMaxBaseDistance = 1000;
+static int64_t phylogenyMaxBlockDistance = 100;
+static bool phylogenyKeepSingleDegreeBlocks = 0;
+static stList *phylogenyTreeBuildingMethods = NULL;
+static enum stCaf_TreeBuildingMethod defaultMethod = GUIDED_NEIGHBOR_JOINING;
+static double phylogenyCostPerDupPerBase = 0.2;
+static double phylogenyCostPerLossPerBase = 0.2;
+static const char *debugFileName = NULL;
+static const char *referenceEventHeader = NULL;
+static double phylogenyDoSplitsWithSupportHigherThanThisAllAtOnce = 1.0;
+static int64_t numTreeBuildingThreads = 2;
+static int64_t writeThreads = 1;
+static int64_t readThreads = 1;
+static int64_t threads = 1;
+static int64_t minimumBlockDegreeToCheckSupport = 10;
+static double minimumBlockHomologySupport = 0.7;
+static double nucleotideScalingFactor = 1.0;
+static HomologyUnitType phylogenyHomologyUnitType = BLOCK;
+static enum stCaf_DistanceCorrectionMethod phylogenyDistanceCorrectionMethod = JUKES_CANTOR;
+static bool sortAlignments = false;
+static char *hgvmEventName = NULL;
+
+///////////////////////////////////////////////////////////////////////////
+// Aligning a flower. Several flowers may be aligned at once, each by its
+// own thread, so all the state of a flower's alignment is in its task or
+// is per thread.
+///////////////////////////////////////////////////////////////////////////
+
+typedef struct _cafTask {
+    Flower *flower;
+    stPinchIterator *pinchIterator;
+    stPinchIterator *secondaryPinchIterator; //NULL if there are no secondary alignments.
+    stPinchIterator *pinchIteratorForConstraints; //NULL if there are no constraints.
+    stList *alignmentLists; //The lists of alignments the iterators read, which belong to the task.
+} CafTask;
+
+static CafTask *cafTask_construct(Flower *flower) {
+    CafTask *task = st_calloc(1, sizeof(CafTask));
+    task->flower = flower;
+    task->alignmentLists = stList_construct3(0, (void (*)(void *)) stList_destruct);
+    return task;
+}
+
+static void cafTask_destruct(CafTask *task) {
+    stPinchIterator_destruct(task->pinchIterator);
+    if (task->secondaryPinchIterator != NULL) {
+        stPinchIterator_destruct(task->secondaryPinchIterator);
+    }
+    if (task->pinchIteratorForConstraints != NULL) {
+        stPinchIterator_destruct(task->pinchIteratorForConstraints);
+    }
+    stList_destruct(task->alignmentLists);
+    free(task);
+}
+
+static stPinchIterator *cafTask_addAlignments(CafTask *task, stList *alignments) {
+    /*
+     * Gives the alignments to the task, returning an iterator over them.
+     */
+    stList_append(task->alignmentLists, alignments);
+    return stPinchIterator_constructFromList(alignments);
+}
+
+static int cafTask_cmpBySizeDescending(CafTask *task1, CafTask *task2) {
+    int64_t size1 = flower_getTotalBaseLength(task1->flower), size2 = flower_getTotalBaseLength(task2->flower);
+    return size1 > size2 ? -1 : (size1 < size2 ? 1 : 0);
+}
+
+static stList *splitAlignmentsBetweenTasks(const char *alignmentsFile, stList *tasks) {
+    stList *flowers = stList_construct();
+    for (int64_t i = 0; i < stList_length(tasks); i++) {
+        stList_append(flowers, ((CafTask *) stList_get(tasks, i))->flower);
+    }
+    stList *alignmentLists = stCaf_splitAlignmentsBetweenFlowers(alignmentsFile, flowers);
+    stList_destruct(flowers);
+    return alignmentLists;
+}
+
+static CafTask *processFlower(CafTask *task) {
+    /*
+     * Anneals and melts the alignments of the flower, then builds its cactus.
+     */
+    flower = task->flower;
+    stPinchIterator *pinchIterator = task->pinchIterator;
+    stPinchIterator *secondaryPinchIterator = task->secondaryPinchIterator;
+    stPinchIterator *pinchIteratorForConstraints = task->pinchIteratorForConstraints;
+
+    st_logDebug("Processing flower: %lli\n", flower_getName(flower));
+
+    stCaf_setFlowerForAlignmentFiltering(flower);
+
+    //Set up the graph and add the initial alignments
+    stPinchThreadSet *threadSet = stCaf_setup(flower);
+
+    //Build the set of outgroup threads
+    stSet *outgroupThreads = stCaf_getOutgroupThreads(flower, threadSet);
+
+    if (filterFn == stCaf_filterToEnsureCycleFreeIsolatedComponents) {
+        stCaf_setupHGVMFiltering(flower, threadSet, hgvmEventName);
+    }
+
+    for (int64_t annealingRound = 0; annealingRound < annealingRoundsLength; annealingRound++) {
+        int64_t minimumChainLength = annealingRounds[annealingRound];
+        int64_t alignmentTrim = annealingRound < alignmentTrimLength ? alignmentTrims[annealingRound] : 0;
+        st_logDebug("Starting annealing round with a minimum chain length of %" PRIi64 " and an alignment trim of %" PRIi64 "\n", minimumChainLength, alignmentTrim);
+
+        stPinchIterator_setTrim(pinchIterator, alignmentTrim);
+        if(secondaryPinchIterator != NULL) {
+        	stPinchIterator_setTrim(secondaryPinchIterator, alignmentTrim);
+        }
+
+        //Add back in the constraints
+        if (pinchIteratorForConstraints != NULL) {
+            stCaf_anneal(threadSet, pinchIteratorForConstraints, NULL);
+        }
+
+        //Do the annealing
+        if (annealingRound == 0) {
+            stCaf_anneal(threadSet, pinchIterator, filterFn);
+        } else {
+            stCaf_annealBetweenAdjacencyComponents(threadSet, pinchIterator, filterFn);
+        }
+
+        // Do the secondary annealing
+        if(secondaryPinchIterator != NULL) {
+					if (annealingRound == 0) {
+						stCaf_anneal(threadSet, secondaryPinchIterator, secondaryFilterFn);
+					} else {
+						stCaf_annealBetweenAdjacencyComponents(threadSet, secondaryPinchIterator, secondaryFilterFn);
+					}
+        }
+
+        // Dump the block degree and length distribution to a file
+        if (debugFileName != NULL) {
+            dumpBlockInfo(threadSet, stString_print("%s-blockStats-preMelting", debugFileName));
+        }
+
+        printf("Sequence graph statistics after annealing:\n");
+        printThreadSetStatistics(threadSet, flower, stdout);
+
+        // Check for poorly-supported blocks--those that have
+        // been transitively aligned together but with very
+        // few homologies supporting the transitive
+        // alignment. These "megablocks" can snarl up the
+        // graph so that a lot of extra gets thrown away in
+        // the first melting step.
+        stPinchThreadSetBlockIt blockIt = stPinchThreadSet_getBlockIt(threadSet);
+        stPinchBlock *block;
+        while ((block = stPinchThreadSetBlockIt_getNext(&blockIt)) != NULL) {
+            if (stPinchBlock_getDegree(block) > minimumBlockDegreeToCheckSupport) {
+                uint64_t supportingHomologies = stPinchBlock_getNumSupportingHomologies(block);
+                uint64_t possibleSupportingHomologies = numPossibleSupportingHomologies(block, flower);
+                double support = ((double) supportingHomologies) / possibleSupportingHomologies;
+                if (support < minimumBlockHomologySupport) {
+                    fprintf(stdout, "Destroyed a megablock with degree %" PRIi64
+                            " and %" PRIi64 " supporting homologies out of a maximum "
+                            "of %" PRIi64 " (%lf%%).\n", stPinchBlock_getDegree(block),
+                            supportingHomologies, possibleSupportingHomologies, support);
+                    stPinchBlock_destruct(block);
+                }
+            }
+        }
+
+        //Do the melting rounds
+        for (int64_t meltingRound = 0; meltingRound < meltingRoundsLength; meltingRound++) {
+            int64_t minimumChainLengthForMeltingRound = meltingRounds[meltingRound];
+            st_logDebug("Starting melting round with a minimum chain length of %" PRIi64 " \n", minimumChainLengthForMeltingRound);
+            if (minimumChainLengthForMeltingRound >= minimumChainLength) {
+                break;
+            }
+            stCaf_melt(flower, threadSet, NULL, 0, minimumChainLengthForMeltingRound, 0, INT64_MAX);
+        } st_logDebug("Last melting round of cycle with a minimum chain length of %" PRIi64 " \n", minimumChainLength);
+        stCaf_melt(flower, threadSet, NULL, 0, minimumChainLength, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds);
+        //This does the filtering of blocks that do not have the required species/tree-coverage/degree.
+        stCaf_melt(flower, threadSet, blockFilterFn, blockTrim, 0, 0, INT64_MAX);
+    }
+
+    if (removeRecoverableChains) {
+        stCaf_meltRecoverableChains(flower, threadSet, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds, recoverableChainsFilter, maxRecoverableChainsIterations, maxRecoverableChainLength);
+    }
+    if (debugFileName != NULL) {
+        dumpBlockInfo(threadSet, stString_print("%s-blockStats-postMelting", debugFileName));
+    }
+
+    printf("Sequence graph statistics after melting:\n");
+    printThreadSetStatistics(threadSet, flower, stdout);
+
+    // Build a tree for each block, then use each tree to
+    // partition the homologies between the ingroups sequences
+    // into those that occur before the speciation with the
+    // outgroup and those which occur late.
+
+    if (stSet_size(outgroupThreads) > 0 && doPhylogeny) {
+        st_logDebug("Starting to build trees and partition ingroup homologies\n");
+        stHash *threadStrings = stCaf_getThreadStrings(flower, threadSet);
+        st_logDebug("Got sets of thread strings and set of threads that are outgroups\n");
+        stCaf_PhylogenyParameters params;
+        params.distanceCorrectionMethod = phylogenyDistanceCorrectionMethod;
+        params.treeBuildingMethods = phylogenyTreeBuildingMethods;
+        params.rootingMethod = phylogenyRootingMethod;
+        params.scoringMethod = phylogenyScoringMethod;
+        params.breakpointScalingFactor = breakpointScalingFactor;
+        params.nucleotideScalingFactor = nucleotideScalingFactor;
+        params.skipSingleCopyBlocks = phylogenySkipSingleCopyBlocks;
+        params.keepSingleDegreeBlocks = phylogenyKeepSingleDegreeBlocks;
+        params.costPerDupPerBase = phylogenyCostPerDupPerBase;
+        params.costPerLossPerBase = phylogenyCostPerLossPerBase;
+        params.maxBaseDistance = phylogenyMaxBaseDistance;
+        params.maxBlockDistance = phylogenyMaxBlockDistance;
+        params.numTrees = phylogenyNumTrees;
+        params.ignoreUnalignedBases = 1;
+        params.onlyIncludeCompleteFeatureBlocks = 0;
+        params.doSplitsWithSupportHigherThanThisAllAtOnce = phylogenyDoSplitsWithSupportHigherThanThisAllAtOnce;
+        params.numTreeBuildingThreads = numTreeBuildingThreads;
+
+        assert(params.numTreeBuildingThreads >= 1);
+
+        stCaf_buildTreesToRemoveAncientHomologies(
+            threadSet, phylogenyHomologyUnitType, threadStrings, outgroupThreads, flower, &params,
+            debugFileName == NULL ? NULL : stString_print("%s-phylogeny", debugFileName), referenceEventHeader);
+        stHash_destruct(threadStrings);
+        st_logDebug("Finished building trees\n");
+
+        if (removeRecoverableChains) {
+            // We melt recoverable chains after splitting, as
+            // well as before, to alleviate coverage loss
+            // caused by bad splits.
+            stCaf_meltRecoverableChains(flower, threadSet, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds, recoverableChainsFilter, maxRecoverableChainsIterations, maxRecoverableChainLength);
+        }
+
+        // Enforce the block constraints on minimum degree,
+        // etc. after splitting.
+        stCaf_melt(flower, threadSet, blockFilterFn, 0, 0, 0, INT64_MAX);
+    }
+
+    //Sort out case when we allow blocks of degree 1
+    if (minimumDegree < 2) {
+        st_logDebug("Creating degree 1 blocks\n");
+        stCaf_makeDegreeOneBlocks(threadSet);
+        stCaf_melt(flower, threadSet, blockFilterFn, blockTrim, 0, 0, INT64_MAX);
+    } else if (maximumAdjacencyComponentSizeRatio < INT64_MAX) { //Deal with giant components
+        st_logDebug("Breaking up components greedily\n");
+        stCaf_breakupComponentsGreedily(threadSet, maximumAdjacencyComponentSizeRatio);
+    }
+
+    //Finish up
+    stCaf_finish(flower, threadSet, chainLengthForBigFlower, longChain, minLengthForChromosome,
+            proportionOfUnalignedBasesForNewChromosome); //Flower is then destroyed at this point.
+    st_logInfo("Ran the cactus core script\n");
+
+    //Cleanup
+    stPinchThreadSet_destruct(threadSet);
+    stSet_destruct(outgroupThreads);
+    stCaf_clearFlowerForAlignmentFiltering();
+    st_logInfo("Cleaned up from aligning the flower\n");
+    return task;
+}
+
 int main(int argc, char *argv[]) {
     /*
      * Script for adding alignments to cactus tree.
      */
     int64_t startTime;
-    stKVDatabaseConf *kvDatabaseConf;
     CactusDisk *cactusDisk;
     int key, k;
 
-    bool (*filterFn)(stPinchSegment *, stPinchSegment *) = NULL;
-    bool (*secondaryFilterFn)(stPinchSegment *, stPinchSegment *) = NULL;
-    stSet *outgroupThreads = NULL;
-
-    /*
-     * Arguments/options
-     */
-    char * logLevelString = NULL;
-    char * alignmentsFile = NULL;
-    char * secondaryAlignmentsFile = NULL;
-    char * constraintsFile = NULL;
-    char * cactusDiskDatabaseString = NULL;
-    char * lastzArguments = "";
-    int64_t minimumSequenceLengthForBlast = 1;
-
-    //Parameters for annealing/melting rounds
-    int64_t *annealingRounds = NULL;
-    int64_t annealingRoundsLength = 0;
-    int64_t *meltingRounds = NULL;
-    int64_t meltingRoundsLength = 0;
-
-    //Parameters for melting
-    float maximumAdjacencyComponentSizeRatio = 10;
-    int64_t blockTrim = 0;
-    int64_t alignmentTrimLength = 0;
-    int64_t *alignmentTrims = NULL;
-    int64_t chainLengthForBigFlower = 1000000;
-    int64_t longChain = 2;
-    int64_t minLengthForChromosome = 1000000;
-    float proportionOfUnalignedBasesForNewChromosome = 0.8;
-    bool breakChainsAtReverseTandems = 1;
-    int64_t maximumMedianSequenceLengthBetweenLinkedEnds = INT64_MAX;
-    bool realign = 0;
-    char *realignArguments = "";
-    bool removeRecoverableChains = false;
-    bool (*recoverableChainsFilter)(stCactusEdgeEnd *, Flower *) = NULL;
-    int64_t maxRecoverableChainsIterations = 1;
-    int64_t maxRecoverableChainLength = INT64_MAX;
-
-    //Parameters for removing ancient homologies
-    bool doPhylogeny = false;
-    int64_t phylogenyNumTrees = 1;
-    enum stCaf_RootingMethod phylogenyRootingMethod = BEST_RECON;
-    enum stCaf_ScoringMethod phylogenyScoringMethod = COMBINED_LIKELIHOOD;
-    double breakpointScalingFactor = 1.0;
-    bool phylogenySkipSingleCopyBlocks = 0;
-    int64_t phylogenyMaxBaseDistance = 1000;
-    int64_t phylogenyMaxBlockDistance = 100;
-    bool phylogenyKeepSingleDegreeBlocks = 0;
-    stList *phylogenyTreeBuildingMethods = stList_construct();
-    enum stCaf_TreeBuildingMethod defaultMethod = GUIDED_NEIGHBOR_JOINING;
+    phylogenyTreeBuildingMethods = stList_construct();
     stList_append(phylogenyTreeBuildingMethods, &defaultMethod);
-    double phylogenyCostPerDupPerBase = 0.2;
-    double phylogenyCostPerLossPerBase = 0.2;
-    const char *debugFileName = NULL;
-    const char *referenceEventHeader = NULL;
-    double phylogenyDoSplitsWithSupportHigherThanThisAllAtOnce = 1.0;
-    int64_t numTreeBuildingThreads = 2;
-    int64_t minimumBlockDegreeToCheckSupport = 10;
-    double minimumBlockHomologySupport = 0.7;
-    double nucleotideScalingFactor = 1.0;
-    HomologyUnitType phylogenyHomologyUnitType = BLOCK;
-    enum stCaf_DistanceCorrectionMethod phylogenyDistanceCorrectionMethod = JUKES_CANTOR;
-    bool sortAlignments = false;
-    char *hgvmEventName = NULL;
 
     ///////////////////////////////////////////////////////////////////////////
     // (0) Parse the inputs handed by genomeCactus.py / setup stuff.
@@ -404,6 +648,9 @@ int main(int argc, char *argv[]) {
 				{ "maxRecoverableChainsIterations", required_argument, 0, '1' },
 				{ "maxRecoverableChainLength", required_argument, 0, '2' },
 				{ "secondaryAlignments", required_argument, 0, '3' },
+				{ "writeThreads", required_argument, 0, '4' },
+				{ "readThreads", required_argument, 0, '5' },
+				{ "threads", required_argument, 0, '6' },
 				{ 0, 0, 0, 0 } };
 
         int option_index = 0;
@@ -697,6 +944,24 @@ int main(int argc, char *argv[]) {
             case '3':
                 secondaryAlignmentsFile = stString_copy(optarg);
                 break;
+            case '4':
+                k = sscanf(optarg, "%" PRIi64, &writeThreads);
+                if (k != 1 || writeThreads < 1) {
+                    st_errAbort("Error parsing the writeThreads argument");
+                }
+                break;
+            case '5':
+                k = sscanf(optarg, "%" PRIi64, &readThreads);
+                if (k != 1 || readThreads < 1) {
+                    st_errAbort("Error parsing the readThreads argument");
+                }
+                break;
+            case '6':
+                k = sscanf(optarg, "%" PRIi64, &threads);
+                if (k != 1 || threads < 1) {
+                    st_errAbort("Error parsing the threads argument");
+                }
+                break;
             default:
                 usage();
                 return 1;
@@ -743,20 +1008,11 @@ int main(int argc, char *argv[]) {
     //Load the database
     //////////////////////////////////////////////
 
-    kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskDatabaseString);
-    cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
+    cactusDisk = cactusDisk_constructFromString(cactusDiskDatabaseString, false, true);
+    cactusDisk_setWriteThreads(cactusDisk, writeThreads);
+    cactusDisk_setReadThreads(cactusDisk, readThreads);
     st_logInfo("Set up the flower disk\n");
 
-    ///////////////////////////////////////////////////////////////////////////
-    // Get the constraints
-    ///////////////////////////////////////////////////////////////////////////
-
-    stPinchIterator *pinchIteratorForConstraints = NULL;
-    if (constraintsFile != NULL) {
-        pinchIteratorForConstraints = stPinchIterator_constructFromFile(constraintsFile);
-        st_logInfo("Created an iterator for the alignment constaints from file: %s\n", constraintsFile);
-    }
-
     ///////////////////////////////////////////////////////////////////////////
     // Do the alignment
     ///////////////////////////////////////////////////////////////////////////
@@ -767,233 +1023,98 @@ int main(int argc, char *argv[]) {
     if (alignmentsFile == NULL) {
         cactusDisk_preCacheStrings(cactusDisk, flowers);
     }
-    char *tempFile1 = NULL;
+    stList *tasks = stList_construct3(0, (void (*)(void *)) cafTask_destruct);
     for (int64_t i = 0; i < stList_length(flowers); i++) {
-        flower = stList_get(flowers, i);
-        if (!flower_builtBlocks(flower)) { // Do nothing if the flower already has defined blocks
-            st_logDebug("Processing flower: %lli\n", flower_getName(flower));
-
-            stCaf_setFlowerForAlignmentFiltering(flower);
-
-            //Set up the graph and add the initial alignments
-            stPinchThreadSet *threadSet = stCaf_setup(flower);
-
-            //Build the set of outgroup threads
-            outgroupThreads = stCaf_getOutgroupThreads(flower, threadSet);
+        if (!flower_builtBlocks(stList_get(flowers, i))) { // Do nothing if the flower already has defined blocks
+            stList_append(tasks, cafTask_construct(stList_get(flowers, i)));
+        } else {
+            st_logInfo("We've already built blocks / alignments for this flower\n");
+        }
+    }
 
-            if (filterFn == stCaf_filterToEnsureCycleFreeIsolatedComponents) {
-                stCaf_setupHGVMFiltering(flower, threadSet, hgvmEventName);
+    //Setup the alignments
+    char *tempFile1 = NULL;
+    if (stList_length(tasks) > 0 && alignmentsFile != NULL) {
+        if (sortAlignments) {
+            tempFile1 = getTempFile();
+            stCaf_sortCigarsFileByScoreInDescendingOrder(alignmentsFile, tempFile1, threads);
+        }
+        char *sortedAlignmentsFile = tempFile1 != NULL ? tempFile1 : alignmentsFile;
+        if (stList_length(tasks) == 1) { //The alignments are read from the files as they are annealed.
+            CafTask *task = stList_get(tasks, 0);
+            task->pinchIterator = stPinchIterator_constructFromFile(sortedAlignmentsFile);
+            if (secondaryAlignmentsFile != NULL) {
+                task->secondaryPinchIterator = stPinchIterator_constructFromFile(secondaryAlignmentsFile);
             }
-
-            //Setup the alignments
-            stPinchIterator *pinchIterator;
-            stPinchIterator *secondaryPinchIterator = NULL;
-            stList *alignmentsList = NULL;
-            if (alignmentsFile != NULL) {
-                assert(i == 0);
-                assert(stList_length(flowers) == 1);
-
-                if (sortAlignments) {
-                    tempFile1 = getTempFile();
-                    stCaf_sortCigarsFileByScoreInDescendingOrder(alignmentsFile, tempFile1);
-                    pinchIterator = stPinchIterator_constructFromFile(tempFile1);
-                } else {
-                    pinchIterator = stPinchIterator_constructFromFile(alignmentsFile);
-                }
-
-                if(secondaryAlignmentsFile != NULL) {
-                	secondaryPinchIterator = stPinchIterator_constructFromFile(secondaryAlignmentsFile);
-                }
-
-            } else {
-                assert(0);
-            	stThrowNew(CACTUS_CHECK_EXCEPTION_ID, " This is no longer supported \n"); // I think we need to clean up this code path, given that we don't do the recursive annealing thing anymore.
-
-                if (tempFile1 == NULL) {
-                    tempFile1 = getTempFile();
-                }
-                alignmentsList = stCaf_selfAlignFlower(flower, minimumSequenceLengthForBlast, lastzArguments, realign, realignArguments, tempFile1);
-                if (sortAlignments) {
-                    stCaf_sortCigarsByScoreInDescendingOrder(alignmentsList);
-                }
-                st_logDebug("Ran lastz and have %" PRIi64 " alignments\n", stList_length(alignmentsList));
-                pinchIterator = stPinchIterator_constructFromList(alignmentsList);
+            if (constraintsFile != NULL) {
+                task->pinchIteratorForConstraints = stPinchIterator_constructFromFile(constraintsFile);
+                st_logInfo("Created an iterator for the alignment constaints from file: %s\n", constraintsFile);
             }
-
-            for (int64_t annealingRound = 0; annealingRound < annealingRoundsLength; annealingRound++) {
-                int64_t minimumChainLength = annealingRounds[annealingRound];
-                int64_t alignmentTrim = annealingRound < alignmentTrimLength ? alignmentTrims[annealingRound] : 0;
-                st_logDebug("Starting annealing round with a minimum chain length of %" PRIi64 " and an alignment trim of %" PRIi64 "\n", minimumChainLength, alignmentTrim);
-
-                stPinchIterator_setTrim(pinchIterator, alignmentTrim);
-                if(secondaryPinchIterator != NULL) {
-                	stPinchIterator_setTrim(secondaryPinchIterator, alignmentTrim);
-                }
-
-                //Add back in the constraints
-                if (pinchIteratorForConstraints != NULL) {
-                    stCaf_anneal(threadSet, pinchIteratorForConstraints, NULL);
-                }
-
-                //Do the annealing
-                if (annealingRound == 0) {
-                    stCaf_anneal(threadSet, pinchIterator, filterFn);
-                } else {
-                    stCaf_annealBetweenAdjacencyComponents(threadSet, pinchIterator, filterFn);
+        } else { //The files are read once, and their alignments split between the flowers.
+            stList *alignmentLists = splitAlignmentsBetweenTasks(sortedAlignmentsFile, tasks);
+            stList *secondaryAlignmentLists = secondaryAlignmentsFile != NULL
+                    ? splitAlignmentsBetweenTasks(secondaryAlignmentsFile, tasks) : NULL;
+            stList *constraintLists = constraintsFile != NULL ? splitAlignmentsBetweenTasks(constraintsFile, tasks) : NULL;
+            for (int64_t i = 0; i < stList_length(tasks); i++) {
+                CafTask *task = stList_get(tasks, i);
+                task->pinchIterator = cafTask_addAlignments(task, stList_get(alignmentLists, i));
+                if (secondaryAlignmentLists != NULL) {
+                    task->secondaryPinchIterator = cafTask_addAlignments(task, stList_get(secondaryAlignmentLists, i));
                 }
-
-                // Do the secondary annealing
-                if(secondaryPinchIterator != NULL) {
-					if (annealingRound == 0) {
-						stCaf_anneal(threadSet, secondaryPinchIterator, secondaryFilterFn);
-					} else {
-						stCaf_annealBetweenAdjacencyComponents(threadSet, secondaryPinchIterator, secondaryFilterFn);
-					}
-                }
-
-                // Dump the block degree and length distribution to a file
-                if (debugFileName != NULL) {
-                    dumpBlockInfo(threadSet, stString_print("%s-blockStats-preMelting", debugFileName));
+                if (constraintLists != NULL) {
+                    task->pinchIteratorForConstraints = cafTask_addAlignments(task, stList_get(constraintLists, i));
                 }
-
-                printf("Sequence graph statistics after annealing:\n");
-                printThreadSetStatistics(threadSet, flower, stdout);
-
-                // Check for poorly-supported blocks--those that have
-                // been transitively aligned together but with very
-                // few homologies supporting the transitive
-                // alignment. These "megablocks" can snarl up the
-                // graph so that a lot of extra gets thrown away in
-                // the first melting step.
-                stPinchThreadSetBlockIt blockIt = stPinchThreadSet_getBlockIt(threadSet);
-                stPinchBlock *block;
-                while ((block = stPinchThreadSetBlockIt_getNext(&blockIt)) != NULL) {
-                    if (stPinchBlock_getDegree(block) > minimumBlockDegreeToCheckSupport) {
-                        uint64_t supportingHomologies = stPinchBlock_getNumSupportingHomologies(block);
-                        uint64_t possibleSupportingHomologies = numPossibleSupportingHomologies(block, flower);
-                        double support = ((double) supportingHomologies) / possibleSupportingHomologies;
-                        if (support < minimumBlockHomologySupport) {
-                            fprintf(stdout, "Destroyed a megablock with degree %" PRIi64
-                                    " and %" PRIi64 " supporting homologies out of a maximum "
-                                    "of %" PRIi64 " (%lf%%).\n", stPinchBlock_getDegree(block),
-                                    supportingHomologies, possibleSupportingHomologies, support);
-                            stPinchBlock_destruct(block);
-                        }
-                    }
-                }
-
-                //Do the melting rounds
-                for (int64_t meltingRound = 0; meltingRound < meltingRoundsLength; meltingRound++) {
-                    int64_t minimumChainLengthForMeltingRound = meltingRounds[meltingRound];
-                    st_logDebug("Starting melting round with a minimum chain length of %" PRIi64 " \n", minimumChainLengthForMeltingRound);
-                    if (minimumChainLengthForMeltingRound >= minimumChainLength) {
-                        break;
-                    }
-                    stCaf_melt(flower, threadSet, NULL, 0, minimumChainLengthForMeltingRound, 0, INT64_MAX);
-                } st_logDebug("Last melting round of cycle with a minimum chain length of %" PRIi64 " \n", minimumChainLength);
-                stCaf_melt(flower, threadSet, NULL, 0, minimumChainLength, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds);
-                //This does the filtering of blocks that do not have the required species/tree-coverage/degree.
-                stCaf_melt(flower, threadSet, blockFilterFn, blockTrim, 0, 0, INT64_MAX);
             }
-
-            if (removeRecoverableChains) {
-                stCaf_meltRecoverableChains(flower, threadSet, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds, recoverableChainsFilter, maxRecoverableChainsIterations, maxRecoverableChainLength);
+            stList_destruct(alignmentLists);
+            if (secondaryAlignmentLists != NULL) {
+                stList_destruct(secondaryAlignmentLists);
             }
-            if (debugFileName != NULL) {
-                dumpBlockInfo(threadSet, stString_print("%s-blockStats-postMelting", debugFileName));
+            if (constraintLists != NULL) {
+                stList_destruct(constraintLists);
             }
-
-            printf("Sequence graph statistics after melting:\n");
-            printThreadSetStatistics(threadSet, flower, stdout);
-
-            // Build a tree for each block, then use each tree to
-            // partition the homologies between the ingroups sequences
-            // into those that occur before the speciation with the
-            // outgroup and those which occur late.
-
-            if (stSet_size(outgroupThreads) > 0 && doPhylogeny) {
-                st_logDebug("Starting to build trees and partition ingroup homologies\n");
-                stHash *threadStrings = stCaf_getThreadStrings(flower, threadSet);
-                st_logDebug("Got sets of thread strings and set of threads that are outgroups\n");
-                stCaf_PhylogenyParameters params;
-                params.distanceCorrectionMethod = phylogenyDistanceCorrectionMethod;
-                params.treeBuildingMethods = phylogenyTreeBuildingMethods;
-                params.rootingMethod = phylogenyRootingMethod;
-                params.scoringMethod = phylogenyScoringMethod;
-                params.breakpointScalingFactor = breakpointScalingFactor;
-                params.nucleotideScalingFactor = nucleotideScalingFactor;
-                params.skipSingleCopyBlocks = phylogenySkipSingleCopyBlocks;
-                params.keepSingleDegreeBlocks = phylogenyKeepSingleDegreeBlocks;
-                params.costPerDupPerBase = phylogenyCostPerDupPerBase;
-                params.costPerLossPerBase = phylogenyCostPerLossPerBase;
-                params.maxBaseDistance = phylogenyMaxBaseDistance;
-                params.maxBlockDistance = phylogenyMaxBlockDistance;
-                params.numTrees = phylogenyNumTrees;
-                params.ignoreUnalignedBases = 1;
-                params.onlyIncludeCompleteFeatureBlocks = 0;
-                params.doSplitsWithSupportHigherThanThisAllAtOnce = phylogenyDoSplitsWithSupportHigherThanThisAllAtOnce;
-                params.numTreeBuildingThreads = numTreeBuildingThreads;
-
-                assert(params.numTreeBuildingThreads >= 1);
-
-                stCaf_buildTreesToRemoveAncientHomologies(
-                    threadSet, phylogenyHomologyUnitType, threadStrings, outgroupThreads, flower, &params,
-                    debugFileName == NULL ? NULL : stString_print("%s-phylogeny", debugFileName), referenceEventHeader);
-                stHash_destruct(threadStrings);
-                st_logDebug("Finished building trees\n");
-
-                if (removeRecoverableChains) {
-                    // We melt recoverable chains after splitting, as
-                    // well as before, to alleviate coverage loss
-                    // caused by bad splits.
-                    stCaf_meltRecoverableChains(flower, threadSet, breakChainsAtReverseTandems, maximumMedianSequenceLengthBetweenLinkedEnds, recoverableChainsFilter, maxRecoverableChainsIterations, maxRecoverableChainLength);
-                }
-
-                // Enforce the block constraints on minimum degree,
-                // etc. after splitting.
-                stCaf_melt(flower, threadSet, blockFilterFn, 0, 0, 0, INT64_MAX);
-            }
-
-            //Sort out case when we allow blocks of degree 1
-            if (minimumDegree < 2) {
-                st_logDebug("Creating degree 1 blocks\n");
-                stCaf_makeDegreeOneBlocks(threadSet);
-                stCaf_melt(flower, threadSet, blockFilterFn, blockTrim, 0, 0, INT64_MAX);
-            } else if (maximumAdjacencyComponentSizeRatio < INT64_MAX) { //Deal with giant components
-                st_logDebug("Breaking up components greedily\n");
-                stCaf_breakupComponentsGreedily(threadSet, maximumAdjacencyComponentSizeRatio);
-            }
-
-            //Finish up
-            stCaf_finish(flower, threadSet, chainLengthForBigFlower, longChain, minLengthForChromosome,
-                    proportionOfUnalignedBasesForNewChromosome); //Flower is then destroyed at this point.
-            st_logInfo("Ran the cactus core script\n");
-
-            //Cleanup
-            stPinchThreadSet_destruct(threadSet);
-            stPinchIterator_destruct(pinchIterator);
-            if(secondaryPinchIterator != NULL) {
-            	free(secondaryPinchIterator);
+        }
+    } else if (stList_length(tasks) > 0) {
+        assert(0);
+        stThrowNew(CACTUS_CHECK_EXCEPTION_ID, " This is no longer supported \n"); // I think we need to clean up this code path, given that we don't do the recursive annealing thing anymore.
+
+        tempFile1 = getTempFile();
+        for (int64_t i = 0; i < stList_length(tasks); i++) {
+            CafTask *task = stList_get(tasks, i);
+            stList *alignmentsList = stCaf_selfAlignFlower(task->flower, minimumSequenceLengthForBlast, lastzArguments, realign, realignArguments, tempFile1);
+            if (sortAlignments) {
+                stCaf_sortCigarsByScoreInDescendingOrder(alignmentsList);
             }
-            stSet_destruct(outgroupThreads);
+            st_logDebug("Ran lastz and have %" PRIi64 " alignments\n", stList_length(alignmentsList));
+            task->pinchIterator = cafTask_addAlignments(task, alignmentsList);
+        }
+    }
 
-            if (alignmentsList != NULL) {
-                stList_destruct(alignmentsList);
-            }
-            st_logInfo("Cleaned up from main loop\n");
-        } else {
-            st_logInfo("We've already built blocks / alignments for this flower\n");
+    //Align the flowers. With several threads, several flowers are aligned at once, the biggest first so the
+    //flowers left to align at the end are small and the threads finish together.
+    int64_t threadNumber = threads < stList_length(tasks) ? threads : stList_length(tasks);
+    if (threadNumber <= 1) {
+        for (int64_t i = 0; i < stList_length(tasks); i++) {
+            processFlower(stList_get(tasks, i));
         }
+    } else {
+        stList_sort(tasks, (int (*)(const void *, const void *)) cafTask_cmpBySizeDescending);
+        cactusDisk_setThreadSafe(cactusDisk, 1);
+        stThreadPool *threadPool = stThreadPool_construct(threadNumber, (void *(*)(void *)) processFlower,
+                cactusMisc_threadPoolNoFinish);
+        for (int64_t i = 0; i < stList_length(tasks); i++) {
+            stThreadPool_push(threadPool, stList_get(tasks, i));
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+        cactusDisk_setThreadSafe(cactusDisk, 0);
     }
+    st_logInfo("Aligned %" PRIi64 " flowers\n", stList_length(tasks));
+    stList_destruct(tasks);
     stList_destruct(flowers);
     if (tempFile1 != NULL) {
         st_system("rm %s", tempFile1);
     }
 
-    if (constraintsFile != NULL) {
-        stPinchIterator_destruct(pinchIteratorForConstraints);
-    }
-
     ///////////////////////////////////////////////////////////////////////////
     // Write the flower to disk.
     ///////////////////////////////////////////////////////////////////////////
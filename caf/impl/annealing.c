@@ -4,6 +4,7 @@
 #include "stPinchIterator.h"
 #include "stCactusGraphs.h"
 #include "stCaf.h"
+#include "pairwiseAlignment.h"
 
 ///////////////////////////////////////////////////////////////////////////
 // Code to safely join all the trivial boundaries in the pinch graph, while
@@ -175,3 +176,49 @@ void stCaf_annealBetweenAdjacencyComponents(stPinchThreadSet *threadSet, stPinch
     stCaf_annealBetweenAdjacencyComponents2(threadSet, (stPinch *(*)(void *)) stPinchIterator_getNext, pinchIterator, filterFn);
     stCaf_joinTrivialBoundaries(threadSet);
 }
+
+///////////////////////////////////////////////////////////////////////////
+// Splitting the alignments of a file between flowers aligned at once.
+///////////////////////////////////////////////////////////////////////////
+
+stList *stCaf_splitAlignmentsBetweenFlowers(const char *alignmentsFile, stList *flowers) {
+    stHash *capNamesToFlowers = stHash_construct3((uint64_t (*)(const void *)) stIntTuple_hashKey,
+            (int (*)(const void *, const void *)) stIntTuple_equalsFn, (void (*)(void *)) stIntTuple_destruct, NULL);
+    stList *alignmentLists = stList_construct();
+    for (int64_t i = 0; i < stList_length(flowers); i++) {
+        Flower_CapIterator *capIt = flower_getCapIterator(stList_get(flowers, i));
+        Cap *cap;
+        while ((cap = flower_getNextCap(capIt)) != NULL) {
+            stHash_insert(capNamesToFlowers, stIntTuple_construct1(cap_getName(cap)), stIntTuple_construct1(i));
+        }
+        flower_destructCapIterator(capIt);
+        stList_append(alignmentLists, stList_construct3(0, (void (*)(void *)) destructPairwiseAlignment));
+    }
+    FILE *fileHandle = fopen(alignmentsFile, "r");
+    if (fileHandle == NULL) {
+        st_errnoAbort("Could not open the alignments file: %s", alignmentsFile);
+    }
+    struct PairwiseAlignment *pairwiseAlignment;
+    while ((pairwiseAlignment = cigarRead(fileHandle)) != NULL) {
+        stIntTuple *name1 = stIntTuple_construct1(cactusMisc_stringToName(pairwiseAlignment->contig1));
+        stIntTuple *name2 = stIntTuple_construct1(cactusMisc_stringToName(pairwiseAlignment->contig2));
+        stIntTuple *flowerIndex1 = stHash_search(capNamesToFlowers, name1);
+        stIntTuple *flowerIndex2 = stHash_search(capNamesToFlowers, name2);
+        if (flowerIndex1 == NULL || flowerIndex2 == NULL || stIntTuple_get(flowerIndex1, 0) != stIntTuple_get(flowerIndex2, 0)) {
+            st_errAbort("The alignment between %s and %s is not between the sequences of one of the flowers",
+                    pairwiseAlignment->contig1, pairwiseAlignment->contig2);
+        }
+        stList_append(stList_get(alignmentLists, stIntTuple_get(flowerIndex1, 0)), pairwiseAlignment);
+        stIntTuple_destruct(name1);
+        stIntTuple_destruct(name2);
+    }
+    fclose(fileHandle);
+    stHashIterator *it = stHash_getIterator(capNamesToFlowers);
+    stIntTuple *key;
+    while ((key = stHash_getNext(it)) != NULL) {
+        stIntTuple_destruct(stHash_search(capNamesToFlowers, key));
+    }
+    stHash_destructIterator(it);
+    stHash_destruct(capNamesToFlowers);
+    return alignmentLists;
+}
@@ -0,0 +1,400 @@
+/*
+ * cigarSort.c
+ *
+ * External merge sort of files of cigars.
+ */
+
+#include <ctype.h>
+#include "sonLib.h"
+#include "cactus.h"
+#include "stCigarSort.h"
+
+/*
+ * A line of a cigar file, "cigar: contig1 start1 end1 strand1 contig2 start2 end2 strand2 score operations...",
+ * with the fields it may be sorted by parsed out of it.
+ */
+typedef struct _cigarLine {
+    char *line; //Without its newline.
+    const char *contig1, *contig2; //Point into the line, each ending at a space.
+    int64_t start1, end1, start2, end2;
+    double score;
+    int64_t index; //Of the line in its run, so lines with equal keys are kept in the order of the file.
+} CigarLine;
+
+typedef struct _cigarSortKeys {
+    const stCaf_CigarSortKey *keys;
+    int64_t keyNumber;
+} CigarSortKeys;
+
+static bool cigarLine_parse(CigarLine *cigarLine, char *line, int64_t index) {
+    /*
+     * Fills out the cigar line from the line, returning false if the line is blank.
+     */
+    const char *fields[10];
+    int64_t fieldNumber = 0;
+    const char *c = line;
+    while (fieldNumber < 10) {
+        while (isspace((unsigned char) *c)) {
+            c++;
+        }
+        if (*c == '\0') {
+            break;
+        }
+        fields[fieldNumber++] = c;
+        while (*c != '\0' && !isspace((unsigned char) *c)) {
+            c++;
+        }
+    }
+    if (fieldNumber == 0) {
+        return 0;
+    }
+    if (fieldNumber < 10) {
+        st_errAbort("Got a malformed cigar line when sorting: %s\n", line);
+    }
+    cigarLine->line = line;
+    cigarLine->contig1 = fields[1];
+    cigarLine->start1 = strtoll(fields[2], NULL, 10);
+    cigarLine->end1 = strtoll(fields[3], NULL, 10);
+    cigarLine->contig2 = fields[5];
+    cigarLine->start2 = strtoll(fields[6], NULL, 10);
+    cigarLine->end2 = strtoll(fields[7], NULL, 10);
+    cigarLine->score = strtod(fields[9], NULL);
+    cigarLine->index = index;
+    return 1;
+}
+
+static int compareContigs(const char *contig1, const char *contig2) {
+    while (1) {
+        int i = *contig1 == '\0' || isspace((unsigned char) *contig1) ? -1 : (unsigned char) *contig1;
+        int j = *contig2 == '\0' || isspace((unsigned char) *contig2) ? -1 : (unsigned char) *contig2;
+        if (i != j) {
+            return i < j ? -1 : 1;
+        }
+        if (i == -1) {
+            return 0;
+        }
+        contig1++;
+        contig2++;
+    }
+}
+
+static int compareInts(int64_t i, int64_t j) {
+    return i == j ? 0 : (i < j ? -1 : 1);
+}
+
+static int cigarLine_cmp(const CigarLine *cigarLine1, const CigarLine *cigarLine2, const CigarSortKeys *sortKeys) {
+    for (int64_t k = 0; k < sortKeys->keyNumber; k++) {
+        int i = 0;
+        switch (sortKeys->keys[k].field) {
+        case CIGAR_SORT_SCORE:
+            i = cigarLine1->score == cigarLine2->score ? 0 : (cigarLine1->score < cigarLine2->score ? -1 : 1);
+            break;
+        case CIGAR_SORT_CONTIG1:
+            i = compareContigs(cigarLine1->contig1, cigarLine2->contig1);
+            break;
+        case CIGAR_SORT_START1:
+            i = compareInts(cigarLine1->start1, cigarLine2->start1);
+            break;
+        case CIGAR_SORT_END1:
+            i = compareInts(cigarLine1->end1, cigarLine2->end1);
+            break;
+        case CIGAR_SORT_CONTIG2:
+            i = compareContigs(cigarLine1->contig2, cigarLine2->contig2);
+            break;
+        case CIGAR_SORT_START2:
+            i = compareInts(cigarLine1->start2, cigarLine2->start2);
+            break;
+        case CIGAR_SORT_END2:
+            i = compareInts(cigarLine1->end2, cigarLine2->end2);
+            break;
+        }
+        if (i != 0) {
+            return sortKeys->keys[k].descending ? -i : i;
+        }
+    }
+    return 0;
+}
+
+static int cigarLine_cmpInRun(const void *cigarLine1, const void *cigarLine2, const void *sortKeys) {
+    int i = cigarLine_cmp(cigarLine1, cigarLine2, sortKeys);
+    return i != 0 ? i : compareInts(((CigarLine *) cigarLine1)->index, ((CigarLine *) cigarLine2)->index);
+}
+
+static void cigarLine_destruct(CigarLine *cigarLine) {
+    free(cigarLine->line);
+    free(cigarLine);
+}
+
+/*
+ * Making runs.
+ */
+
+static stList *readRun(FILE *fileHandle, int64_t memoryBudget) {
+    /*
+     * Reads the lines of the next run of the file, at least one line unless the file is done.
+     */
+    stList *cigarLines = stList_construct3(0, (void (*)(void *)) cigarLine_destruct);
+    int64_t size = 0;
+    char *line;
+    while (size < memoryBudget && (line = stFile_getLineFromFile(fileHandle)) != NULL) {
+        CigarLine *cigarLine = st_malloc(sizeof(CigarLine));
+        if (!cigarLine_parse(cigarLine, line, stList_length(cigarLines))) {
+            free(line);
+            free(cigarLine);
+            continue;
+        }
+        stList_append(cigarLines, cigarLine);
+        size += strlen(line) + 1 + sizeof(CigarLine) + sizeof(void *);
+    }
+    return cigarLines;
+}
+
+typedef struct _runSlice {
+    stList *cigarLines;
+    const CigarSortKeys *sortKeys;
+} RunSlice;
+
+static RunSlice *runSlice_sort(RunSlice *runSlice) {
+    stList_sort2(runSlice->cigarLines, cigarLine_cmpInRun, runSlice->sortKeys);
+    return runSlice;
+}
+
+static stList *sortRun(stList *cigarLines, const CigarSortKeys *sortKeys, int64_t threads) {
+    /*
+     * Splits the lines of the run into a slice for each thread, in the order of the file, and sorts the slices.
+     * The lines are moved to the slices.
+     */
+    int64_t sliceNumber = threads < stList_length(cigarLines) ? threads : stList_length(cigarLines);
+    if (sliceNumber < 1) {
+        sliceNumber = 1;
+    }
+    stList *runSlices = stList_construct3(0, free);
+    int64_t j = 0;
+    for (int64_t i = 0; i < sliceNumber; i++) {
+        RunSlice *runSlice = st_malloc(sizeof(RunSlice));
+        runSlice->cigarLines = stList_construct3(0, (void (*)(void *)) cigarLine_destruct);
+        runSlice->sortKeys = sortKeys;
+        for (int64_t k = (stList_length(cigarLines) * (i + 1)) / sliceNumber; j < k; j++) {
+            stList_append(runSlice->cigarLines, stList_get(cigarLines, j));
+        }
+        stList_append(runSlices, runSlice);
+    }
+    stList_setDestructor(cigarLines, NULL);
+    stList_destruct(cigarLines);
+    if (sliceNumber == 1) {
+        runSlice_sort(stList_get(runSlices, 0));
+    } else {
+        stThreadPool *threadPool = stThreadPool_construct(sliceNumber, (void *(*)(void *)) runSlice_sort,
+                cactusMisc_threadPoolNoFinish);
+        for (int64_t i = 0; i < sliceNumber; i++) {
+            stThreadPool_push(threadPool, stList_get(runSlices, i));
+        }
+        stThreadPool_wait(threadPool);
+        stThreadPool_destruct(threadPool);
+    }
+    return runSlices;
+}
+
+/*
+ * Merging.
+ */
+
+typedef struct _mergeSource {
+    CigarLine *cigarLine; //The next line of the source, or NULL if it is done.
+    int64_t rank; //The order of the source in the file, so lines with equal keys are kept in the order of the file.
+    stList *cigarLines; //The lines of a slice of a run, or NULL if the source is a run's file.
+    int64_t index;
+    FILE *fileHandle;
+    char *buffer; //Of the file.
+    CigarLine fileLine;
+} MergeSource;
+
+static void mergeSource_next(MergeSource *mergeSource) {
+    if (mergeSource->cigarLines != NULL) {
+        mergeSource->cigarLine = mergeSource->index < stList_length(mergeSource->cigarLines) ? stList_get(
+                mergeSource->cigarLines, mergeSource->index++) : NULL;
+        return;
+    }
+    free(mergeSource->fileLine.line);
+    mergeSource->fileLine.line = NULL;
+    mergeSource->cigarLine = NULL;
+    char *line;
+    while ((line = stFile_getLineFromFile(mergeSource->fileHandle)) != NULL) {
+        if (cigarLine_parse(&mergeSource->fileLine, line, 0)) {
+            mergeSource->cigarLine = &mergeSource->fileLine;
+            return;
+        }
+        free(line);
+    }
+}
+
+static bool mergeSource_isBefore(MergeSource *mergeSource1, MergeSource *mergeSource2, const CigarSortKeys *sortKeys) {
+    int i = cigarLine_cmp(mergeSource1->cigarLine, mergeSource2->cigarLine, sortKeys);
+    return i != 0 ? i < 0 : mergeSource1->rank < mergeSource2->rank;
+}
+
+static void siftDown(MergeSource **heap, int64_t heapSize, int64_t i, const CigarSortKeys *sortKeys) {
+    while (1) {
+        int64_t j = i;
+        if (2 * i + 1 < heapSize && mergeSource_isBefore(heap[2 * i + 1], heap[j], sortKeys)) {
+            j = 2 * i + 1;
+        }
+        if (2 * i + 2 < heapSize && mergeSource_isBefore(heap[2 * i + 2], heap[j], sortKeys)) {
+            j = 2 * i + 2;
+        }
+        if (j == i) {
+            return;
+        }
+        MergeSource *mergeSource = heap[i];
+        heap[i] = heap[j];
+        heap[j] = mergeSource;
+        i = j;
+    }
+}
+
+static void merge(stList *mergeSources, const char *outputFile, const CigarSortKeys *sortKeys) {
+    /*
+     * Merges the sources, given in the order of the file, into the output file, using a heap of the sources
+     * ordered by their next lines.
+     */
+    FILE *fileHandle = fopen(outputFile, "w");
+    if (fileHandle == NULL) {
+        st_errnoAbort("Opening the sorted cigar file %s failed", outputFile);
+    }
+    MergeSource **heap = st_malloc(sizeof(MergeSource *) * (stList_length(mergeSources) + 1));
+    int64_t heapSize = 0;
+    for (int64_t i = 0; i < stList_length(mergeSources); i++) {
+        MergeSource *mergeSource = stList_get(mergeSources, i);
+        mergeSource->rank = i;
+        mergeSource_next(mergeSource);
+        if (mergeSource->cigarLine != NULL) {
+            heap[heapSize++] = mergeSource;
+        }
+    }
+    for (int64_t i = heapSize / 2 - 1; i >= 0; i--) {
+        siftDown(heap, heapSize, i, sortKeys);
+    }
+    while (heapSize > 0) {
+        MergeSource *mergeSource = heap[0];
+        fprintf(fileHandle, "%s\n", mergeSource->cigarLine->line);
+        mergeSource_next(mergeSource);
+        if (mergeSource->cigarLine == NULL) {
+            heap[0] = heap[--heapSize];
+        }
+        siftDown(heap, heapSize, 0, sortKeys);
+    }
+    free(heap);
+    if (fclose(fileHandle) != 0) {
+        st_errnoAbort("Writing the sorted cigar file %s failed", outputFile);
+    }
+}
+
+static MergeSource *mergeSource_constructForSlice(RunSlice *runSlice) {
+    MergeSource *mergeSource = st_calloc(1, sizeof(MergeSource));
+    mergeSource->cigarLines = runSlice->cigarLines;
+    return mergeSource;
+}
+
+static MergeSource *mergeSource_constructForRun(const char *runFile, int64_t bufferSize) {
+    MergeSource *mergeSource = st_calloc(1, sizeof(MergeSource));
+    mergeSource->fileHandle = fopen(runFile, "r");
+    if (mergeSource->fileHandle == NULL) {
+        st_errnoAbort("Opening the cigar run %s failed", runFile);
+    }
+    mergeSource->buffer = st_malloc(bufferSize);
+    setvbuf(mergeSource->fileHandle, mergeSource->buffer, _IOFBF, bufferSize);
+    return mergeSource;
+}
+
+static void mergeSource_destruct(MergeSource *mergeSource) {
+    if (mergeSource->fileHandle != NULL) {
+        fclose(mergeSource->fileHandle);
+        free(mergeSource->buffer);
+        free(mergeSource->fileLine.line);
+    }
+    free(mergeSource);
+}
+
+static void mergeRuns(stList *runFiles, const char *outputFile, int64_t memoryBudget, const CigarSortKeys *sortKeys) {
+    /*
+     * Merges the run files, given in the order of the file, into the output file, then removes them.
+     */
+    //The runs' file buffers share the memory budget, within reason.
+    int64_t bufferSize = memoryBudget / stList_length(runFiles);
+    bufferSize = bufferSize < 4096 ? 4096 : (bufferSize > 1048576 ? 1048576 : bufferSize);
+    stList *mergeSources = stList_construct3(0, (void (*)(void *)) mergeSource_destruct);
+    for (int64_t i = 0; i < stList_length(runFiles); i++) {
+        stList_append(mergeSources, mergeSource_constructForRun(stList_get(runFiles, i), bufferSize));
+    }
+    merge(mergeSources, outputFile, sortKeys);
+    stList_destruct(mergeSources);
+    for (int64_t i = 0; i < stList_length(runFiles); i++) {
+        remove(stList_get(runFiles, i));
+    }
+}
+
+void stCaf_sortCigarsFile(const char *cigarsFile, const char *sortedFile, const stCaf_CigarSortKey *keys,
+        int64_t keyNumber, int64_t memoryBudget, int64_t threads) {
+    CigarSortKeys sortKeys = { keys, keyNumber };
+    FILE *fileHandle = fopen(cigarsFile, "r");
+    if (fileHandle == NULL) {
+        st_errnoAbort("Opening the cigar file %s failed", cigarsFile);
+    }
+    stList *runFiles = stList_construct3(0, free);
+    int64_t runNumber = 0; //Of the run files made, to name them.
+    while (1) {
+        stList *runSlices = sortRun(readRun(fileHandle, memoryBudget), &sortKeys, threads);
+        int c = getc(fileHandle);
+        bool done = c == EOF;
+        if (!done) {
+            ungetc(c, fileHandle);
+        }
+        //A file that fits in one run is merged straight into the sorted file.
+        char *runFile = done && stList_length(runFiles) == 0 ? stString_copy(sortedFile) : stString_print("%s.run%" PRIi64,
+                sortedFile, runNumber++);
+        stList *mergeSources = stList_construct3(0, (void (*)(void *)) mergeSource_destruct);
+        for (int64_t i = 0; i < stList_length(runSlices); i++) {
+            stList_append(mergeSources, mergeSource_constructForSlice(stList_get(runSlices, i)));
+        }
+        merge(mergeSources, runFile, &sortKeys);
+        stList_destruct(mergeSources);
+        for (int64_t i = 0; i < stList_length(runSlices); i++) {
+            stList_destruct(((RunSlice *) stList_get(runSlices, i))->cigarLines);
+        }
+        stList_destruct(runSlices);
+        if (done && stList_length(runFiles) == 0) {
+            free(runFile);
+            break;
+        }
+        stList_append(runFiles, runFile);
+        if (done) {
+            st_logDebug("Merging %" PRIi64 " runs of the cigar file %s\n", stList_length(runFiles), cigarsFile);
+            while (stList_length(runFiles) > CIGAR_SORT_MAX_FAN_IN) {
+                //Too many runs to open at once, so each CIGAR_SORT_MAX_FAN_IN consecutive runs are merged into one.
+                stList *mergedRunFiles = stList_construct3(0, free);
+                for (int64_t i = 0; i < stList_length(runFiles); i += CIGAR_SORT_MAX_FAN_IN) {
+                    int64_t j = i + CIGAR_SORT_MAX_FAN_IN < stList_length(runFiles) ? i + CIGAR_SORT_MAX_FAN_IN
+                            : stList_length(runFiles);
+                    if (j - i == 1) { //A last run on its own is kept as it is.
+                        stList_append(mergedRunFiles, stString_copy(stList_get(runFiles, i)));
+                        continue;
+                    }
+                    stList *runFilesToMerge = stList_construct();
+                    for (int64_t k = i; k < j; k++) {
+                        stList_append(runFilesToMerge, stList_get(runFiles, k));
+                    }
+                    char *mergedRunFile = stString_print("%s.run%" PRIi64, sortedFile, runNumber++);
+                    mergeRuns(runFilesToMerge, mergedRunFile, memoryBudget, &sortKeys);
+                    stList_destruct(runFilesToMerge);
+                    stList_append(mergedRunFiles, mergedRunFile);
+                }
+                stList_destruct(runFiles);
+                runFiles = mergedRunFiles;
+            }
+            mergeRuns(runFiles, sortedFile, memoryBudget, &sortKeys);
+            break;
+        }
+    }
+    fclose(fileHandle);
+    stList_destruct(runFiles);
+}
@@ -5,11 +5,40 @@
 
 // This global is a bit gross but needs to be used to work around the
 // fact that the pinch filter functions don't have an "extra data"
-// parameter.
-static Flower *flower;
+// parameter. It is per thread, as several flowers may be processed at
+// once, each by its own thread.
+static __thread Flower *flower;
+
+/*
+ * Each event and sequence is given a small index the first time a filter sees it, so the events or sequences of a
+ * block are collected in a bitset, reused between calls, rather than in a fresh sorted set. The bitset is all zeros
+ * between calls, each call clearing just the bits it set. Like the flower they are per thread.
+ */
+static __thread stHash *eventIndices; //Each event to its index plus one.
+static __thread stHash *sequenceIndices; //Each sequence to its index plus one.
+static __thread uint64_t *bits;
+static __thread int64_t bitsLength; //In words.
 
 void stCaf_setFlowerForAlignmentFiltering(Flower *input) {
+    stCaf_clearFlowerForAlignmentFiltering();
     flower = input;
+    eventIndices = stHash_construct();
+    sequenceIndices = stHash_construct();
+    bits = st_calloc(1, sizeof(uint64_t));
+    bitsLength = 1;
+}
+
+void stCaf_clearFlowerForAlignmentFiltering(void) {
+    if (eventIndices != NULL) {
+        stHash_destruct(eventIndices);
+        stHash_destruct(sequenceIndices);
+        free(bits);
+        eventIndices = NULL;
+        sequenceIndices = NULL;
+        bits = NULL;
+        bitsLength = 0;
+    }
+    flower = NULL;
 }
 
 /*
@@ -88,30 +117,104 @@ bool stCaf_relaxedFilterByOutgroup(stPinchSegment *segment1,
 }
 
 /*
- * Filtering by presence of repeat species in block. This code is inefficient and does not scale.
+ * Filtering by presence of repeat species in block. This code scales linearly with depth.
  */
 
-static bool checkIntersection(stSortedSet *names1, stSortedSet *names2) {
-    stSortedSet *n12 = stSortedSet_getIntersection(names1, names2);
-    bool b = stSortedSet_size(n12) > 0;
-    stSortedSet_destruct(names1);
-    stSortedSet_destruct(names2);
-    stSortedSet_destruct(n12);
-    return b;
+static int64_t getIndex(stHash *indices, void *object) {
+    int64_t index = (intptr_t) stHash_search(indices, object);
+    if (index == 0) {
+        index = stHash_size(indices) + 1;
+        stHash_insert(indices, object, (void *) (intptr_t) index);
+    }
+    return index - 1;
 }
 
-static stSortedSet *getEvents(stPinchSegment *segment, Flower *flower) {
-    stSortedSet *events = stSortedSet_construct();
-    if (stPinchSegment_getBlock(segment) != NULL) {
-        stPinchBlock *block = stPinchSegment_getBlock(segment);
+static int64_t getEventIndex(stPinchSegment *segment) {
+    return getIndex(eventIndices, stCaf_getEvent(segment, flower));
+}
+
+static int64_t getIngroupEventIndex(stPinchSegment *segment) {
+    Event *event = stCaf_getEvent(segment, flower);
+    return event_isOutgroup(event) ? -1 : getIndex(eventIndices, event);
+}
+
+static int64_t getSequenceIndex(stPinchSegment *segment) {
+    return getIndex(sequenceIndices, cap_getSequence(flower_getCap(flower, stPinchSegment_getName(segment))));
+}
+
+static void setBit(int64_t index) {
+    if (index / 64 >= bitsLength) {
+        int64_t newBitsLength = bitsLength * 2 > index / 64 + 1 ? bitsLength * 2 : index / 64 + 1;
+        bits = st_realloc(bits, newBitsLength * sizeof(uint64_t));
+        memset(bits + bitsLength, 0, (newBitsLength - bitsLength) * sizeof(uint64_t));
+        bitsLength = newBitsLength;
+    }
+    bits[index / 64] |= ((uint64_t) 1) << (index % 64);
+}
+
+static void clearBit(int64_t index) {
+    bits[index / 64] &= ~(((uint64_t) 1) << (index % 64));
+}
+
+static bool isBitSet(int64_t index) {
+    return index / 64 < bitsLength && (bits[index / 64] & (((uint64_t) 1) << (index % 64))) != 0;
+}
+
+static void setOrClearBits(stPinchSegment *segment, int64_t (*getIndexFn)(stPinchSegment *), bool set) {
+    /*
+     * Sets (or clears) the bits of the indices of the segments of the block of the segment, or of the segment
+     * if it is not in a block. Indices less than zero are ignored.
+     */
+    stPinchBlock *block = stPinchSegment_getBlock(segment);
+    stPinchBlockIt it;
+    if (block != NULL) {
+        it = stPinchBlock_getSegmentIterator(block);
+        segment = stPinchBlockIt_getNext(&it);
+    }
+    while (segment != NULL) {
+        int64_t index = getIndexFn(segment);
+        if (index >= 0) {
+            if (set) {
+                setBit(index);
+            } else {
+                clearBit(index);
+            }
+        }
+        segment = block != NULL ? stPinchBlockIt_getNext(&it) : NULL;
+    }
+}
+
+static bool anyBitSet(stPinchSegment *segment, int64_t (*getIndexFn)(stPinchSegment *)) {
+    /*
+     * Returns true if the bit of the index of a segment of the block of the segment, or of the segment if it is
+     * not in a block, is set.
+     */
+    stPinchBlock *block = stPinchSegment_getBlock(segment);
+    if (block != NULL) {
         stPinchBlockIt it = stPinchBlock_getSegmentIterator(block);
         while ((segment = stPinchBlockIt_getNext(&it)) != NULL) {
-            stSortedSet_insert(events, stCaf_getEvent(segment, flower));
+            int64_t index = getIndexFn(segment);
+            if (index >= 0 && isBitSet(index)) {
+                return 1;
+            }
         }
-    } else {
-        stSortedSet_insert(events, stCaf_getEvent(segment, flower));
+        return 0;
     }
-    return events;
+    int64_t index = getIndexFn(segment);
+    return index >= 0 && isBitSet(index);
+}
+
+static bool shareIndex(stPinchSegment *segment1, stPinchSegment *segment2,
+                       int64_t (*getIndexFn)(stPinchSegment *)) {
+    /*
+     * Returns true if a segment of the block of segment1 (or segment1, if it is not in a block) has the same index
+     * as a segment of the block of segment2 (or segment2). The check, and clearing the bits it set after, are linear
+     * in the degrees of the two blocks, however many events or sequences have been indexed.
+     */
+    setOrClearBits(segment1, getIndexFn, 1);
+    bool shared = anyBitSet(segment2, getIndexFn);
+    setOrClearBits(segment1, getIndexFn, 0);
+    return shared;
 }
 
 static bool containsMoreThanOneEvent(stPinchSegment *segment, Flower *flower) {
@@ -151,69 +254,31 @@ bool stCaf_filterByMultipleSpecies(stPinchSegment *segment1,
 
 bool stCaf_filterByRepeatSpecies(stPinchSegment *segment1,
                                  stPinchSegment *segment2) {
-    return checkIntersection(getEvents(segment1, flower), getEvents(segment2, flower));
+    return shareIndex(segment1, segment2, getEventIndex);
 }
 
 bool stCaf_relaxedFilterByRepeatSpecies(stPinchSegment *segment1,
                                         stPinchSegment *segment2) {
     return stPinchSegment_getBlock(segment1) != NULL
         && stPinchSegment_getBlock(segment2) != NULL
-        && checkIntersection(getEvents(segment1, flower), getEvents(segment2, flower));
-}
-
-static stSortedSet *getChrNames(stPinchSegment *segment, Flower *flower) {
-    stSortedSet *names = stSortedSet_construct();
-    if (stPinchSegment_getBlock(segment) != NULL) {
-        stPinchBlock *block = stPinchSegment_getBlock(segment);
-        stPinchBlockIt it = stPinchBlock_getSegmentIterator(block);
-        while ((segment = stPinchBlockIt_getNext(&it)) != NULL) {
-            Cap *cap = flower_getCap(flower, stPinchSegment_getName(segment));
-            Sequence *sequence = cap_getSequence(cap);
-            stSortedSet_insert(names, (void *) sequence_getName(sequence));
-        }
-    } else {
-        Cap *cap = flower_getCap(flower, stPinchSegment_getName(segment));
-        Sequence *sequence = cap_getSequence(cap);
-        stSortedSet_insert(names, (void *) sequence_getName(sequence));
-    }
-    return names;
+        && shareIndex(segment1, segment2, getEventIndex);
 }
 
 bool stCaf_singleCopyChr(stPinchSegment *segment1,
                          stPinchSegment *segment2) {
-    return checkIntersection(getChrNames(segment1, flower), getChrNames(segment2, flower));
-}
-
-static stSortedSet *getIngroupEvents(stPinchSegment *segment, Flower *flower) {
-    stSortedSet *events = stSortedSet_construct();
-    if (stPinchSegment_getBlock(segment) != NULL) {
-        stPinchBlock *block = stPinchSegment_getBlock(segment);
-        stPinchBlockIt it = stPinchBlock_getSegmentIterator(block);
-        while ((segment = stPinchBlockIt_getNext(&it)) != NULL) {
-            Event *event = stCaf_getEvent(segment, flower);
-            if (!event_isOutgroup(event)) {
-                stSortedSet_insert(events, event);
-            }
-        }
-    } else {
-        Event *event = stCaf_getEvent(segment, flower);
-        if (!event_isOutgroup(event)) {
-            stSortedSet_insert(events, event);
-        }
-    }
-    return events;
+    return shareIndex(segment1, segment2, getSequenceIndex);
 }
 
 bool stCaf_singleCopyIngroup(stPinchSegment *segment1,
                              stPinchSegment *segment2) {
-    return checkIntersection(getIngroupEvents(segment1, flower), getIngroupEvents(segment2, flower));
+    return shareIndex(segment1, segment2, getIngroupEventIndex);
 }
 
 bool stCaf_relaxedSingleCopyIngroup(stPinchSegment *segment1,
                                     stPinchSegment *segment2) {
     return stPinchSegment_getBlock(segment1) != NULL
         && stPinchSegment_getBlock(segment2) != NULL
-        && checkIntersection(getIngroupEvents(segment1, flower), getIngroupEvents(segment2, flower));
+        && shareIndex(segment1, segment2, getIngroupEventIndex);
 }
 
 /*
@@ -221,9 +286,9 @@ bool stCaf_relaxedSingleCopyIngroup(stPinchSegment *segment1,
  * be in its own component and should have no within-component cycles.
  */
 
-static stUnionFind *threadToComponent;
-static stSet *specialComponents;
-static stSet *specialThreads;
+static __thread stUnionFind *threadToComponent;
+static __thread stSet *specialComponents;
+static __thread stSet *specialThreads;
 
 void stCaf_setupHGVMFiltering(Flower *flower, stPinchThreadSet *threadSet,
                               char *hgvmEventName) {
@@ -7,11 +7,13 @@
 
 #define _XOPEN_SOURCE 500
 
+#include <sys/stat.h>
 #include "bioioC.h"
 #include "cactus.h"
 #include "sonLib.h"
 #include "pairwiseAlignment.h"
 #include "blastAlignmentLib.h"
+#include "stCigarSort.h"
 
 stList *stCaf_selfAlignFlower(Flower *flower, int64_t minimumSequenceLength, const char *lastzArgs,
         bool realign, const char *realignArgs,
@@ -80,15 +82,16 @@ void stCaf_sortCigarsByScoreInDescendingOrder(stList *cigars) {
 #endif
 }
 
-void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile) {
-    int64_t i = st_system("sort -k10,10nr -k2,2 %s > %s", cigarsFile, sortedFile);
-    if(i != 0) {
-        st_errAbort("Encountered unix sort error when sorting cigar alignments in file: %s\n", cigarsFile);
-    }
-    i = st_system("chmod 777 %s", sortedFile);
-    if(i != 0) {
-        st_errAbort("Encountered error when changing file permissions: %s\n", cigarsFile);
+static void setPermissions(char *sortedFile) {
+    if (chmod(sortedFile, 0777) != 0) {
+        st_errnoAbort("Encountered error when changing file permissions: %s\n", sortedFile);
     }
+}
+
+void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile, int64_t threads) {
+    stCaf_CigarSortKey keys[] = { { CIGAR_SORT_SCORE, 1 }, { CIGAR_SORT_CONTIG1, 0 } };
+    stCaf_sortCigarsFile(cigarsFile, sortedFile, keys, 2, CIGAR_SORT_DEFAULT_MEMORY_BUDGET, threads);
+    setPermissions(sortedFile);
 #ifndef NDEBUG
     double score = INT64_MAX;
     FILE *fileHandle = fopen(sortedFile, "r");
@@ -96,7 +99,14 @@ void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sorted
     while ((pA = cigarRead(fileHandle)) != NULL) {
         assert(pA->score <= score);
         score = pA->score;
+        destructPairwiseAlignment(pA);
     }
     fclose(fileHandle);
 #endif
 }
+
+void stCaf_sortCigarsFileByFirstSequenceStartCoordinateInAscendingOrder(char *cigarsFile, char *sortedFile, int64_t threads) {
+    stCaf_CigarSortKey keys[] = { { CIGAR_SORT_CONTIG1, 0 }, { CIGAR_SORT_START1, 0 } };
+    stCaf_sortCigarsFile(cigarsFile, sortedFile, keys, 2, CIGAR_SORT_DEFAULT_MEMORY_BUDGET, threads);
+    setPermissions(sortedFile);
+}
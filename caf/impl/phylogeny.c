@@ -28,6 +28,10 @@ typedef struct {
     stHash *eventToSpeciesNode;
     stTree *speciesStTree;
     stSet *speciesToSplitOn;
+    // Updated by the finisher of the tree-building thread pool, which
+    // is run in series.
+    int64_t numSimpleBlocksSkipped;
+    int64_t numSingleCopyBlocksSkipped;
 } TreeBuildingConstants;
 
 // Gets passed to buildTreeForHomologyUnit.
@@ -41,6 +45,7 @@ typedef struct {
 // addTreeToHash.
 typedef struct {
     stHash *homologyUnitsToTrees;
+    TreeBuildingConstants *constants;
     stTree *tree;
     HomologyUnit *homologyUnit;
     bool wasSimple;
@@ -49,18 +54,15 @@ typedef struct {
 
 // Globals for collecting statistics that are later output.  Globals
 // are gross, but since these don't affect the actual output of the
-// program, it's probably excusable.
-static int64_t numSingleDegreeSegmentsDropped = 0;
-static int64_t numBasesDroppedFromSingleDegreeSegments = 0;
-static int64_t totalNumberOfBlocksRecomputed = 0;
-static double totalSupport = 0.0;
-static int64_t numberOfSplitsMade = 0;
-// These are especially bad since they are updated in a critical section.
-// FIXME: (Dec 4): Remove these after the first whole-genome tests.
-static int64_t numSimpleBlocksSkipped = 0;
-static int64_t numSingleCopyBlocksSkipped = 0;
-static FILE *gDebugFile;
-static stHash *gThreadStrings;
+// program, it's probably excusable. They are per thread, as several
+// flowers may be processed at once, each by its own thread.
+static __thread int64_t numSingleDegreeSegmentsDropped = 0;
+static __thread int64_t numBasesDroppedFromSingleDegreeSegments = 0;
+static __thread int64_t totalNumberOfBlocksRecomputed = 0;
+static __thread double totalSupport = 0.0;
+static __thread int64_t numberOfSplitsMade = 0;
+static __thread FILE *gDebugFile;
+static __thread stHash *gThreadStrings;
 
 HomologyUnit *HomologyUnit_construct(HomologyUnitType unitType, void *unit) {
     HomologyUnit *ret = st_malloc(sizeof(HomologyUnit));
@@ -78,6 +80,7 @@ void HomologyUnit_destruct(HomologyUnit *unit) {
 
 stHash *stCaf_getThreadStrings(Flower *flower, stPinchThreadSet *threadSet) {
     stHash *threadStrings = stHash_construct2(NULL, free);
+    SequenceView *view = sequenceView_construct();
     stPinchThreadSetIt threadIt = stPinchThreadSet_getIt(threadSet);
     stPinchThread *thread;
     while((thread = stPinchThreadSetIt_getNext(&threadIt)) != NULL) {
@@ -85,12 +88,17 @@ stHash *stCaf_getThreadStrings(Flower *flower, stPinchThreadSet *threadSet) {
         assert(cap != NULL);
         Sequence *sequence = cap_getSequence(cap);
         assert(sequence != NULL);
-        assert(stPinchThread_getLength(thread)-2 >= 0);
-        char *string = sequence_getString(sequence, stPinchThread_getStart(thread)+1, stPinchThread_getLength(thread)-2, 1); //Gets the sequence excluding the empty positions representing the caps.
-        char *paddedString = stString_print_r("N%sN", string); //Add in positions to represent the flanking bases
+        int64_t length = stPinchThread_getLength(thread)-2;
+        assert(length >= 0);
+        sequenceView_set(view, sequence, stPinchThread_getStart(thread)+1, length, 1); //Gets the sequence excluding the empty positions representing the caps.
+        char *paddedString = st_malloc(length + 3); //Add in positions to represent the flanking bases
+        paddedString[0] = 'N';
+        memcpy(paddedString + 1, sequenceView_getForwardString(view), length);
+        paddedString[length + 1] = 'N';
+        paddedString[length + 2] = '\0';
         stHash_insert(threadStrings, thread, paddedString);
-        free(string);
     }
+    sequenceView_destruct(view);
     gThreadStrings = threadStrings;
     return threadStrings;
 }
@@ -991,6 +999,7 @@ static TreeBuildingResult *buildTreeForHomologyUnit(TreeBuildingInput *input) {
 
     TreeBuildingResult *ret = st_calloc(1, sizeof(TreeBuildingResult));
     ret->homologyUnitsToTrees = input->homologyUnitsToTrees;
+    ret->constants = input->constants;
     ret->homologyUnit = unit;
 
     if (stCaf_hasSimplePhylogeny(unit, input->constants->flower)) {
@@ -1134,9 +1143,9 @@ static void addTreeToHash(TreeBuildingResult *result) {
         stHash_insert(result->homologyUnitsToTrees, result->homologyUnit, result->tree);
     } else {
         if (result->wasSimple) {
-            numSimpleBlocksSkipped++;
+            result->constants->numSimpleBlocksSkipped++;
         } else if (result->wasSingleCopy) {
-            numSingleCopyBlocksSkipped++;
+            result->constants->numSingleCopyBlocksSkipped++;
         }
     }
     free(result); // Sucks to have to do this in a critical section,
@@ -1945,6 +1954,8 @@ void stCaf_buildTreesToRemoveAncientHomologies(stPinchThreadSet *threadSet,
     constants.eventToSpeciesNode = eventToSpeciesNode;
     constants.speciesStTree = speciesStTree;
     constants.speciesToSplitOn = speciesToSplitOn;
+    constants.numSimpleBlocksSkipped = 0;
+    constants.numSingleCopyBlocksSkipped = 0;
 
     for (int64_t i = 0; i < stList_length(params->treeBuildingMethods); i++) {
         enum stCaf_TreeBuildingMethod *method = stList_get(params->treeBuildingMethods, i);
@@ -2036,7 +2047,7 @@ void stCaf_buildTreesToRemoveAncientHomologies(stPinchThreadSet *threadSet,
     fprintf(stdout, "First tree-building round done. Skipped %" PRIi64
             " simple blocks (those with 1 event or with < 3 segments, and %"
             PRIi64 " single-copy blocks (those with (# events) = (# segments))."
-            "\n", numSimpleBlocksSkipped, numSingleCopyBlocksSkipped);
+            "\n", constants.numSimpleBlocksSkipped, constants.numSingleCopyBlocksSkipped);
 
     if (unitType == CHAIN) {
         stCaf_printBadChainSummary(homologyUnits, &constants, params, flower);
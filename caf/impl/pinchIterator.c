@@ -5,7 +5,13 @@
  *      Author: benedictpaten
  */
 
+// For mmap (POSIX extensions).
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "sonLib.h"
 #include "stPinchGraphs.h"
 #include "stPinchIterator.h"
@@ -52,6 +58,7 @@ typedef struct _pairwiseAlignmentToPinch {
     struct PairwiseAlignment *pairwiseAlignment;
     int64_t alignmentIndex, xCoordinate, yCoordinate, xName, yName;
     bool freeAlignments;
+    stPinch pinch; //The pinch returned, kept per iterator so iterators can be used by different threads.
 } PairwiseAlignmentToPinch;
 
 static PairwiseAlignmentToPinch *pairwiseAlignmentToPinch_construct(void *alignmentArg,
@@ -64,7 +71,6 @@ static PairwiseAlignmentToPinch *pairwiseAlignmentToPinch_construct(void *alignm
 }
 
 static stPinch *pairwiseAlignmentToPinch_getNext(PairwiseAlignmentToPinch *pA) {
-    static stPinch pinch;
     while (1) {
         if (pA->pairwiseAlignment == NULL) {
             pA->pairwiseAlignment = pA->getPairwiseAlignment(pA->alignmentArg);
@@ -82,24 +88,24 @@ static stPinch *pairwiseAlignmentToPinch_getNext(PairwiseAlignmentToPinch *pA) {
             if (op->opType == PAIRWISE_MATCH && op->length >= 1) { //deal with the possibility of a zero length match (strange, but not illegal)
                 if (pA->pairwiseAlignment->strand1) {
                     if (pA->pairwiseAlignment->strand2) {
-                        stPinch_fillOut(&pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 1);
+                        stPinch_fillOut(&pA->pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 1);
                         pA->yCoordinate += op->length;
                     } else {
                         pA->yCoordinate -= op->length;
-                        stPinch_fillOut(&pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 0);
+                        stPinch_fillOut(&pA->pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 0);
                     }
                     pA->xCoordinate += op->length;
                 } else {
                     pA->xCoordinate -= op->length;
                     if (pA->pairwiseAlignment->strand2) {
-                        stPinch_fillOut(&pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 0);
+                        stPinch_fillOut(&pA->pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 0);
                         pA->yCoordinate += op->length;
                     } else {
                         pA->yCoordinate -= op->length;
-                        stPinch_fillOut(&pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 1);
+                        stPinch_fillOut(&pA->pinch, pA->xName, pA->yName, pA->xCoordinate, pA->yCoordinate, op->length, 1);
                     }
                 }
-                return &pinch;
+                return &pA->pinch;
             }
             if (op->opType != PAIRWISE_INDEL_Y) {
                 pA->xCoordinate += pA->pairwiseAlignment->strand1 ? op->length : -op->length;
@@ -118,24 +124,207 @@ static stPinch *pairwiseAlignmentToPinch_getNext(PairwiseAlignmentToPinch *pA) {
     return NULL;
 }
 
-static PairwiseAlignmentToPinch *pairwiseAlignmentToPinch_resetForFile(PairwiseAlignmentToPinch *pA) {
-    fseek(pA->alignmentArg, 0, SEEK_SET);
-    pA->pairwiseAlignment = NULL;
-    return pA;
+/*
+ * The pinches of a file of cigars are converted once into a file of fixed size binary records, which is memory mapped,
+ * so each round of annealing after the first iterates the records rather than parsing the cigars again. The binary
+ * file is made in the temporary directory, by getTempFile, as the directory of the alignment file may not be writable,
+ * and is unlinked as soon as it is opened, so it goes away with the iterator, even if the process dies.
+ *
+ * The cigars are parsed by a background thread while the first round of annealing pinches, so parsing and pinching
+ * overlap. The parser passes the pinches, in the order of the file, through a bounded ring buffer, in batches to
+ * keep locking rare, as well as writing them to the binary file. The first round is done with the file once the
+ * parser is done, or it is cut short by a reset. A reset before the first pinch is taken leaves the first round as is.
+ */
+#define PINCH_BATCH_SIZE 1024
+#define PINCH_BUFFER_SIZE (64 * PINCH_BATCH_SIZE)
+
+typedef struct _pinchRecord {
+    int64_t name1, name2, start1, start2;
+    int64_t length; //Negated for a pinch between opposite strands.
+} PinchRecord;
+
+typedef struct _pinchRecords {
+    PinchRecord *records; //Mapped once parsed. NULL until then, or if there are no records, as empty files can't be mapped.
+    int64_t recordNumber; //Counted by the parser.
+    int64_t index;
+    stPinch pinch; //The pinch returned, as the records are read only.
+    //Used while parsing, in the first round.
+    bool parsing;
+    char *alignmentFile;
+    FILE *alignmentFileHandle, *recordsFileHandle;
+    pthread_t parser;
+    pthread_mutex_t mutex;
+    pthread_cond_t notEmpty, notFull;
+    PinchRecord *buffer;
+    int64_t bufferStart, bufferLength;
+    bool parsed; //Set once the parser has added its last pinch to the buffer.
+    PinchRecord batch[PINCH_BATCH_SIZE]; //The pinches last taken from the buffer.
+    int64_t batchLength, batchIndex;
+} PinchRecords;
+
+static void pinchRecords_addToBuffer(PinchRecords *pinchRecords, PinchRecord *batch, int64_t batchLength) {
+    pthread_mutex_lock(&pinchRecords->mutex);
+    for (int64_t i = 0; i < batchLength; i++) {
+        while (pinchRecords->bufferLength == PINCH_BUFFER_SIZE) {
+            pthread_cond_signal(&pinchRecords->notEmpty);
+            pthread_cond_wait(&pinchRecords->notFull, &pinchRecords->mutex);
+        }
+        pinchRecords->buffer[(pinchRecords->bufferStart + pinchRecords->bufferLength++) % PINCH_BUFFER_SIZE] = batch[i];
+    }
+    pthread_cond_signal(&pinchRecords->notEmpty);
+    pthread_mutex_unlock(&pinchRecords->mutex);
 }
 
-static void pairwiseAlignmentToPinch_destructForFile(PairwiseAlignmentToPinch *pA) {
-    fclose(pA->alignmentArg);
+static bool pinchRecords_takeFromBuffer(PinchRecords *pinchRecords) {
+    /*
+     * Takes the next batch of pinches from the buffer, returning false if there are no more.
+     */
+    pthread_mutex_lock(&pinchRecords->mutex);
+    while (pinchRecords->bufferLength == 0 && !pinchRecords->parsed) {
+        pthread_cond_wait(&pinchRecords->notEmpty, &pinchRecords->mutex);
+    }
+    pinchRecords->batchLength = pinchRecords->bufferLength < PINCH_BATCH_SIZE ? pinchRecords->bufferLength : PINCH_BATCH_SIZE;
+    for (int64_t i = 0; i < pinchRecords->batchLength; i++) {
+        pinchRecords->batch[i] = pinchRecords->buffer[(pinchRecords->bufferStart + i) % PINCH_BUFFER_SIZE];
+    }
+    pinchRecords->bufferStart = (pinchRecords->bufferStart + pinchRecords->batchLength) % PINCH_BUFFER_SIZE;
+    pinchRecords->bufferLength -= pinchRecords->batchLength;
+    pthread_cond_signal(&pinchRecords->notFull);
+    pthread_mutex_unlock(&pinchRecords->mutex);
+    pinchRecords->batchIndex = 0;
+    return pinchRecords->batchLength > 0;
+}
+
+static void *pinchRecords_parse(PinchRecords *pinchRecords) {
+    PairwiseAlignmentToPinch *pA = pairwiseAlignmentToPinch_construct(pinchRecords->alignmentFileHandle,
+            (struct PairwiseAlignment *(*)(void *)) cigarRead, 1);
+    PinchRecord batch[PINCH_BATCH_SIZE];
+    int64_t batchLength = 0;
+    stPinch *pinch;
+    do {
+        pinch = pairwiseAlignmentToPinch_getNext(pA);
+        if (pinch != NULL) {
+            PinchRecord record = { pinch->name1, pinch->name2, pinch->start1, pinch->start2,
+                    pinch->strand ? pinch->length : -pinch->length };
+            batch[batchLength++] = record;
+        }
+        if (batchLength == PINCH_BATCH_SIZE || (pinch == NULL && batchLength > 0)) {
+            if (fwrite(batch, sizeof(PinchRecord), batchLength, pinchRecords->recordsFileHandle) != (size_t) batchLength) {
+                st_errnoAbort("Writing the pinches of the alignment file %s failed", pinchRecords->alignmentFile);
+            }
+            pinchRecords_addToBuffer(pinchRecords, batch, batchLength);
+            pinchRecords->recordNumber += batchLength;
+            batchLength = 0;
+        }
+    } while (pinch != NULL);
     free(pA);
+    if (fflush(pinchRecords->recordsFileHandle) != 0) {
+        st_errnoAbort("Writing the pinches of the alignment file %s failed", pinchRecords->alignmentFile);
+    }
+    pthread_mutex_lock(&pinchRecords->mutex);
+    pinchRecords->parsed = 1;
+    pthread_cond_signal(&pinchRecords->notEmpty);
+    pthread_mutex_unlock(&pinchRecords->mutex);
+    return NULL;
+}
+
+static PinchRecords *pinchRecords_constructFromFile(const char *alignmentFile) {
+    PinchRecords *pinchRecords = st_calloc(1, sizeof(PinchRecords));
+    pinchRecords->alignmentFile = stString_copy(alignmentFile);
+    pinchRecords->alignmentFileHandle = fopen(alignmentFile, "r");
+    if (pinchRecords->alignmentFileHandle == NULL) {
+        st_errnoAbort("Opening the alignment file %s failed", alignmentFile);
+    }
+    char *recordsFile = getTempFile();
+    pinchRecords->recordsFileHandle = fopen(recordsFile, "w+"); //Readable too, to be mapped.
+    if (pinchRecords->recordsFileHandle == NULL) {
+        st_errnoAbort("Opening the pinch file %s failed", recordsFile);
+    }
+    unlink(recordsFile);
+    free(recordsFile);
+    pinchRecords->buffer = st_malloc(PINCH_BUFFER_SIZE * sizeof(PinchRecord));
+    pthread_mutex_init(&pinchRecords->mutex, NULL);
+    pthread_cond_init(&pinchRecords->notEmpty, NULL);
+    pthread_cond_init(&pinchRecords->notFull, NULL);
+    pinchRecords->parsing = 1;
+    if (pthread_create(&pinchRecords->parser, NULL, (void *(*)(void *)) pinchRecords_parse, pinchRecords) != 0) {
+        st_errAbort("Starting the parser of the alignment file %s failed", alignmentFile);
+    }
+    return pinchRecords;
+}
+
+static void pinchRecords_finishParsing(PinchRecords *pinchRecords) {
+    /*
+     * Waits for the parser, throwing away the pinches it has yet to pass on, then maps the binary file.
+     */
+    while (pinchRecords_takeFromBuffer(pinchRecords)) {
+        ;
+    }
+    pthread_join(pinchRecords->parser, NULL);
+    if (pinchRecords->recordNumber > 0) {
+        pinchRecords->records = mmap(NULL, pinchRecords->recordNumber * sizeof(PinchRecord), PROT_READ, MAP_SHARED,
+                fileno(pinchRecords->recordsFileHandle), 0);
+        if (pinchRecords->records == MAP_FAILED) {
+            st_errnoAbort("Mapping the pinches of the alignment file %s failed", pinchRecords->alignmentFile);
+        }
+    }
+    fclose(pinchRecords->recordsFileHandle); //The mapping keeps the file open.
+    fclose(pinchRecords->alignmentFileHandle);
+    pthread_mutex_destroy(&pinchRecords->mutex);
+    pthread_cond_destroy(&pinchRecords->notEmpty);
+    pthread_cond_destroy(&pinchRecords->notFull);
+    free(pinchRecords->buffer);
+    pinchRecords->parsing = 0;
+    pinchRecords->index = pinchRecords->recordNumber;
+    st_logDebug("Converted the alignments of %s to %" PRIi64 " pinches\n", pinchRecords->alignmentFile,
+            pinchRecords->recordNumber);
+}
+
+static stPinch *pinchRecords_getNext(PinchRecords *pinchRecords) {
+    PinchRecord *record;
+    if (pinchRecords->parsing) {
+        if (pinchRecords->batchIndex == pinchRecords->batchLength && !pinchRecords_takeFromBuffer(pinchRecords)) {
+            pinchRecords_finishParsing(pinchRecords);
+            return NULL;
+        }
+        record = &pinchRecords->batch[pinchRecords->batchIndex++];
+    } else {
+        if (pinchRecords->index >= pinchRecords->recordNumber) {
+            return NULL;
+        }
+        record = &pinchRecords->records[pinchRecords->index++];
+    }
+    stPinch_fillOut(&pinchRecords->pinch, record->name1, record->name2, record->start1, record->start2,
+            record->length > 0 ? record->length : -record->length, record->length > 0);
+    return &pinchRecords->pinch;
+}
+
+static PinchRecords *pinchRecords_reset(PinchRecords *pinchRecords) {
+    //The batch index is only zero while parsing before the first pinch is taken, as each batch is taken to return a pinch.
+    if (pinchRecords->parsing && pinchRecords->batchIndex > 0) {
+        pinchRecords_finishParsing(pinchRecords);
+    }
+    pinchRecords->index = 0;
+    return pinchRecords;
+}
+
+static void pinchRecords_destruct(PinchRecords *pinchRecords) {
+    if (pinchRecords->parsing) {
+        pinchRecords_finishParsing(pinchRecords);
+    }
+    if (pinchRecords->records != NULL) {
+        munmap(pinchRecords->records, pinchRecords->recordNumber * sizeof(PinchRecord));
+    }
+    free(pinchRecords->alignmentFile);
+    free(pinchRecords);
 }
 
 stPinchIterator *stPinchIterator_constructFromFile(const char *alignmentFile) {
     stPinchIterator *pinchIterator = st_calloc(1, sizeof(stPinchIterator));
-    pinchIterator->alignmentArg = pairwiseAlignmentToPinch_construct(fopen(alignmentFile, "r"),
-            (struct PairwiseAlignment *(*)(void *)) cigarRead, 1);
-    pinchIterator->getNextAlignment = (stPinch *(*)(void *)) pairwiseAlignmentToPinch_getNext;
-    pinchIterator->destructAlignmentArg = (void(*)(void *)) pairwiseAlignmentToPinch_destructForFile;
-    pinchIterator->startAlignmentStack = (void *(*)(void *)) pairwiseAlignmentToPinch_resetForFile;
+    pinchIterator->alignmentArg = pinchRecords_constructFromFile(alignmentFile);
+    pinchIterator->getNextAlignment = (stPinch *(*)(void *)) pinchRecords_getNext;
+    pinchIterator->destructAlignmentArg = (void(*)(void *)) pinchRecords_destruct;
+    pinchIterator->startAlignmentStack = (void *(*)(void *)) pinchRecords_reset;
     return pinchIterator;
 }
 
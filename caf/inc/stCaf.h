@@ -43,6 +43,13 @@ void stCaf_anneal(stPinchThreadSet *threadSet, stPinchIterator *pinchIterator, b
  */
 void stCaf_annealBetweenAdjacencyComponents(stPinchThreadSet *threadSet, stPinchIterator *pinchIterator, bool (*filterFn)(stPinchSegment *, stPinchSegment *));
 
+/*
+ * Reads the alignments of a file of cigars, returning a list of lists of alignments, the ith list holding the
+ * alignments between the sequences of the ith flower, in the order of the file. Each alignment must be between
+ * the sequences of one of the flowers.
+ */
+stList *stCaf_splitAlignmentsBetweenFlowers(const char *alignmentsFile, stList *flowers);
+
 /*
  * Joins all trivial boundaries, but not joining stub boundaries.
  */
@@ -118,12 +125,18 @@ void stCaf_finish(Flower *flower, stPinchThreadSet *threadSet, int64_t chainLeng
 ///////////////////////////////////////////////////////////////////////////
 
 /*
- * Must be used before any of stCaf_filterByOutgroup,
- * stCaf_relaxedFilterByOutgroup, or stCaf_filterByRepeatSpecies are
- * used.
+ * Must be used before any of the alignment filters below (other than
+ * the HGVM filter) are used, by the thread using them, and again for
+ * each flower.
  */
 void stCaf_setFlowerForAlignmentFiltering(Flower *input);
 
+/*
+ * Frees the state the alignment filters keep for the flower, once the
+ * thread using them is done with it.
+ */
+void stCaf_clearFlowerForAlignmentFiltering(void);
+
 /*
  * Filters incoming alignments by presence of outgroup, to ensure at
  * most one outgroup segment is in any block.
@@ -0,0 +1,52 @@
+/*
+ * stCigarSort.h
+ *
+ * External merge sort of files of cigars.
+ */
+
+#ifndef ST_CIGAR_SORT_H_
+#define ST_CIGAR_SORT_H_
+
+#include "sonLib.h"
+
+// The fields of a cigar a file of cigars can be sorted by.
+enum stCaf_CigarSortField {
+    CIGAR_SORT_SCORE,
+    CIGAR_SORT_CONTIG1,
+    CIGAR_SORT_START1,
+    CIGAR_SORT_END1,
+    CIGAR_SORT_CONTIG2,
+    CIGAR_SORT_START2,
+    CIGAR_SORT_END2
+};
+
+typedef struct {
+    enum stCaf_CigarSortField field;
+    bool descending;
+} stCaf_CigarSortKey;
+
+/*
+ * The memory budget used by the sorts of cigar files that don't take one, in bytes.
+ */
+#define CIGAR_SORT_DEFAULT_MEMORY_BUDGET 1000000000
+
+/*
+ * The most run files merged at once, so a sort keeps at most this many files open.
+ */
+#define CIGAR_SORT_MAX_FAN_IN 64
+
+/*
+ * Sorts the cigars of a file, one per line, by the given keys, the first key first, writing them to the sorted
+ * file. Contig names are compared byte by byte and the other fields numerically, and cigars whose keys are equal
+ * are kept in the order of the file, so the sort does not depend on the locale.
+ *
+ * The file is read in runs of about memoryBudget bytes, including the sort's own overhead. Each run is split
+ * between the given number of threads, which sort their slices at once, and the slices are merged into a run file
+ * next to the sorted file. The run files are then merged into the sorted file, first merging each
+ * CIGAR_SORT_MAX_FAN_IN consecutive runs into one, as many times as needed, if there are more runs than that. A
+ * file that fits in the memory budget is merged straight into the sorted file.
+ */
+void stCaf_sortCigarsFile(const char *cigarsFile, const char *sortedFile, const stCaf_CigarSortKey *keys,
+        int64_t keyNumber, int64_t memoryBudget, int64_t threads);
+
+#endif /* ST_CIGAR_SORT_H_ */
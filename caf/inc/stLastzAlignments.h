@@ -17,6 +17,15 @@ stList *stCaf_selfAlignFlower(Flower *flower, int64_t minimumSequenceLength, con
 
 void stCaf_sortCigarsByScoreInDescendingOrder(stList *cigars);
 
-void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile);
+/*
+ * Sorts the cigars of a file into descending order of score, then by first contig, using the given number of threads.
+ */
+void stCaf_sortCigarsFileByScoreInDescendingOrder(char *cigarsFile, char *sortedFile, int64_t threads);
+
+/*
+ * Sorts the cigars of a file by first contig, then into ascending order of first start coordinate, using the given
+ * number of threads.
+ */
+void stCaf_sortCigarsFileByFirstSequenceStartCoordinateInAscendingOrder(char *cigarsFile, char *sortedFile, int64_t threads);
 
 #endif /* ST_LASTZALIGNMENT_H_ */
@@ -32,7 +32,8 @@ void stPinchIterator_destruct(
         stPinchIterator *stPinchIterator);
 
 /*
- * Get a pairwise alignment iterator from a file.
+ * Get a pairwise alignment iterator from a file of cigars. The file is parsed once, when the
+ * iterator is constructed, so resetting the iterator does not parse it again.
  */
 stPinchIterator *stPinchIterator_constructFromFile(
         const char *alignmentFile);
@@ -8,6 +8,7 @@
 #include "sonLib.h"
 #include "stCaf.h"
 #include "stPinchGraphs.h"
+#include "pairwiseAlignment.h"
 
 void stCaf_anneal2(stPinchThreadSet *threadSet, stPinch *(*pinchIterator)(void *), void *extraArg);
 
@@ -41,9 +42,89 @@ static void testAnnealingBetweenAdjacencyComponents(CuTest *testCase) {
     }
 }
 
+static Name addThreadToFlower(Flower *flower, Event *event, int64_t length) {
+    /*
+     * Adds a thread of random nucleotides to the flower, returning the name of its 5' cap.
+     */
+    char *dna = stRandom_getRandomDNAString(length, true, true, true);
+    MetaSequence *metaSequence = metaSequence_construct(2, length, dna, "", event_getName(event),
+            flower_getCactusDisk(flower));
+    Sequence *sequence = sequence_construct(metaSequence, flower);
+    Cap *cap1 = cap_construct2(end_construct2(0, 0, flower), 1, 1, sequence);
+    Cap *cap2 = cap_construct2(end_construct2(1, 0, flower), length + 2, 1, sequence);
+    cap_makeAdjacent(cap1, cap2);
+    free(dna);
+    return cap_getName(cap1);
+}
+
+static void testSplitAlignmentsBetweenFlowers(CuTest *testCase) {
+    /*
+     * Checks the alignments of a file, interleaved between two flowers, are split so each flower gets exactly its
+     * own alignments, in the order of the file, and a flower without alignments gets none.
+     */
+    CactusDisk *cactusDisk = testCommon_getTemporaryCactusDisk();
+    EventTree *eventTree = eventTree_construct2(cactusDisk);
+    Event *event = event_construct3("event", 0.1, eventTree_getRootEvent(eventTree), eventTree);
+    stList *flowers = stList_construct();
+    Name capNames[3][2];
+    for (int64_t i = 0; i < 3; i++) {
+        Flower *flower = flower_construct(cactusDisk);
+        capNames[i][0] = addThreadToFlower(flower, event, 100);
+        capNames[i][1] = addThreadToFlower(flower, event, 100);
+        stList_append(flowers, flower);
+    }
+    char *alignmentsFile = "tempFileForSplitAlignmentsTest.cig";
+    FILE *fileHandle = fopen(alignmentsFile, "w");
+    int64_t alignmentNumber = 100, alignmentNumbers[2] = { 0, 0 };
+    int64_t *flowerIndices = st_malloc(alignmentNumber * sizeof(int64_t));
+    for (int64_t i = 0; i < alignmentNumber; i++) {
+        flowerIndices[i] = st_randomInt(0, 2);
+        alignmentNumbers[flowerIndices[i]]++;
+        char *contig1 = cactusMisc_nameToString(capNames[flowerIndices[i]][0]);
+        char *contig2 = cactusMisc_nameToString(capNames[flowerIndices[i]][i % 2]);
+        struct List *operationList = constructEmptyList(0, NULL);
+        listAppend(operationList, constructAlignmentOperation(PAIRWISE_MATCH, 10, 0));
+        struct PairwiseAlignment *pairwiseAlignment = constructPairwiseAlignment(contig1, 2, 12, 1, contig2, 20, 30, 1,
+                i, operationList); //The score is the index of the alignment in the file.
+        cigarWrite(fileHandle, pairwiseAlignment, 0);
+        destructPairwiseAlignment(pairwiseAlignment);
+        free(contig1);
+        free(contig2);
+    }
+    fclose(fileHandle);
+
+    stList *alignmentLists = stCaf_splitAlignmentsBetweenFlowers(alignmentsFile, flowers);
+    CuAssertIntEquals(testCase, 3, stList_length(alignmentLists));
+    for (int64_t i = 0; i < 2; i++) {
+        stList *alignments = stList_get(alignmentLists, i);
+        CuAssertIntEquals(testCase, alignmentNumbers[i], stList_length(alignments));
+        int64_t previousIndex = -1;
+        for (int64_t j = 0; j < stList_length(alignments); j++) {
+            struct PairwiseAlignment *pairwiseAlignment = stList_get(alignments, j);
+            int64_t index = (int64_t) pairwiseAlignment->score;
+            CuAssertTrue(testCase, index > previousIndex);
+            CuAssertIntEquals(testCase, i, flowerIndices[index]);
+            CuAssertIntEquals(testCase, capNames[i][0], cactusMisc_stringToName(pairwiseAlignment->contig1));
+            CuAssertIntEquals(testCase, capNames[i][index % 2], cactusMisc_stringToName(pairwiseAlignment->contig2));
+            previousIndex = index;
+        }
+    }
+    CuAssertIntEquals(testCase, 0, stList_length(stList_get(alignmentLists, 2)));
+
+    for (int64_t i = 0; i < stList_length(alignmentLists); i++) {
+        stList_destruct(stList_get(alignmentLists, i));
+    }
+    stList_destruct(alignmentLists);
+    stList_destruct(flowers);
+    free(flowerIndices);
+    stFile_rmrf(alignmentsFile);
+    testCommon_deleteTemporaryCactusDisk(cactusDisk);
+}
+
 CuSuite* annealingTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testAnnealing);
     SUITE_ADD_TEST(suite, testAnnealingBetweenAdjacencyComponents);
+    SUITE_ADD_TEST(suite, testSplitAlignmentsBetweenFlowers);
     return suite;
 }
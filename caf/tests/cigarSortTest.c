@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "CuTest.h"
+#include "sonLib.h"
+#include "stCigarSort.h"
+#include "pairwiseAlignment.h"
+#include <sys/resource.h>
+
+static stList *getRandomCigars(int64_t cigarNumber) {
+    /*
+     * Gets cigars with few distinct keys, so there are many ties. The second contig of each cigar is its index,
+     * to check ties are kept in order.
+     */
+    stList *cigars = stList_construct3(0, (void(*)(void *)) destructPairwiseAlignment);
+    for (int64_t i = 0; i < cigarNumber; i++) {
+        char *contig1 = stString_print("contig%" PRIi64 "", st_randomInt(0, 12));
+        char *contig2 = stString_print("%" PRIi64 "", i);
+        int64_t start1 = st_randomInt(0, 20);
+        int64_t start2 = st_randomInt(0, 20);
+        int64_t length = st_randomInt(0, 10);
+        struct List *operationList = constructEmptyList(0, NULL);
+        listAppend(operationList, constructAlignmentOperation(PAIRWISE_MATCH, length, 0));
+        stList_append(cigars, constructPairwiseAlignment(contig1, start1, start1 + length, 1, contig2, start2,
+                start2 + length, 1, st_randomInt(0, 5) * 1.5, operationList));
+        free(contig1);
+        free(contig2);
+    }
+    return cigars;
+}
+
+static int compareCigars(struct PairwiseAlignment *pA, struct PairwiseAlignment *pA2, stCaf_CigarSortKey *keys,
+        int64_t keyNumber) {
+    for (int64_t k = 0; k < keyNumber; k++) {
+        int64_t i = 0;
+        switch (keys[k].field) {
+        case CIGAR_SORT_SCORE:
+            i = pA->score == pA2->score ? 0 : (pA->score < pA2->score ? -1 : 1);
+            break;
+        case CIGAR_SORT_CONTIG1:
+            i = strcmp(pA->contig1, pA2->contig1);
+            break;
+        case CIGAR_SORT_START1:
+            i = pA->start1 - pA2->start1;
+            break;
+        case CIGAR_SORT_END1:
+            i = pA->end1 - pA2->end1;
+            break;
+        case CIGAR_SORT_CONTIG2:
+            i = strcmp(pA->contig2, pA2->contig2);
+            break;
+        case CIGAR_SORT_START2:
+            i = pA->start2 - pA2->start2;
+            break;
+        case CIGAR_SORT_END2:
+            i = pA->end2 - pA2->end2;
+            break;
+        }
+        if (i != 0) {
+            return (i < 0 ? -1 : 1) * (keys[k].descending ? -1 : 1);
+        }
+    }
+    return 0;
+}
+
+static void testCigarSort_random(CuTest *testCase) {
+    stCaf_CigarSortKey keys[] = { { CIGAR_SORT_SCORE, 1 }, { CIGAR_SORT_CONTIG1, 0 }, { CIGAR_SORT_START1, 0 },
+            { CIGAR_SORT_END1, 1 }, { CIGAR_SORT_START2, 0 }, { CIGAR_SORT_END2, 0 } };
+    char *cigarsFile = "tempFileForCigarSortTest.cig";
+    char *sortedFile = "tempFileForCigarSortTest.sorted.cig";
+    for (int64_t test = 0; test < 100; test++) {
+        stList *cigars = getRandomCigars(st_randomInt(0, 2000));
+        FILE *fileHandle = fopen(cigarsFile, "w");
+        for (int64_t i = 0; i < stList_length(cigars); i++) {
+            cigarWrite(fileHandle, stList_get(cigars, i), 0);
+        }
+        fclose(fileHandle);
+        //Sort by a random set of the keys, with small memory budgets, so most files are sorted in several runs.
+        int64_t keyStart = st_randomInt(0, 6);
+        int64_t keyNumber = st_randomInt(0, 6 - keyStart + 1);
+        int64_t memoryBudget = st_randomInt(1, 100000);
+        int64_t threads = st_randomInt(1, 5);
+        st_logInfo("Doing a random cigar sort test %" PRIi64 " with %" PRIi64 " cigars, %" PRIi64 " keys, a budget of %"
+                PRIi64 " bytes and %" PRIi64 " threads\n", test, stList_length(cigars), keyNumber, memoryBudget, threads);
+        stCaf_sortCigarsFile(cigarsFile, sortedFile, keys + keyStart, keyNumber, memoryBudget, threads);
+        //Check the sorted file has each cigar once, in order, with ties in the order of the file.
+        fileHandle = fopen(sortedFile, "r");
+        bool *seen = st_calloc(stList_length(cigars) + 1, sizeof(bool));
+        struct PairwiseAlignment *pA, *previousPA = NULL;
+        int64_t cigarNumber = 0, previousIndex = -1;
+        while ((pA = cigarRead(fileHandle)) != NULL) {
+            int64_t index = -1;
+            sscanf(pA->contig2, "%" PRIi64 "", &index);
+            CuAssertTrue(testCase, index >= 0 && index < stList_length(cigars));
+            CuAssertTrue(testCase, !seen[index]);
+            seen[index] = 1;
+            if (previousPA != NULL) {
+                int i = compareCigars(previousPA, pA, keys + keyStart, keyNumber);
+                CuAssertTrue(testCase, i < 0 || (i == 0 && previousIndex < index));
+                destructPairwiseAlignment(previousPA);
+            }
+            previousPA = pA;
+            previousIndex = index;
+            cigarNumber++;
+        }
+        if (previousPA != NULL) {
+            destructPairwiseAlignment(previousPA);
+        }
+        fclose(fileHandle);
+        CuAssertIntEquals(testCase, stList_length(cigars), cigarNumber);
+        free(seen);
+        stList_destruct(cigars);
+    }
+    stFile_rmrf(cigarsFile);
+    stFile_rmrf(sortedFile);
+}
+
+static void testCigarSort_manyRuns(CuTest *testCase) {
+    /*
+     * Sorts a file in many more runs than can be merged at once, with the number of open files limited to little
+     * more than CIGAR_SORT_MAX_FAN_IN, so the sort must merge the runs in several passes to not run out of files.
+     */
+    stCaf_CigarSortKey keys[] = { { CIGAR_SORT_START1, 0 } };
+    char *cigarsFile = "tempFileForCigarSortTest.cig";
+    char *sortedFile = "tempFileForCigarSortTest.sorted.cig";
+    int64_t cigarNumber = 20 * CIGAR_SORT_MAX_FAN_IN + 1;
+    stList *cigars = getRandomCigars(cigarNumber);
+    FILE *fileHandle = fopen(cigarsFile, "w");
+    for (int64_t i = 0; i < stList_length(cigars); i++) {
+        cigarWrite(fileHandle, stList_get(cigars, i), 0);
+    }
+    fclose(fileHandle);
+    struct rlimit limit, previousLimit;
+    CuAssertIntEquals(testCase, 0, getrlimit(RLIMIT_NOFILE, &previousLimit));
+    limit = previousLimit;
+    if (limit.rlim_cur == RLIM_INFINITY || limit.rlim_cur > 4 * CIGAR_SORT_MAX_FAN_IN) {
+        limit.rlim_cur = 4 * CIGAR_SORT_MAX_FAN_IN;
+    }
+    CuAssertIntEquals(testCase, 0, setrlimit(RLIMIT_NOFILE, &limit));
+    //A budget of a byte makes a run of each cigar.
+    stCaf_sortCigarsFile(cigarsFile, sortedFile, keys, 1, 1, 1);
+    CuAssertIntEquals(testCase, 0, setrlimit(RLIMIT_NOFILE, &previousLimit));
+    fileHandle = fopen(sortedFile, "r");
+    struct PairwiseAlignment *pA, *previousPA = NULL;
+    int64_t sortedCigarNumber = 0, previousIndex = -1;
+    while ((pA = cigarRead(fileHandle)) != NULL) {
+        int64_t index = -1;
+        sscanf(pA->contig2, "%" PRIi64 "", &index);
+        if (previousPA != NULL) {
+            int i = compareCigars(previousPA, pA, keys, 1);
+            CuAssertTrue(testCase, i < 0 || (i == 0 && previousIndex < index));
+            destructPairwiseAlignment(previousPA);
+        }
+        previousPA = pA;
+        previousIndex = index;
+        sortedCigarNumber++;
+    }
+    if (previousPA != NULL) {
+        destructPairwiseAlignment(previousPA);
+    }
+    fclose(fileHandle);
+    CuAssertIntEquals(testCase, cigarNumber, sortedCigarNumber);
+    for (int64_t i = 0; i < 2 * cigarNumber; i++) { //The runs are all removed.
+        char *runFile = stString_print("%s.run%" PRIi64, sortedFile, i);
+        CuAssertTrue(testCase, !stFile_exists(runFile));
+        free(runFile);
+    }
+    stList_destruct(cigars);
+    stFile_rmrf(cigarsFile);
+    stFile_rmrf(sortedFile);
+}
+
+CuSuite* cigarSortTestSuite(void) {
+    CuSuite* suite = CuSuiteNew();
+    SUITE_ADD_TEST(suite, testCigarSort_random);
+    SUITE_ADD_TEST(suite, testCigarSort_manyRuns);
+    return suite;
+}
@@ -349,11 +349,69 @@ static void testHGVMFiltering(CuTest *testCase) {
     }
 }
 
+static void checkBlocksHaveNoRepeats(CuTest *testCase, stPinchThreadSet *threadSet, bool ingroupOnly, bool bySequence) {
+    /*
+     * Checks no block has two segments of the same event (or ingroup event, or sequence).
+     */
+    stPinchThreadSetBlockIt blockIt = stPinchThreadSet_getBlockIt(threadSet);
+    stPinchBlock *block;
+    while ((block = stPinchThreadSetBlockIt_getNext(&blockIt)) != NULL) {
+        stSet *seen = stSet_construct();
+        stPinchBlockIt segmentIt = stPinchBlock_getSegmentIterator(block);
+        stPinchSegment *segment;
+        while ((segment = stPinchBlockIt_getNext(&segmentIt)) != NULL) {
+            Cap *cap = flower_getCap(flower, stPinchSegment_getName(segment));
+            if (ingroupOnly && event_isOutgroup(cap_getEvent(cap))) {
+                continue;
+            }
+            void *key = bySequence ? (void *) cap_getSequence(cap) : (void *) cap_getEvent(cap);
+            CuAssertTrue(testCase, stSet_search(seen, key) == NULL);
+            stSet_insert(seen, key);
+        }
+        stSet_destruct(seen);
+    }
+}
+
+static void testRepeatFiltering(CuTest *testCase) {
+    bool (*filterFns[])(stPinchSegment *, stPinchSegment *) = { stCaf_filterByRepeatSpecies,
+            stCaf_singleCopyIngroup, stCaf_singleCopyChr };
+    for (int64_t testNum = 0; testNum < 30; testNum++) {
+        int64_t filter = testNum % 3;
+        setup(true);
+        addThreadToFlower(flower, ingroup1, 100);
+        addThreadToFlower(flower, ingroup1, 100);
+        addThreadToFlower(flower, ingroup2, 100);
+        addThreadToFlower(flower, ingroup2, 100);
+        addThreadToFlower(flower, outgroup1, 100);
+        addThreadToFlower(flower, outgroup1, 100);
+        addThreadToFlower(flower, outgroup2, 100);
+
+        stCaf_setFlowerForAlignmentFiltering(flower);
+        stPinchThreadSet *threadSet = stCaf_setup(flower);
+        for (int64_t i = 0; i < 500; i++) {
+            stPinch pinch = stPinchThreadSet_getRandomPinch(threadSet);
+            stPinchThread_filterPinch(stPinchThreadSet_getThread(threadSet, pinch.name1),
+                                      stPinchThreadSet_getThread(threadSet, pinch.name2),
+                                      pinch.start1,
+                                      pinch.start2,
+                                      pinch.length,
+                                      pinch.strand,
+                                      filterFns[filter]);
+        }
+        checkBlocksHaveNoRepeats(testCase, threadSet, filter == 1, filter == 2);
+
+        stCaf_clearFlowerForAlignmentFiltering();
+        stPinchThreadSet_destruct(threadSet);
+        teardown();
+    }
+}
+
 CuSuite* filteringTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testChainHasUnequalNumberOfIngroupCopies);
     SUITE_ADD_TEST(suite, testChainHasUnequalNumberOfIngroupCopiesOrNoOutgroup);
     SUITE_ADD_TEST(suite, testChainHasUnequalNumberOfIngroupCopiesOrNoOutgroup_noOutgroups);
     SUITE_ADD_TEST(suite, testHGVMFiltering);
+    SUITE_ADD_TEST(suite, testRepeatFiltering);
     return suite;
 }
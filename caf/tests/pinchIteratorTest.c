@@ -51,9 +51,9 @@ static void testIterator(CuTest *testCase, stPinchIterator *pinchIterator, stLis
     }
 }
 
-static stList *getRandomPairwiseAlignments() {
+static stList *getRandomPairwiseAlignments(int64_t maxAlignmentNumber) {
     stList *pairwiseAlignments = stList_construct3(0, (void(*)(void *)) destructPairwiseAlignment);
-    int64_t randomAlignmentNumber = st_randomInt(0, 10);
+    int64_t randomAlignmentNumber = st_randomInt(0, maxAlignmentNumber);
     for (int64_t i = 0; i < randomAlignmentNumber; i++) {
         char *contig1 = stString_print("%" PRIi64 "", i);
         char *contig2 = stString_print("%" PRIi64 "", i * 10);
@@ -84,17 +84,21 @@ static stList *getRandomPairwiseAlignments() {
     return pairwiseAlignments;
 }
 
+static void writeAlignments(const char *tempFile, stList *pairwiseAlignments) {
+    FILE *fileHandle = fopen(tempFile, "w");
+    for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
+        cigarWrite(fileHandle, stList_get(pairwiseAlignments, i), 0);
+    }
+    fclose(fileHandle);
+}
+
 static void testPinchIteratorFromFile(CuTest *testCase) {
     for (int64_t test = 0; test < 100; test++) {
-        stList *pairwiseAlignments = getRandomPairwiseAlignments();
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(10);
         st_logInfo("Doing a random pinch iterator from file test %" PRIi64 " with %" PRIi64 " alignments\n", test, stList_length(pairwiseAlignments));
         //Put alignments in a file
         char *tempFile = "tempFileForPinchIteratorTest.cig";
-        FILE *fileHandle = fopen(tempFile, "w");
-        for (int64_t i = 0; i < stList_length(pairwiseAlignments); i++) {
-            cigarWrite(fileHandle, stList_get(pairwiseAlignments, i), 0);
-        }
-        fclose(fileHandle);
+        writeAlignments(tempFile, pairwiseAlignments);
         //Get an iterator
         stPinchIterator *pinchIterator = stPinchIterator_constructFromFile(tempFile);
         //Now test it
@@ -106,9 +110,53 @@ static void testPinchIteratorFromFile(CuTest *testCase) {
     }
 }
 
+static void testPinchIteratorFromLargeFile(CuTest *testCase) {
+    /*
+     * Checks files with more pinches than fit in the buffer between the parser and the iterator, and iterators
+     * reset or destructed before the parser is done.
+     */
+    for (int64_t test = 0; test < 5; test++) {
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(50000);
+        st_logInfo("Doing a random pinch iterator from large file test %" PRIi64 " with %" PRIi64 " alignments\n", test, stList_length(pairwiseAlignments));
+        char *tempFile = "tempFileForPinchIteratorTest.cig";
+        writeAlignments(tempFile, pairwiseAlignments);
+        stPinchIterator *pinchIterator = stPinchIterator_constructFromFile(tempFile);
+        for (int64_t i = st_randomInt(0, 10000); i > 0 && stPinchIterator_getNext(pinchIterator) != NULL; i--) {
+            ;
+        }
+        stPinchIterator_reset(pinchIterator);
+        testIterator(testCase, pinchIterator, pairwiseAlignments);
+        stPinchIterator_destruct(pinchIterator);
+        pinchIterator = stPinchIterator_constructFromFile(tempFile);
+        stPinchIterator_getNext(pinchIterator);
+        stPinchIterator_destruct(pinchIterator);
+        stFile_rmrf(tempFile);
+        stList_destruct(pairwiseAlignments);
+    }
+}
+
+static void testPinchIteratorResetBeforeFirstPinch(CuTest *testCase) {
+    /*
+     * Checks an iterator reset before any pinch is taken, as the annealing does before its first round, still
+     * gives every pinch in order.
+     */
+    for (int64_t test = 0; test < 10; test++) {
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(test % 2 == 0 ? 10 : 50000);
+        char *tempFile = "tempFileForPinchIteratorTest.cig";
+        writeAlignments(tempFile, pairwiseAlignments);
+        stPinchIterator *pinchIterator = stPinchIterator_constructFromFile(tempFile);
+        stPinchIterator_reset(pinchIterator);
+        stPinchIterator_reset(pinchIterator);
+        testIterator(testCase, pinchIterator, pairwiseAlignments);
+        stPinchIterator_destruct(pinchIterator);
+        stFile_rmrf(tempFile);
+        stList_destruct(pairwiseAlignments);
+    }
+}
+
 static void testPinchIteratorFromList(CuTest *testCase) {
     for (int64_t test = 0; test < 100; test++) {
-        stList *pairwiseAlignments = getRandomPairwiseAlignments();
+        stList *pairwiseAlignments = getRandomPairwiseAlignments(10);
         st_logInfo("Doing a random pinch iterator from list test %" PRIi64 " with %" PRIi64 " alignments\n", test, stList_length(pairwiseAlignments));
         //Get an iterator
         stPinchIterator *pinchIterator = stPinchIterator_constructFromList(pairwiseAlignments);
@@ -123,6 +171,8 @@ static void testPinchIteratorFromList(CuTest *testCase) {
 CuSuite* pinchIteratorTestSuite(void) {
     CuSuite* suite = CuSuiteNew();
     SUITE_ADD_TEST(suite, testPinchIteratorFromFile);
+    SUITE_ADD_TEST(suite, testPinchIteratorFromLargeFile);
+    SUITE_ADD_TEST(suite, testPinchIteratorResetBeforeFirstPinch);
     SUITE_ADD_TEST(suite, testPinchIteratorFromList);
     return suite;
 }
@@ -1,13 +1,19 @@
+// For clock_gettime and rand_r (POSIX extensions).
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <limits.h>
+#include <math.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
 #include <time.h>
 #include <getopt.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "sonLib.h"
+#include "cactusLocalDatabase.h"
 
 void usage() {
     fprintf(stderr, "dpTestScript, version 0.1\n");
@@ -20,6 +26,13 @@ void usage() {
     fprintf(stderr, "-g --minRecordSize : Min size of record.\n");
     fprintf(stderr, "-h --maxRecordSize : Min size of record.\n");
     fprintf(stderr, "-i --create : Make the database.\n");
+    fprintf(stderr, "-j --benchmark : Run the benchmark workload on the keys, adding them first if --addRecords is given.\n");
+    fprintf(stderr, "-k --threads : The number of concurrent clients in the benchmark, each with its own connection (default 1).\n");
+    fprintf(stderr, "-l --operations : The number of operations made by each client in the benchmark (default 1000).\n");
+    fprintf(stderr, "-m --maxFanOut : The most records in one bulk request of the benchmark (default 64).\n");
+    fprintf(stderr, "-n --medianRecordSize : The median size of the flower records of the benchmark (default 2048).\n");
+    fprintf(stderr, "The database conf string may also describe a local database, e.g.\n"
+            "<st_kv_database_conf type=\"local\"><local database_dir=\"path\"/></st_kv_database_conf>, for the benchmark only.\n");
 }
 
 void *getRandomRecord(int64_t minRecordSize, int64_t maxRecordSize, int64_t *recordSize) {
@@ -31,6 +44,343 @@ void *getRandomRecord(int64_t minRecordSize, int64_t maxRecordSize, int64_t *rec
     return cA;
 }
 
+/*
+ * The benchmark replays a workload like that of cactus. The first three quarters of the keys are flower records, whose
+ * sizes are log-normally distributed, like those of flowers: most are a few KB, with a long tail of large flowers near the
+ * root, up to the maximum record size. The last quarter are
+ * sequence chunks of 500 bytes, which are read in runs of consecutive keys, as the chunks of a substring. Each client mixes
+ * bulk gets of flowers, with a skewed fan-out like that of getting the children of a flower, gets of runs of sequence
+ * chunks, and bulk updates of flowers, as made by writing a cactus disk.
+ */
+
+#define SEQUENCE_CHUNK_SIZE 500
+#define MAX_SEQUENCE_CHUNK_RUN 16
+#define INSERT_BATCH_SIZE 1000
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+#define FLOWER_RECORD_SIZE_SIGMA 1.5 //The spread of the log of the flower record sizes, about a median of 2KB.
+
+/*
+ * The database of a client, either a stKVDatabase or the embedded local database of cactus.
+ */
+typedef struct _benchmarkDatabase {
+    stKVDatabase *database;
+    CactusLocalDatabase *localDatabase;
+} BenchmarkDatabase;
+
+typedef enum {
+    BENCHMARK_INSERT = 0, BENCHMARK_FLOWER_GET = 1, BENCHMARK_SEQUENCE_CHUNK_GET = 2, BENCHMARK_UPDATE = 3
+} BenchmarkOperation;
+
+#define BENCHMARK_OPERATION_NUMBER 4
+
+static const char *benchmarkOperationNames[] = { "bulkInsert", "flowerBulkGet", "sequenceChunkGet", "flowerBulkUpdate" };
+
+typedef struct _benchmarkClient {
+    stKVDatabaseConf *conf;
+    const char *localDatabaseDir; //If non-null, the directory of the local database used in place of the conf.
+    int64_t firstKey; //The range of keys of the benchmark.
+    int64_t keyNumber;
+    int64_t firstInsertKey; //The range of keys inserted by this client, if adding records.
+    int64_t insertKeyNumber;
+    int64_t operationNumber;
+    int64_t minRecordSize;
+    int64_t maxRecordSize;
+    int64_t medianRecordSize;
+    int64_t maxFanOut;
+    unsigned int seed;
+    int64_t *latencies[BENCHMARK_OPERATION_NUMBER]; //In microseconds.
+    int64_t latencyCapacities[BENCHMARK_OPERATION_NUMBER];
+    int64_t calls[BENCHMARK_OPERATION_NUMBER];
+    int64_t records[BENCHMARK_OPERATION_NUMBER];
+    int64_t bytes[BENCHMARK_OPERATION_NUMBER];
+} BenchmarkClient;
+
+static int64_t getTime() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (int64_t) time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+static int64_t randomInt(unsigned int *seed, int64_t min, int64_t max) {
+    /*
+     * Returns a random integer in [min, max). The clients each have their own seed, as st_randomInt is not thread safe.
+     */
+    assert(max > min);
+    uint64_t i = ((uint64_t) rand_r(seed) << 31) ^ (uint64_t) rand_r(seed);
+    return min + (int64_t) (i % (uint64_t) (max - min));
+}
+
+static double randomDouble(unsigned int *seed) {
+    return ((double) rand_r(seed)) / ((double) RAND_MAX + 1.0);
+}
+
+static int64_t getFlowerKeyNumber(BenchmarkClient *client) {
+    int64_t flowerKeyNumber = client->keyNumber * 3 / 4;
+    return flowerKeyNumber > 0 ? flowerKeyNumber : 1;
+}
+
+static int64_t getFlowerRecordSize(BenchmarkClient *client) {
+    /*
+     * A log-normally distributed size about the median record size, clamped to the min and max record sizes. With the
+     * default median two thirds of the records are between 500 bytes and 9KB, and one in a thousand is over 200KB.
+     */
+    double u1 = 1.0 - randomDouble(&client->seed), u2 = randomDouble(&client->seed);
+    double z = sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2); //Box-Muller.
+    double size = client->medianRecordSize * exp(FLOWER_RECORD_SIZE_SIGMA * z);
+    int64_t minSize = client->minRecordSize > 1 ? client->minRecordSize : 1;
+    return size < minSize ? minSize : size > client->maxRecordSize ? client->maxRecordSize : (int64_t) size;
+}
+
+static void *getBenchmarkRecord(BenchmarkClient *client, int64_t key, int64_t *recordSize) {
+    *recordSize = key - client->firstKey < getFlowerKeyNumber(client) ? getFlowerRecordSize(client) : SEQUENCE_CHUNK_SIZE;
+    char *cA = st_malloc(*recordSize > 0 ? *recordSize : 1);
+    for (int64_t i = 0; i < *recordSize; i++) {
+        cA[i] = rand_r(&client->seed) % 128;
+    }
+    return cA;
+}
+
+static int64_t getFanOut(BenchmarkClient *client) {
+    double u = randomDouble(&client->seed);
+    return 1 + (int64_t) (u * u * u * client->maxFanOut);
+}
+
+static void addLatency(BenchmarkClient *client, BenchmarkOperation operation, int64_t startTime, int64_t records,
+        int64_t bytes) {
+    int64_t i = client->calls[operation]++;
+    if (i == client->latencyCapacities[operation]) {
+        client->latencyCapacities[operation] = 2 * i + 64;
+        client->latencies[operation] = st_realloc(client->latencies[operation],
+                client->latencyCapacities[operation] * sizeof(int64_t));
+    }
+    client->latencies[operation][i] = getTime() - startTime;
+    client->records[operation] += records;
+    client->bytes[operation] += bytes;
+}
+
+static BenchmarkDatabase *benchmarkDatabase_construct(stKVDatabaseConf *conf, const char *localDatabaseDir, bool create) {
+    BenchmarkDatabase *database = st_calloc(1, sizeof(BenchmarkDatabase));
+    if (localDatabaseDir != NULL) {
+        database->localDatabase = cactusLocalDatabase_construct(localDatabaseDir, create);
+    } else {
+        database->database = stKVDatabase_construct(conf, create);
+    }
+    return database;
+}
+
+static void benchmarkDatabase_destruct(BenchmarkDatabase *database) {
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_destruct(database->localDatabase);
+    } else {
+        stKVDatabase_destruct(database->database);
+    }
+    free(database);
+}
+
+static void bulkSet(BenchmarkClient *client, BenchmarkDatabase *database, BenchmarkOperation operation, stList *requests) {
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < stList_length(requests); i++) {
+        bytes += ((stKVDatabaseBulkRequest *) stList_get(requests, i))->size;
+    }
+    int64_t startTime = getTime();
+    if (database->localDatabase != NULL) {
+        cactusLocalDatabase_bulkSetRecords(database->localDatabase, requests);
+    } else {
+        stKVDatabase_bulkSetRecords(database->database, requests);
+    }
+    addLatency(client, operation, startTime, stList_length(requests), bytes);
+}
+
+static void bulkGet(BenchmarkClient *client, BenchmarkDatabase *database, BenchmarkOperation operation, stList *keys) {
+    int64_t startTime = getTime();
+    stList *records = database->localDatabase != NULL ? cactusLocalDatabase_bulkGetRecords(database->localDatabase, keys)
+            : stKVDatabase_bulkGetRecords(database->database, keys);
+    int64_t bytes = 0;
+    for (int64_t i = 0; i < stList_length(records); i++) {
+        int64_t recordSize;
+        if (stKVDatabaseBulkResult_getRecord(stList_get(records, i), &recordSize) == NULL) {
+            st_errAbort("The record %" PRIi64 " is missing from the database", *(int64_t *) stList_get(keys, i));
+        }
+        bytes += recordSize;
+    }
+    addLatency(client, operation, startTime, stList_length(records), bytes);
+    stList_destruct(records);
+}
+
+static stList *getKeys(int64_t firstKey, int64_t keyNumber) {
+    stList *keys = stList_construct3(0, free);
+    for (int64_t i = 0; i < keyNumber; i++) {
+        int64_t *iA = st_malloc(sizeof(int64_t));
+        iA[0] = firstKey + i;
+        stList_append(keys, iA);
+    }
+    return keys;
+}
+
+static void *insertBenchmarkRecords(BenchmarkClient *client) {
+    /*
+     * Inserts this client's share of the keys, in batches.
+     */
+    BenchmarkDatabase *database = benchmarkDatabase_construct(client->conf, client->localDatabaseDir, 0);
+    for (int64_t i = 0; i < client->insertKeyNumber; i += INSERT_BATCH_SIZE) {
+        stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+        for (int64_t j = i; j < i + INSERT_BATCH_SIZE && j < client->insertKeyNumber; j++) {
+            int64_t recordSize;
+            void *record = getBenchmarkRecord(client, client->firstInsertKey + j, &recordSize);
+            stList_append(requests, stKVDatabaseBulkRequest_constructInsertRequest(client->firstInsertKey + j, record,
+                    recordSize));
+            free(record); //The request copies the record.
+        }
+        bulkSet(client, database, BENCHMARK_INSERT, requests);
+        stList_destruct(requests);
+    }
+    benchmarkDatabase_destruct(database);
+    return NULL;
+}
+
+static void *runBenchmarkOperations(BenchmarkClient *client) {
+    BenchmarkDatabase *database = benchmarkDatabase_construct(client->conf, client->localDatabaseDir, 0);
+    int64_t flowerKeyNumber = getFlowerKeyNumber(client);
+    int64_t sequenceChunkKeyNumber = client->keyNumber - flowerKeyNumber;
+    for (int64_t i = 0; i < client->operationNumber; i++) {
+        double u = randomDouble(&client->seed);
+        if (u < 0.6 || sequenceChunkKeyNumber == 0) {
+            stList *keys = stList_construct3(0, free);
+            for (int64_t j = getFanOut(client); j > 0; j--) {
+                int64_t *iA = st_malloc(sizeof(int64_t));
+                iA[0] = client->firstKey + randomInt(&client->seed, 0, flowerKeyNumber);
+                stList_append(keys, iA);
+            }
+            bulkGet(client, database, BENCHMARK_FLOWER_GET, keys);
+            stList_destruct(keys);
+        } else if (u < 0.85) {
+            int64_t run = randomInt(&client->seed, 1, MAX_SEQUENCE_CHUNK_RUN + 1);
+            run = run < sequenceChunkKeyNumber ? run : sequenceChunkKeyNumber;
+            stList *keys = getKeys(client->firstKey + flowerKeyNumber
+                    + randomInt(&client->seed, 0, sequenceChunkKeyNumber - run + 1), run);
+            bulkGet(client, database, BENCHMARK_SEQUENCE_CHUNK_GET, keys);
+            stList_destruct(keys);
+        } else {
+            stList *requests = stList_construct3(0, (void (*)(void *)) stKVDatabaseBulkRequest_destruct);
+            stSortedSet *updatedKeys = stSortedSet_construct3((int (*)(const void *, const void *)) stIntTuple_cmpFn,
+                    (void (*)(void *)) stIntTuple_destruct);
+            for (int64_t j = getFanOut(client); j > 0; j--) {
+                int64_t key = client->firstKey + randomInt(&client->seed, 0, flowerKeyNumber);
+                stIntTuple *k = stIntTuple_construct1(key);
+                if (stSortedSet_search(updatedKeys, k) != NULL) { //A bulk request updates each record once.
+                    stIntTuple_destruct(k);
+                    continue;
+                }
+                stSortedSet_insert(updatedKeys, k);
+                int64_t recordSize;
+                void *record = getBenchmarkRecord(client, key, &recordSize);
+                stList_append(requests, stKVDatabaseBulkRequest_constructUpdateRequest(key, record, recordSize));
+                free(record);
+            }
+            bulkSet(client, database, BENCHMARK_UPDATE, requests);
+            stList_destruct(requests);
+            stSortedSet_destruct(updatedKeys);
+        }
+    }
+    benchmarkDatabase_destruct(database);
+    return NULL;
+}
+
+static int compareLatencies(const void *a, const void *b) {
+    int64_t i = *(const int64_t *) a, j = *(const int64_t *) b;
+    return i < j ? -1 : (i > j ? 1 : 0);
+}
+
+static int64_t getPercentile(int64_t *latencies, int64_t latencyNumber, double fraction) {
+    int64_t i = (int64_t) (fraction * latencyNumber);
+    return latencies[i < latencyNumber ? i : latencyNumber - 1];
+}
+
+static double runBenchmarkClients(BenchmarkClient *clients, int64_t threadNumber, void *(*clientFn)(BenchmarkClient *)) {
+    /*
+     * Runs the function of each client in its own thread, returning the time taken, in seconds.
+     */
+    pthread_t *threads = st_malloc(threadNumber * sizeof(pthread_t));
+    int64_t startTime = getTime();
+    for (int64_t i = 0; i < threadNumber; i++) {
+        if (pthread_create(&threads[i], NULL, (void *(*)(void *)) clientFn, &clients[i]) != 0) {
+            st_errAbort("Could not start benchmark client %" PRIi64 "", i);
+        }
+    }
+    for (int64_t i = 0; i < threadNumber; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    free(threads);
+    return (getTime() - startTime) / 1000000.0;
+}
+
+static void runBenchmark(stKVDatabaseConf *conf, const char *localDatabaseDir, int64_t firstKey, int64_t keyNumber,
+        bool addRecords, int64_t threadNumber, int64_t operationNumber, int64_t minRecordSize, int64_t maxRecordSize,
+        int64_t medianRecordSize, int64_t maxFanOut, int64_t seed) {
+    /*
+     * Runs the clients concurrently, first inserting the records (if adding records) and then running the mix of
+     * operations, then reports the throughput and latencies of each operation over all the clients. The throughput
+     * of the inserts is over the time taken to insert, and that of the other operations over the time taken to run the mix.
+     */
+    BenchmarkClient *clients = st_calloc(threadNumber, sizeof(BenchmarkClient));
+    for (int64_t i = 0; i < threadNumber; i++) {
+        BenchmarkClient *client = &clients[i];
+        client->conf = conf;
+        client->localDatabaseDir = localDatabaseDir;
+        client->firstKey = firstKey;
+        client->keyNumber = keyNumber;
+        if (addRecords) {
+            client->firstInsertKey = firstKey + keyNumber * i / threadNumber;
+            client->insertKeyNumber = firstKey + keyNumber * (i + 1) / threadNumber - client->firstInsertKey;
+        }
+        client->operationNumber = operationNumber;
+        client->minRecordSize = minRecordSize;
+        client->maxRecordSize = maxRecordSize;
+        client->medianRecordSize = medianRecordSize;
+        client->maxFanOut = maxFanOut;
+        client->seed = (unsigned int) (seed + i);
+    }
+    double insertSeconds = addRecords ? runBenchmarkClients(clients, threadNumber, insertBenchmarkRecords) : 0.0;
+    double seconds = runBenchmarkClients(clients, threadNumber, runBenchmarkOperations);
+
+    fprintf(stdout, "Benchmark of %" PRIi64 " clients over %" PRIi64 " keys took %.3f seconds to insert and %.3f seconds"
+            " to run %" PRIi64 " operations per client\n", threadNumber, keyNumber, insertSeconds, seconds, operationNumber);
+    fprintf(stdout, "operation\tcalls\trecords\tbytes\tcalls/s\trecords/s\tMB/s\tp50 (us)\tp99 (us)\n");
+    for (int64_t i = 0; i < BENCHMARK_OPERATION_NUMBER; i++) {
+        int64_t calls = 0, records = 0, bytes = 0;
+        for (int64_t j = 0; j < threadNumber; j++) {
+            calls += clients[j].calls[i];
+            records += clients[j].records[i];
+            bytes += clients[j].bytes[i];
+        }
+        if (calls == 0) {
+            continue;
+        }
+        int64_t *latencies = st_malloc(calls * sizeof(int64_t));
+        int64_t k = 0;
+        for (int64_t j = 0; j < threadNumber; j++) {
+            memcpy(latencies + k, clients[j].latencies[i], clients[j].calls[i] * sizeof(int64_t));
+            k += clients[j].calls[i];
+        }
+        qsort(latencies, calls, sizeof(int64_t), compareLatencies);
+        double operationSeconds = i == BENCHMARK_INSERT ? insertSeconds : seconds;
+        fprintf(stdout, "%s\t%" PRIi64 "\t%" PRIi64 "\t%" PRIi64 "\t%.1f\t%.1f\t%.3f\t%" PRIi64 "\t%" PRIi64 "\n",
+                benchmarkOperationNames[i], calls, records, bytes, calls / operationSeconds, records / operationSeconds,
+                bytes / operationSeconds / (1024 * 1024), getPercentile(latencies, calls, 0.5),
+                getPercentile(latencies, calls, 0.99));
+        free(latencies);
+    }
+
+    for (int64_t i = 0; i < threadNumber; i++) {
+        for (int64_t j = 0; j < BENCHMARK_OPERATION_NUMBER; j++) {
+            free(clients[i].latencies[j]);
+        }
+    }
+    free(clients);
+}
+
 int main(int argc, char *argv[]) {
     /*
      * Script for adding a reference genome to a flower.
@@ -43,19 +393,23 @@ int main(int argc, char *argv[]) {
     char * databaseString = NULL;
     int64_t firstKey = INT64_MIN;
     int64_t keyNumber = INT64_MIN;
-    bool addRecords = 0, setRecords = 0, create = 0;
+    bool addRecords = 0, setRecords = 0, create = 0, benchmark = 0;
     int64_t minRecordSize = 0, maxRecordSize = 100000000;
+    int64_t threadNumber = 1, operationNumber = 1000, maxFanOut = 64, medianRecordSize = 2048;
     int64_t i;
 
     while (1) {
         static struct option long_options[] = { { "logLevel", required_argument, 0, 'a' }, { "databaseConf", required_argument, 0, 'b' }, {
                 "firstKey", required_argument, 0, 'c' }, { "keyNumber", required_argument, 0, 'd' }, { "addRecords", no_argument, 0, 'e' },
                 { "setRecords", no_argument, 0, 'f' }, { "minRecordSize", required_argument, 0, 'g' }, { "maxRecordSize",
-                        required_argument, 0, 'h' }, { "maxRecordSize", no_argument, 0, 'i' }, { 0, 0, 0, 0 } };
+                        required_argument, 0, 'h' }, { "create", no_argument, 0, 'i' }, { "benchmark", no_argument, 0, 'j' },
+                { "threads", required_argument, 0, 'k' }, { "operations", required_argument, 0, 'l' },
+                { "maxFanOut", required_argument, 0, 'm' }, { "medianRecordSize", required_argument, 0, 'n' },
+                { 0, 0, 0, 0 } };
 
         int option_index = 0;
 
-        int key = getopt_long(argc, argv, "a:b:c:d:efg:h:i", long_options, &option_index);
+        int key = getopt_long(argc, argv, "a:b:c:d:efg:h:ijk:l:m:n:", long_options, &option_index);
 
         if (key == -1) {
             break;
@@ -100,6 +454,34 @@ int main(int argc, char *argv[]) {
                 break;
             case 'i':
                 create = 1;
+                break;
+            case 'j':
+                benchmark = 1;
+                break;
+            case 'k':
+                i = sscanf(optarg, "%" PRIi64 "", &threadNumber);
+                if (i != 1 || threadNumber < 1) {
+                    st_errAbort("Did not parse a valid threads number: %s", optarg);
+                }
+                break;
+            case 'l':
+                i = sscanf(optarg, "%" PRIi64 "", &operationNumber);
+                if (i != 1 || operationNumber < 0) {
+                    st_errAbort("Did not parse a valid operations number: %s", optarg);
+                }
+                break;
+            case 'm':
+                i = sscanf(optarg, "%" PRIi64 "", &maxFanOut);
+                if (i != 1 || maxFanOut < 1) {
+                    st_errAbort("Did not parse a valid maxFanOut number: %s", optarg);
+                }
+                break;
+            case 'n':
+                i = sscanf(optarg, "%" PRIi64 "", &medianRecordSize);
+                if (i != 1 || medianRecordSize < 1) {
+                    st_errAbort("Did not parse a valid medianRecordSize number: %s", optarg);
+                }
+                break;
             default:
                 usage();
                 return 1;
@@ -124,8 +506,16 @@ int main(int argc, char *argv[]) {
     //Load the database
     //////////////////////////////////////////////
 
-    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(databaseString);
-    stKVDatabase *database = stKVDatabase_construct(kvDatabaseConf, create);
+    char *localDatabaseDir = cactusLocalDatabase_getDatabaseDirFromConfString(databaseString);
+    if (localDatabaseDir != NULL) {
+        if (!benchmark) {
+            st_errAbort("A local database is only supported with --benchmark");
+        }
+        benchmarkDatabase_destruct(benchmarkDatabase_construct(NULL, localDatabaseDir, create));
+        st_logInfo("Set up the local database\n");
+    }
+    stKVDatabaseConf *kvDatabaseConf = localDatabaseDir == NULL ? stKVDatabaseConf_constructFromString(databaseString) : NULL;
+    stKVDatabase *database = localDatabaseDir == NULL ? stKVDatabase_construct(kvDatabaseConf, create) : NULL;
     st_logInfo("Set up the database\n");
 
     //////////////////////////////////////////////
@@ -140,6 +530,20 @@ int main(int argc, char *argv[]) {
     // Do meat of manipulating the database
     ///////////////////////////////////////////////////////////////////////////
 
+    if (benchmark) {
+        //The clients open their own connections, so the database is closed first, for backends that lock their files.
+        if (database != NULL) {
+            stKVDatabase_destruct(database);
+        }
+        runBenchmark(kvDatabaseConf, localDatabaseDir, firstKey, keyNumber, addRecords, threadNumber, operationNumber,
+                minRecordSize, maxRecordSize, medianRecordSize, maxFanOut, seed);
+        if (kvDatabaseConf != NULL) {
+            stKVDatabaseConf_destruct(kvDatabaseConf);
+        }
+        free(localDatabaseDir);
+        return 0;
+    }
+
     st_logInfo("Modifying records to the database in the range %" PRIi64 " to %" PRIi64 "\n", firstKey, firstKey+keyNumber);
 
     if (addRecords) {
@@ -161,7 +161,7 @@ static stList *getCaps(Flower *flower) {
     return caps;
 }
 
-void makeHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventName, FILE *fileHandle) {
+void makeHalFormat(Flower *flower, CactusSecondaryDatabase *database, Name referenceEventName, FILE *fileHandle) {
     globalReferenceEventName = referenceEventName;
     stList *caps = getCaps(flower);
     if (fileHandle == NULL) {
@@ -11,7 +11,7 @@
 #include "sonLib.h"
 #include "cactus.h"
 
-void makeHalFormat(Flower *flower, stKVDatabase *database, Name referenceEventName,
+void makeHalFormat(Flower *flower, CactusSecondaryDatabase *database, Name referenceEventName,
                    FILE *fileHandle);
 
 void printFastaSequences(Flower *flower, FILE *fileHandle, Name referenceEventName);
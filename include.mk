@@ -11,5 +11,16 @@ include ${sonLibRootPath}/include.mk
 dataSetsPath=/Users/benedictpaten/Dropbox/Documents/work/myPapers/genomeCactusPaper/dataSets
 
 cflags += -I ${sonLibPath}
-basicLibs = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a ${dblibs}
+
+#Optional record codecs (see api/inc/cactusCodec.h), compiled in if their headers are installed.
+ifneq ($(wildcard /usr/include/zstd.h /usr/local/include/zstd.h),)
+cflags += -DHAVE_ZSTD=1
+codecLibs += -lzstd
+endif
+ifneq ($(wildcard /usr/include/lz4.h /usr/local/include/lz4.h),)
+cflags += -DHAVE_LZ4=1
+codecLibs += -llz4
+endif
+
+basicLibs = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a ${dblibs} ${codecLibs} -lpthread
 basicLibsDependencies = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a 
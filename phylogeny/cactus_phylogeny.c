@@ -44,7 +44,7 @@ char **chainAlignment_getAlignment(ChainAlignment *chainAlignment) {
     char **alignment;
     int64_t i, j, k, l;
     Segment *segment;
-    char *cA;
+    SequenceView *view = sequenceView_construct();
 
     //alloc the memory for the char alignment.
     alignment = st_malloc(sizeof(void *) * chainAlignment->rowNumber);
@@ -65,16 +65,16 @@ char **chainAlignment_getAlignment(ChainAlignment *chainAlignment) {
                     alignment[j][l++] = 'N';
                 }
             } else {
-                cA = segment_getString(segment);
-                for (k = 0; k < segment_getLength(segment); k++) {
-                    alignment[j][l++] = cA[k];
-                }
-                free(cA);
+                sequenceView_setToSegment(view, segment);
+                assert(sequenceView_getLength(view) == segment_getLength(segment));
+                sequenceView_copyString(view, alignment[j] + l);
+                l += segment_getLength(segment);
             }
         }
         alignment[j][l] = '\0';
         assert(l == chainAlignment->totalAlignmentLength);
     }
+    sequenceView_destruct(view);
 
     return alignment;
 }
@@ -666,8 +666,7 @@ int main(int argc, char *argv[]) {
     //Load the database
     //////////////////////////////////////////////
 
-    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(cactusDiskDatabaseString);
-    cactusDisk = cactusDisk_construct(kvDatabaseConf, false, true);
+    cactusDisk = cactusDisk_constructFromString(cactusDiskDatabaseString, false, true);
     st_logInfo("Set up the flower disk\n");
 
     //////////////////////////////////////////////
@@ -892,7 +891,6 @@ int main(int argc, char *argv[]) {
 
     //Destruct stuff
     startTime = time(NULL);
-    stKVDatabaseConf_destruct(kvDatabaseConf);
     if(logLevelString != NULL) {
         free(logLevelString);
     }
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "cactus.h"
+
+/*
+ * Exports the records of a cactus disk to an archive, for checkpointing it, or imports an archive into a
+ * database (of any type), for restoring it.
+ */
+
+void usage() {
+    fprintf(stderr, "cactus_dbArchive, version 0.1\n");
+    fprintf(stderr, "-a --logLevel : Set the log level\n");
+    fprintf(stderr, "-c --cactusDisk : The location of the flower disk directory\n");
+    fprintf(stderr, "-d --archive : The archive file\n");
+    fprintf(stderr, "-e --export : Export the cactus disk to the archive\n");
+    fprintf(stderr, "-f --import : Import the archive into the cactus disk\n");
+    fprintf(stderr, "-g --flowerName : The name of the root flower to export, defaults to 0\n");
+    fprintf(stderr, "-i --threads : The number of threads to compress or insert the blocks with, defaults to 1\n");
+    fprintf(stderr, "-j --create : Create the database before importing the archive into it\n");
+    fprintf(stderr, "-h --help : Print this help screen\n");
+}
+
+int main(int argc, char *argv[]) {
+    /*
+     * Arguments/options
+     */
+    char * logLevelString = NULL;
+    char * cactusDiskDatabaseString = NULL;
+    char * archiveFile = NULL;
+    bool exportArchive = 0;
+    bool importArchive = 0;
+    Name rootFlowerName = 0;
+    int64_t threadNumber = 1;
+    bool create = 0;
+
+    while (1) {
+        static struct option long_options[] = { { "logLevel", required_argument, 0, 'a' },
+                { "cactusDisk", required_argument, 0, 'c' }, { "archive", required_argument, 0, 'd' },
+                { "export", no_argument, 0, 'e' }, { "import", no_argument, 0, 'f' },
+                { "flowerName", required_argument, 0, 'g' }, { "threads", required_argument, 0, 'i' },
+                { "create", no_argument, 0, 'j' }, { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+
+        int key = getopt_long(argc, argv, "a:c:d:efg:i:jh", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+            case 'a':
+                logLevelString = stString_copy(optarg);
+                break;
+            case 'c':
+                cactusDiskDatabaseString = stString_copy(optarg);
+                break;
+            case 'd':
+                archiveFile = stString_copy(optarg);
+                break;
+            case 'e':
+                exportArchive = 1;
+                break;
+            case 'f':
+                importArchive = 1;
+                break;
+            case 'g':
+                rootFlowerName = cactusMisc_stringToName(optarg);
+                break;
+            case 'i':
+                threadNumber = atol(optarg);
+                break;
+            case 'j':
+                create = 1;
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (cactusDiskDatabaseString == NULL || archiveFile == NULL || exportArchive == importArchive || threadNumber < 1) {
+        usage();
+        return 1;
+    }
+
+    st_setLogLevelFromString(logLevelString);
+
+    if (exportArchive) {
+        CactusDisk *cactusDisk = cactusDisk_constructFromString(cactusDiskDatabaseString, 0, 0);
+        st_logInfo("Set up the flower disk\n");
+        cactusDisk_exportArchive(cactusDisk, rootFlowerName, archiveFile, threadNumber);
+        st_logInfo("Wrote the archive of flower %" PRIi64 " and its descendants to %s\n", rootFlowerName, archiveFile);
+        cactusDisk_destruct(cactusDisk);
+    } else {
+        CactusArchive *archive = cactusArchive_construct(archiveFile);
+        int64_t recordNumber = cactusArchive_import(archive, cactusDiskDatabaseString, create, threadNumber);
+        st_logInfo("Imported %" PRIi64 " records from the %" PRIi64 " blocks of %s\n", recordNumber,
+                cactusArchive_getBlockNumber(archive), archiveFile);
+        cactusArchive_destruct(archive);
+    }
+
+    free(cactusDiskDatabaseString);
+    free(archiveFile);
+    free(logLevelString);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2009-2011 by Benedict Paten (benedictpaten@gmail.com)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <getopt.h>
+
+#include "cactus.h"
+
+/*
+ * Writes a snapshot of the flowers named on stdin (in the format written by the flower writer), the flowers
+ * nested in them and their sequences, which the workers on a node can then share by passing
+ * snapshot="<file>" in their --cactusDisk strings.
+ */
+
+void usage() {
+    fprintf(stderr, "cactus_exportSnapshot, version 0.1\n");
+    fprintf(stderr, "-a --logLevel : Set the log level\n");
+    fprintf(stderr, "-c --cactusDisk : The location of the flower disk directory\n");
+    fprintf(stderr, "-d --snapshot : The file to write the snapshot to\n");
+    fprintf(stderr, "-h --help : Print this help screen\n");
+}
+
+int main(int argc, char *argv[]) {
+    /*
+     * Arguments/options
+     */
+    char * logLevelString = NULL;
+    char * cactusDiskDatabaseString = NULL;
+    char * snapshotFile = NULL;
+
+    while (1) {
+        static struct option long_options[] = { { "logLevel", required_argument, 0, 'a' },
+                { "cactusDisk", required_argument, 0, 'c' }, { "snapshot", required_argument, 0, 'd' },
+                { "help", no_argument, 0, 'h' }, { 0, 0, 0, 0 } };
+
+        int option_index = 0;
+
+        int key = getopt_long(argc, argv, "a:c:d:h", long_options, &option_index);
+
+        if (key == -1) {
+            break;
+        }
+
+        switch (key) {
+            case 'a':
+                logLevelString = stString_copy(optarg);
+                break;
+            case 'c':
+                cactusDiskDatabaseString = stString_copy(optarg);
+                break;
+            case 'd':
+                snapshotFile = stString_copy(optarg);
+                break;
+            case 'h':
+                usage();
+                return 0;
+            default:
+                usage();
+                return 1;
+        }
+    }
+
+    if (cactusDiskDatabaseString == NULL || snapshotFile == NULL) {
+        usage();
+        return 1;
+    }
+
+    st_setLogLevelFromString(logLevelString);
+
+    CactusDisk *cactusDisk = cactusDisk_constructFromString(cactusDiskDatabaseString, 0, 0);
+    st_logInfo("Set up the flower disk\n");
+
+    stList *flowerNames = flowerWriter_parseNames(stdin);
+    cactusDisk_exportSnapshot(cactusDisk, flowerNames, snapshotFile);
+    st_logInfo("Wrote the snapshot of %" PRIi64 " flowers and their descendants to %s\n", stList_length(flowerNames),
+            snapshotFile);
+
+    stList_destruct(flowerNames);
+    cactusDisk_destruct(cactusDisk);
+    free(cactusDiskDatabaseString);
+    free(snapshotFile);
+    free(logLevelString);
+    return 0;
+}
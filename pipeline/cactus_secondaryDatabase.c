@@ -5,21 +5,21 @@
  */
 
 #include "sonLib.h"
+#include "cactus.h"
 
 int main(int argc, char *argv[]) {
     assert(argc == 3);
-    stKVDatabaseConf *kvDatabaseConf = stKVDatabaseConf_constructFromString(argv[1]);
     int64_t create;
     int64_t i = sscanf(argv[2], "%" PRIi64 "", &create);
     (void)i;
     assert(i == 1);
     if(create) {
-         stKVDatabase *database = stKVDatabase_construct(kvDatabaseConf, 1);
-         stKVDatabase_destruct(database);
+         CactusSecondaryDatabase *database = cactusSecondaryDatabase_constructFromString(argv[1], 1);
+         cactusSecondaryDatabase_destruct(database);
     }
     else {
-        stKVDatabase *database = stKVDatabase_construct(kvDatabaseConf, 0);
-        stKVDatabase_deleteFromDisk(database);
+        CactusSecondaryDatabase *database = cactusSecondaryDatabase_constructFromString(argv[1], 0);
+        cactusSecondaryDatabase_deleteFromDisk(database);
     }
     return 0;
 }
@@ -284,7 +284,7 @@ static stList *getCaps(stList *flowers, Name referenceEventName) {
     return caps;
 }
 
-void bottomUp(stList *flowers, stKVDatabase *sequenceDatabase, Name referenceEventName,
+void bottomUp(stList *flowers, CactusSecondaryDatabase *sequenceDatabase, Name referenceEventName,
               bool isTop, stMatrix *(*generateSubstitutionMatrix)(double)) {
     /*
      * A reference thread between the two caps
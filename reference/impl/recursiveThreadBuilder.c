@@ -12,15 +12,23 @@
 #include "cactus.h"
 #include "sonLib.h"
 
-static void *compress(char *string, int64_t *dataSize) {
-    void *data = stCompression_compress(string, strlen(string) + 1, dataSize, 1); //going with least, fastest compression-1);
+/*
+ * Thread strings are compressed with the cactus disk's thread string codec, by default zlib at level 1, the least, fastest compression.
+ */
+
+static CactusDisk *getCactusDisk(Cap *cap) {
+    return flower_getCactusDisk(end_getFlower(cap_getEnd(cap)));
+}
+
+static void *compress(CactusDisk *cactusDisk, char *string, int64_t *dataSize) {
+    void *data = cactusDisk_compressRecord(cactusDisk, CACTUS_RECORD_THREAD_STRING, string, strlen(string) + 1, dataSize);
     free(string);
     return data;
 }
 
-static char *decompress(void *data, int64_t dataSize) {
+static char *decompress(CactusDisk *cactusDisk, void *data, int64_t dataSize) {
     int64_t uncompressedSize;
-    char *string = stCompression_decompress(data, dataSize, &uncompressedSize);
+    char *string = cactusDisk_decompressRecord(cactusDisk, CACTUS_RECORD_THREAD_STRING, data, dataSize, &uncompressedSize);
     assert(strlen(string)+1 == uncompressedSize);
     free(data);
     return string;
@@ -40,7 +48,7 @@ static void cacheNonNestedRecords(stCache *cache, stList *caps, char *(*segmentW
             Group *group = end_getGroup(cap_getEnd(cap));
             assert(group != NULL);
             if (group_isLeaf(group)) { //Record must not be in the database already
-                void *data = compress(terminalAdjacencyWriteFn(cap), &recordSize);
+                void *data = compress(getCactusDisk(cap), terminalAdjacencyWriteFn(cap), &recordSize);
                 assert(!stCache_containsRecord(cache, cap_getName(cap), 0, INT64_MAX));
                 stCache_setRecord(cache, cap_getName(cap), 0, recordSize, data);
                 free(data);
@@ -50,7 +58,7 @@ static void cacheNonNestedRecords(stCache *cache, stList *caps, char *(*segmentW
             }
             Segment *segment = cap_getSegment(adjacentCap);
             assert(!stCache_containsRecord(cache, segment_getName(segment), 0, INT64_MAX));
-            void *data = compress(segmentWriteFn(segment), &recordSize);
+            void *data = compress(getCactusDisk(cap), segmentWriteFn(segment), &recordSize);
             stCache_setRecord(cache, segment_getName(segment), 0, recordSize, data);
             free(data);
         }
@@ -82,7 +90,7 @@ static stList *getNestedRecordNames(stList *caps) {
     return getRequests;
 }
 
-static void cacheNestedRecords(stKVDatabase *database, stCache *cache, stList *caps) {
+static void cacheNestedRecords(CactusSecondaryDatabase *database, stCache *cache, stList *caps) {
     /*
      * Caches all the non-terminal adjacencies by retrieving them from the database.
      */
@@ -93,7 +101,7 @@ static void cacheNestedRecords(stKVDatabase *database, stCache *cache, stList *c
     //Do the retrieval of the records
     stList *records = NULL;
     stTry {
-            records = stKVDatabase_bulkGetRecords(database, getRequests);
+            records = cactusSecondaryDatabase_bulkGetRecords(database, getRequests);
         }stCatch(except)
             {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
@@ -118,7 +126,7 @@ static void cacheNestedRecords(stKVDatabase *database, stCache *cache, stList *c
     stList_destruct(records);
 }
 
-static stCache *cacheRecords(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
+static stCache *cacheRecords(CactusSecondaryDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *)) {
     /*
      * Cache all the elements needed to construct the set of threads.
@@ -129,7 +137,7 @@ static stCache *cacheRecords(stKVDatabase *database, stList *caps, char *(*segme
     return cache;
 }
 
-static void deleteNestedRecords(stKVDatabase *database, stList *caps) {
+static void deleteNestedRecords(CactusSecondaryDatabase *database, stList *caps) {
     /*
      * Removes the non-terminal adjacencies from the database.
      */
@@ -142,7 +150,7 @@ static void deleteNestedRecords(stKVDatabase *database, stList *caps) {
     stList_setDestructor(deleteRequests, (void(*)(void *)) stIntTuple_destruct);
     //Do the deletion of the records
     stTry {
-            stKVDatabase_bulkRemoveRecords(database, deleteRequests);
+            cactusSecondaryDatabase_bulkRemoveRecords(database, deleteRequests);
         }stCatch(except)
             {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
@@ -163,20 +171,20 @@ static char *getThread(stCache *cache, Cap *startCap) {
         int64_t recordSize;
         assert(stCache_containsRecord(cache, cap_getName(cap), 0, INT64_MAX));
         void *data = stCache_getRecord(cache, cap_getName(cap), 0, INT64_MAX, &recordSize);
-        stList_append(strings, decompress(data, recordSize));
+        stList_append(strings, decompress(getCactusDisk(startCap), data, recordSize));
         if ((cap = cap_getOtherSegmentCap(adjacentCap)) == NULL) {
             break;
         }
         assert(stCache_containsRecord(cache, segment_getName(cap_getSegment(adjacentCap)), 0, INT64_MAX));
         data = stCache_getRecord(cache, segment_getName(cap_getSegment(adjacentCap)), 0, INT64_MAX, &recordSize);
-        stList_append(strings, decompress(data, recordSize));
+        stList_append(strings, decompress(getCactusDisk(startCap), data, recordSize));
     }
     char *string = stString_join2("", strings);
     stList_destruct(strings);
     return string;
 }
 
-void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
+void buildRecursiveThreads(CactusSecondaryDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *)) {
     //Cache records
     stCache *cache = cacheRecords(database, caps, segmentWriteFn, terminalAdjacencyWriteFn);
@@ -188,7 +196,7 @@ void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segment
         char *string = getThread(cache, cap);
         assert(string != NULL);
         int64_t recordSize;
-        void *data = compress(string, &recordSize);
+        void *data = compress(getCactusDisk(cap), string, &recordSize);
         stList_append(records, stKVDatabaseBulkRequest_constructInsertRequest(cap_getName(cap), data, recordSize));
         free(data);
     }
@@ -196,7 +204,7 @@ void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segment
     //Delete old records and insert new records
     deleteNestedRecords(database, caps);
     stTry {
-            stKVDatabase_bulkSetRecords(database, records);
+            cactusSecondaryDatabase_bulkSetRecords(database, records);
         }stCatch(except)
             {
                 stThrowNewCause(except, ST_KV_DATABASE_EXCEPTION_ID,
@@ -208,7 +216,7 @@ void buildRecursiveThreads(stKVDatabase *database, stList *caps, char *(*segment
     stList_destruct(records);
 }
 
-stList *buildRecursiveThreadsInList(stKVDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
+stList *buildRecursiveThreadsInList(CactusSecondaryDatabase *database, stList *caps, char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *)) {
     stList *threadStrings = stList_construct3(0, free);
 
@@ -8,11 +8,11 @@
 #ifndef RECURSIVETHREADBUILDER_H_
 #define RECURSIVETHREADBUILDER_H_
 
-void buildRecursiveThreads(stKVDatabase *database, stList *caps,
+void buildRecursiveThreads(CactusSecondaryDatabase *database, stList *caps,
         char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *));
 
-stList *buildRecursiveThreadsInList(stKVDatabase *database, stList *caps,
+stList *buildRecursiveThreadsInList(CactusSecondaryDatabase *database, stList *caps,
         char *(*segmentWriteFn)(Segment *),
         char *(*terminalAdjacencyWriteFn)(Cap *));
 
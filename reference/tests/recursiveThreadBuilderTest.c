@@ -79,18 +79,18 @@ static void recursiveFileBuilder_test(CuTest *testCase) {
     //Create the sequence database
     stKVDatabaseConf *secondaryConf = stKVDatabaseConf_constructTokyoCabinet(
                     stFile_pathJoin(tempDir, "temporaryCactusDisk2"));
-    stKVDatabase *secondaryDatabase = stKVDatabase_construct(secondaryConf, 1);
+    CactusSecondaryDatabase *secondaryDatabase = cactusSecondaryDatabase_construct(secondaryConf, 1);
     stList *caps = stList_construct();
     stList_append(caps, flower_getCap(nestedFlower, cap_getName(cap1)));
     buildRecursiveThreads(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency);
-    stKVDatabase_destruct(secondaryDatabase);
+    cactusSecondaryDatabase_destruct(secondaryDatabase);
 
     //Now complete the alignment
-    secondaryDatabase = stKVDatabase_construct(secondaryConf, 0);
+    secondaryDatabase = cactusSecondaryDatabase_construct(secondaryConf, 0);
     stList_pop(caps);
     stList_append(caps, cap1);
     stList *threadStrings = buildRecursiveThreadsInList(secondaryDatabase, caps, writeSegment, writeTerminalAdjacency);
-    stKVDatabase_deleteFromDisk(secondaryDatabase);
+    cactusSecondaryDatabase_deleteFromDisk(secondaryDatabase);
 
     CuAssertIntEquals(testCase, 1, stList_length(threadStrings));
     CuAssertStrEquals(testCase, "1 ACG 3 TA ", stList_get(threadStrings, 0));
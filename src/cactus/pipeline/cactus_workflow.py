@@ -299,6 +299,9 @@ class SavePrimaryDB(CactusPhasesJob):
                                      flowerName=0)
         fileStore.logToMaster("At end of %s phase, got stats %s" % (self.phaseName, stats))
         dbElem = DbElemWrapper(ET.fromstring(self.cactusWorkflowArguments.cactusDiskDatabaseString))
+        if dbElem.getDbType() != "kyoto_tycoon":
+            # Embedded databases persist in place, there is no server to snapshot.
+            return None
         # Send the terminate message
         stopKtserver(dbElem)
         # Wait for the file to appear in the right place. This may take a while
@@ -1387,6 +1390,9 @@ class CactusWorkflowArguments:
         #Secondary, scratch DB
         secondaryConf = copy.deepcopy(self.experimentNode.find("cactus_disk").find("st_kv_database_conf"))
         secondaryElem = DbElemWrapper(secondaryConf)
+        if secondaryElem.getDbType() == "local":
+            # A local database is the log in its directory, so the secondary needs a directory of its own.
+            secondaryElem.getDbElem().attrib["database_dir"] = secondaryElem.getDbElem().attrib["database_dir"].rstrip("/") + "_secondary"
         self.secondaryDatabaseString = secondaryElem.getConfString()
 
         #The config node
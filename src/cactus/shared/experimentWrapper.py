@@ -20,7 +20,9 @@ class DbElemWrapper(object):
         dbElem = confElem.find(typeString)
         self.dbElem = dbElem
         self.confElem = confElem
-        self.dbElem.attrib["database_dir"] = "fakepath"
+        if typeString != "local":
+            # The embedded local database is shared through its directory, so keep the real path.
+            self.dbElem.attrib["database_dir"] = "fakepath"
 
     def check(self):
         """Function checks the database conf is as expected and creates useful exceptions
@@ -43,6 +45,12 @@ class DbElemWrapper(object):
                 raise RuntimeError("Database conf is of kyoto tycoon but there is no nested kyoto tycoon tag: %s" % dataString)
             if not set(("host", "port", "database_dir")).issubset(set(kyotoTycoon.attrib.keys())):
                 raise RuntimeError("The kyoto tycoon tag has a missing attribute: %s" % dataString)
+        elif typeString == "local":
+            local = self.confElem.find("local")
+            if local == None:
+                raise RuntimeError("Database conf is of type local but there is no nested local tag: %s" % dataString)
+            if not local.attrib.has_key("database_dir"):
+                raise RuntimeError("The local tag has no database_dir tag: %s" % dataString)
         else:
             raise RuntimeError("Unrecognised database type in conf string: %s" % typeString)
 